@@ -747,8 +747,6 @@ bool AiInterface::isResourceNear(const Vec2i &pos, const ResourceType *rt, Vec2i
 bool AiInterface::getNearestSightedResource(const ResourceType *rt, const Vec2i &pos,
 											Vec2i &resultPos, bool usableResourceTypeOnly) {
 	Faction *faction = world->getFaction(factionIndex);
-	//float tmpDist=0;
-	float nearestDist= infinity;
 	bool anyResource= false;
 	resultPos.x = -1;
 	resultPos.y = -1;
@@ -786,33 +784,11 @@ bool AiInterface::getNearestSightedResource(const ResourceType *rt, const Vec2i
 		}
 		else {
 			const Map *map		= world->getMap();
-			//Faction *faction 	= world->getFaction(factionIndex);
-
-			for(int i = 0; i < map->getW(); ++i) {
-				for(int j = 0; j < map->getH(); ++j) {
-					Vec2i resPos = Vec2i(i, j);
-					Vec2i surfPos= Map::toSurfCoords(resPos);
-					SurfaceCell *sc = map->getSurfaceCell(surfPos);
-
-					//if explored cell
-					if(sc != NULL && sc->isExplored(teamIndex)) {
-						Resource *r= sc->getResource();
-
-						//if resource cell
-						if(r != NULL) {
-							if(r->getType() == rt) {
-								float tmpDist= pos.dist(resPos);
-								if(tmpDist < nearestDist) {
-									anyResource= true;
-									nearestDist= tmpDist;
-									resultPos= resPos;
-								}
-							}
-
-							//faction->addResourceTargetToCache(resPos,false);
-						}
-					}
-				}
+
+			// nearest explored cell of the resource type, searched through
+			// the resource index of the map instead of every map cell
+			if(map->getResourceSpatialIndex()->findNearestResourceCell(rt, pos, map, teamIndex, resultPos) == true) {
+				anyResource= true;
 			}
 		}
 	}
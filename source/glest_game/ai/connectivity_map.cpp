@@ -0,0 +1,287 @@
+// ==============================================================
+//	This file is part of Glest (www.glest.org)
+//
+//	Copyright (C) 2001-2008 Martiño Figueroa
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#include "connectivity_map.h"
+
+#include <algorithm>
+
+#include "map.h"
+#include "conversion.h"
+#include "platform_common.h"
+#include "leak_dumper.h"
+
+using namespace std;
+using namespace Shared::Util;
+using namespace Shared::PlatformCommon;
+
+namespace Glest{ namespace Game{
+
+// =====================================================
+// 	class ConnectivityMap
+// =====================================================
+
+// ===================== PUBLIC ========================
+
+ConnectivityMap::ConnectivityMap(const Map *map) {
+	if(map == NULL) {
+		throw megaglest_runtime_error("map == NULL");
+	}
+	this->map = map;
+	this->mutex = new Mutex();
+}
+
+ConnectivityMap::~ConnectivityMap() {
+	for(LayerMap::iterator iterMap = layers.begin(); iterMap != layers.end(); ++iterMap) {
+		delete iterMap->second;
+	}
+	layers.clear();
+	map = NULL;
+
+	delete mutex;
+	mutex = NULL;
+}
+
+void ConnectivityMap::cellsChanged(const Vec2i &pos, int size) {
+	static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
+	MutexSafeWrapper safeMutex(mutex,mutexOwnerId);
+
+	for(LayerMap::iterator iterMap = layers.begin(); iterMap != layers.end(); ++iterMap) {
+		Layer *layer = iterMap->second;
+
+		int minX = max(pos.x - (layer->unitSize - 1), 0);
+		int minY = max(pos.y - (layer->unitSize - 1), 0);
+		int maxX = min(pos.x + size - 1, map->getW() - 1);
+		int maxY = min(pos.y + size - 1, map->getH() - 1);
+
+		vector<Vec2i> freedCells;
+		for(int y = minY; y <= maxY; ++y) {
+			for(int x = minX; x <= maxX; ++x) {
+				Vec2i cellPos(x, y);
+				int index = y * map->getW() + x;
+				bool passable = isPassable(layer, cellPos);
+				if(passable == layer->passable[index]) {
+					continue;
+				}
+				layer->passable[index] = passable;
+
+				// a new obstacle may split a region, that needs a full relabel
+				if(passable == false) {
+					layer->dirty = true;
+				}
+				else {
+					freedCells.push_back(cellPos);
+				}
+			}
+		}
+
+		if(layer->dirty == false) {
+			for(unsigned int i = 0; i < freedCells.size(); ++i) {
+				mergeFreedCell(layer, freedCells[i]);
+			}
+		}
+	}
+}
+
+bool ConnectivityMap::isReachable(Field field, int unitSize, const Vec2i &from, const Vec2i &to) {
+	static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
+	MutexSafeWrapper safeMutex(mutex,mutexOwnerId);
+
+	Layer *layer = getLayer(field, unitSize);
+	int fromRegion = getRegion(layer, from);
+
+	// unknown start, let the regular search decide
+	if(fromRegion == 0) {
+		return true;
+	}
+	return (fromRegion == getRegion(layer, to));
+}
+
+bool ConnectivityMap::findNearestReachable(Field field, int unitSize, const Vec2i &from, const Vec2i &target, int radius, Vec2i &result) {
+	static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
+	MutexSafeWrapper safeMutex(mutex,mutexOwnerId);
+
+	Layer *layer = getLayer(field, unitSize);
+	int fromRegion = getRegion(layer, from);
+	if(fromRegion == 0) {
+		return false;
+	}
+
+	bool found = false;
+	int nearestDist = 0;
+	for(int y = target.y - radius; y <= target.y + radius; ++y) {
+		for(int x = target.x - radius; x <= target.x + radius; ++x) {
+			Vec2i cellPos(x, y);
+			int dist = (x - target.x) * (x - target.x) + (y - target.y) * (y - target.y);
+			if((found == false || dist < nearestDist) &&
+				getRegion(layer, cellPos) == fromRegion) {
+				result = cellPos;
+				nearestDist = dist;
+				found = true;
+			}
+		}
+	}
+	return found;
+}
+
+string ConnectivityMap::getStats() {
+	static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
+	MutexSafeWrapper safeMutex(mutex,mutexOwnerId);
+
+	string result = "layers = " + intToStr(layers.size());
+	for(LayerMap::iterator iterMap = layers.begin(); iterMap != layers.end(); ++iterMap) {
+		const Layer *layer = iterMap->second;
+		result += " [field = " + intToStr(layer->field) +
+				  " size = " + intToStr(layer->unitSize) +
+				  " labels = " + intToStr(layer->parents.size()) +
+				  " relabels = " + intToStr(layer->relabelCount) +
+				  " dirty = " + intToStr(layer->dirty) + "]";
+	}
+	return result;
+}
+
+// ==================== PRIVATE ====================
+
+ConnectivityMap::Layer * ConnectivityMap::getLayer(Field field, int unitSize) {
+	std::pair<int,int> key(field, unitSize);
+	LayerMap::iterator iterFind = layers.find(key);
+	if(iterFind != layers.end()) {
+		return iterFind->second;
+	}
+
+	Layer *layer = new Layer();
+	layer->field = field;
+	layer->unitSize = unitSize;
+	layer->passable.resize(map->getW() * map->getH(), false);
+	for(int y = 0; y < map->getH(); ++y) {
+		for(int x = 0; x < map->getW(); ++x) {
+			layer->passable[y * map->getW() + x] = isPassable(layer, Vec2i(x, y));
+		}
+	}
+	layer->dirty = true;
+	layers[key] = layer;
+
+	return layer;
+}
+
+void ConnectivityMap::labelLayer(Layer *layer) {
+	const int w = map->getW();
+	const int h = map->getH();
+
+	layer->labels.assign(w * h, 0);
+	layer->parents.clear();
+	// label 0 is reserved for blocked cells
+	layer->parents.push_back(0);
+
+	vector<int> openCells;
+	for(int start = 0; start < w * h; ++start) {
+		if(layer->passable[start] == false || layer->labels[start] != 0) {
+			continue;
+		}
+
+		int label = (int)layer->parents.size();
+		layer->parents.push_back(label);
+		layer->labels[start] = label;
+
+		openCells.clear();
+		openCells.push_back(start);
+		while(openCells.empty() == false) {
+			int index = openCells.back();
+			openCells.pop_back();
+			Vec2i cellPos(index % w, index / w);
+
+			for(int i = -1; i <= 1; ++i) {
+				for(int j = -1; j <= 1; ++j) {
+					Vec2i nextPos(cellPos.x + i, cellPos.y + j);
+					if((i == 0 && j == 0) || map->isInside(nextPos) == false) {
+						continue;
+					}
+					int nextIndex = nextPos.y * w + nextPos.x;
+					if(layer->labels[nextIndex] == 0 && canStep(layer, cellPos, nextPos) == true) {
+						layer->labels[nextIndex] = label;
+						openCells.push_back(nextIndex);
+					}
+				}
+			}
+		}
+	}
+
+	layer->dirty = false;
+	layer->relabelCount++;
+}
+
+void ConnectivityMap::mergeFreedCell(Layer *layer, const Vec2i &pos) {
+	int index = pos.y * map->getW() + pos.x;
+	int label = (int)layer->parents.size();
+	layer->parents.push_back(label);
+	layer->labels[index] = label;
+
+	for(int i = -1; i <= 1; ++i) {
+		for(int j = -1; j <= 1; ++j) {
+			Vec2i nextPos(pos.x + i, pos.y + j);
+			if((i == 0 && j == 0) || map->isInside(nextPos) == false) {
+				continue;
+			}
+			int nextLabel = layer->labels[nextPos.y * map->getW() + nextPos.x];
+			if(nextLabel != 0 && canStep(layer, pos, nextPos) == true) {
+				int root = findRoot(layer, label);
+				int nextRoot = findRoot(layer, nextLabel);
+				if(root != nextRoot) {
+					// keep the lower label as root so results do not depend on merge order
+					layer->parents[max(root, nextRoot)] = min(root, nextRoot);
+				}
+			}
+		}
+	}
+}
+
+int ConnectivityMap::getRegion(Layer *layer, const Vec2i &pos) {
+	if(map->isInside(pos) == false) {
+		return 0;
+	}
+	if(layer->dirty == true) {
+		labelLayer(layer);
+	}
+	int label = layer->labels[pos.y * map->getW() + pos.x];
+	return (label == 0 ? 0 : findRoot(layer, label));
+}
+
+int ConnectivityMap::findRoot(Layer *layer, int label) {
+	int root = label;
+	while(layer->parents[root] != root) {
+		root = layer->parents[root];
+	}
+	// path compression
+	while(layer->parents[label] != root) {
+		int next = layer->parents[label];
+		layer->parents[label] = root;
+		label = next;
+	}
+	return root;
+}
+
+bool ConnectivityMap::isPassable(const Layer *layer, const Vec2i &pos) const {
+	return map->isStaticFreeCells(pos, layer->unitSize, layer->field);
+}
+
+// same step rule as Map::aproxCanMove: no corner cutting for single cell units
+bool ConnectivityMap::canStep(const Layer *layer, const Vec2i &from, const Vec2i &to) const {
+	const int w = map->getW();
+	if(layer->passable[to.y * w + to.x] == false) {
+		return false;
+	}
+	if(layer->unitSize == 1 && from.x != to.x && from.y != to.y) {
+		return (layer->passable[to.y * w + from.x] == true &&
+				layer->passable[from.y * w + to.x] == true);
+	}
+	return true;
+}
+
+}}//end namespace
@@ -0,0 +1,87 @@
+// ==============================================================
+//	This file is part of Glest (www.glest.org)
+//
+//	Copyright (C) 2001-2008 Martiño Figueroa
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#ifndef _GLEST_GAME_CONNECTIVITYMAP_H_
+#define _GLEST_GAME_CONNECTIVITYMAP_H_
+
+#ifdef WIN32
+    #include <winsock2.h>
+    #include <winsock.h>
+#endif
+
+#include "vec.h"
+#include <vector>
+#include <map>
+#include <string>
+#include "skill_type.h"
+#include "thread.h"
+#include "leak_dumper.h"
+
+using std::vector;
+using std::string;
+using Shared::Graphics::Vec2i;
+using Shared::Platform::Mutex;
+
+namespace Glest { namespace Game {
+
+class Map;
+
+// =====================================================
+// 	class ConnectivityMap
+//
+///	Labels the connected regions of the static map per
+///	field and unit size so impossible path requests can
+///	be detected without searching
+// =====================================================
+
+class ConnectivityMap {
+private:
+	class Layer {
+	public:
+		Layer() { field = fLand; unitSize = 1; dirty = true; relabelCount = 0; }
+		Field field;
+		int unitSize;
+		vector<bool> passable;
+		// 0 for blocked cells, otherwise an index into parents
+		vector<int> labels;
+		// union-find over labels, regions merge when cells become free
+		vector<int> parents;
+		bool dirty;
+		int relabelCount;
+	};
+	typedef std::map<std::pair<int,int>, Layer *> LayerMap;
+
+	const Map *map;
+	Mutex *mutex;
+	LayerMap layers;
+
+public:
+	ConnectivityMap(const Map *map);
+	~ConnectivityMap();
+
+	void cellsChanged(const Vec2i &pos, int size);
+	bool isReachable(Field field, int unitSize, const Vec2i &from, const Vec2i &to);
+	bool findNearestReachable(Field field, int unitSize, const Vec2i &from, const Vec2i &target, int radius, Vec2i &result);
+	string getStats();
+
+private:
+	Layer *getLayer(Field field, int unitSize);
+	void labelLayer(Layer *layer);
+	void mergeFreedCell(Layer *layer, const Vec2i &pos);
+	int getRegion(Layer *layer, const Vec2i &pos);
+	int findRoot(Layer *layer, int label);
+	bool isPassable(const Layer *layer, const Vec2i &pos) const;
+	bool canStep(const Layer *layer, const Vec2i &from, const Vec2i &to) const;
+};
+
+}}//end namespace
+
+#endif
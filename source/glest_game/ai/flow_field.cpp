@@ -0,0 +1,272 @@
+// ==============================================================
+//	This file is part of Glest (www.glest.org)
+//
+//	Copyright (C) 2001-2008 Martiño Figueroa
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#include "flow_field.h"
+
+#include <queue>
+#include <functional>
+
+#include "map.h"
+#include "conversion.h"
+#include "platform_common.h"
+#include "leak_dumper.h"
+
+using namespace std;
+using namespace Shared::Util;
+using namespace Shared::PlatformCommon;
+
+namespace Glest{ namespace Game{
+
+// =====================================================
+// 	class FlowFieldCache
+// =====================================================
+
+const int FlowFieldCache::maxCachedFields	= 8;
+const int FlowFieldCache::maxSeedRadius		= 10;
+const int FlowFieldCache::straightCost		= 10;
+const int FlowFieldCache::diagonalCost		= 14;
+const int FlowFieldCache::directionCount	= 8;
+const int FlowFieldCache::directionOffsets[8][2] = {
+	{ 0,-1}, { 1, 0}, { 0, 1}, {-1, 0},
+	{ 1,-1}, { 1, 1}, {-1, 1}, {-1,-1}
+};
+
+// ===================== PUBLIC ========================
+
+FlowFieldCache::FlowFieldCache(const Map *map) {
+	if(map == NULL) {
+		throw megaglest_runtime_error("map == NULL");
+	}
+	this->map = map;
+	this->mutex = new Mutex();
+	this->buildCount = 0;
+}
+
+FlowFieldCache::~FlowFieldCache() {
+	clear();
+	map = NULL;
+
+	delete mutex;
+	mutex = NULL;
+}
+
+void FlowFieldCache::clear() {
+	static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
+	MutexSafeWrapper safeMutex(mutex,mutexOwnerId);
+
+	for(FlowFieldMap::iterator iterMap = fields.begin(); iterMap != fields.end(); ++iterMap) {
+		delete iterMap->second;
+	}
+	fields.clear();
+	fieldUsage.clear();
+}
+
+bool FlowFieldCache::getDownhillSteps(const FlowFieldKey &key, const Vec2i &from, vector<Vec2i> &steps) {
+	static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
+	MutexSafeWrapper safeMutex(mutex,mutexOwnerId);
+
+	steps.clear();
+	if(map->isInside(from) == false) {
+		return false;
+	}
+	const FlowField *flowField = getField(key);
+	const int w = map->getW();
+	int fromCost = flowField->costs[from.y * w + from.x];
+	if(fromCost < 0) {
+		return false;
+	}
+
+	vector<int> stepCosts;
+	for(int i = 0; i < directionCount; ++i) {
+		Vec2i nextPos(from.x + directionOffsets[i][0], from.y + directionOffsets[i][1]);
+		if(map->isInside(nextPos) == false) {
+			continue;
+		}
+		int nextCost = flowField->costs[nextPos.y * w + nextPos.x];
+		if(nextCost < 0 || nextCost >= fromCost) {
+			continue;
+		}
+		int expectedCost = nextCost + (i < 4 ? straightCost : diagonalCost);
+		// next to a reachable cell a negative cost means blocked, no corner cutting
+		if(i >= 4 && key.unitSize == 1 &&
+			(flowField->costs[from.y * w + nextPos.x] < 0 ||
+			 flowField->costs[nextPos.y * w + from.x] < 0)) {
+			continue;
+		}
+
+		// stable insertion keeps the direction order as tie breaker
+		vector<int>::iterator iterCost = stepCosts.begin();
+		vector<Vec2i>::iterator iterStep = steps.begin();
+		while(iterCost != stepCosts.end() && *iterCost <= expectedCost) {
+			++iterCost;
+			++iterStep;
+		}
+		stepCosts.insert(iterCost, expectedCost);
+		steps.insert(iterStep, nextPos);
+	}
+	return true;
+}
+
+bool FlowFieldCache::getPath(const FlowFieldKey &key, const Vec2i &from, int maxSteps, vector<Vec2i> &path) {
+	static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
+	MutexSafeWrapper safeMutex(mutex,mutexOwnerId);
+
+	if(map->isInside(from) == false) {
+		return false;
+	}
+	const FlowField *flowField = getField(key);
+	const int w = map->getW();
+	if(flowField->costs[from.y * w + from.x] < 0) {
+		return false;
+	}
+
+	Vec2i pos = from;
+	for(int step = 0; step < maxSteps; ++step) {
+		int direction = flowField->directions[pos.y * w + pos.x];
+		if(direction < 0) {
+			break;
+		}
+		pos.x += directionOffsets[direction][0];
+		pos.y += directionOffsets[direction][1];
+		path.push_back(pos);
+	}
+	return true;
+}
+
+string FlowFieldCache::getStats() {
+	static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
+	MutexSafeWrapper safeMutex(mutex,mutexOwnerId);
+
+	return "fields = " + intToStr(fields.size()) + " builds = " + intToStr(buildCount);
+}
+
+// ==================== PRIVATE ====================
+
+FlowFieldCache::FlowField * FlowFieldCache::getField(const FlowFieldKey &key) {
+	FlowField *flowField = NULL;
+	FlowFieldMap::iterator iterFind = fields.find(key);
+	if(iterFind != fields.end()) {
+		flowField = iterFind->second;
+		for(std::list<FlowFieldKey>::iterator iterUsage = fieldUsage.begin(); iterUsage != fieldUsage.end(); ++iterUsage) {
+			if((*iterUsage < key) == false && (key < *iterUsage) == false) {
+				fieldUsage.erase(iterUsage);
+				break;
+			}
+		}
+	}
+	else {
+		// fields only depend on the static map, evicting one just costs a rebuild
+		if((int)fields.size() >= maxCachedFields) {
+			FlowFieldKey oldestKey = fieldUsage.back();
+			fieldUsage.pop_back();
+			delete fields[oldestKey];
+			fields.erase(oldestKey);
+		}
+		flowField = buildField(key);
+		fields[key] = flowField;
+	}
+	fieldUsage.push_front(key);
+
+	return flowField;
+}
+
+FlowFieldCache::FlowField * FlowFieldCache::buildField(const FlowFieldKey &key) {
+	const int w = map->getW();
+	const int h = map->getH();
+
+	vector<bool> passable(w * h, false);
+	for(int y = 0; y < h; ++y) {
+		for(int x = 0; x < w; ++x) {
+			passable[y * w + x] = map->isStaticFreeCells(Vec2i(x, y), key.unitSize, key.field);
+		}
+	}
+
+	FlowField *flowField = new FlowField();
+	flowField->costs.assign(w * h, -1);
+	flowField->directions.assign(w * h, -1);
+
+	typedef std::pair<int,int> CostEntry;
+	std::priority_queue<CostEntry, vector<CostEntry>, std::greater<CostEntry> > openCells;
+
+	// a blocked target (building, resource) is approached from the nearest free ring
+	for(int radius = 0; radius <= maxSeedRadius && openCells.empty() == true; ++radius) {
+		for(int y = key.target.y - radius; y <= key.target.y + radius; ++y) {
+			for(int x = key.target.x - radius; x <= key.target.x + radius; ++x) {
+				Vec2i seedPos(x, y);
+				if(max(abs(x - key.target.x), abs(y - key.target.y)) != radius ||
+					map->isInside(seedPos) == false || passable[y * w + x] == false) {
+					continue;
+				}
+				flowField->costs[y * w + x] = 0;
+				openCells.push(CostEntry(0, y * w + x));
+			}
+		}
+	}
+
+	while(openCells.empty() == false) {
+		CostEntry entry = openCells.top();
+		openCells.pop();
+		if(entry.first > flowField->costs[entry.second]) {
+			continue;
+		}
+		Vec2i pos(entry.second % w, entry.second / w);
+
+		for(int i = 0; i < directionCount; ++i) {
+			Vec2i nextPos(pos.x + directionOffsets[i][0], pos.y + directionOffsets[i][1]);
+			if(map->isInside(nextPos) == false || canStep(passable, key.unitSize, pos, nextPos) == false) {
+				continue;
+			}
+			int nextIndex = nextPos.y * w + nextPos.x;
+			int nextCost = entry.first + (i < 4 ? straightCost : diagonalCost);
+			if(flowField->costs[nextIndex] < 0 || nextCost < flowField->costs[nextIndex]) {
+				flowField->costs[nextIndex] = nextCost;
+				openCells.push(CostEntry(nextCost, nextIndex));
+			}
+		}
+	}
+
+	// direction field, the neighbour on a shortest route in fixed direction order
+	for(int index = 0; index < w * h; ++index) {
+		int cost = flowField->costs[index];
+		if(cost <= 0) {
+			continue;
+		}
+		Vec2i pos(index % w, index / w);
+		for(int i = 0; i < directionCount; ++i) {
+			Vec2i nextPos(pos.x + directionOffsets[i][0], pos.y + directionOffsets[i][1]);
+			if(map->isInside(nextPos) == false || canStep(passable, key.unitSize, pos, nextPos) == false) {
+				continue;
+			}
+			int nextCost = flowField->costs[nextPos.y * w + nextPos.x];
+			if(nextCost >= 0 && nextCost + (i < 4 ? straightCost : diagonalCost) == cost) {
+				flowField->directions[index] = i;
+				break;
+			}
+		}
+	}
+
+	buildCount++;
+	return flowField;
+}
+
+// same step rule as Map::aproxCanMove: no corner cutting for single cell units
+bool FlowFieldCache::canStep(const vector<bool> &passable, int unitSize, const Vec2i &from, const Vec2i &to) const {
+	const int w = map->getW();
+	if(passable[to.y * w + to.x] == false) {
+		return false;
+	}
+	if(unitSize == 1 && from.x != to.x && from.y != to.y) {
+		return (passable[to.y * w + from.x] == true && passable[from.y * w + to.x] == true);
+	}
+	return true;
+}
+
+}}//end namespace
@@ -0,0 +1,114 @@
+// ==============================================================
+//	This file is part of Glest (www.glest.org)
+//
+//	Copyright (C) 2001-2008 Martiño Figueroa
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#ifndef _GLEST_GAME_FLOWFIELD_H_
+#define _GLEST_GAME_FLOWFIELD_H_
+
+#ifdef WIN32
+    #include <winsock2.h>
+    #include <winsock.h>
+#endif
+
+#include "vec.h"
+#include <vector>
+#include <map>
+#include <list>
+#include <string>
+#include "skill_type.h"
+#include "thread.h"
+#include "leak_dumper.h"
+
+using std::vector;
+using std::string;
+using Shared::Graphics::Vec2i;
+using Shared::Platform::Mutex;
+
+namespace Glest { namespace Game {
+
+class Map;
+
+// =====================================================
+// 	class FlowFieldKey
+// =====================================================
+
+class FlowFieldKey {
+public:
+	FlowFieldKey() { field = fLand; unitSize = 1; }
+	FlowFieldKey(const Vec2i &target, Field field, int unitSize) {
+		this->target = target;
+		this->field = field;
+		this->unitSize = unitSize;
+	}
+
+	Vec2i target;
+	Field field;
+	int unitSize;
+
+	bool operator<(const FlowFieldKey &other) const {
+		if(target.x != other.target.x) return target.x < other.target.x;
+		if(target.y != other.target.y) return target.y < other.target.y;
+		if(field != other.field) return field < other.field;
+		return unitSize < other.unitSize;
+	}
+};
+
+// =====================================================
+// 	class FlowFieldCache
+//
+///	Integration and direction fields towards a target over
+///	the static map, shared by every unit heading there
+// =====================================================
+
+class FlowFieldCache {
+public:
+	static const int maxCachedFields;
+	static const int maxSeedRadius;
+
+private:
+	// integral costs keep the fields identical on every client
+	static const int straightCost;
+	static const int diagonalCost;
+	static const int directionCount;
+	static const int directionOffsets[8][2];
+
+	class FlowField {
+	public:
+		// -1 for cells that cannot reach the target
+		vector<int> costs;
+		// index into directionOffsets, -1 at the target or when unreachable
+		vector<signed char> directions;
+	};
+	typedef std::map<FlowFieldKey, FlowField *> FlowFieldMap;
+
+	const Map *map;
+	Mutex *mutex;
+	FlowFieldMap fields;
+	std::list<FlowFieldKey> fieldUsage;
+	int buildCount;
+
+public:
+	FlowFieldCache(const Map *map);
+	~FlowFieldCache();
+
+	void clear();
+	bool getDownhillSteps(const FlowFieldKey &key, const Vec2i &from, vector<Vec2i> &steps);
+	bool getPath(const FlowFieldKey &key, const Vec2i &from, int maxSteps, vector<Vec2i> &path);
+	string getStats();
+
+private:
+	FlowField *getField(const FlowFieldKey &key);
+	FlowField *buildField(const FlowFieldKey &key);
+	bool canStep(const vector<bool> &passable, int unitSize, const Vec2i &from, const Vec2i &to) const;
+};
+
+}}//end namespace
+
+#endif
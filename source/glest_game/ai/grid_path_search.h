@@ -0,0 +1,136 @@
+// ==============================================================
+//	This file is part of Glest (www.glest.org)
+//
+//	Copyright (C) 2001-2008 Martiño Figueroa
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#ifndef _GLEST_GAME_GRIDPATHSEARCH_H_
+#define _GLEST_GAME_GRIDPATHSEARCH_H_
+
+#include "vec.h"
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+#include "leak_dumper.h"
+
+using Shared::Graphics::Vec2i;
+
+namespace Glest { namespace Game {
+
+// =====================================================
+// 	Grid path search
+//
+///	Map independent parts of the flat pathfinder searches.
+///	A Grid provides isEnterable(pos) and isExplored(pos).
+// =====================================================
+
+// octile distance with integral costs so all clients order nodes identically
+inline int jumpPointDistance(const Vec2i &pos1, const Vec2i &pos2) {
+	int dx = abs(pos1.x - pos2.x);
+	int dy = abs(pos1.y - pos2.y);
+	return 10 * (std::max(dx, dy) - std::min(dx, dy)) + 14 * std::min(dx, dy);
+}
+
+// diagonal steps never cut corners
+template<typename Grid>
+bool canJumpPointStep(Grid &grid, const Vec2i &pos, int dx, int dy) {
+	if(grid.isEnterable(Vec2i(pos.x + dx, pos.y + dy)) == false) {
+		return false;
+	}
+	if(dx != 0 && dy != 0) {
+		return (grid.isEnterable(Vec2i(pos.x + dx, pos.y)) == true &&
+				grid.isEnterable(Vec2i(pos.x, pos.y + dy)) == true);
+	}
+	return true;
+}
+
+// Scans are capped at maxDistance and the cell at the cap becomes a jump
+// point. A diagonal cell whose straight scans reach the cap is kept as a
+// jump point too, otherwise corridors longer than the cap are never entered.
+template<typename Grid>
+bool findJumpPoint(Grid &grid, const Vec2i &start, int dx, int dy, const Vec2i &finalPos, int maxDistance, Vec2i &jumpPoint) {
+	Vec2i pos = start;
+	for(int distance = 1; ; ++distance) {
+		if(canJumpPointStep(grid, pos, dx, dy) == false) {
+			return false;
+		}
+		pos.x += dx;
+		pos.y += dy;
+
+		if(pos == finalPos || grid.isExplored(pos) == false) {
+			jumpPoint = pos;
+			return true;
+		}
+		if(distance >= maxDistance) {
+			jumpPoint = pos;
+			return true;
+		}
+
+		if(dx != 0 && dy != 0) {
+			Vec2i straightJumpPoint;
+			if(findJumpPoint(grid, pos, dx, 0, finalPos, maxDistance, straightJumpPoint) == true ||
+			   findJumpPoint(grid, pos, 0, dy, finalPos, maxDistance, straightJumpPoint) == true) {
+				jumpPoint = pos;
+				return true;
+			}
+		}
+		else if(dx != 0) {
+			if((grid.isEnterable(Vec2i(pos.x, pos.y - 1)) == true && grid.isEnterable(Vec2i(pos.x - dx, pos.y - 1)) == false) ||
+			   (grid.isEnterable(Vec2i(pos.x, pos.y + 1)) == true && grid.isEnterable(Vec2i(pos.x - dx, pos.y + 1)) == false)) {
+				jumpPoint = pos;
+				return true;
+			}
+		}
+		else {
+			if((grid.isEnterable(Vec2i(pos.x - 1, pos.y)) == true && grid.isEnterable(Vec2i(pos.x - 1, pos.y - dy)) == false) ||
+			   (grid.isEnterable(Vec2i(pos.x + 1, pos.y)) == true && grid.isEnterable(Vec2i(pos.x + 1, pos.y - dy)) == false)) {
+				jumpPoint = pos;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// Chains a node for each cell of a ready made route behind firstNode and
+// returns the last one. nodeSource.newNode() returns NULL once the node
+// pool is used up, the chain then simply ends early.
+template<typename NodeType, typename NodeSource>
+NodeType *chainPathNodes(NodeType *firstNode, const std::vector<Vec2i> &cells, NodeSource &nodeSource) {
+	NodeType *node = firstNode;
+	for(unsigned int i = 0; i < cells.size(); ++i) {
+		NodeType *pathNode = nodeSource.newNode();
+		if(pathNode == NULL) {
+			break;
+		}
+		pathNode->pos = cells[i];
+		pathNode->prev = node;
+		pathNode->next = NULL;
+		node = pathNode;
+	}
+	return node;
+}
+
+// Returns every cell along the node chain, jump point nodes are linked
+// across straight or diagonal runs which are filled in here
+template<typename NodeType>
+void getPathCells(const NodeType *firstNode, std::vector<Vec2i> &cells) {
+	for(const NodeType *currNode = firstNode; currNode->next != NULL; currNode = currNode->next) {
+		Vec2i pos = currNode->pos;
+		const Vec2i &nextPos = currNode->next->pos;
+		while(pos != nextPos) {
+			pos.x += (nextPos.x > pos.x ? 1 : (nextPos.x < pos.x ? -1 : 0));
+			pos.y += (nextPos.y > pos.y ? 1 : (nextPos.y < pos.y ? -1 : 0));
+			cells.push_back(pos);
+		}
+	}
+}
+
+}}//end namespace
+
+#endif
@@ -0,0 +1,550 @@
+// ==============================================================
+//	This file is part of Glest (www.glest.org)
+//
+//	Copyright (C) 2001-2008 Martiño Figueroa
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#include "hierarchical_path_graph.h"
+
+#include <algorithm>
+#include <queue>
+#include <functional>
+
+#include "map.h"
+#include "conversion.h"
+#include "platform_common.h"
+#include "leak_dumper.h"
+
+using namespace std;
+using namespace Shared::Util;
+using namespace Shared::PlatformCommon;
+
+namespace Glest{ namespace Game{
+
+// =====================================================
+// 	class HierarchicalPathGraph
+// =====================================================
+
+// ===================== PUBLIC ========================
+
+const int HierarchicalPathGraph::defaultClusterSize = 16;
+const int HierarchicalPathGraph::straightCost = 10;
+const int HierarchicalPathGraph::diagonalCost = 14;
+
+// runs of free border cells shorter than this get a single entrance
+static const int maxSingleEntranceWidth = 6;
+
+typedef std::pair<int,int> CostIndexPair;
+typedef std::priority_queue<CostIndexPair, vector<CostIndexPair>, std::greater<CostIndexPair> > CostIndexQueue;
+
+HierarchicalPathGraph::HierarchicalPathGraph(const Map *map, int clusterSize) {
+	if(map == NULL) {
+		throw megaglest_runtime_error("map == NULL");
+	}
+	if(clusterSize < 4) {
+		clusterSize = 4;
+	}
+	this->map = map;
+	this->clusterSize = clusterSize;
+	this->clustersW = (map->getW() + clusterSize - 1) / clusterSize;
+	this->clustersH = (map->getH() + clusterSize - 1) / clusterSize;
+	this->mutex = new Mutex();
+}
+
+HierarchicalPathGraph::~HierarchicalPathGraph() {
+	for(LayerMap::iterator iterMap = layers.begin(); iterMap != layers.end(); ++iterMap) {
+		delete iterMap->second;
+	}
+	layers.clear();
+	map = NULL;
+
+	delete mutex;
+	mutex = NULL;
+}
+
+void HierarchicalPathGraph::cellsChanged(const Vec2i &pos, int size) {
+	static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
+	MutexSafeWrapper safeMutex(mutex,mutexOwnerId);
+
+	for(LayerMap::iterator iterMap = layers.begin(); iterMap != layers.end(); ++iterMap) {
+		Layer *layer = iterMap->second;
+
+		// a unit is anchored at its top left cell so larger units are
+		// affected by changes up to unitSize - 1 cells right / below them
+		int minX = max(pos.x - (layer->unitSize - 1), 0);
+		int minY = max(pos.y - (layer->unitSize - 1), 0);
+		int maxX = min(pos.x + size - 1, map->getW() - 1);
+		int maxY = min(pos.y + size - 1, map->getH() - 1);
+		if(minX > maxX || minY > maxY) {
+			continue;
+		}
+
+		for(int cy = minY / clusterSize; cy <= maxY / clusterSize; ++cy) {
+			for(int cx = minX / clusterSize; cx <= maxX / clusterSize; ++cx) {
+				int clusterIndex = cy * clustersW + cx;
+				if(layer->dirtyClusters[clusterIndex] == false) {
+					layer->dirtyClusters[clusterIndex] = true;
+					layer->dirtyCount++;
+				}
+			}
+		}
+	}
+}
+
+bool HierarchicalPathGraph::findWaypoint(Field field, int unitSize, const Vec2i &start, const Vec2i &goal, Vec2i &waypoint) {
+	if(start == goal) {
+		return false;
+	}
+
+	static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
+	MutexSafeWrapper safeMutex(mutex,mutexOwnerId);
+
+	Layer *layer = getLayer(field, unitSize);
+	updateLayer(layer);
+
+	if(isPassable(layer, start) == false || isPassable(layer, goal) == false) {
+		return false;
+	}
+	int startCluster = getClusterIndex(start);
+	int goalCluster = getClusterIndex(goal);
+	if(startCluster == goalCluster) {
+		return false;
+	}
+
+	// connect the start and goal cells to the entrances of their clusters
+	vector<bool> passable;
+	vector<int> startCosts;
+	computePassable(layer, startCluster, passable);
+	searchCluster(startCluster, passable, unitSize, start, startCosts);
+
+	vector<int> goalCosts;
+	computePassable(layer, goalCluster, passable);
+	searchCluster(goalCluster, passable, unitSize, goal, goalCosts);
+
+	const int nodeCount = (int)layer->nodes.size();
+	const int goalNode = nodeCount;
+	vector<int> costs(nodeCount + 1, -1);
+	vector<int> parents(nodeCount + 1, -1);
+	vector<bool> closed(nodeCount + 1, false);
+	CostIndexQueue openQueue;
+
+	const Cluster &firstCluster = layer->clusters[startCluster];
+	for(unsigned int i = 0; i < firstCluster.entries.size(); ++i) {
+		int cost = startCosts[getLocalIndex(startCluster, firstCluster.entries[i])];
+		if(cost >= 0) {
+			int nodeIndex = firstCluster.firstNode + i;
+			costs[nodeIndex] = cost;
+			openQueue.push(CostIndexPair(cost + estimateCost(firstCluster.entries[i], goal), nodeIndex));
+		}
+	}
+
+	bool pathFound = false;
+	while(openQueue.empty() == false) {
+		int nodeIndex = openQueue.top().second;
+		openQueue.pop();
+		if(closed[nodeIndex] == true) {
+			continue;
+		}
+		closed[nodeIndex] = true;
+		if(nodeIndex == goalNode) {
+			pathFound = true;
+			break;
+		}
+
+		const AbstractNode &node = layer->nodes[nodeIndex];
+		const Cluster &cluster = layer->clusters[node.cluster];
+		const int entryCount = (int)cluster.entries.size();
+
+		// candidates: other entrances of this cluster, the linked entrance in
+		// the neighbour cluster and finally the goal cell itself
+		vector<CostIndexPair> candidates;
+		for(int i = 0; i < entryCount; ++i) {
+			int distance = cluster.distances[node.localIndex * entryCount + i];
+			if(i != node.localIndex && distance >= 0) {
+				candidates.push_back(CostIndexPair(distance, cluster.firstNode + i));
+			}
+		}
+		for(unsigned int i = 0; i < node.links.size(); ++i) {
+			candidates.push_back(CostIndexPair(straightCost, node.links[i]));
+		}
+		if(node.cluster == goalCluster) {
+			int distance = goalCosts[getLocalIndex(goalCluster, node.pos)];
+			if(distance >= 0) {
+				candidates.push_back(CostIndexPair(distance, goalNode));
+			}
+		}
+
+		for(unsigned int i = 0; i < candidates.size(); ++i) {
+			int nextIndex = candidates[i].second;
+			int cost = costs[nodeIndex] + candidates[i].first;
+			if(closed[nextIndex] == false && (costs[nextIndex] < 0 || cost < costs[nextIndex])) {
+				costs[nextIndex] = cost;
+				parents[nextIndex] = nodeIndex;
+				int estimate = (nextIndex == goalNode ? 0 : estimateCost(layer->nodes[nextIndex].pos, goal));
+				openQueue.push(CostIndexPair(cost + estimate, nextIndex));
+			}
+		}
+	}
+
+	if(pathFound == false) {
+		return false;
+	}
+
+	// the goal is close enough for the regular search to reach it directly
+	const int lookAheadCost = clusterSize * straightCost * 2;
+	if(costs[goalNode] <= lookAheadCost) {
+		return false;
+	}
+
+	vector<int> route;
+	for(int nodeIndex = parents[goalNode]; nodeIndex >= 0; nodeIndex = parents[nodeIndex]) {
+		route.push_back(nodeIndex);
+	}
+	std::reverse(route.begin(), route.end());
+	if(route.empty() == true) {
+		return false;
+	}
+
+	int waypointNode = route[0];
+	for(unsigned int i = 1; i < route.size(); ++i) {
+		if(costs[route[i]] > lookAheadCost && costs[waypointNode] > 0) {
+			break;
+		}
+		waypointNode = route[i];
+	}
+	waypoint = layer->nodes[waypointNode].pos;
+	return (waypoint != start);
+}
+
+string HierarchicalPathGraph::getStats() {
+	static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
+	MutexSafeWrapper safeMutex(mutex,mutexOwnerId);
+
+	string result = "clusterSize = " + intToStr(clusterSize) +
+					" clusters = " + intToStr(clustersW) + "x" + intToStr(clustersH) +
+					" layers = " + intToStr(layers.size());
+	for(LayerMap::iterator iterMap = layers.begin(); iterMap != layers.end(); ++iterMap) {
+		const Layer *layer = iterMap->second;
+		result += " [field = " + intToStr(layer->field) +
+				  " size = " + intToStr(layer->unitSize) +
+				  " nodes = " + intToStr(layer->nodes.size()) +
+				  " dirty = " + intToStr(layer->dirtyCount) + "]";
+	}
+	return result;
+}
+
+// ==================== PRIVATE ====================
+
+HierarchicalPathGraph::Layer * HierarchicalPathGraph::getLayer(Field field, int unitSize) {
+	std::pair<int,int> key(field, unitSize);
+	LayerMap::iterator iterFind = layers.find(key);
+	if(iterFind != layers.end()) {
+		return iterFind->second;
+	}
+
+	const int clusterCount = clustersW * clustersH;
+	Layer *layer = new Layer();
+	layer->field = field;
+	layer->unitSize = unitSize;
+	layer->borders.resize(clusterCount * 2);
+	layer->clusters.resize(clusterCount);
+	layer->cellNodes.resize(map->getW() * map->getH(), -1);
+	layer->dirtyClusters.resize(clusterCount, true);
+	layer->dirtyCount = clusterCount;
+	layers[key] = layer;
+
+	return layer;
+}
+
+void HierarchicalPathGraph::updateLayer(Layer *layer) {
+	if(layer->dirtyCount <= 0) {
+		return;
+	}
+
+	const int clusterCount = clustersW * clustersH;
+	vector<bool> recompute(clusterCount, false);
+	for(int clusterIndex = 0; clusterIndex < clusterCount; ++clusterIndex) {
+		if(layer->dirtyClusters[clusterIndex] == false) {
+			continue;
+		}
+		int cx = clusterIndex % clustersW;
+		int cy = clusterIndex / clustersW;
+
+		// every border this cluster touches, then every cluster whose entrances
+		// may have moved because of it
+		computeBorder(layer, clusterIndex * 2);
+		computeBorder(layer, clusterIndex * 2 + 1);
+		if(cx > 0) {
+			computeBorder(layer, (clusterIndex - 1) * 2);
+		}
+		if(cy > 0) {
+			computeBorder(layer, (clusterIndex - clustersW) * 2 + 1);
+		}
+
+		recompute[clusterIndex] = true;
+		if(cx > 0) recompute[clusterIndex - 1] = true;
+		if(cx + 1 < clustersW) recompute[clusterIndex + 1] = true;
+		if(cy > 0) recompute[clusterIndex - clustersW] = true;
+		if(cy + 1 < clustersH) recompute[clusterIndex + clustersW] = true;
+
+		layer->dirtyClusters[clusterIndex] = false;
+	}
+	layer->dirtyCount = 0;
+
+	for(int clusterIndex = 0; clusterIndex < clusterCount; ++clusterIndex) {
+		if(recompute[clusterIndex] == true) {
+			computeCluster(layer, clusterIndex);
+		}
+	}
+	linkNodes(layer);
+}
+
+void HierarchicalPathGraph::computeBorder(Layer *layer, int borderIndex) {
+	vector<Transition> &transitions = layer->borders[borderIndex];
+	transitions.clear();
+
+	int clusterIndex = borderIndex / 2;
+	bool vertical = (borderIndex % 2 == 0);
+	int cx = clusterIndex % clustersW;
+	int cy = clusterIndex / clustersW;
+	if((vertical == true && cx + 1 >= clustersW) ||
+	   (vertical == false && cy + 1 >= clustersH)) {
+		return;
+	}
+
+	Vec2i topLeft;
+	Vec2i bottomRight;
+	getClusterBounds(clusterIndex, topLeft, bottomRight);
+
+	// walk along the shared edge, first is inside this cluster and second
+	// inside the right / lower neighbour
+	Vec2i step = (vertical == true ? Vec2i(0, 1) : Vec2i(1, 0));
+	Vec2i across = (vertical == true ? Vec2i(1, 0) : Vec2i(0, 1));
+	Vec2i edgeStart = (vertical == true ? Vec2i(bottomRight.x, topLeft.y) : Vec2i(topLeft.x, bottomRight.y));
+	int length = (vertical == true ? bottomRight.y - topLeft.y + 1 : bottomRight.x - topLeft.x + 1);
+
+	int runStart = -1;
+	for(int i = 0; i <= length; ++i) {
+		bool open = false;
+		if(i < length) {
+			Vec2i first = edgeStart + step * i;
+			open = isPassable(layer, first) == true && isPassable(layer, first + across) == true;
+		}
+
+		if(open == true && runStart < 0) {
+			runStart = i;
+		}
+		else if(open == false && runStart >= 0) {
+			int runEnd = i - 1;
+			if(runEnd - runStart + 1 < maxSingleEntranceWidth) {
+				Vec2i first = edgeStart + step * ((runStart + runEnd) / 2);
+				transitions.push_back(Transition(first, first + across));
+			}
+			else {
+				Vec2i first = edgeStart + step * runStart;
+				transitions.push_back(Transition(first, first + across));
+				first = edgeStart + step * runEnd;
+				transitions.push_back(Transition(first, first + across));
+			}
+			runStart = -1;
+		}
+	}
+}
+
+void HierarchicalPathGraph::computeCluster(Layer *layer, int clusterIndex) {
+	Cluster &cluster = layer->clusters[clusterIndex];
+	cluster.entries.clear();
+	cluster.distances.clear();
+
+	int cx = clusterIndex % clustersW;
+	int cy = clusterIndex / clustersW;
+
+	vector<const Transition *> ownTransitions;
+	vector<const Transition *> neighbourTransitions;
+	for(int border = 0; border < 2; ++border) {
+		const vector<Transition> &transitions = layer->borders[clusterIndex * 2 + border];
+		for(unsigned int i = 0; i < transitions.size(); ++i) {
+			ownTransitions.push_back(&transitions[i]);
+		}
+	}
+	if(cx > 0) {
+		const vector<Transition> &transitions = layer->borders[(clusterIndex - 1) * 2];
+		for(unsigned int i = 0; i < transitions.size(); ++i) {
+			neighbourTransitions.push_back(&transitions[i]);
+		}
+	}
+	if(cy > 0) {
+		const vector<Transition> &transitions = layer->borders[(clusterIndex - clustersW) * 2 + 1];
+		for(unsigned int i = 0; i < transitions.size(); ++i) {
+			neighbourTransitions.push_back(&transitions[i]);
+		}
+	}
+
+	for(unsigned int i = 0; i < ownTransitions.size(); ++i) {
+		if(std::find(cluster.entries.begin(), cluster.entries.end(), ownTransitions[i]->first) == cluster.entries.end()) {
+			cluster.entries.push_back(ownTransitions[i]->first);
+		}
+	}
+	for(unsigned int i = 0; i < neighbourTransitions.size(); ++i) {
+		if(std::find(cluster.entries.begin(), cluster.entries.end(), neighbourTransitions[i]->second) == cluster.entries.end()) {
+			cluster.entries.push_back(neighbourTransitions[i]->second);
+		}
+	}
+
+	const int entryCount = (int)cluster.entries.size();
+	cluster.distances.resize(entryCount * entryCount, -1);
+	if(entryCount == 0) {
+		return;
+	}
+
+	vector<bool> passable;
+	vector<int> costs;
+	computePassable(layer, clusterIndex, passable);
+	for(int i = 0; i < entryCount; ++i) {
+		searchCluster(clusterIndex, passable, layer->unitSize, cluster.entries[i], costs);
+		for(int j = 0; j < entryCount; ++j) {
+			cluster.distances[i * entryCount + j] = costs[getLocalIndex(clusterIndex, cluster.entries[j])];
+		}
+	}
+}
+
+void HierarchicalPathGraph::linkNodes(Layer *layer) {
+	for(unsigned int i = 0; i < layer->nodes.size(); ++i) {
+		const Vec2i &pos = layer->nodes[i].pos;
+		layer->cellNodes[pos.y * map->getW() + pos.x] = -1;
+	}
+	layer->nodes.clear();
+
+	for(unsigned int clusterIndex = 0; clusterIndex < layer->clusters.size(); ++clusterIndex) {
+		Cluster &cluster = layer->clusters[clusterIndex];
+		cluster.firstNode = (int)layer->nodes.size();
+		for(unsigned int i = 0; i < cluster.entries.size(); ++i) {
+			AbstractNode node;
+			node.pos = cluster.entries[i];
+			node.cluster = clusterIndex;
+			node.localIndex = i;
+			layer->cellNodes[node.pos.y * map->getW() + node.pos.x] = (int)layer->nodes.size();
+			layer->nodes.push_back(node);
+		}
+	}
+
+	for(unsigned int borderIndex = 0; borderIndex < layer->borders.size(); ++borderIndex) {
+		const vector<Transition> &transitions = layer->borders[borderIndex];
+		for(unsigned int i = 0; i < transitions.size(); ++i) {
+			int firstNode = layer->cellNodes[transitions[i].first.y * map->getW() + transitions[i].first.x];
+			int secondNode = layer->cellNodes[transitions[i].second.y * map->getW() + transitions[i].second.x];
+			if(firstNode >= 0 && secondNode >= 0) {
+				layer->nodes[firstNode].links.push_back(secondNode);
+				layer->nodes[secondNode].links.push_back(firstNode);
+			}
+		}
+	}
+}
+
+void HierarchicalPathGraph::getClusterBounds(int clusterIndex, Vec2i &topLeft, Vec2i &bottomRight) const {
+	topLeft.x = (clusterIndex % clustersW) * clusterSize;
+	topLeft.y = (clusterIndex / clustersW) * clusterSize;
+	bottomRight.x = min(topLeft.x + clusterSize, map->getW()) - 1;
+	bottomRight.y = min(topLeft.y + clusterSize, map->getH()) - 1;
+}
+
+void HierarchicalPathGraph::computePassable(const Layer *layer, int clusterIndex, vector<bool> &passable) const {
+	Vec2i topLeft;
+	Vec2i bottomRight;
+	getClusterBounds(clusterIndex, topLeft, bottomRight);
+
+	int localW = bottomRight.x - topLeft.x + 1;
+	int localH = bottomRight.y - topLeft.y + 1;
+	passable.assign(localW * localH, false);
+	for(int y = 0; y < localH; ++y) {
+		for(int x = 0; x < localW; ++x) {
+			passable[y * localW + x] = isPassable(layer, Vec2i(topLeft.x + x, topLeft.y + y));
+		}
+	}
+}
+
+void HierarchicalPathGraph::searchCluster(int clusterIndex, const vector<bool> &passable, int unitSize, const Vec2i &origin, vector<int> &costs) const {
+	Vec2i topLeft;
+	Vec2i bottomRight;
+	getClusterBounds(clusterIndex, topLeft, bottomRight);
+
+	const int localW = bottomRight.x - topLeft.x + 1;
+	const int localH = bottomRight.y - topLeft.y + 1;
+	costs.assign(localW * localH, -1);
+
+	int originIndex = getLocalIndex(clusterIndex, origin);
+	if(passable[originIndex] == false) {
+		return;
+	}
+
+	// dijkstra over the cluster cells using the same step rules as Map::aproxCanMove
+	vector<bool> closed(localW * localH, false);
+	CostIndexQueue openQueue;
+	costs[originIndex] = 0;
+	openQueue.push(CostIndexPair(0, originIndex));
+
+	while(openQueue.empty() == false) {
+		int cellIndex = openQueue.top().second;
+		openQueue.pop();
+		if(closed[cellIndex] == true) {
+			continue;
+		}
+		closed[cellIndex] = true;
+
+		int x = cellIndex % localW;
+		int y = cellIndex / localW;
+		for(int i = -1; i <= 1; ++i) {
+			for(int j = -1; j <= 1; ++j) {
+				if(i == 0 && j == 0) {
+					continue;
+				}
+				int nextX = x + i;
+				int nextY = y + j;
+				if(nextX < 0 || nextY < 0 || nextX >= localW || nextY >= localH) {
+					continue;
+				}
+				int nextIndex = nextY * localW + nextX;
+				if(closed[nextIndex] == true || passable[nextIndex] == false) {
+					continue;
+				}
+
+				bool diagonal = (i != 0 && j != 0);
+				if(diagonal == true && unitSize == 1 &&
+					(passable[y * localW + nextX] == false || passable[nextY * localW + x] == false)) {
+					continue;
+				}
+
+				int cost = costs[cellIndex] + (diagonal == true ? diagonalCost : straightCost);
+				if(costs[nextIndex] < 0 || cost < costs[nextIndex]) {
+					costs[nextIndex] = cost;
+					openQueue.push(CostIndexPair(cost, nextIndex));
+				}
+			}
+		}
+	}
+}
+
+int HierarchicalPathGraph::getLocalIndex(int clusterIndex, const Vec2i &pos) const {
+	Vec2i topLeft;
+	Vec2i bottomRight;
+	getClusterBounds(clusterIndex, topLeft, bottomRight);
+
+	return (pos.y - topLeft.y) * (bottomRight.x - topLeft.x + 1) + (pos.x - topLeft.x);
+}
+
+bool HierarchicalPathGraph::isPassable(const Layer *layer, const Vec2i &pos) const {
+	return map->isStaticFreeCells(pos, layer->unitSize, layer->field);
+}
+
+int HierarchicalPathGraph::estimateCost(const Vec2i &pos1, const Vec2i &pos2) {
+	int dx = abs(pos1.x - pos2.x);
+	int dy = abs(pos1.y - pos2.y);
+	return straightCost * (max(dx, dy) - min(dx, dy)) + diagonalCost * min(dx, dy);
+}
+
+}}//end namespace
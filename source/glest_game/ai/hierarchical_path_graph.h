@@ -0,0 +1,134 @@
+// ==============================================================
+//	This file is part of Glest (www.glest.org)
+//
+//	Copyright (C) 2001-2008 Martiño Figueroa
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#ifndef _GLEST_GAME_HIERARCHICALPATHGRAPH_H_
+#define _GLEST_GAME_HIERARCHICALPATHGRAPH_H_
+
+#ifdef WIN32
+    #include <winsock2.h>
+    #include <winsock.h>
+#endif
+
+#include "vec.h"
+#include <vector>
+#include <map>
+#include <string>
+#include "skill_type.h"
+#include "thread.h"
+#include "leak_dumper.h"
+
+using std::vector;
+using std::string;
+using Shared::Graphics::Vec2i;
+using Shared::Platform::Mutex;
+
+namespace Glest { namespace Game {
+
+class Map;
+
+// =====================================================
+// 	class HierarchicalPathGraph
+//
+///	Abstract graph of the static map obstacles (HPA*),
+///	the map is split into square clusters connected by
+///	entrances so long routes can be planned cheaply
+// =====================================================
+
+class HierarchicalPathGraph {
+public:
+	static const int defaultClusterSize;
+
+private:
+	// path costs are kept integral so every client computes identical routes
+	static const int straightCost;
+	static const int diagonalCost;
+
+	class Transition {
+	public:
+		Transition() { }
+		Transition(const Vec2i &first, const Vec2i &second) {
+			this->first = first;
+			this->second = second;
+		}
+		Vec2i first;
+		Vec2i second;
+	};
+
+	class Cluster {
+	public:
+		Cluster() { firstNode = 0; }
+		vector<Vec2i> entries;
+		// entries.size() squared, -1 when two entries are not connected
+		vector<int> distances;
+		int firstNode;
+	};
+
+	class AbstractNode {
+	public:
+		AbstractNode() { cluster = -1; localIndex = -1; }
+		Vec2i pos;
+		int cluster;
+		int localIndex;
+		vector<int> links;
+	};
+
+	class Layer {
+	public:
+		Layer() { field = fLand; unitSize = 1; dirtyCount = 0; }
+		Field field;
+		int unitSize;
+		vector<vector<Transition> > borders;
+		vector<Cluster> clusters;
+		vector<AbstractNode> nodes;
+		vector<int> cellNodes;
+		vector<bool> dirtyClusters;
+		int dirtyCount;
+	};
+	typedef std::map<std::pair<int,int>, Layer *> LayerMap;
+
+	const Map *map;
+	int clusterSize;
+	int clustersW;
+	int clustersH;
+	Mutex *mutex;
+	LayerMap layers;
+
+public:
+	HierarchicalPathGraph(const Map *map, int clusterSize=defaultClusterSize);
+	~HierarchicalPathGraph();
+
+	inline int getClusterSize() const { return clusterSize; }
+
+	void cellsChanged(const Vec2i &pos, int size);
+	bool findWaypoint(Field field, int unitSize, const Vec2i &start, const Vec2i &goal, Vec2i &waypoint);
+	string getStats();
+
+private:
+	Layer *getLayer(Field field, int unitSize);
+	void updateLayer(Layer *layer);
+	void computeBorder(Layer *layer, int borderIndex);
+	void computeCluster(Layer *layer, int clusterIndex);
+	void linkNodes(Layer *layer);
+	void getClusterBounds(int clusterIndex, Vec2i &topLeft, Vec2i &bottomRight) const;
+	void computePassable(const Layer *layer, int clusterIndex, vector<bool> &passable) const;
+	void searchCluster(int clusterIndex, const vector<bool> &passable, int unitSize, const Vec2i &origin, vector<int> &costs) const;
+	int getLocalIndex(int clusterIndex, const Vec2i &pos) const;
+
+	inline int getClusterIndex(const Vec2i &pos) const {
+		return (pos.y / clusterSize) * clustersW + (pos.x / clusterSize);
+	}
+	bool isPassable(const Layer *layer, const Vec2i &pos) const;
+	static int estimateCost(const Vec2i &pos1, const Vec2i &pos2);
+};
+
+}}//end namespace
+
+#endif
@@ -21,6 +21,8 @@
 #include "command.h"
 #include "faction.h"
 #include "randomgen.h"
+#include "benchmark.h"
+#include "game_trace.h"
 #include "leak_dumper.h"
 
 using namespace std;
@@ -47,9 +49,21 @@ const int PathFinder::pathFindBailoutRadius	= 20;
 const int PathFinder::pathFindExtendRefreshForNodeCount	= 25;
 const int PathFinder::pathFindExtendRefreshNodeCountMin	= 40;
 const int PathFinder::pathFindExtendRefreshNodeCountMax	= 40;
+const int PathFinder::jumpPointMaxDistance				= 64;
+const int PathFinder::unreachableSearchRadius			= 20;
+const int PathFinder::flowFieldMinGroupSize				= 4;
+const int PathFinder::flowFieldMinDistance				= 20;
+const int PathFinder::flowFieldPathLength				= 24;
+const int PathFinder::flowFieldMaxRequestTargets		= 64;
 
 PathFinder::PathFinder() {
 	minorDebugPathfinder = false;
+	useFlatHeapSearch = false;
+	useJumpPointSearch = false;
+	hierarchyGraph = NULL;
+	connectivityMap = NULL;
+	flowFieldCache = NULL;
+	preprocessChunkCount = 0;
 	factionMutex = new Mutex();
 	for(int i = 0; i < GameConstants::maxPlayers; ++i) {
 		factions.push_back(FactionState());
@@ -58,13 +72,19 @@ PathFinder::PathFinder() {
 	map=NULL;
 }
 
-int PathFinder::getPathFindExtendRefreshNodeCount(int factionIndex) {
-	int refreshNodeCount = factions[factionIndex].random.randRange(PathFinder::pathFindExtendRefreshNodeCountMin,PathFinder::pathFindExtendRefreshNodeCountMax);
+int PathFinder::getPathFindExtendRefreshNodeCount(FactionState &faction) {
+	int refreshNodeCount = faction.random.randRange(PathFinder::pathFindExtendRefreshNodeCountMin,PathFinder::pathFindExtendRefreshNodeCountMax);
 	return refreshNodeCount;
 }
 
 PathFinder::PathFinder(const Map *map) {
 	minorDebugPathfinder = false;
+	useFlatHeapSearch = false;
+	useJumpPointSearch = false;
+	hierarchyGraph = NULL;
+	connectivityMap = NULL;
+	flowFieldCache = NULL;
+	preprocessChunkCount = 0;
 	factionMutex = new Mutex();
 	for(int i = 0; i < GameConstants::maxPlayers; ++i) {
 		factions.push_back(FactionState());
@@ -77,14 +97,193 @@ PathFinder::PathFinder(const Map *map) {
 
 void PathFinder::init(const Map *map) {
 	PathFinder::pathFindNodesMax = Config::getInstance().getInt("MaxPathfinderNodeCount",intToStr(PathFinder::pathFindNodesMax).c_str());
+	useFlatHeapSearch = Config::getInstance().getBool("EnablePathfinderFlatHeap","false");
 
 	for(int i = 0; i < GameConstants::maxPlayers; ++i) {
 		factions[i].nodePool.resize(pathFindNodesAbsoluteMax);
 		factions[i].useMaxNodeCount = PathFinder::pathFindNodesMax;
+
+		if(useFlatHeapSearch == true) {
+			factions[i].openNodeHeap.reserve(pathFindNodesAbsoluteMax);
+			if(map != NULL) {
+				factions[i].visitedCells.init(map->getW(), map->getH());
+			}
+		}
 	}
 	this->map= map;
 }
 
+// Set from the game settings, never from the local config, so every
+// client plans on the same clusters
+void PathFinder::setUseHierarchy(bool value, int clusterSize) {
+	delete hierarchyGraph;
+	hierarchyGraph = NULL;
+	if(value == true && map != NULL) {
+		hierarchyGraph = new HierarchicalPathGraph(map,
+				(clusterSize > 0 ? clusterSize : HierarchicalPathGraph::defaultClusterSize));
+	}
+}
+
+void PathFinder::setUseConnectivity(bool value) {
+	delete connectivityMap;
+	connectivityMap = NULL;
+	if(value == true && map != NULL) {
+		connectivityMap = new ConnectivityMap(map);
+	}
+}
+
+void PathFinder::setUseFlowField(bool value) {
+	delete flowFieldCache;
+	flowFieldCache = NULL;
+	if(value == true && map != NULL) {
+		flowFieldCache = new FlowFieldCache(map);
+	}
+}
+
+void PathFinder::mapCellsChanged(const Vec2i &pos, int size) {
+	if(hierarchyGraph != NULL) {
+		hierarchyGraph->cellsChanged(pos, size);
+	}
+	if(connectivityMap != NULL) {
+		connectivityMap->cellsChanged(pos, size);
+	}
+	if(flowFieldCache != NULL) {
+		flowFieldCache->clear();
+	}
+}
+
+// =====================================================
+// 	class PathFinder::NodeHeap
+// =====================================================
+
+void PathFinder::NodeHeap::push(Node *node) {
+	Entry entry;
+	entry.priority	= node->heuristic + node->cost;
+	entry.sequence	= nextSequence++;
+	entry.node		= node;
+
+	entries.push_back(entry);
+
+	// sift up
+	size_t index = entries.size() - 1;
+	while(index > 0) {
+		size_t parent = (index - 1) / 2;
+		if(lessThan(entry, entries[parent]) == false) {
+			break;
+		}
+		entries[index] = entries[parent];
+		index = parent;
+	}
+	entries[index] = entry;
+}
+
+PathFinder::Node * PathFinder::NodeHeap::pop() {
+	Node *result = entries[0].node;
+	Entry last = entries.back();
+	entries.pop_back();
+
+	// sift down
+	size_t count = entries.size();
+	if(count > 0) {
+		size_t index = 0;
+		for(;;) {
+			size_t child = index * 2 + 1;
+			if(child >= count) {
+				break;
+			}
+			if(child + 1 < count && lessThan(entries[child + 1], entries[child]) == true) {
+				child++;
+			}
+			if(lessThan(entries[child], last) == false) {
+				break;
+			}
+			entries[index] = entries[child];
+			index = child;
+		}
+		entries[index] = last;
+	}
+	return result;
+}
+
+// =====================================================
+// 	class PathFinder::NodeVisitGrid
+// =====================================================
+
+void PathFinder::NodeVisitGrid::init(int width, int height) {
+	this->width		= width;
+	this->height	= height;
+	this->stamps.assign(width * height, 0);
+	this->generation	= 0;
+	this->markedCount	= 0;
+}
+
+void PathFinder::NodeVisitGrid::nextSearch() {
+	generation++;
+	if(generation == 0) {
+		// stamps wrapped around, start over from a clean grid
+		std::fill(stamps.begin(), stamps.end(), 0);
+		generation = 1;
+	}
+	markedCount = 0;
+}
+
+// =====================================================
+// 	class PathFinder::CellValueGrid
+// =====================================================
+
+void PathFinder::CellValueGrid::init(int width, int height) {
+	this->width		= width;
+	this->height	= height;
+	this->stamps.assign(width * height, 0);
+	this->values.assign(width * height, 0);
+	this->generation	= 0;
+}
+
+void PathFinder::CellValueGrid::nextSearch() {
+	generation++;
+	if(generation == 0) {
+		std::fill(stamps.begin(), stamps.end(), 0);
+		generation = 1;
+	}
+}
+
+void PathFinder::clearSearchState(FactionState &faction) {
+	if(useFlatHeapSearch == true || useJumpPointSearch == true) {
+		if(faction.visitedCells.isInitialized(map->getW(), map->getH()) == false) {
+			faction.visitedCells.init(map->getW(), map->getH());
+		}
+		faction.openNodeHeap.clear();
+		faction.visitedCells.nextSearch();
+		faction.bestClosedNode = NULL;
+	}
+	if(useJumpPointSearch == true) {
+		if(faction.jumpPointCosts.isInitialized(map->getW(), map->getH()) == false) {
+			faction.jumpPointCosts.init(map->getW(), map->getH());
+			faction.enterableCells.init(map->getW(), map->getH());
+		}
+		faction.jumpPointCosts.nextSearch();
+		faction.enterableCells.nextSearch();
+	}
+	if(useFlatHeapSearch == false) {
+		faction.openNodesList.clear();
+		faction.openPosList.clear();
+		faction.closedNodesList.clear();
+	}
+}
+
+string PathFinder::getSearchStateStats(const FactionState &faction) const {
+	char szBuf[1024]="";
+	if(useFlatHeapSearch == true || useJumpPointSearch == true) {
+		snprintf(szBuf,1024,"openNodeHeap.size() [" MG_SIZE_T_SPECIFIER "] visitedCells [%d]",
+				faction.openNodeHeap.size(),faction.visitedCells.getMarkedCount());
+	}
+	else {
+		snprintf(szBuf,1024,"openNodesList.size() [" MG_SIZE_T_SPECIFIER "] openPosList.size() [" MG_SIZE_T_SPECIFIER "]",
+				faction.openNodesList.size(),faction.openPosList.size());
+	}
+	return szBuf;
+}
+
 PathFinder::~PathFinder() {
 	for(int i = 0; i < GameConstants::maxPlayers; ++i) {
 		factions[i].nodePool.clear();
@@ -92,6 +291,21 @@ PathFinder::~PathFinder() {
 	factions.clear();
 	map=NULL;
 
+	delete hierarchyGraph;
+	hierarchyGraph = NULL;
+
+	delete connectivityMap;
+	connectivityMap = NULL;
+
+	delete flowFieldCache;
+	flowFieldCache = NULL;
+
+	for(unsigned int i = 0; i < preprocessChunks.size(); ++i) {
+		delete preprocessChunks[i];
+	}
+	preprocessChunks.clear();
+	unitPreprocessChunks.clear();
+
 	delete factionMutex;
 	factionMutex = NULL;
 }
@@ -111,10 +325,81 @@ void PathFinder::clearUnitPrecache(Unit *unit) {
 	static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
 	MutexSafeWrapper safeMutex(factionMutex,mutexOwnerId);
 
-	factions[unit->getFactionIndex()].precachedTravelState[unit->getId()] = tsImpossible;
-	factions[unit->getFactionIndex()].precachedPath[unit->getId()].clear();
+	FactionState &searchState = getSearchState(unit);
+	searchState.precachedTravelState[unit->getId()] = tsImpossible;
+	searchState.precachedPath[unit->getId()].clear();
 
-	factions[unit->getFactionIndex()].badCellList.clear();
+	searchState.badCellList.clear();
+}
+
+// Called before the preprocess jobs are queued, every search for one of
+// these units until applyPreprocessChunks runs on the chunk's own state
+void PathFinder::addPreprocessChunk(Faction *faction, int chunkIndex, const std::vector<Unit *> &units, int frameIndex) {
+	if(preprocessChunkCount >= (int)preprocessChunks.size()) {
+		PreprocessChunk *newChunk = new PreprocessChunk();
+		newChunk->searchState.nodePool.resize(pathFindNodesAbsoluteMax);
+		if(useFlatHeapSearch == true) {
+			newChunk->searchState.openNodeHeap.reserve(pathFindNodesAbsoluteMax);
+		}
+		preprocessChunks.push_back(newChunk);
+	}
+	PreprocessChunk *chunk = preprocessChunks[preprocessChunkCount];
+	preprocessChunkCount++;
+
+	chunk->faction = faction;
+	chunk->searchState.useMaxNodeCount = PathFinder::pathFindNodesMax;
+	// The seed only depends on the frame and the chunk's place in its
+	// faction so every client searches with the same numbers
+	uint32 seed = ((uint32)frameIndex * GameConstants::maxPlayers + faction->getIndex()) * 256 + chunkIndex;
+	chunk->searchState.random.init((int)(seed & 0x7FFFFFFF));
+
+	for(unsigned int i = 0; i < units.size(); ++i) {
+		unitPreprocessChunks[units[i]->getId()] = chunk;
+	}
+}
+
+// Called once the preprocess jobs are done, merges the chunks into their
+// factions in the order they were added
+void PathFinder::applyPreprocessChunks() {
+	for(int i = 0; i < preprocessChunkCount; ++i) {
+		PreprocessChunk *chunk = preprocessChunks[i];
+		FactionState &searchState = chunk->searchState;
+		FactionState &factionState = factions[chunk->faction->getIndex()];
+
+		for(std::map<int,TravelState>::iterator iterMap = searchState.precachedTravelState.begin();
+			iterMap != searchState.precachedTravelState.end(); ++iterMap) {
+			factionState.precachedTravelState[iterMap->first] = iterMap->second;
+		}
+		for(std::map<int,std::vector<Vec2i> >::iterator iterMap = searchState.precachedPath.begin();
+			iterMap != searchState.precachedPath.end(); ++iterMap) {
+			factionState.precachedPath[iterMap->first].swap(iterMap->second);
+		}
+		if(searchState.precachedTravelState.empty() == false) {
+			factionState.badCellList.clear();
+		}
+
+		for(std::map<FlowFieldKey, std::set<int> >::iterator iterMap = searchState.flowFieldRequests.begin();
+			iterMap != searchState.flowFieldRequests.end(); ++iterMap) {
+			if(factionState.flowFieldRequests.find(iterMap->first) == factionState.flowFieldRequests.end() &&
+				(int)factionState.flowFieldRequests.size() >= flowFieldMaxRequestTargets) {
+				factionState.flowFieldRequests.clear();
+			}
+			factionState.flowFieldRequests[iterMap->first].insert(iterMap->second.begin(), iterMap->second.end());
+		}
+
+		for(unsigned int j = 0; j < chunk->pathfindingUnitList.size(); ++j) {
+			chunk->faction->addUnitToPathfindingList(chunk->pathfindingUnitList[j]);
+		}
+
+		searchState.precachedTravelState.clear();
+		searchState.precachedPath.clear();
+		searchState.badCellList.clear();
+		searchState.flowFieldRequests.clear();
+		chunk->pathfindingUnitList.clear();
+		chunk->faction = NULL;
+	}
+	preprocessChunkCount = 0;
+	unitPreprocessChunks.clear();
 }
 
 void PathFinder::removeUnitPrecache(Unit *unit) {
@@ -132,6 +417,8 @@ void PathFinder::removeUnitPrecache(Unit *unit) {
 }
 
 TravelState PathFinder::findPath(Unit *unit, const Vec2i &finalPos, bool *wasStuck, int frameIndex) {
+	BenchmarkPhaseTimer benchmarkTimer(bpPathfinding);
+	TRACE_SCOPE_ARGS(tevFindPath,unit->getId(),frameIndex);
 	if(map == NULL) {
 		throw megaglest_runtime_error("map == NULL");
 	}
@@ -144,7 +431,12 @@ TravelState PathFinder::findPath(Unit *unit, const Vec2i &finalPos, bool *wasStu
 		clearUnitPrecache(unit);
 	}
 	//else {
-		if(unit->getFaction()->canUnitsPathfind() == true) {
+		PreprocessChunk *chunk = getPreprocessChunk(unit);
+		if(chunk != NULL) {
+			// Only factions without a pathfinding limit are split in chunks
+			chunk->pathfindingUnitList.push_back(unit->getId());
+		}
+		else if(unit->getFaction()->canUnitsPathfind() == true) {
 			unit->getFaction()->addUnitToPathfindingList(unit->getId());
 		}
 		else {
@@ -231,7 +523,7 @@ TravelState PathFinder::findPath(Unit *unit, const Vec2i &finalPos, bool *wasStu
 
 	int maxNodeCount=-1;
 	if(unit->getUsePathfinderExtendedMaxNodes() == true) {
-		const bool showConsoleDebugInfo = Config::getInstance().getBool("EnablePathfinderDistanceOutput","false");
+		const bool showConsoleDebugInfo = Config::getCachedValues().enablePathfinderDistanceOutput;
 		if(showConsoleDebugInfo || SystemFlags::VERBOSE_MODE_ENABLED) {
 			printf("\n\n\n\n### Continued call to AStar with LARGE maxnodes for unit [%d - %s]\n\n",unit->getId(),unit->getFullName().c_str());
 		}
@@ -276,12 +568,12 @@ TravelState PathFinder::findPath(Unit *unit, const Vec2i &finalPos, bool *wasStu
 				}
 				unit->setInBailOutAttempt(true);
 
-				bool useBailoutRadius = Config::getInstance().getBool("EnableBailoutPathfinding","true");
+				bool useBailoutRadius = Config::getCachedValues().enableBailoutPathfinding;
 				if(useBailoutRadius == true) {
 					bool unitImmediatelyBlocked = false;
 
 					// First check if unit currently blocked all around them, if so don't try to pathfind
-					const bool showConsoleDebugInfo = Config::getInstance().getBool("EnablePathfinderDistanceOutput","false");
+					const bool showConsoleDebugInfo = Config::getCachedValues().enablePathfinderDistanceOutput;
 					const Vec2i unitPos = unit->getPos();
 					int failureCount = 0;
 					int cellCount = 0;
@@ -306,7 +598,7 @@ TravelState PathFinder::findPath(Unit *unit, const Vec2i &finalPos, bool *wasStu
 					}
 
 					if(unitImmediatelyBlocked == false) {
-						int tryRadius = factions[unit->getFactionIndex()].random.randRange(0,1);
+						int tryRadius = getSearchState(unit).random.randRange(0,1);
 
 						// Try to bail out up to PathFinder::pathFindBailoutRadius cells away
 						if(tryRadius > 0) {
@@ -380,11 +672,12 @@ TravelState PathFinder::findPath(Unit *unit, const Vec2i &finalPos, bool *wasStu
 						pos = basicPath->pop(frameIndex < 0);
 					}
 					else {
-						if(factions[unit->getFactionIndex()].precachedPath[unit->getId()].size() <= 0) {
-							throw megaglest_runtime_error("factions[unit->getFactionIndex()].precachedPath[unit->getId()].size() <= 0!");
+						std::vector<Vec2i> &precachedPath = getSearchState(unit).precachedPath[unit->getId()];
+						if(precachedPath.size() <= 0) {
+							throw megaglest_runtime_error("precachedPath[unit->getId()].size() <= 0!");
 						}
 
-						pos = factions[unit->getFactionIndex()].precachedPath[unit->getId()][0];
+						pos = precachedPath[0];
 					}
 
 					if(map->canMove(unit, unit->getPos(), pos)) {
@@ -435,349 +728,318 @@ TravelState PathFinder::findPath(Unit *unit, const Vec2i &finalPos, bool *wasStu
 
 // ==================== PRIVATE ==================== 
 
-bool PathFinder::addToOpenSet(Unit *unit, Node *node,const Vec2i finalPos, Vec2i sucPos, bool &nodeLimitReached,int maxNodeCount,Node **newNodeAdded, bool bypassChecks) {
-	bool result = false;
-
-	*newNodeAdded=NULL;
-	//Vec2i sucPos= node->pos + Vec2i(i, j);
-	if(bypassChecks == true ||
-		(canUnitMoveSoon(unit, node->pos, sucPos) == true && openPos(sucPos, factions[unit->getFactionIndex()]) == false)) {
-		//if node is not open and canMove then generate another node
-		Node *sucNode= newNode(factions[unit->getFactionIndex()],maxNodeCount);
-		if(sucNode != NULL) {
-			sucNode->pos= sucPos;
-			sucNode->heuristic= heuristic(sucNode->pos, finalPos);
-			sucNode->prev= node;
-			sucNode->next= NULL;
-			sucNode->exploredCell= map->getSurfaceCell(Map::toSurfCoords(sucPos))->isExplored(unit->getTeam());
-
-			static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
-			MutexSafeWrapper safeMutex(factionMutex,mutexOwnerId);
-
-			if(factions[unit->getFactionIndex()].openNodesList.find(sucNode->heuristic) == factions[unit->getFactionIndex()].openNodesList.end()) {
-				factions[unit->getFactionIndex()].openNodesList[sucNode->heuristic].clear();
-			}
-			factions[unit->getFactionIndex()].openNodesList[sucNode->heuristic].push_back(sucNode);
-			factions[unit->getFactionIndex()].openPosList[sucNode->pos] = true;
+// =====================================================
+// 	Flow fields
+//
+//	Once several units of a faction head for the same target the
+//	route is read from a shared field instead of a search per unit.
+//	The request count is kept per faction so the decision only
+//	depends on the faction's own (deterministic) update order.
+// =====================================================
 
-			*newNodeAdded=sucNode;
-			result = true;
+bool PathFinder::computeFlowFieldPath(Unit *unit, const Vec2i &targetPos, vector<Vec2i> &flowPath) {
+	const Vec2i unitPos = unit->getPos();
+	if(unitPos.dist(targetPos) < flowFieldMinDistance) {
+		return false;
+	}
+
+	FactionState &searchState = getSearchState(unit);
+	FlowFieldKey key(targetPos, unit->getCurrField(), unit->getType()->getSize());
+	if(searchState.flowFieldRequests.find(key) == searchState.flowFieldRequests.end() &&
+		(int)searchState.flowFieldRequests.size() >= flowFieldMaxRequestTargets) {
+		searchState.flowFieldRequests.clear();
+	}
+	std::set<int> &requestUnits = searchState.flowFieldRequests[key];
+	requestUnits.insert(unit->getId());
+	int requestCount = (int)requestUnits.size();
+
+	// A chunk also counts what its faction asked for before this frame,
+	// the faction's list is only read until the chunks are merged
+	FactionState &factionState = factions[unit->getFactionIndex()];
+	if(&searchState != &factionState) {
+		std::map<FlowFieldKey, std::set<int> >::const_iterator iterFind = factionState.flowFieldRequests.find(key);
+		if(iterFind != factionState.flowFieldRequests.end()) {
+			for(std::set<int>::const_iterator iterUnit = iterFind->second.begin();
+				iterUnit != iterFind->second.end(); ++iterUnit) {
+				if(requestUnits.find(*iterUnit) == requestUnits.end()) {
+					requestCount++;
+				}
+			}
 		}
-		else {
-			nodeLimitReached= true;
+	}
+	if(requestCount < flowFieldMinGroupSize) {
+		return false;
+	}
+
+	// the field ignores units, so only the first step is checked against them
+	vector<Vec2i> steps;
+	if(flowFieldCache->getDownhillSteps(key, unitPos, steps) == false) {
+		return false;
+	}
+	for(unsigned int i = 0; i < steps.size(); ++i) {
+		if(canUnitMoveSoon(unit, unitPos, steps[i]) == true) {
+			flowPath.push_back(steps[i]);
+			flowFieldCache->getPath(key, steps[i], flowFieldPathLength - 1, flowPath);
+			return true;
 		}
 	}
-	return result;
+	return false;
 }
 
+class PathFinder::FactionNodeSource {
+private:
+	FactionState &factionState;
+	int maxNodeCount;
 
-direction PathFinder::directionOfMove(Vec2i to, Vec2i from) const {
-	if (from.x == to.x) {
-		if (from.y == to.y)
-			return 0;
-		else if (from.y < to.y)
-			return 4;
-		else // from.y > to.y
-			return 0;
-	}
-	else if (from.x < to.x) {
-		if (from.y == to.y)
-			return 2;
-		else if (from.y < to.y)
-			return 3;
-		else // from.y > to.y
-			return 1;
-	}
-	else { // from.x > to.x
-		if (from.y == to.y)
-			return 6;
-		else if (from.y < to.y)
-			return 5;
-		else // from.y > to.y
-			return 7;
+public:
+	FactionNodeSource(FactionState &factionState, int maxNodeCount) :
+		factionState(factionState), maxNodeCount(maxNodeCount) {
 	}
-
-}
-
-direction PathFinder::directionWeCameFrom(Vec2i node, Vec2i nodeFrom) const {
-	direction result = NO_DIRECTION;
-	if(nodeFrom.x >= 0 && nodeFrom.y >= 0) {
-		result = directionOfMove(node, nodeFrom);
+	Node *newNode() {
+		return PathFinder::newNode(factionState, maxNodeCount);
 	}
-
-	//printf("directionWeCameFrom node [%s] nodeFrom [%s] result = %d\n",node.getString().c_str(),nodeFrom.getString().c_str(),result);
-
-	return result;
+};
+
+// The route is chained behind the start node like a searched path, so the
+// caller reads it back the same way
+void PathFinder::doFlowFieldSearch(bool &pathFound, Node *&node, Node *firstNode, const vector<Vec2i> &flowPath,
+		const Vec2i &finalPos, FactionState &factionState, int maxNodeCount) {
+
+	FactionNodeSource nodeSource(factionState, maxNodeCount);
+	node = chainPathNodes(firstNode, flowPath, nodeSource);
+	for(Node *pathNode = node; pathNode != firstNode; pathNode = pathNode->prev) {
+		pathNode->heuristic = heuristic(pathNode->pos, finalPos);
+		pathNode->exploredCell = true;
+	}
+	pathFound = (node != firstNode);
 }
 
-// is this coordinate contained within the map bounds?
-bool PathFinder::contained(Vec2i c) {
-	return (map->isInside(c) == true && map->isInsideSurface(map->toSurfCoords(c)) == true);
-}
+// =====================================================
+// 	Jump point search
+//
+//	Uniform cost land movement without corner cutting, the same rule
+//	Map::aproxCanMoveSoon applies to single cell units. Multi cell units
+//	use the same stricter diagonal rule so every step stays legal.
+// =====================================================
 
-// is this coordinate within the map bounds, and also walkable?
-bool PathFinder::isEnterable(Vec2i coord) {
-	//node node = getIndex (astar->bounds, coord);
-	//return contained(coord) && astar->grid[node];
-	return contained(coord);
-}
-// the coordinate one tile in the given direction
-Vec2i PathFinder::adjustInDirection(Vec2i c, int dir) {
-	// we want to implement "rotation" - that is, for instance, we can
-	// subtract 2 from the direction "north" and get "east"
-	// C's modulo operator doesn't quite behave the right way to do this,
-	// but for our purposes this kluge should be good enough
-	switch ((dir + 65536) % 8) {
-	case 0: return Vec2i(c.x, c.y - 1);
-	case 1: return Vec2i(c.x + 1, c.y - 1);
-	case 2: return Vec2i(c.x + 1, c.y );
-	case 3: return Vec2i(c.x + 1, c.y + 1);
-	case 4: return Vec2i(c.x, c.y + 1);
-	case 5: return Vec2i(c.x - 1, c.y + 1);
-	case 6: return Vec2i(c.x - 1, c.y);
-	case 7: return Vec2i(c.x - 1, c.y - 1);
-	}
-	return Vec2i( -1, -1 );
-}
+void PathFinder::doJumpPointSearch(bool &nodeLimitReached, int &whileLoopCount,
+		FactionState &factionState, bool &pathFound, Node *&node, const Vec2i &finalPos,
+		Unit *unit, int maxNodeCount) {
 
-bool PathFinder::directionIsDiagonal(direction dir) const {
-	return (dir % 2) != 0;
-}
+	while(nodeLimitReached == false) {
+		whileLoopCount++;
+		if(factionState.openNodeHeap.empty() == true) {
+			pathFound = false;
+			break;
+		}
+		node = factionState.openNodeHeap.pop();
 
-// logical implication operator
-bool PathFinder::implies(bool a, bool b) const {
-	return a ? b : true;
-}
+		// a cheaper route to this cell was already expanded
+		if(factionState.visitedCells.isMarked(node->pos) == true) {
+			continue;
+		}
+		if(node->pos == finalPos || node->exploredCell == false) {
+			pathFound = true;
+			break;
+		}
+
+		factionState.visitedCells.mark(node->pos);
+		if(factionState.bestClosedNode == NULL ||
+			node->heuristic < factionState.bestClosedNode->heuristic) {
+			factionState.bestClosedNode = node;
+		}
 
-directionset PathFinder::addDirectionToSet(directionset dirs, direction dir) const {
-	return dirs | 1 << dir;
+		addJumpPointSuccessors(factionState, unit, node, finalPos, nodeLimitReached, maxNodeCount);
+	}
 }
 
-directionset PathFinder::forcedNeighbours(Vec2i coord,direction dir) {
-	if (dir == NO_DIRECTION)
-		return 0;
+void PathFinder::addJumpPointSuccessors(FactionState &factionState, Unit *unit, Node *node, const Vec2i &finalPos, bool &nodeLimitReached, int maxNodeCount) {
+	const Vec2i &pos = node->pos;
+	int directionCount = 0;
+	int directionsX[8];
+	int directionsY[8];
 
-	directionset dirs = 0;
-#define ENTERABLE(n) isEnterable(adjustInDirection(coord, (dir + (n)) % 8))
-	if (directionIsDiagonal(dir)) {
-		if (!implies (ENTERABLE (6), ENTERABLE (5)))
-			dirs = addDirectionToSet (dirs, (dir + 6) % 8);
-		if (!implies (ENTERABLE (2), ENTERABLE (3)))
-			dirs = addDirectionToSet (dirs, (dir + 2) % 8);
+	if(node->prev == NULL) {
+		for(int i = -1; i <= 1; ++i) {
+			for(int j = -1; j <= 1; ++j) {
+				if(i != 0 || j != 0) {
+					directionsX[directionCount] = i;
+					directionsY[directionCount] = j;
+					directionCount++;
+				}
+			}
+		}
 	}
 	else {
-		if (!implies (ENTERABLE (7), ENTERABLE (6)))
-			dirs = addDirectionToSet (dirs, (dir + 7) % 8);
-		if (!implies (ENTERABLE (1), ENTERABLE (2)))
-			dirs = addDirectionToSet (dirs, (dir + 1) % 8);
+		// prune the neighbours that a path through the parent reaches at least as cheaply
+		int dx = (pos.x > node->prev->pos.x ? 1 : (pos.x < node->prev->pos.x ? -1 : 0));
+		int dy = (pos.y > node->prev->pos.y ? 1 : (pos.y < node->prev->pos.y ? -1 : 0));
+
+		if(dx != 0 && dy != 0) {
+			bool verticalOpen = isJumpPointEnterable(factionState, unit, Vec2i(pos.x, pos.y + dy));
+			bool horizontalOpen = isJumpPointEnterable(factionState, unit, Vec2i(pos.x + dx, pos.y));
+			if(verticalOpen == true) {
+				directionsX[directionCount] = 0; directionsY[directionCount] = dy; directionCount++;
+			}
+			if(horizontalOpen == true) {
+				directionsX[directionCount] = dx; directionsY[directionCount] = 0; directionCount++;
+			}
+			if(verticalOpen == true && horizontalOpen == true) {
+				directionsX[directionCount] = dx; directionsY[directionCount] = dy; directionCount++;
+			}
+		}
+		else if(dx != 0) {
+			bool nextOpen = isJumpPointEnterable(factionState, unit, Vec2i(pos.x + dx, pos.y));
+			bool upOpen = isJumpPointEnterable(factionState, unit, Vec2i(pos.x, pos.y - 1));
+			bool downOpen = isJumpPointEnterable(factionState, unit, Vec2i(pos.x, pos.y + 1));
+			if(nextOpen == true) {
+				directionsX[directionCount] = dx; directionsY[directionCount] = 0; directionCount++;
+				if(upOpen == true) {
+					directionsX[directionCount] = dx; directionsY[directionCount] = -1; directionCount++;
+				}
+				if(downOpen == true) {
+					directionsX[directionCount] = dx; directionsY[directionCount] = 1; directionCount++;
+				}
+			}
+			if(upOpen == true) {
+				directionsX[directionCount] = 0; directionsY[directionCount] = -1; directionCount++;
+			}
+			if(downOpen == true) {
+				directionsX[directionCount] = 0; directionsY[directionCount] = 1; directionCount++;
+			}
+		}
+		else {
+			bool nextOpen = isJumpPointEnterable(factionState, unit, Vec2i(pos.x, pos.y + dy));
+			bool leftOpen = isJumpPointEnterable(factionState, unit, Vec2i(pos.x - 1, pos.y));
+			bool rightOpen = isJumpPointEnterable(factionState, unit, Vec2i(pos.x + 1, pos.y));
+			if(nextOpen == true) {
+				directionsX[directionCount] = 0; directionsY[directionCount] = dy; directionCount++;
+				if(leftOpen == true) {
+					directionsX[directionCount] = -1; directionsY[directionCount] = dy; directionCount++;
+				}
+				if(rightOpen == true) {
+					directionsX[directionCount] = 1; directionsY[directionCount] = dy; directionCount++;
+				}
+			}
+			if(leftOpen == true) {
+				directionsX[directionCount] = -1; directionsY[directionCount] = 0; directionCount++;
+			}
+			if(rightOpen == true) {
+				directionsX[directionCount] = 1; directionsY[directionCount] = 0; directionCount++;
+			}
+		}
 	}
-#undef ENTERABLE
-	return dirs;
-}
 
-directionset PathFinder::naturalNeighbours(direction dir) const {
-	if (dir == NO_DIRECTION)
-		return 255;
+	for(int i = 0; i < directionCount && nodeLimitReached == false; ++i) {
+		Vec2i jumpPoint;
+		if(findJumpPoint(factionState, unit, pos, directionsX[i], directionsY[i], finalPos, jumpPoint) == false ||
+			factionState.visitedCells.isMarked(jumpPoint) == true) {
+			continue;
+		}
 
-	directionset dirs = 0;
-	dirs = addDirectionToSet (dirs, dir);
-	if (directionIsDiagonal (dir)) {
-		dirs = addDirectionToSet (dirs, (dir + 1) % 8);
-		dirs = addDirectionToSet (dirs, (dir + 7) % 8);
-	}
-	return dirs;
-}
+		int cost = (int)node->cost + jumpPointDistance(pos, jumpPoint);
+		int knownCost = 0;
+		if(factionState.jumpPointCosts.getValue(jumpPoint, knownCost) == true && knownCost <= cost) {
+			continue;
+		}
 
-// return and remove a direction from the set
-// returns NO_DIRECTION if the set was empty
-direction PathFinder::nextDirectionInSet(directionset *dirs) const {
-	for (int i = 0; i < 8; i++) {
-		char bit = 1 << i;
-		if (*dirs & bit) {
-			*dirs ^= bit;
-			return i;
+		Node *sucNode= newNode(factionState,maxNodeCount);
+		if(sucNode == NULL) {
+			nodeLimitReached= true;
+			break;
 		}
+		sucNode->pos= jumpPoint;
+		sucNode->cost= (float)cost;
+		sucNode->heuristic= (float)jumpPointDistance(jumpPoint, finalPos);
+		sucNode->prev= node;
+		sucNode->next= NULL;
+		sucNode->exploredCell= map->getSurfaceCell(Map::toSurfCoords(jumpPoint))->isExplored(unit->getTeam());
+
+		factionState.jumpPointCosts.setValue(jumpPoint, cost);
+		factionState.openNodeHeap.push(sucNode);
 	}
-	return NO_DIRECTION;
 }
 
-// directly translated from "algorithm 2" in the paper
-Vec2i PathFinder::jump(Vec2i dest, direction dir, Vec2i start,std::vector<Vec2i> &path, int pathLength) {
-	Vec2i coord = adjustInDirection(start, dir);
-	//printf("jump dir [%u] start [%s] coord [%s] dest [%s]\n",dir,start.getString().c_str(),coord.getString().c_str(),dest.getString().c_str());
-
-	if (!isEnterable(coord))
-		return Vec2i(-1,-1);
-
-	if(path.size() > max(300,pathLength*2)) {
-	//if(path.size() > 2000) {
-		//printf("path.size() > pathLength [%d]\n",pathLength);
-		//return Vec2i(-1,-1);
-		return coord;
+// The map as seen by one unit, for the scans in grid_path_search.h
+class PathFinder::JumpPointGrid {
+private:
+	PathFinder *pathFinder;
+	FactionState &factionState;
+	Unit *unit;
+	const Map *map;
+
+public:
+	JumpPointGrid(PathFinder *pathFinder, FactionState &factionState, Unit *unit, const Map *map) :
+		factionState(factionState) {
+		this->pathFinder = pathFinder;
+		this->unit = unit;
+		this->map = map;
 	}
-	path.push_back(coord);
-
-	//int node = getIndex (astar->bounds, coord);
-	if (coord == dest || forcedNeighbours(coord, dir)) {
-		//path.push_back(coord);
-		//printf("jump #1 = %d [%d]\n",(int)path.size(),pathLength);
-		return coord;
+	bool isEnterable(const Vec2i &pos) {
+		return pathFinder->isJumpPointEnterable(factionState, unit, pos);
 	}
-
-	if(directionIsDiagonal(dir)) {
-		Vec2i next = jump(dest, (dir + 7) % 8, coord,path,pathLength);
-		if (next.x >= 0) {
-			//path.push_back(coord);
-			//printf("jump #2 = %d [%d]\n",(int)path.size(),pathLength);
-			return coord;
-		}
-		next = jump(dest, (dir + 1) % 8, coord, path,pathLength);
-		if (next.x >= 0) {
-			//path.push_back(coord);
-			//printf("jump #3 = %d [%d]\n",(int)path.size(),pathLength);
-			return coord;
-		}
+	bool isExplored(const Vec2i &pos) const {
+		return map->getSurfaceCell(Map::toSurfCoords(pos))->isExplored(unit->getTeam());
 	}
-	//else {
-	//path.push_back(coord);
-	//}
-	return jump(dest, dir, coord, path,pathLength);
-}
+};
 
+bool PathFinder::findJumpPoint(FactionState &factionState, Unit *unit, const Vec2i &start, int dx, int dy, const Vec2i &finalPos, Vec2i &jumpPoint) {
+	JumpPointGrid grid(this, factionState, unit, map);
+	return Glest::Game::findJumpPoint(grid, start, dx, dy, finalPos, jumpPointMaxDistance, jumpPoint);
+}
 
-void PathFinder::astarJPS(std::map<Vec2i,Vec2i> cameFrom, Node *& node,
-		const Vec2i & finalPos, std::map<Vec2i,bool> closedNodes,
-		std::map<std::pair<Vec2i,Vec2i> ,bool> canAddNode, Unit *& unit,
-		bool & nodeLimitReached, int & maxNodeCount) {
-	Vec2i cameFromPos(-1, -1);
-	if(cameFrom.find(node->pos) != cameFrom.end()) {
-		cameFromPos = cameFrom[node->pos];
+bool PathFinder::isJumpPointEnterable(FactionState &factionState, Unit *unit, const Vec2i &pos) {
+	if(map->isInside(pos) == false || map->isInsideSurface(map->toSurfCoords(pos)) == false) {
+		return false;
 	}
-	direction from = directionWeCameFrom(node->pos, cameFromPos);
-	directionset dirs = forcedNeighbours(node->pos, from) | naturalNeighbours(from);
-	bool canAddEntirePath = false;
-	bool foundQuickRoute = false;
-	for (int dir = nextDirectionInSet(&dirs); dir != NO_DIRECTION; dir = nextDirectionInSet(&dirs)) {
-		//for (int dir = 0; dir < 8; dir++) {
-		std::vector<Vec2i> path;
-		Vec2i newNode = jump(finalPos, dir, node->pos,path,(int)node->pos.dist(finalPos));
-		//Vec2i newNode = adjustInDirection(node->pos, dir);
-
-		//printf("examine node from [%u][%u] - current node [%s] next possible node [%s]\n",from,dirs,node->pos.getString().c_str(),newNode.getString().c_str());
-
-		//coord_t newCoord = getCoord (bounds, newNode);
-
-		// this'll also bail out if jump() returned -1
-		if (!contained(newNode))
-			continue;
-
-		if(closedNodes.find(newNode) != closedNodes.end())
-			continue;
-		//if(factions[unit->getFactionIndex()].closedNodesList.find(node->heuristic) == factions[unit->getFactionIndex()].closedNodesList.end()) {
-
-		//addToOpenSet (&astar, newNode, node);
-		//printf("JPS #2 node->pos [%s] newNode [%s] path.size() [%d] pos [%s]\n",node->pos.getString().c_str(),newNode.getString().c_str(),(int)path.size(),path[0].getString().c_str());
-
-		Vec2i newPath = path[0];
-
-		//bool canUnitMoveToCell = map->aproxCanMove(unit, node->pos, newPath);
-		//bool posOpen = (openPos(newPath, factions[unit->getFactionIndex()]) == false);
-		//bool isFreeCell = map->isFreeCell(newPath,unit->getType()->getField());
-
-		if(canAddNode.find(make_pair(node->pos,newPath)) == canAddNode.end()) {
-			Node *newNode=NULL;
-			if(addToOpenSet(unit, node, finalPos, newPath, nodeLimitReached, maxNodeCount,&newNode,false) == true) {
-				//cameFrom = node->pos;
-				cameFrom[newPath]=node->pos;
-				foundQuickRoute = true;
-
-				if(path.size() > 1 && path[path.size()-1] == finalPos) {
-					canAddEntirePath = true;
-					for(unsigned int x = 1; x < path.size(); ++x) {
-						Vec2i futureNode = path[x];
-
-						bool canUnitMoveToCell = canUnitMoveSoon(unit, newNode->pos, futureNode);
-						if(canUnitMoveToCell != true || openPos(futureNode, factions[unit->getFactionIndex()]) == true) {
-							canAddEntirePath = false;
-							canAddNode[make_pair(node->pos,futureNode)]=false;
-							//printf("COULD NOT ADD ENTIRE PATH! canUnitMoveToCell = %d\n",canUnitMoveToCell);
-							break;
-						}
-					}
-					if(canAddEntirePath == true) {
-						//printf("add node - ENTIRE PATH!\n");
 
-						for(unsigned int x = 1; x < path.size(); ++x) {
-							Vec2i futureNode = path[x];
-
-							Node *newNode2=NULL;
-							addToOpenSet(unit, newNode, finalPos, futureNode, nodeLimitReached, maxNodeCount,&newNode2, true);
-							newNode=newNode2;
-						}
+	CellValueGrid &enterableCells = factionState.enterableCells;
+	int value = 0;
+	if(enterableCells.getValue(pos, value) == true) {
+		return (value != 0);
+	}
+	// moving onto a cell from itself only checks the cell (or footprint) itself
+	bool result = canUnitMoveSoon(unit, pos, pos);
+	enterableCells.setValue(pos, (result == true ? 1 : 0));
+	return result;
+}
 
-						//Node *result = factions[unit->getFactionIndex()].openNodesList.begin()->second[0];
-						//if(result->pos == finalPos || result->exploredCell == false) {
-						//	printf("Will break out of pathfinding now!\n");
-						//}
-					}
-				}
-				//printf("add node - current node [%s] next possible node [%s] canUnitMoveToCell [%d] posOpen [%d] isFreeCell [%d]\n",node->pos.getString().c_str(),newPath.getString().c_str(),canUnitMoveToCell,posOpen,isFreeCell);
+//route a unit using A* algorithm
+// Targets outside the unit's region are moved to the closest reachable cell
+// (or flagged unreachable) instead of exhausting the node budget.
+// Long trips are planned on the cluster graph first, the cell search
+// then only has to reach the next waypoint along that route
+Vec2i PathFinder::computeSearchTarget(Unit *unit, const Vec2i &targetPos, bool inBailout, bool &targetUnreachable) {
+	Vec2i finalPos= computeNearestFreePos(unit, targetPos);
+	const Vec2i unitPos = unit->getPos();
+	targetUnreachable = false;
+
+	if(connectivityMap != NULL && inBailout == false) {
+		const Field field = unit->getCurrField();
+		const int unitSize = unit->getType()->getSize();
+		if(connectivityMap->isReachable(field, unitSize, unitPos, finalPos) == false) {
+			Vec2i reachablePos;
+			if(connectivityMap->findNearestReachable(field, unitSize, unitPos, finalPos, unreachableSearchRadius, reachablePos) == true) {
+				finalPos= reachablePos;
 			}
 			else {
-				//printf("COULD NOT add node - current node [%s] next possible node [%s] canUnitMoveToCell [%d] posOpen [%d] isFreeCell [%d]\n",node->pos.getString().c_str(),newPath.getString().c_str(),canUnitMoveToCell,posOpen,isFreeCell);
-				canAddNode[make_pair(node->pos,newPath)]=false;
+				targetUnreachable = true;
+				return finalPos;
 			}
 		}
-
-		//if(canAddEntirePath == true) {
-		//	break;
-		//}
 	}
-	if(foundQuickRoute == false) {
-		for (int dir = 0; dir < 8; dir++) {
-			Vec2i newNode = adjustInDirection(node->pos, dir);
-
-			//printf("examine node from [%u][%u] - current node [%s] next possible node [%s]\n",from,dirs,node->pos.getString().c_str(),newNode.getString().c_str());
-
-			//coord_t newCoord = getCoord (bounds, newNode);
 
-			// this'll also bail out if jump() returned -1
-			if (!contained(newNode))
-				continue;
-
-			if(closedNodes.find(newNode) != closedNodes.end())
-				continue;
-			//if(factions[unit->getFactionIndex()].closedNodesList.find(node->heuristic) == factions[unit->getFactionIndex()].closedNodesList.end()) {
-
-			//addToOpenSet (&astar, newNode, node);
-			//printf("JPS #3 node->pos [%s] newNode [%s]\n",node->pos.getString().c_str(),newNode.getString().c_str());
-
-			Vec2i newPath = newNode;
-
-			//bool canUnitMoveToCell = map->aproxCanMove(unit, node->pos, newPath);
-			//bool posOpen = (openPos(newPath, factions[unit->getFactionIndex()]) == false);
-			//bool isFreeCell = map->isFreeCell(newPath,unit->getType()->getField());
-
-			if(canAddNode.find(make_pair(node->pos,newPath)) == canAddNode.end()) {
-				Node *newNode=NULL;
-				if(addToOpenSet(unit, node, finalPos, newPath, nodeLimitReached, maxNodeCount,&newNode, false) == true) {
-					//cameFrom = node->pos;
-					cameFrom[newPath]=node->pos;
-					foundQuickRoute = true;
-
-					//printf("#2 add node - current node [%s] next possible node [%s] canUnitMoveToCell [%d] posOpen [%d] isFreeCell [%d]\n",node->pos.getString().c_str(),newPath.getString().c_str(),canUnitMoveToCell,posOpen,isFreeCell);
-				}
-				else {
-					//printf("#2 COULD NOT add node - current node [%s] next possible node [%s] canUnitMoveToCell [%d] posOpen [%d] isFreeCell [%d]\n",node->pos.getString().c_str(),newPath.getString().c_str(),canUnitMoveToCell,posOpen,isFreeCell);
-					canAddNode[make_pair(node->pos,newPath)]=false;
-				}
+	if(hierarchyGraph != NULL && inBailout == false) {
+		if(unitPos.dist(finalPos) > hierarchyGraph->getClusterSize() * 1.5f) {
+			Vec2i waypoint;
+			if(hierarchyGraph->findWaypoint(unit->getCurrField(), unit->getType()->getSize(), unitPos, finalPos, waypoint) == true) {
+				finalPos= computeNearestFreePos(unit, waypoint);
 			}
 		}
 	}
+	return finalPos;
 }
 
-
-//route a unit using A* algorithm
 TravelState PathFinder::aStar(Unit *unit, const Vec2i &targetPos, bool inBailout,
 		int frameIndex, int maxNodeCount, uint32 *searched_node_count) {
 
@@ -788,11 +1050,12 @@ TravelState PathFinder::aStar(Unit *unit, const Vec2i &targetPos, bool inBailout
 		throw megaglest_runtime_error("map == NULL");
 	}
 
-	const bool showConsoleDebugInfo = Config::getInstance().getBool("EnablePathfinderDistanceOutput","false");
-	const bool tryLastPathCache = Config::getInstance().getBool("EnablePathfinderCache","false");
+	const bool showConsoleDebugInfo = Config::getCachedValues().enablePathfinderDistanceOutput;
+	const bool tryLastPathCache = Config::getCachedValues().enablePathfinderCache;
 
+	FactionState &searchState = getSearchState(unit);
 	if(maxNodeCount < 0) {
-		maxNodeCount = factions[unit->getFactionIndex()].useMaxNodeCount;
+		maxNodeCount = searchState.useMaxNodeCount;
 
 		//printf("AStar set maxNodeCount = %d\n",maxNodeCount);
 	}
@@ -804,32 +1067,28 @@ TravelState PathFinder::aStar(Unit *unit, const Vec2i &targetPos, bool inBailout
 	}
 
 	UnitPathInterface *path= unit->getPath();
-	int unitFactionIndex = unit->getFactionIndex();
-
-	factions[unitFactionIndex].nodePoolCount= 0;
-	factions[unitFactionIndex].openNodesList.clear();
-	factions[unitFactionIndex].openPosList.clear();
-	factions[unitFactionIndex].closedNodesList.clear();
+	searchState.nodePoolCount= 0;
+	clearSearchState(searchState);
 
 	TravelState ts = tsImpossible;
 
 	// check the pre-cache to see if we can re-use a cached path
 	if(frameIndex < 0) {
-		if(factions[unitFactionIndex].precachedTravelState.find(unit->getId()) != factions[unitFactionIndex].precachedTravelState.end()) {
-			if(factions[unitFactionIndex].precachedTravelState[unit->getId()] == tsMoving) {
+		if(searchState.precachedTravelState.find(unit->getId()) != searchState.precachedTravelState.end()) {
+			if(searchState.precachedTravelState[unit->getId()] == tsMoving) {
 				bool canMoveToCells = true;
 
 				Vec2i lastPos = unit->getPos();
-				for(int i=0; i < factions[unitFactionIndex].precachedPath[unit->getId()].size(); i++) {
-					Vec2i nodePos = factions[unitFactionIndex].precachedPath[unit->getId()][i];
+				for(int i=0; i < searchState.precachedPath[unit->getId()].size(); i++) {
+					Vec2i nodePos = searchState.precachedPath[unit->getId()][i];
 					if(map->isInside(nodePos) == false || map->isInsideSurface(map->toSurfCoords(nodePos)) == false) {
 						throw megaglest_runtime_error("Pathfinder invalid node path position = " + nodePos.getString() + " i = " + intToStr(i));
 					}
 
 					//if(i < pathFindRefresh ||
 					if(i < unit->getPathFindRefreshCellCount() ||
-						(factions[unitFactionIndex].precachedPath[unit->getId()].size() >= pathFindExtendRefreshForNodeCount &&
-						 i < getPathFindExtendRefreshNodeCount(unitFactionIndex))) {
+						(searchState.precachedPath[unit->getId()].size() >= pathFindExtendRefreshForNodeCount &&
+						 i < getPathFindExtendRefreshNodeCount(searchState))) {
 						//!!! Test MV
 						if(canUnitMoveSoon(unit, lastPos, nodePos) == false) {
 							canMoveToCells = false;
@@ -846,16 +1105,16 @@ TravelState PathFinder::aStar(Unit *unit, const Vec2i &targetPos, bool inBailout
 					path->clear();
 					UnitPathBasic *basicPathFinder = dynamic_cast<UnitPathBasic *>(path);
 
-					for(int i=0; i < factions[unitFactionIndex].precachedPath[unit->getId()].size(); i++) {
-						Vec2i nodePos = factions[unitFactionIndex].precachedPath[unit->getId()][i];
+					for(int i=0; i < searchState.precachedPath[unit->getId()].size(); i++) {
+						Vec2i nodePos = searchState.precachedPath[unit->getId()][i];
 						if(map->isInside(nodePos) == false || map->isInsideSurface(map->toSurfCoords(nodePos)) == false) {
 							throw megaglest_runtime_error("Pathfinder invalid node path position = " + nodePos.getString() + " i = " + intToStr(i));
 						}
 
 						//if(i < pathFindRefresh ||
 						if(i < unit->getPathFindRefreshCellCount() ||
-								(factions[unitFactionIndex].precachedPath[unit->getId()].size() >= pathFindExtendRefreshForNodeCount &&
-								 i < getPathFindExtendRefreshNodeCount(unitFactionIndex))) {
+								(searchState.precachedPath[unit->getId()].size() >= pathFindExtendRefreshForNodeCount &&
+								 i < getPathFindExtendRefreshNodeCount(searchState))) {
 							path->add(nodePos);
 						}
 						//else if(tryLastPathCache == false) {
@@ -868,16 +1127,16 @@ TravelState PathFinder::aStar(Unit *unit, const Vec2i &targetPos, bool inBailout
 						}
 					}
 					unit->setUsePathfinderExtendedMaxNodes(false);
-					return factions[unitFactionIndex].precachedTravelState[unit->getId()];
+					return searchState.precachedTravelState[unit->getId()];
 				}
 				else {
 					clearUnitPrecache(unit);
 				}
 			}
-			else if(factions[unitFactionIndex].precachedTravelState[unit->getId()] == tsBlocked) {
+			else if(searchState.precachedTravelState[unit->getId()] == tsBlocked) {
 				path->incBlockCount();
 				unit->setUsePathfinderExtendedMaxNodes(false);
-				return factions[unitFactionIndex].precachedTravelState[unit->getId()];
+				return searchState.precachedTravelState[unit->getId()];
 			}
 		}
 	}
@@ -886,10 +1145,16 @@ TravelState PathFinder::aStar(Unit *unit, const Vec2i &targetPos, bool inBailout
 	}
 
 	const Vec2i unitPos = unit->getPos();
-	const Vec2i finalPos= computeNearestFreePos(unit, targetPos);
+	// Groups sent to the same target share one flow field instead of searching
+	vector<Vec2i> flowPath;
+	const bool flowFieldSearch = (flowFieldCache != NULL && inBailout == false &&
+								  computeFlowFieldPath(unit, targetPos, flowPath) == true);
+
+	bool targetUnreachable = false;
+	const Vec2i finalPos= computeSearchTarget(unit, targetPos, (inBailout || flowFieldSearch), targetUnreachable);
 
 	float dist= unitPos.dist(finalPos);
-	factions[unitFactionIndex].useMaxNodeCount = PathFinder::pathFindNodesMax;
+	searchState.useMaxNodeCount = PathFinder::pathFindNodesMax;
 
 	if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled == true && chrono.getMillis() > 4) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s Line: %d] took msecs: %lld\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,chrono.getMillis());
 
@@ -929,7 +1194,7 @@ TravelState PathFinder::aStar(Unit *unit, const Vec2i &targetPos, bool inBailout
 										}
 
 										if(frameIndex >= 0) {
-											factions[unitFactionIndex].precachedPath[unit->getId()].push_back(cachedPath[k]);
+											searchState.precachedPath[unit->getId()].push_back(cachedPath[k]);
 										}
 										else {
 											//if(pathCount < pathFindRefresh) {
@@ -945,8 +1210,8 @@ TravelState PathFinder::aStar(Unit *unit, const Vec2i &targetPos, bool inBailout
 
 									if(SystemFlags::getSystemSettingType(SystemFlags::debugWorldSynch).enabled == true && frameIndex < 0) {
 										char szBuf[8096]="";
-										snprintf(szBuf,8096,"[Setting new path for unit] openNodesList.size() [" MG_SIZE_T_SPECIFIER "] openPosList.size() [" MG_SIZE_T_SPECIFIER "] finalPos [%s] targetPos [%s] inBailout [%d] ts [%d]",
-												factions[unitFactionIndex].openNodesList.size(),factions[unitFactionIndex].openPosList.size(),finalPos.getString().c_str(),targetPos.getString().c_str(),inBailout,ts);
+										snprintf(szBuf,8096,"[Setting new path for unit] %s finalPos [%s] targetPos [%s] inBailout [%d] ts [%d]",
+												getSearchStateStats(searchState).c_str(),finalPos.getString().c_str(),targetPos.getString().c_str(),inBailout,ts);
 										unit->logSynchData(extractFileFromDirectoryPath(__FILE__).c_str(),__LINE__,szBuf);
 									}
 
@@ -986,7 +1251,7 @@ TravelState PathFinder::aStar(Unit *unit, const Vec2i &targetPos, bool inBailout
 										}
 
 										if(frameIndex >= 0) {
-											factions[unitFactionIndex].precachedPath[unit->getId()].push_back(cachedPath[k]);
+											searchState.precachedPath[unit->getId()].push_back(cachedPath[k]);
 										}
 										else {
 											//if(pathCount < pathFindRefresh) {
@@ -1002,8 +1267,8 @@ TravelState PathFinder::aStar(Unit *unit, const Vec2i &targetPos, bool inBailout
 
 									if(SystemFlags::getSystemSettingType(SystemFlags::debugWorldSynch).enabled == true && frameIndex < 0) {
 										char szBuf[8096]="";
-										snprintf(szBuf,8096,"[Setting new path for unit] openNodesList.size() [" MG_SIZE_T_SPECIFIER "] openPosList.size() [" MG_SIZE_T_SPECIFIER "] finalPos [%s] targetPos [%s] inBailout [%d] ts [%d]",
-												factions[unitFactionIndex].openNodesList.size(),factions[unitFactionIndex].openPosList.size(),finalPos.getString().c_str(),targetPos.getString().c_str(),inBailout,ts);
+										snprintf(szBuf,8096,"[Setting new path for unit] %s finalPos [%s] targetPos [%s] inBailout [%d] ts [%d]",
+												getSearchStateStats(searchState).c_str(),finalPos.getString().c_str(),targetPos.getString().c_str(),inBailout,ts);
 										unit->logSynchData(extractFileFromDirectoryPath(__FILE__).c_str(),__LINE__,szBuf);
 									}
 
@@ -1039,22 +1304,26 @@ TravelState PathFinder::aStar(Unit *unit, const Vec2i &targetPos, bool inBailout
 	//path find algorithm
 
 	//a) push starting pos into openNodes
-	Node *firstNode= newNode(factions[unitFactionIndex],maxNodeCount);
+	Node *firstNode= newNode(searchState,maxNodeCount);
 	assert(firstNode != NULL);
 	if(firstNode == NULL) {
 		throw megaglest_runtime_error("firstNode == NULL");
 	}
 
+	const bool jumpPointSearch = (useJumpPointSearch == true && unit->getCurrField() == fLand);
+
 	firstNode->next= NULL;
 	firstNode->prev= NULL;
 	firstNode->pos= unitPos;
-	firstNode->heuristic= heuristic(unitPos, finalPos);
 	firstNode->exploredCell= true;
-	if(factions[unitFactionIndex].openNodesList.find(firstNode->heuristic) == factions[unitFactionIndex].openNodesList.end()) {
-		factions[unitFactionIndex].openNodesList[firstNode->heuristic].clear();
+	if(jumpPointSearch == true) {
+		firstNode->heuristic= (float)jumpPointDistance(unitPos, finalPos);
+		searchState.openNodeHeap.push(firstNode);
+	}
+	else {
+		firstNode->heuristic= heuristic(unitPos, finalPos);
+		addOpenNode(searchState,firstNode);
 	}
-	factions[unitFactionIndex].openNodesList[firstNode->heuristic].push_back(firstNode);
-	factions[unitFactionIndex].openPosList[firstNode->pos] = true;
 
 	//b) loop
 	bool pathFound			= true;
@@ -1118,28 +1387,35 @@ TravelState PathFinder::aStar(Unit *unit, const Vec2i &targetPos, bool inBailout
 			}
 		}
 	}
+
+	// Start and target are in different regions, no search can succeed
+	if(nodeLimitReached == false && targetUnreachable == true) {
+		nodeLimitReached = true;
+		pathFound = false;
+
+		if(showConsoleDebugInfo) {
+			printf("**Target unreachable, unit [%d - %s] from [%s] to [%s]\n",
+					unit->getId(),unit->getFullName().c_str(), unitPos.getString().c_str(), finalPos.getString().c_str());
+		}
+	}
 	//
 
 	// START
-	//Vec2i cameFrom= unit->getPos();
-	//Vec2i cameFrom(-1,-1);
-	std::map<std::pair<Vec2i,Vec2i> ,bool> canAddNode;
-	std::map<Vec2i,bool> closedNodes;
-	std::map<Vec2i,Vec2i> cameFrom;
-	cameFrom[unitPos] = Vec2i(-1,-1);
-	//cameFrom[unitPos] = unit->getPos();
-
 	// Do the a-star base pathfind work if required
 
 	int whileLoopCount = 0;
 	if(nodeLimitReached == false) {
-		//printf("\n\n\n====== START AStar-JPS Pathfinder start [%s] end [%s]\n",unitPos.getString().c_str(),finalPos.getString().c_str());
-
-		const bool tryJPSPathfinder = false;
-
-		doAStarPathSearch(nodeLimitReached, whileLoopCount, unitFactionIndex,
-							pathFound, node, finalPos, tryJPSPathfinder,
-							closedNodes, cameFrom, canAddNode, unit, maxNodeCount,frameIndex);
+		if(flowFieldSearch == true) {
+			doFlowFieldSearch(pathFound, node, firstNode, flowPath, finalPos, searchState, maxNodeCount);
+		}
+		else if(jumpPointSearch == true) {
+			doJumpPointSearch(nodeLimitReached, whileLoopCount, searchState,
+								pathFound, node, finalPos, unit, maxNodeCount);
+		}
+		else {
+			doAStarPathSearch(nodeLimitReached, whileLoopCount, searchState,
+								pathFound, node, finalPos, unit, maxNodeCount,frameIndex);
+		}
 
 		if(searched_node_count != NULL) {
 			*searched_node_count = whileLoopCount;
@@ -1169,19 +1445,19 @@ TravelState PathFinder::aStar(Unit *unit, const Vec2i &targetPos, bool inBailout
 		}
 	}
 
-	if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled == true && chrono.getMillis() > 1) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s Line: %d] took msecs: %lld nodeLimitReached = %d whileLoopCount = %d nodePoolCount = %d\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,chrono.getMillis(),nodeLimitReached,whileLoopCount,factions[unitFactionIndex].nodePoolCount);
+	if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled == true && chrono.getMillis() > 1) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s Line: %d] took msecs: %lld nodeLimitReached = %d whileLoopCount = %d nodePoolCount = %d\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,chrono.getMillis(),nodeLimitReached,whileLoopCount,searchState.nodePoolCount);
 	if(showConsoleDebugInfo && chrono.getMillis() > 2) {
-		printf("Distance for unit [%d - %s] from [%s] to [%s] is %.2f took msecs: %lld nodeLimitReached = %d whileLoopCount = %d nodePoolCount = %d\n",unit->getId(),unit->getFullName().c_str(), unitPos.getString().c_str(), finalPos.getString().c_str(), dist,(long long int)chrono.getMillis(),nodeLimitReached,whileLoopCount,factions[unitFactionIndex].nodePoolCount);
+		printf("Distance for unit [%d - %s] from [%s] to [%s] is %.2f took msecs: %lld nodeLimitReached = %d whileLoopCount = %d nodePoolCount = %d\n",unit->getId(),unit->getFullName().c_str(), unitPos.getString().c_str(), finalPos.getString().c_str(), dist,(long long int)chrono.getMillis(),nodeLimitReached,whileLoopCount,searchState.nodePoolCount);
 	}
 
 	Node *lastNode= node;
 
 	//if consumed all nodes find best node (to avoid strange behaviour)
 	if(nodeLimitReached == true) {
-		if(factions[unitFactionIndex].closedNodesList.size() > 0) {
-			float bestHeuristic = factions[unitFactionIndex].closedNodesList.begin()->first;
-			if(bestHeuristic < lastNode->heuristic) {
-				lastNode= factions[unitFactionIndex].closedNodesList.begin()->second[0];
+		Node *bestClosedNode = (jumpPointSearch == true ? searchState.bestClosedNode : getBestClosedNode(searchState));
+		if(bestClosedNode != NULL) {
+			if(bestClosedNode->heuristic < lastNode->heuristic) {
+				lastNode= bestClosedNode;
 			}
 		}
 	}
@@ -1219,8 +1495,8 @@ TravelState PathFinder::aStar(Unit *unit, const Vec2i &targetPos, bool inBailout
 
 		if(SystemFlags::getSystemSettingType(SystemFlags::debugWorldSynch).enabled == true && frameIndex < 0) {
 			char szBuf[8096]="";
-			snprintf(szBuf,8096,"[path for unit BLOCKED] openNodesList.size() [" MG_SIZE_T_SPECIFIER "] openPosList.size() [" MG_SIZE_T_SPECIFIER "] finalPos [%s] targetPos [%s] inBailout [%d] ts [%d]",
-					factions[unitFactionIndex].openNodesList.size(),factions[unitFactionIndex].openPosList.size(),finalPos.getString().c_str(),targetPos.getString().c_str(),inBailout,ts);
+			snprintf(szBuf,8096,"[path for unit BLOCKED] %s finalPos [%s] targetPos [%s] inBailout [%d] ts [%d]",
+					getSearchStateStats(searchState).c_str(),finalPos.getString().c_str(),targetPos.getString().c_str(),inBailout,ts);
 			unit->logSynchData(extractFileFromDirectoryPath(__FILE__).c_str(),__LINE__,szBuf);
 		}
 
@@ -1260,9 +1536,10 @@ TravelState PathFinder::aStar(Unit *unit, const Vec2i &targetPos, bool inBailout
 
 		UnitPathBasic *basicPathFinder = dynamic_cast<UnitPathBasic *>(path);
 
-		currNode= firstNode;
-		for(int i=0; currNode->next != NULL; currNode= currNode->next, i++) {
-			Vec2i nodePos = currNode->next->pos;
+		vector<Vec2i> pathCells;
+		Glest::Game::getPathCells(firstNode, pathCells);
+		for(int i=0; i < (int)pathCells.size(); i++) {
+			Vec2i nodePos = pathCells[i];
 			if(map->isInside(nodePos) == false || map->isInsideSurface(map->toSurfCoords(nodePos)) == false) {
 				throw megaglest_runtime_error("Pathfinder invalid node path position = " + nodePos.getString() + " i = " + intToStr(i));
 			}
@@ -1271,13 +1548,13 @@ TravelState PathFinder::aStar(Unit *unit, const Vec2i &targetPos, bool inBailout
 			if(minorDebugPathfinder) printf("nodePos [%s]\n",nodePos.getString().c_str());
 
 			if(frameIndex >= 0) {
-				factions[unitFactionIndex].precachedPath[unit->getId()].push_back(nodePos);
+				searchState.precachedPath[unit->getId()].push_back(nodePos);
 			}
 			else {
 				//if(i < pathFindRefresh ||
 				if(i < unit->getPathFindRefreshCellCount() ||
 					(whileLoopCount >= pathFindExtendRefreshForNodeCount &&
-					 i < getPathFindExtendRefreshNodeCount(unitFactionIndex))) {
+					 i < getPathFindExtendRefreshNodeCount(searchState))) {
 					path->add(nodePos);
 				}
 				//else if(tryLastPathCache == false) {
@@ -1295,8 +1572,8 @@ TravelState PathFinder::aStar(Unit *unit, const Vec2i &targetPos, bool inBailout
 
 		if(SystemFlags::getSystemSettingType(SystemFlags::debugWorldSynch).enabled == true && frameIndex < 0) {
 			char szBuf[8096]="";
-			snprintf(szBuf,8096,"[Setting new path for unit] openNodesList.size() [" MG_SIZE_T_SPECIFIER "] openPosList.size() [" MG_SIZE_T_SPECIFIER "] finalPos [%s] targetPos [%s] inBailout [%d] ts [%d]",
-					factions[unitFactionIndex].openNodesList.size(),factions[unitFactionIndex].openPosList.size(),finalPos.getString().c_str(),targetPos.getString().c_str(),inBailout,ts);
+			snprintf(szBuf,8096,"[Setting new path for unit] %s finalPos [%s] targetPos [%s] inBailout [%d] ts [%d]",
+					getSearchStateStats(searchState).c_str(),finalPos.getString().c_str(),targetPos.getString().c_str(),inBailout,ts);
 			unit->logSynchData(extractFileFromDirectoryPath(__FILE__).c_str(),__LINE__,szBuf);
 
 			string pathToTake = "";
@@ -1326,14 +1603,12 @@ TravelState PathFinder::aStar(Unit *unit, const Vec2i &targetPos, bool inBailout
 		if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled == true && chrono.getMillis() > 4) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s Line: %d] took msecs: %lld\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,chrono.getMillis());
 	}
 
-	factions[unitFactionIndex].openNodesList.clear();
-	factions[unitFactionIndex].openPosList.clear();
-	factions[unitFactionIndex].closedNodesList.clear();
+	clearSearchState(searchState);
 
 	if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled == true && chrono.getMillis() > 4) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s] Line: %d took msecs: %lld --------------------------- [END OF METHOD] ---------------------------\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,chrono.getMillis());
 
 	if(frameIndex >= 0) {
-		factions[unitFactionIndex].precachedTravelState[unit->getId()] = ts;
+		searchState.precachedTravelState[unit->getId()] = ts;
 	}
 	else {
 		if(SystemFlags::VERBOSE_MODE_ENABLED && chrono.getMillis() >= 5) printf("In [%s::%s Line: %d] astar took [%lld] msecs, ts = %d.\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,(long long int)chrono.getMillis(),ts);
@@ -1423,7 +1698,7 @@ bool PathFinder::unitCannotMove(Unit *unit) {
 	bool unitImmediatelyBlocked = false;
 
 	// First check if unit currently blocked all around them, if so don't try to pathfind
-	const bool showConsoleDebugInfo = Config::getInstance().getBool("EnablePathfinderDistanceOutput","false");
+	const bool showConsoleDebugInfo = Config::getCachedValues().enablePathfinderDistanceOutput;
 	const Vec2i unitPos = unit->getPos();
 	int failureCount = 0;
 	int cellCount = 0;
@@ -20,10 +20,15 @@
 #include "vec.h"
 #include <vector>
 #include <map>
+#include <set>
 #include "game_constants.h"
 #include "skill_type.h"
 #include "map.h"
 #include "unit.h"
+#include "hierarchical_path_graph.h"
+#include "connectivity_map.h"
+#include "flow_field.h"
+#include "grid_path_search.h"
 
 //#include <tr1/unordered_map>
 //using namespace std::tr1;
@@ -38,19 +43,13 @@ namespace Glest { namespace Game {
 //class Map;
 //class Unit;
 
-// The order of directions is:
-// N, NE, E, SE, S, SW, W, NW
-typedef unsigned char direction;
-#define NO_DIRECTION 8
-typedef unsigned char directionset;
-
 // =====================================================
 // 	class PathFinder
 //
 ///	Finds paths for units using a modification of the A* algorithm
 // =====================================================
 
-class PathFinder {
+class PathFinder : public MapCellChangeCallbackInterface {
 public:
 	class BadUnitNodeList {
 	public:
@@ -90,16 +89,133 @@ public:
 			next=NULL;
 			prev=NULL;
 			heuristic=0.0;
+			cost=0.0;
 			exploredCell=false;
 		}
 		Vec2i pos;
 		Node *next;
 		Node *prev;
 		float heuristic;
+		// path cost from the start, only used by the jump point search
+		float cost;
 		bool exploredCell;
 	};
 	typedef vector<Node*> Nodes;
 
+	// Binary min-heap of open nodes ordered by heuristic plus cost, ties
+	// broken by insertion order. The legacy search never sets a cost so
+	// this pops nodes in exactly the same order as the std::map<float, Nodes>
+	// open list and both search engines produce identical paths.
+	class NodeHeap {
+	public:
+		class Entry {
+		public:
+			float priority;
+			uint32 sequence;
+			Node *node;
+		};
+
+		NodeHeap() {
+			nextSequence = 0;
+		}
+		inline void clear() {
+			entries.clear();
+			nextSequence = 0;
+		}
+		inline void reserve(int count)	{ entries.reserve(count); }
+		inline bool empty() const		{ return entries.empty(); }
+		inline size_t size() const		{ return entries.size(); }
+
+		void push(Node *node);
+		Node * pop();
+
+	private:
+		inline static bool lessThan(const Entry &a, const Entry &b) {
+			if(a.priority < b.priority) {
+				return true;
+			}
+			return (a.priority == b.priority && a.sequence < b.sequence);
+		}
+
+		std::vector<Entry> entries;
+		uint32 nextSequence;
+	};
+
+	// One stamp per map cell, a cell is marked for the current search when
+	// its stamp equals the current generation so it is reset in O(1)
+	class NodeVisitGrid {
+	public:
+		NodeVisitGrid() {
+			width = 0;
+			height = 0;
+			generation = 0;
+			markedCount = 0;
+		}
+		void init(int width, int height);
+		void nextSearch();
+
+		inline bool isMarked(const Vec2i &pos) const {
+			if(pos.x < 0 || pos.y < 0 || pos.x >= width || pos.y >= height) {
+				return false;
+			}
+			return (stamps[pos.y * width + pos.x] == generation);
+		}
+		inline void mark(const Vec2i &pos) {
+			uint32 &stamp = stamps[pos.y * width + pos.x];
+			if(stamp != generation) {
+				stamp = generation;
+				markedCount++;
+			}
+		}
+		inline bool isInitialized(int width, int height) const {
+			return (this->width == width && this->height == height);
+		}
+		inline int getMarkedCount() const { return markedCount; }
+
+	private:
+		std::vector<uint32> stamps;
+		int width;
+		int height;
+		uint32 generation;
+		int markedCount;
+	};
+
+	// Same generation scheme as NodeVisitGrid but with a value per cell
+	class CellValueGrid {
+	public:
+		CellValueGrid() {
+			width = 0;
+			height = 0;
+			generation = 0;
+		}
+		void init(int width, int height);
+		void nextSearch();
+
+		inline bool getValue(const Vec2i &pos, int &value) const {
+			int index = pos.y * width + pos.x;
+			if(stamps[index] != generation) {
+				return false;
+			}
+			value = values[index];
+			return true;
+		}
+		inline void setValue(const Vec2i &pos, int value) {
+			int index = pos.y * width + pos.x;
+			stamps[index] = generation;
+			values[index] = value;
+		}
+		inline bool isInitialized(int width, int height) const {
+			return (this->width == width && this->height == height);
+		}
+
+	private:
+		std::vector<uint32> stamps;
+		std::vector<int> values;
+		int width;
+		int height;
+		uint32 generation;
+	};
+
 	class FactionState {
 	public:
 		FactionState() {
@@ -114,6 +230,7 @@ public:
 			//mapFromToNodeList.clear();
 			//lastFromToNodeListFrame = -100;
 			badCellList.clear();
+			bestClosedNode = NULL;
 		}
 		~FactionState() {
 			//fa = NULL;
@@ -121,6 +238,17 @@ public:
 		std::map<Vec2i, bool> openPosList;
 		std::map<float, Nodes> openNodesList;
 		std::map<float, Nodes> closedNodesList;
+
+		// Used instead of the lists above when EnablePathfinderFlatHeap is set
+		// and by the jump point search
+		NodeHeap openNodeHeap;
+		NodeVisitGrid visitedCells;
+		Node *bestClosedNode;
+
+		// Jump point search: best known cost per cell and cached passability
+		CellValueGrid jumpPointCosts;
+		CellValueGrid enterableCells;
+
 		std::vector<Node> nodePool;
 		int nodePoolCount;
 		RandomGen random;
@@ -133,9 +261,25 @@ public:
 		//std::map<int, std::map<Vec2i,std::map<Vec2i, bool> > > mapFromToNodeList;
 
 		std::map<int,std::map<Field,BadUnitNodeList> > badCellList;
+
+		// Units of this faction that asked for each flow field target
+		std::map<FlowFieldKey, std::set<int> > flowFieldRequests;
 	};
 	typedef vector<FactionState> FactionStateList;
 
+	// A slice of one faction's units preprocessed by its own job. It
+	// searches with its own state and keeps its results here until
+	// applyPreprocessChunks copies them to the faction in chunk order.
+	class PreprocessChunk {
+	public:
+		PreprocessChunk() {
+			faction = NULL;
+		}
+		Faction *faction;
+		FactionState searchState;
+		std::vector<int> pathfindingUnitList;
+	};
+
 public:
 	static const int maxFreeSearchRadius;
 	//static const int pathFindRefresh;
@@ -143,6 +287,12 @@ public:
 	static const int pathFindExtendRefreshForNodeCount;
 	static const int pathFindExtendRefreshNodeCountMin;
 	static const int pathFindExtendRefreshNodeCountMax;
+	static const int jumpPointMaxDistance;
+	static const int unreachableSearchRadius;
+	static const int flowFieldMinGroupSize;
+	static const int flowFieldMinDistance;
+	static const int flowFieldPathLength;
+	static const int flowFieldMaxRequestTargets;
 
 private:
 
@@ -153,17 +303,32 @@ private:
 	FactionStateList factions;
 	const Map *map;
 	bool minorDebugPathfinder;
+	bool useFlatHeapSearch;
+	bool useJumpPointSearch;
+	HierarchicalPathGraph *hierarchyGraph;
+	ConnectivityMap *connectivityMap;
+	FlowFieldCache *flowFieldCache;
+
+	std::vector<PreprocessChunk *> preprocessChunks;
+	int preprocessChunkCount;
+	std::map<int, PreprocessChunk *> unitPreprocessChunks;
 
 public:
 	PathFinder();
 	PathFinder(const Map *map);
 	~PathFinder();
 	void init(const Map *map);
+	void setUseJumpPointSearch(bool value)			{ useJumpPointSearch = value; }
+	void setUseConnectivity(bool value);
+	void setUseFlowField(bool value);
 	TravelState findPath(Unit *unit, const Vec2i &finalPos, bool *wasStuck=NULL,int frameIndex=-1);
 	void clearUnitPrecache(Unit *unit);
 	void removeUnitPrecache(Unit *unit);
 	void clearCaches();
 
+	void addPreprocessChunk(Faction *faction, int chunkIndex, const std::vector<Unit *> &units, int frameIndex);
+	void applyPreprocessChunks();
+
 	bool unitCannotMove(Unit *unit);
 
 	int findNodeIndex(Node *node, Nodes &nodeList);
@@ -172,8 +337,32 @@ public:
 	void saveGame(XmlNode *rootNode);
 	void loadGame(const XmlNode *rootNode);
 
+	void setUseHierarchy(bool value, int clusterSize);
+	virtual void mapCellsChanged(const Vec2i &pos, int size);
+
 private:
+	Vec2i computeSearchTarget(Unit *unit, const Vec2i &targetPos, bool inBailout, bool &targetUnreachable);
 	TravelState aStar(Unit *unit, const Vec2i &finalPos, bool inBailout, int frameIndex, int maxNodeCount=-1,uint32 *searched_node_count=NULL);
+
+	inline PreprocessChunk * getPreprocessChunk(const Unit *unit) {
+		if(unitPreprocessChunks.empty() == true) {
+			return NULL;
+		}
+		std::map<int, PreprocessChunk *>::iterator iterFind = unitPreprocessChunks.find(unit->getId());
+		if(iterFind == unitPreprocessChunks.end()) {
+			return NULL;
+		}
+		return iterFind->second;
+	}
+	// The state a search for this unit runs on, its chunk's while the unit
+	// is being preprocessed in a chunk and its faction's otherwise
+	inline FactionState & getSearchState(const Unit *unit) {
+		PreprocessChunk *chunk = getPreprocessChunk(unit);
+		if(chunk != NULL) {
+			return chunk->searchState;
+		}
+		return factions[unit->getFactionIndex()];
+	}
 	//Node *newNode(FactionState &faction,int maxNodeCount);
 	inline static Node *newNode(FactionState &faction, int maxNodeCount) {
 		if( faction.nodePoolCount < faction.nodePool.size() &&
@@ -194,16 +383,75 @@ private:
 	}
 
 	//bool openPos(const Vec2i &sucPos,FactionState &faction);
-	inline static bool openPos(const Vec2i &sucPos, FactionState &faction) {
+	inline bool openPos(const Vec2i &sucPos, FactionState &faction) const {
+		if(useFlatHeapSearch == true) {
+			return faction.visitedCells.isMarked(sucPos);
+		}
 		if(faction.openPosList.find(sucPos) == faction.openPosList.end()) {
 			return false;
 		}
 		return true;
 	}
 
+	inline void addOpenNode(FactionState &faction, Node *node) {
+		if(useFlatHeapSearch == true) {
+			faction.openNodeHeap.push(node);
+			faction.visitedCells.mark(node->pos);
+			return;
+		}
+		if(faction.openNodesList.find(node->heuristic) == faction.openNodesList.end()) {
+			faction.openNodesList[node->heuristic].clear();
+		}
+		faction.openNodesList[node->heuristic].push_back(node);
+		faction.openPosList[node->pos] = true;
+	}
+
+	inline void addClosedNode(FactionState &faction, Node *node) {
+		if(useFlatHeapSearch == true) {
+			// Only the first closed node with the lowest heuristic is ever used
+			if(faction.bestClosedNode == NULL ||
+				node->heuristic < faction.bestClosedNode->heuristic) {
+				faction.bestClosedNode = node;
+			}
+			faction.visitedCells.mark(node->pos);
+			return;
+		}
+		if(faction.closedNodesList.find(node->heuristic) == faction.closedNodesList.end()) {
+			faction.closedNodesList[node->heuristic].clear();
+		}
+		faction.closedNodesList[node->heuristic].push_back(node);
+		faction.openPosList[node->pos] = true;
+	}
+
+	inline bool hasOpenNodes(const FactionState &faction) const {
+		if(useFlatHeapSearch == true) {
+			return (faction.openNodeHeap.empty() == false);
+		}
+		return (faction.openNodesList.empty() == false);
+	}
+
+	inline Node * getBestClosedNode(FactionState &faction) const {
+		if(useFlatHeapSearch == true) {
+			return faction.bestClosedNode;
+		}
+		if(faction.closedNodesList.empty() == true) {
+			return NULL;
+		}
+		return faction.closedNodesList.begin()->second[0];
+	}
+
+	void clearSearchState(FactionState &faction);
+	string getSearchStateStats(const FactionState &faction) const;
 
 	//Node * minHeuristicFastLookup(FactionState &faction);
-	inline static Node * minHeuristicFastLookup(FactionState &faction) {
+	inline Node * minHeuristicFastLookup(FactionState &faction) {
+		if(useFlatHeapSearch == true) {
+			if(faction.openNodeHeap.empty() == true) {
+				throw megaglest_runtime_error("openNodeHeap.empty() == true");
+			}
+			return faction.openNodeHeap.pop();
+		}
+
 		assert(faction.openNodesList.empty() == false);
 		if(faction.openNodesList.empty() == true) {
 			throw megaglest_runtime_error("openNodesList.empty() == true");
@@ -219,11 +467,10 @@ private:
 
 
 	//bool processNode(Unit *unit, Node *node,const Vec2i finalPos, int i, int j, bool &nodeLimitReached, int maxNodeCount);
-	inline bool processNode(Unit *unit, Node *node,const Vec2i finalPos, int i, int j, bool &nodeLimitReached,int maxNodeCount) {
+	inline bool processNode(FactionState &searchState, Unit *unit, Node *node,const Vec2i finalPos, int i, int j, bool &nodeLimitReached,int maxNodeCount) {
 		bool result = false;
 		Vec2i sucPos= node->pos + Vec2i(i, j);
 
-		int unitFactionIndex = unit->getFactionIndex();
 	//	std::map<int, std::map<Vec2i,std::map<Vec2i, bool> > >::iterator iterFind1 = factions[unitFactionIndex].mapFromToNodeList.find(unit->getType()->getId());
 	//	if(iterFind1 != factions[unitFactionIndex].mapFromToNodeList.end()) {
 	//		std::map<Vec2i,std::map<Vec2i, bool> >::iterator iterFind2 = iterFind1->second.find(node->pos);
@@ -238,22 +485,17 @@ private:
 
 		//bool canUnitMoveToCell = map->aproxCanMove(unit, node->pos, sucPos);
 		//bool canUnitMoveToCell = map->aproxCanMoveSoon(unit, node->pos, sucPos);
-		if(openPos(sucPos, factions[unitFactionIndex]) == false &&
+		if(openPos(sucPos, searchState) == false &&
 				canUnitMoveSoon(unit, node->pos, sucPos) == true) {
 			//if node is not open and canMove then generate another node
-			Node *sucNode= newNode(factions[unitFactionIndex],maxNodeCount);
+			Node *sucNode= newNode(searchState,maxNodeCount);
 			if(sucNode != NULL) {
 				sucNode->pos= sucPos;
 				sucNode->heuristic= heuristic(sucNode->pos, finalPos);
 				sucNode->prev= node;
 				sucNode->next= NULL;
 				sucNode->exploredCell= map->getSurfaceCell(Map::toSurfCoords(sucPos))->isExplored(unit->getTeam());
-				if(factions[unitFactionIndex].openNodesList.find(sucNode->heuristic) == factions[unitFactionIndex].openNodesList.end()) {
-					factions[unitFactionIndex].openNodesList[sucNode->heuristic].clear();
-					//factions[unitFactionIndex].openNodesList[sucNode->heuristic].reserve(PathFinder::pathFindNodesMax);
-				}
-				factions[unitFactionIndex].openNodesList[sucNode->heuristic].push_back(sucNode);
-				factions[unitFactionIndex].openPosList[sucNode->pos] = true;
+				addOpenNode(searchState,sucNode);
 
 				result = true;
 			}
@@ -267,27 +509,21 @@ private:
 	}
 
 	void processNearestFreePos(const Vec2i &finalPos, int i, int j, int size, Field field, int teamIndex,Vec2i unitPos, Vec2i &nearestPos, float &nearestDist);
-	int getPathFindExtendRefreshNodeCount(int factionIndex);
-
-
-	void astarJPS(std::map<Vec2i,Vec2i> cameFrom, Node *& node,
-			const Vec2i & finalPos, std::map<Vec2i,bool> closedNodes,
-			std::map<std::pair<Vec2i,Vec2i> ,bool> canAddNode, Unit *& unit,
-			bool & nodeLimitReached, int & maxNodeCount);
-
-	bool contained(Vec2i c);
-	direction directionOfMove(Vec2i to, Vec2i from) const;
-	direction directionWeCameFrom(Vec2i node, Vec2i nodeFrom) const;
-	bool isEnterable(Vec2i coord);
-	Vec2i adjustInDirection(Vec2i c, int dir);
-	bool directionIsDiagonal(direction dir) const;
-	directionset forcedNeighbours(Vec2i coord,direction dir);
-	bool implies(bool a, bool b) const;
-	directionset addDirectionToSet(directionset dirs, direction dir) const;
-	directionset naturalNeighbours(direction dir) const;
-	direction nextDirectionInSet(directionset *dirs) const;
-	Vec2i jump(Vec2i dest, direction dir, Vec2i start,std::vector<Vec2i> &path,int pathLength);
-	bool addToOpenSet(Unit *unit, Node *node,const Vec2i finalPos, Vec2i sucPos, bool &nodeLimitReached,int maxNodeCount,Node **newNodeAdded,bool bypassChecks);
+	int getPathFindExtendRefreshNodeCount(FactionState &faction);
+
+
+	void doJumpPointSearch(bool &nodeLimitReached, int &whileLoopCount,
+			FactionState &factionState, bool &pathFound, Node *&node, const Vec2i &finalPos,
+			Unit *unit, int maxNodeCount);
+	void addJumpPointSuccessors(FactionState &factionState, Unit *unit, Node *node, const Vec2i &finalPos, bool &nodeLimitReached, int maxNodeCount);
+	class JumpPointGrid;
+	bool findJumpPoint(FactionState &factionState, Unit *unit, const Vec2i &start, int dx, int dy, const Vec2i &finalPos, Vec2i &jumpPoint);
+	bool isJumpPointEnterable(FactionState &factionState, Unit *unit, const Vec2i &pos);
+
+	bool computeFlowFieldPath(Unit *unit, const Vec2i &targetPos, vector<Vec2i> &flowPath);
+	class FactionNodeSource;
+	void doFlowFieldSearch(bool &pathFound, Node *&node, Node *firstNode, const vector<Vec2i> &flowPath,
+			const Vec2i &finalPos, FactionState &factionState, int maxNodeCount);
 
 	//bool canUnitMoveSoon(const Unit *unit, const Vec2i &pos1, const Vec2i &pos2);
 	inline bool canUnitMoveSoon(const Unit *unit, const Vec2i &pos1, const Vec2i &pos2) {
@@ -317,19 +553,16 @@ private:
 	}
 
 	inline void doAStarPathSearch(bool & nodeLimitReached, int & whileLoopCount,
-			int & unitFactionIndex, bool & pathFound, Node *& node, const Vec2i & finalPos,
-			const bool tryJPSPathfinder, std::map<Vec2i,bool> closedNodes,
-			std::map<Vec2i,Vec2i> cameFrom, std::map<std::pair<Vec2i,Vec2i> ,
-			bool> canAddNode, Unit *& unit, int & maxNodeCount, int curFrameIndex)  {
+			FactionState & factionState, bool & pathFound, Node *& node, const Vec2i & finalPos,
+			Unit *& unit, int & maxNodeCount, int curFrameIndex)  {
 
 		//Chrono chrono;
 		//if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled) chrono.start();
 		//chrono.start();
 
-		FactionState &factionState = factions[unitFactionIndex];
 		while(nodeLimitReached == false) {
 			whileLoopCount++;
-			if(factionState.openNodesList.empty() == true) {
+			if(hasOpenNodes(factionState) == false) {
 				pathFound = false;
 				break;
 			}
@@ -356,61 +589,48 @@ private:
 //				}
 //			}
 
-			if(tryJPSPathfinder == true) {
-				closedNodes[node->pos] = true;
-			}
-			if(factionState.closedNodesList.find(node->heuristic) == factionState.closedNodesList.end()) {
-				factionState.closedNodesList[node->heuristic].clear();
-				//factionState.closedNodesList[node->heuristic].reserve(PathFinder::pathFindNodesMax);
-			}
-			factionState.closedNodesList[node->heuristic].push_back(node);
-			factionState.openPosList[node->pos] = true;
-			if(tryJPSPathfinder == true) {
-				astarJPS(cameFrom, node, finalPos, closedNodes, canAddNode, unit, nodeLimitReached, maxNodeCount);
-			}
-			else {
-				int failureCount 	= 0;
-				int cellCount 		= 0;
-				int tryDirection 	= factionState.random.randRange(0, 3);
-
-				if(tryDirection == 3) {
-					for(int i = 1;i >= -1 && nodeLimitReached == false;--i) {
-						for(int j = -1;j <= 1 && nodeLimitReached == false;++j) {
-							if(processNode(unit, node, finalPos, i, j, nodeLimitReached, maxNodeCount) == false) {
-								failureCount++;
-							}
-							cellCount++;
+			addClosedNode(factionState,node);
+			int failureCount 	= 0;
+			int cellCount 		= 0;
+			int tryDirection 	= factionState.random.randRange(0, 3);
+
+			if(tryDirection == 3) {
+				for(int i = 1;i >= -1 && nodeLimitReached == false;--i) {
+					for(int j = -1;j <= 1 && nodeLimitReached == false;++j) {
+						if(processNode(factionState, unit, node, finalPos, i, j, nodeLimitReached, maxNodeCount) == false) {
+							failureCount++;
 						}
+						cellCount++;
 					}
 				}
-				else if(tryDirection == 2) {
-					for(int i = -1;i <= 1 && nodeLimitReached == false;++i) {
-						for(int j = 1;j >= -1 && nodeLimitReached == false;--j) {
-							if(processNode(unit, node, finalPos, i, j, nodeLimitReached, maxNodeCount) == false) {
-								failureCount++;
-							}
-							cellCount++;
+			}
+			else if(tryDirection == 2) {
+				for(int i = -1;i <= 1 && nodeLimitReached == false;++i) {
+					for(int j = 1;j >= -1 && nodeLimitReached == false;--j) {
+						if(processNode(factionState, unit, node, finalPos, i, j, nodeLimitReached, maxNodeCount) == false) {
+							failureCount++;
 						}
+						cellCount++;
 					}
 				}
-				else if(tryDirection == 1) {
-					for(int i = -1;i <= 1 && nodeLimitReached == false;++i) {
-						for(int j = -1;j <= 1 && nodeLimitReached == false;++j) {
-							if(processNode(unit, node, finalPos, i, j, nodeLimitReached, maxNodeCount) == false) {
-								failureCount++;
-							}
-							cellCount++;
+			}
+			else if(tryDirection == 1) {
+				for(int i = -1;i <= 1 && nodeLimitReached == false;++i) {
+					for(int j = -1;j <= 1 && nodeLimitReached == false;++j) {
+						if(processNode(factionState, unit, node, finalPos, i, j, nodeLimitReached, maxNodeCount) == false) {
+							failureCount++;
 						}
+						cellCount++;
 					}
 				}
-				else {
-					for(int i = 1;i >= -1 && nodeLimitReached == false;--i) {
-						for(int j = 1;j >= -1 && nodeLimitReached == false;--j) {
-							if(processNode(unit, node, finalPos, i, j, nodeLimitReached, maxNodeCount) == false) {
-								failureCount++;
-							}
-							cellCount++;
+			}
+			else {
+				for(int i = 1;i >= -1 && nodeLimitReached == false;--i) {
+					for(int j = 1;j >= -1 && nodeLimitReached == false;--j) {
+						if(processNode(factionState, unit, node, finalPos, i, j, nodeLimitReached, maxNodeCount) == false) {
+							failureCount++;
 						}
+						cellCount++;
 					}
 				}
 			}
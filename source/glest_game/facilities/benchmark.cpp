@@ -0,0 +1,220 @@
+// ==============================================================
+//	This file is part of Glest (www.glest.org)
+//
+//	Copyright (C) 2001-2009 Martiño Figueroa
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#include "benchmark.h"
+
+#include <cstdio>
+#include "program.h"
+#include "game.h"
+#include "world.h"
+#include "checksum.h"
+#include "conversion.h"
+#include "util.h"
+
+#include "leak_dumper.h"
+
+using namespace Shared::Util;
+
+namespace Glest{ namespace Game{
+
+static string escapeJsonString(const string &value) {
+	string result = "";
+	for(unsigned int i = 0; i < value.size(); ++i) {
+		char c = value[i];
+		if(c == '\\' || c == '"') {
+			result += '\\';
+			result += c;
+		}
+		else if((unsigned char)c < 0x20) {
+			result += ' ';
+		}
+		else {
+			result += c;
+		}
+	}
+	return result;
+}
+
+// =====================================================
+//	class Benchmark
+// =====================================================
+
+bool Benchmark::enabled = false;
+string Benchmark::loadGameSettingsFile = "";
+int Benchmark::maxFrames = 3000;
+string Benchmark::outputFile = "benchmark.json";
+
+// ===================== PUBLIC ========================
+
+Benchmark::Benchmark() {
+	for(int i = 0; i < bpCount; ++i) {
+		currentPhaseMicros[i] = 0;
+	}
+	resultsSaved = false;
+}
+
+Benchmark & Benchmark::getInstance() {
+	static Benchmark benchmark;
+	return benchmark;
+}
+
+const char * Benchmark::getPhaseName(BenchmarkPhase phase) {
+	switch(phase) {
+		case bpWorld:
+			return "world";
+		case bpUnits:
+			return "units";
+		case bpPathfinding:
+			return "pathfinding";
+		case bpFow:
+			return "fow";
+		case bpAi:
+			return "ai";
+		case bpScript:
+			return "script";
+		case bpParticles:
+			return "particles";
+		default:
+			break;
+	}
+	return "unknown";
+}
+
+void Benchmark::addPhaseTime(BenchmarkPhase phase, int64 micros) {
+	static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
+	MutexSafeWrapper safeMutex(&mutexPhases,mutexOwnerId);
+	currentPhaseMicros[phase] += micros;
+}
+
+void Benchmark::endFrame(int frame) {
+	static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
+	MutexSafeWrapper safeMutex(&mutexPhases,mutexOwnerId);
+
+	if(frameTimings.empty() == true) {
+		chronoRun.start();
+	}
+	FrameTimings timings;
+	timings.frame = frame;
+	for(int i = 0; i < bpCount; ++i) {
+		timings.phaseMicros[i] = currentPhaseMicros[i];
+		currentPhaseMicros[i] = 0;
+	}
+	frameTimings.push_back(timings);
+}
+
+bool Benchmark::updateGame(Game *game) {
+	if(game->getWorld()->getFrameCount() < maxFrames) {
+		return false;
+	}
+
+	if(resultsSaved == false) {
+		saveResults(game->getWorld());
+	}
+
+	Program *program = game->getProgram();
+	Stats endStats = game->quitGame();
+	Game::exitGameState(program, endStats);
+	return true;
+}
+
+void Benchmark::saveResults(World *world) {
+	static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
+	MutexSafeWrapper safeMutex(&mutexPhases,mutexOwnerId);
+
+	resultsSaved = true;
+
+	int64 totalMicros[bpCount];
+	int64 maxMicros[bpCount];
+	for(int i = 0; i < bpCount; ++i) {
+		totalMicros[i] = 0;
+		maxMicros[i] = 0;
+	}
+	for(unsigned int j = 0; j < frameTimings.size(); ++j) {
+		for(int i = 0; i < bpCount; ++i) {
+			totalMicros[i] += frameTimings[j].phaseMicros[i];
+			if(frameTimings[j].phaseMicros[i] > maxMicros[i]) {
+				maxMicros[i] = frameTimings[j].phaseMicros[i];
+			}
+		}
+	}
+	uint32 checksum = computeWorldChecksum(world);
+
+#ifdef WIN32
+	FILE *fp = _wfopen(Shared::Platform::utf8_decode(outputFile).c_str(), L"w");
+#else
+	FILE *fp = fopen(outputFile.c_str(), "w");
+#endif
+	if(fp == NULL) {
+		throw megaglest_runtime_error("Can not open benchmark output file: [" + outputFile + "]");
+	}
+
+	fprintf(fp,"{\n");
+	fprintf(fp,"\t\"gameSettingsFile\": \"%s\",\n",escapeJsonString(loadGameSettingsFile).c_str());
+	fprintf(fp,"\t\"frames\": %d,\n",(int)frameTimings.size());
+	fprintf(fp,"\t\"finalFrame\": %d,\n",world->getFrameCount());
+	fprintf(fp,"\t\"checksum\": %u,\n",checksum);
+	fprintf(fp,"\t\"runMicros\": " MG_I64_SPECIFIER ",\n",chronoRun.getMicros());
+	// units, fow and particles are part of world, pathfinding and script
+	// time is also counted in the phase that called them
+	fprintf(fp,"\t\"phases\": {\n");
+	for(int i = 0; i < bpCount; ++i) {
+		fprintf(fp,"\t\t\"%s\": { \"totalMicros\": " MG_I64_SPECIFIER ", \"maxMicros\": " MG_I64_SPECIFIER " }%s\n",
+				getPhaseName(static_cast<BenchmarkPhase>(i)),totalMicros[i],maxMicros[i],(i + 1 < bpCount ? "," : ""));
+	}
+	fprintf(fp,"\t},\n");
+	fprintf(fp,"\t\"frameTimings\": [\n");
+	for(unsigned int j = 0; j < frameTimings.size(); ++j) {
+		fprintf(fp,"\t\t{ \"frame\": %d",frameTimings[j].frame);
+		for(int i = 0; i < bpCount; ++i) {
+			fprintf(fp,", \"%s\": " MG_I64_SPECIFIER,getPhaseName(static_cast<BenchmarkPhase>(i)),frameTimings[j].phaseMicros[i]);
+		}
+		fprintf(fp," }%s\n",(j + 1 < frameTimings.size() ? "," : ""));
+	}
+	fprintf(fp,"\t]\n");
+	fprintf(fp,"}\n");
+	fclose(fp);
+
+	printf("Benchmark of %d frames written to [%s], world checksum: %u\n",(int)frameTimings.size(),outputFile.c_str(),checksum);
+}
+
+// The simulation state every peer of a network game has to agree on
+uint32 Benchmark::computeWorldChecksum(World *world) {
+	Checksum checksum;
+	checksum.addInt(world->getFrameCount());
+
+	const TechTree *techTree = world->getTechTree();
+	for(int i = 0; i < world->getFactionCount(); ++i) {
+		Faction *faction = world->getFaction(i);
+		checksum.addInt(faction->getIndex());
+		checksum.addInt(faction->getTeam());
+
+		for(int j = 0; j < techTree->getResourceTypeCount(); ++j) {
+			checksum.addInt(faction->getResource(j)->getAmount());
+		}
+
+		for(int j = 0; j < faction->getUnitCount(); ++j) {
+			Unit *unit = faction->getUnit(j);
+			checksum.addInt(unit->getId());
+			checksum.addString(unit->getType()->getName());
+			checksum.addInt(unit->getPosNotThreadSafe().x);
+			checksum.addInt(unit->getPosNotThreadSafe().y);
+			checksum.addInt(unit->getHp());
+			checksum.addInt(unit->getEp());
+			checksum.addInt(unit->getLoadCount());
+			checksum.addInt(unit->getKills());
+			checksum.addInt(unit->getCurrSkill()->getClass());
+			checksum.addInt(unit->getCommandSize());
+		}
+	}
+	return checksum.getSum();
+}
+
+}}//end namespace
@@ -0,0 +1,130 @@
+// ==============================================================
+//	This file is part of Glest (www.glest.org)
+//
+//	Copyright (C) 2001-2009 Martiño Figueroa
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#ifndef _GLEST_GAME_BENCHMARK_H_
+#define _GLEST_GAME_BENCHMARK_H_
+
+#ifdef WIN32
+    #include <winsock2.h>
+    #include <winsock.h>
+#endif
+
+#include <string>
+#include <vector>
+#include "platform_common.h"
+#include "thread.h"
+#include "data_types.h"
+#include "leak_dumper.h"
+
+using namespace std;
+using Shared::Platform::Mutex;
+using Shared::Platform::int64;
+using Shared::Platform::uint32;
+using Shared::PlatformCommon::Chrono;
+
+namespace Glest{ namespace Game{
+
+class Game;
+class World;
+
+enum BenchmarkPhase {
+	bpWorld,
+	bpUnits,
+	bpPathfinding,
+	bpFow,
+	bpAi,
+	bpScript,
+	bpParticles,
+
+	bpCount
+};
+
+// =====================================================
+//	class Benchmark
+//
+///	Headless simulation run of a fixed frame count, writes
+///	the timings of each frame and the final world checksum
+// =====================================================
+
+class Benchmark {
+private:
+	class FrameTimings {
+	public:
+		int frame;
+		int64 phaseMicros[bpCount];
+	};
+
+	static bool enabled;
+	static string loadGameSettingsFile;
+	static int maxFrames;
+	static string outputFile;
+
+	Mutex mutexPhases;
+	int64 currentPhaseMicros[bpCount];
+	vector<FrameTimings> frameTimings;
+	Chrono chronoRun;
+	bool resultsSaved;
+
+public:
+	static Benchmark & getInstance();
+	Benchmark();
+
+	static bool isEnabled() { return enabled; }
+	static void setEnabled(bool value) { enabled = value; }
+	static string getLoadGameSettingsFile() { return loadGameSettingsFile; }
+	static void setLoadGameSettingsFile(string filename) { loadGameSettingsFile = filename; }
+	static int getMaxFrames() { return maxFrames; }
+	static void setMaxFrames(int value) { maxFrames = value; }
+	static string getOutputFile() { return outputFile; }
+	static void setOutputFile(string filename) { outputFile = filename; }
+
+	static const char * getPhaseName(BenchmarkPhase phase);
+
+	// safe to call from the faction worker threads
+	void addPhaseTime(BenchmarkPhase phase, int64 micros);
+	void endFrame(int frame);
+
+	bool updateGame(Game *game);
+	void saveResults(World *world);
+
+	static uint32 computeWorldChecksum(World *world);
+};
+
+// =====================================================
+//	class BenchmarkPhaseTimer
+//
+///	Adds the time spent in its scope to a phase
+// =====================================================
+
+class BenchmarkPhaseTimer {
+private:
+	BenchmarkPhase phase;
+	bool active;
+	Chrono chrono;
+
+public:
+	BenchmarkPhaseTimer(BenchmarkPhase phase) {
+		this->phase = phase;
+		this->active = Benchmark::isEnabled();
+		if(this->active == true) {
+			chrono.start();
+		}
+	}
+	~BenchmarkPhaseTimer() {
+		if(this->active == true) {
+			Benchmark::getInstance().addPhaseTime(phase, chrono.getMicros());
+		}
+	}
+};
+
+}}//end namespace
+
+#endif
@@ -0,0 +1,104 @@
+// ==============================================================
+//	This file is part of Glest (www.glest.org)
+//
+//	Copyright (C) 2001-2009 Martiño Figueroa
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#include "game_trace.h"
+
+#include "config.h"
+#include "game_constants.h"
+#include "game_util.h"
+#include "platform_common.h"
+#include "conversion.h"
+#include "util.h"
+
+#include "leak_dumper.h"
+
+using namespace Shared::Util;
+using namespace Shared::PlatformCommon;
+
+namespace Glest{ namespace Game{
+
+static const TraceEventType gameTraceEventTypes[tevCount] = {
+	{ "Game::update",				"game",		{ "frame", NULL } },
+	{ "Game::render",				"render",	{ "frame", NULL } },
+	{ "World::update",				"world",	{ "frame", NULL } },
+	{ "World::tick",				"world",	{ "frame", NULL } },
+	{ "World::updateAllFactionUnits","world",	{ "frame", "factions" } },
+	{ "Faction::preprocess",		"world",	{ "faction", "units" } },
+	{ "UnitUpdater::updateUnit",	"unit",		{ "unit", NULL } },
+	{ "UnitUpdater::updateUnitCommand","unit",	{ "unit", "frame" } },
+	{ "Unit::update",				"unit",		{ "unit", NULL } },
+	{ "World::moveUnitCells",		"unit",		{ "unit", NULL } },
+	{ "UnitUpdater::updateStop",	"unit",		{ "unit", "frame" } },
+	{ "UnitUpdater::updateMove",	"unit",		{ "unit", "frame" } },
+	{ "World::computeFow",			"world",	{ "faction", NULL } },
+	{ "PathFinder::findPath",		"path",		{ "unit", "frame" } },
+	{ "ParticleManager::update",	"render",	{ "scope", NULL } },
+	{ "ServerInterface::update",	"network",	{ NULL, NULL } },
+	{ "units",						"world",	{ NULL, NULL } },
+};
+
+// =====================================================
+//	class GameTrace
+// =====================================================
+
+int GameTrace::spikeMillis = 0;
+int GameTrace::spikeExportsLeft = 0;
+
+void GameTrace::init(const Config &config) {
+	// 0 turns the spike exports off
+	spikeMillis = config.getInt("TraceSpikeMillis","100");
+	spikeExportsLeft = config.getInt("TraceSpikeExports","5");
+
+	int eventsPerThread = config.getInt("TraceEventsPerThread",intToStr(Tracer::defaultEventsPerThread).c_str());
+	Tracer::init(gameTraceEventTypes, tevCount, eventsPerThread);
+	Tracer::setEnabled(config.getBool("EnableTracing","false"));
+	if(Tracer::isEnabled() == true) {
+		Tracer::setThreadName("main");
+	}
+}
+
+bool GameTrace::exportTrace(const string &fileSuffix) {
+	if(Tracer::isEnabled() == false) {
+		return false;
+	}
+	return Tracer::exportChromeTrace(getTraceFileName(fileSuffix));
+}
+
+void GameTrace::frameEnded(int frame, int64 frameMillis) {
+	if(spikeMillis <= 0 || frameMillis < spikeMillis || spikeExportsLeft <= 0) {
+		return;
+	}
+	spikeExportsLeft--;
+	if(SystemFlags::VERBOSE_MODE_ENABLED) printf("Frame %d took " MG_I64_SPECIFIER " msecs, exporting the trace\n",frame,frameMillis);
+	exportTrace("_spike_" + intToStr(frame));
+}
+
+string GameTrace::getTraceFileName(const string &fileSuffix) {
+	Config &config = Config::getInstance();
+	string traceFile = config.getString("TraceFile","megaglest_trace.json");
+	if(fileSuffix != "") {
+		size_t extensionPos = traceFile.rfind('.');
+		if(extensionPos == string::npos) {
+			extensionPos = traceFile.size();
+		}
+		traceFile.insert(extensionPos, fileSuffix);
+	}
+	if(getGameReadWritePath(GameConstants::path_logs_CacheLookupKey) != "") {
+		return getGameReadWritePath(GameConstants::path_logs_CacheLookupKey) + traceFile;
+	}
+	string userData = config.getString("UserData_Root","");
+	if(userData != "") {
+		endPathWithSlash(userData);
+	}
+	return userData + traceFile;
+}
+
+}}//end namespace
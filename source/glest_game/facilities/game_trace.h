@@ -0,0 +1,107 @@
+// ==============================================================
+//	This file is part of Glest (www.glest.org)
+//
+//	Copyright (C) 2001-2009 Martiño Figueroa
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#ifndef _GLEST_GAME_GAMETRACE_H_
+#define _GLEST_GAME_GAMETRACE_H_
+
+#ifdef WIN32
+    #include <winsock2.h>
+    #include <winsock.h>
+#endif
+
+#include <string>
+#include "trace.h"
+#include "platform_common.h"
+#include "leak_dumper.h"
+
+using std::string;
+
+namespace Glest{ namespace Game{
+
+class Config;
+
+// Event ids of the game, gameTraceEventTypes holds their names in the same order
+enum GameTraceEvent {
+	tevGameUpdate,
+	tevGameRender,
+	tevWorldUpdate,
+	tevWorldTick,
+	tevUpdateAllFactionUnits,
+	tevFactionPreprocess,
+	tevUnitUpdate,
+	tevUnitUpdateCommand,
+	tevUnitUpdateSkill,
+	tevUnitMoveCells,
+	tevUnitStop,
+	tevUnitMove,
+	tevComputeFow,
+	tevFindPath,
+	tevParticleUpdate,
+	tevServerUpdate,
+	tevUnitCount,
+
+	tevCount
+};
+
+// =====================================================
+//	class GameTrace
+//
+///	Tracing setup of the game from the ini settings
+// =====================================================
+
+class GameTrace {
+private:
+	static int spikeMillis;
+	static int spikeExportsLeft;
+
+public:
+	static void init(const Config &config);
+	// fileSuffix goes before the extension of the TraceFile setting
+	static bool exportTrace(const string &fileSuffix="");
+	static string getTraceFileName(const string &fileSuffix="");
+
+	// exports the rings when a frame took TraceSpikeMillis or longer, they
+	// only hold the last moments so waiting for the end of the game would
+	// lose the spike
+	static void frameEnded(int frame, int64 frameMillis);
+};
+
+// =====================================================
+//	class GameTraceFrame
+//
+///	Times a frame for GameTrace::frameEnded, declared
+///	before the frame's TRACE_SCOPE so its end is exported
+// =====================================================
+
+class GameTraceFrame {
+private:
+	int frame;
+	bool active;
+	Shared::PlatformCommon::Chrono chrono;
+
+public:
+	inline GameTraceFrame(int frame) {
+		this->frame = frame;
+		this->active = Shared::Util::Tracer::isEnabled();
+		if(this->active == true) {
+			chrono.start();
+		}
+	}
+	inline ~GameTraceFrame() {
+		if(this->active == true) {
+			GameTrace::frameEnded(frame, chrono.getMillis());
+		}
+	}
+};
+
+}}//end namespace
+
+#endif
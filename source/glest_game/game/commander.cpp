@@ -136,6 +136,7 @@ Commander::Commander() {
 	//this->networkThread->setUniqueID(__FILE__);
 	//this->networkThread->start();
 	world=NULL;
+	replayCommandListIndex=0;
 }
 
 Commander::~Commander() {
@@ -571,24 +572,22 @@ void Commander::commanderNetworkUpdateTask(int id) {
 
 bool Commander::getReplayCommandListForFrame(int worldFrameCount) {
 	bool haveReplyCommands = false;
-	if(replayCommandList.empty() == false) {
+	if(hasReplayCommandListForFrame() == true) {
 		//int worldFrameCount = world->getFrameCount();
-		if(SystemFlags::VERBOSE_MODE_ENABLED) printf("worldFrameCount = %d replayCommandList.size() = " MG_SIZE_T_SPECIFIER "\n",worldFrameCount,replayCommandList.size());
-
-		std::vector<NetworkCommand> replayList;
-		for(unsigned int i = 0; i < replayCommandList.size(); ++i) {
-			std::pair<int,NetworkCommand> &cmd = replayCommandList[i];
-			if(cmd.first <= worldFrameCount) {
-				replayList.push_back(cmd.second);
-				haveReplyCommands = true;
-			}
+		if(SystemFlags::VERBOSE_MODE_ENABLED) printf("worldFrameCount = %d replayCommandList.size() = %d\n",worldFrameCount,getReplayCommandListForFrameCount());
+
+		// The list is ordered by frame so the commands due in this frame
+		// are the ones right after the play position
+		unsigned int replayListStart = replayCommandListIndex;
+		for(; replayCommandListIndex < replayCommandList.size() &&
+			  replayCommandList[replayCommandListIndex].first <= worldFrameCount;
+			  ++replayCommandListIndex) {
+			haveReplyCommands = true;
 		}
 		if(haveReplyCommands == true) {
-			replayCommandList.erase(replayCommandList.begin(),replayCommandList.begin() + replayList.size());
-
-			if(SystemFlags::VERBOSE_MODE_ENABLED) printf("worldFrameCount = %d GIVING COMMANDS replayList.size() = " MG_SIZE_T_SPECIFIER "\n",worldFrameCount,replayList.size());
-			for(int i= 0; i < replayList.size(); ++i){
-				giveNetworkCommand(&replayList[i]);
+			if(SystemFlags::VERBOSE_MODE_ENABLED) printf("worldFrameCount = %d GIVING COMMANDS replayList.size() = %u\n",worldFrameCount,replayCommandListIndex - replayListStart);
+			for(unsigned int i = replayListStart; i < replayCommandListIndex; ++i) {
+				giveNetworkCommand(&replayCommandList[i].second);
 				//pushNetworkCommand(&replayList[i]);
 			}
 			GameNetworkInterface *gameNetworkInterface= NetworkManager::getInstance().getGameNetworkInterface();
@@ -599,11 +598,11 @@ bool Commander::getReplayCommandListForFrame(int worldFrameCount) {
 }
 
 bool Commander::hasReplayCommandListForFrame() const {
-	return (replayCommandList.empty() == false);
+	return (replayCommandListIndex < replayCommandList.size());
 }
 
 int Commander::getReplayCommandListForFrameCount() const {
-	return replayCommandList.size();
+	return (int)(replayCommandList.size() - replayCommandListIndex);
 }
 
 void Commander::updateNetwork(Game *game) {
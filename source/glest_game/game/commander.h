@@ -87,6 +87,7 @@ private:
 	//CommanderNetworkThread *networkThread;
 	//Game *game;
 	std::vector<std::pair<int,NetworkCommand> > replayCommandList;
+	unsigned int replayCommandListIndex;
 
 public:
     Commander();
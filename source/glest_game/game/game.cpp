@@ -23,9 +23,16 @@
 #include "network_manager.h"
 #include "checksum.h"
 #include "auto_test.h"
+#include "benchmark.h"
+#include "game_trace.h"
 #include "menu_state_keysetup.h"
 #include "video_player.h"
 #include "compression_utils.h"
+#ifdef WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
 
 #include "leak_dumper.h"
 
@@ -161,6 +168,9 @@ Game::Game() : ProgramState(NULL) {
 
 	loadGameNode = NULL;
 	lastworldFrameCountForReplay = -1;
+	saveCommandsForReplay = false;
+	replayKeyframeFrames = 0;
+	replayKeyframeIndex = 0;
 	lastNetworkPlayerConnectionCheck = time(NULL);
 	inJoinGameLoading = false;
 
@@ -171,6 +181,8 @@ Game::Game() : ProgramState(NULL) {
 
 	fadeMusicMilliseconds = Config::getInstance().getInt("GameStartStopFadeSoundMilliseconds",intToStr(fadeMusicMilliseconds).c_str());
 	GAME_STATS_DUMP_INTERVAL = Config::getInstance().getInt("GameStatsDumpIntervalSeconds",intToStr(GAME_STATS_DUMP_INTERVAL).c_str());
+	saveCommandsForReplay = Config::getInstance().getBool("SaveCommandsForReplay","false");
+	replayKeyframeFrames = Config::getInstance().getInt("ReplayKeyframeFrames","400");
 }
 
 void Game::resetMembers() {
@@ -269,6 +281,9 @@ void Game::resetMembers() {
 
 	loadGameNode = NULL;
 	lastworldFrameCountForReplay = -1;
+	saveCommandsForReplay = false;
+	replayKeyframeFrames = 0;
+	replayKeyframeIndex = 0;
 
 	lastNetworkPlayerConnectionCheck = time(NULL);
 
@@ -282,6 +297,8 @@ void Game::resetMembers() {
 
 	fadeMusicMilliseconds = Config::getInstance().getInt("GameStartStopFadeSoundMilliseconds",intToStr(fadeMusicMilliseconds).c_str());
 	GAME_STATS_DUMP_INTERVAL = Config::getInstance().getInt("GameStatsDumpIntervalSeconds",intToStr(GAME_STATS_DUMP_INTERVAL).c_str());
+	saveCommandsForReplay = Config::getInstance().getBool("SaveCommandsForReplay","false");
+	replayKeyframeFrames = Config::getInstance().getInt("ReplayKeyframeFrames","400");
 
     Logger &logger= Logger::getInstance();
 	logger.showProgress();
@@ -1658,12 +1675,14 @@ void Game::setupPopupMenus(bool checkClientAdminOverrideOnly) {
 
 //update
 void Game::update() {
+	GameTraceFrame traceFrame(world.getFrameCount());
+	TRACE_SCOPE_ARG(tevGameUpdate,world.getFrameCount());
 	try {
 		if(currentUIState != NULL) {
 			currentUIState->update();
 		}
 
-		bool showPerfStats = Config::getInstance().getBool("ShowPerfStats","false");
+		bool showPerfStats = Config::getCachedValues().showPerfStats;
 		Chrono chronoPerf;
 		char perfBuf[8096]="";
 		std::vector<string> perfList;
@@ -1915,6 +1934,8 @@ void Game::update() {
 					}
 
 					//AiInterface
+					Chrono chronoBenchmark;
+					if(Benchmark::isEnabled() == true) chronoBenchmark.start();
 					if(commander.hasReplayCommandListForFrame() == false) {
 
 
@@ -1937,7 +1958,7 @@ void Game::update() {
 						}
 						*/
 
-						const bool newThreadManager = Config::getInstance().getBool("EnableNewThreadManager","false");
+						const bool newThreadManager = Config::getCachedValues().enableNewThreadManager;
 						if(newThreadManager == true) {
 							int currentFrameCount = world.getFrameCount();
 							masterController.signalSlaves(&currentFrameCount);
@@ -2054,9 +2075,15 @@ void Game::update() {
 
 					if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s] Line: %d took msecs: %lld [AI updates]\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,chrono.getMillis());
 					if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) chrono.start();
+					if(Benchmark::isEnabled() == true) {
+						Benchmark::getInstance().addPhaseTime(bpAi,chronoBenchmark.getMicros());
+						chronoBenchmark.start();
+					}
 
 					//World
 					if(pendingQuitError == false) world.update();
+					if(pendingQuitError == false) updateReplayKeyframe();
+					if(Benchmark::isEnabled() == true) Benchmark::getInstance().addPhaseTime(bpWorld,chronoBenchmark.getMicros());
 					if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s] Line: %d took msecs: %lld [world update i = %d]\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,chrono.getMillis(),i);
 					if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) chrono.start();
 
@@ -2132,7 +2159,12 @@ void Game::update() {
 					}
 
 					Renderer &renderer= Renderer::getInstance();
+					if(Benchmark::isEnabled() == true) chronoBenchmark.start();
 					renderer.updateParticleManager(rsGame,avgRenderFps);
+					if(Benchmark::isEnabled() == true) {
+						Benchmark::getInstance().addPhaseTime(bpParticles,chronoBenchmark.getMicros());
+						Benchmark::getInstance().endFrame(world.getFrameCount());
+					}
 					if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s] Line: %d took msecs: %lld [particle manager updating i = %d]\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,chrono.getMillis(),i);
 					if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) chrono.start();
 
@@ -2426,10 +2458,13 @@ void Game::update() {
 		// END - Handle joining in progress games
 
 		//update auto test
-		if(Config::getInstance().getBool("AutoTest")){
+		if(Config::getCachedValues().autoTest){
 			AutoTest::getInstance().updateGame(this);
 			return;
 		}
+		if(Benchmark::isEnabled() == true && Benchmark::getInstance().updateGame(this) == true) {
+			return;
+		}
 
 		if(showPerfStats) {
 			sprintf(perfBuf,"In [%s::%s] Line: %d took msecs: " MG_I64_SPECIFIER "\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,chronoPerf.getMillis());
@@ -2965,6 +3000,7 @@ void Game::updateCamera(){
 
 //render
 void Game::render() {
+	TRACE_SCOPE_ARG(tevGameRender,world.getFrameCount());
 	// Ensure the camera starts in the right position
 	if(isFirstRender == true) {
 		isFirstRender = false;
@@ -4197,7 +4233,7 @@ void Game::mouseMove(int x, int y, const MouseState *ms) {
 					}
 				}
 				else {
-					bool mouseMoveScrollsWorld = Config::getInstance().getBool("MouseMoveScrollsWorld","true");
+					bool mouseMoveScrollsWorld = Config::getCachedValues().mouseMoveScrollsWorld;
 					if(mouseMoveScrollsWorld == true) {
 						if (y < 10) {
 							gameCamera.setMoveZ(-scrollSpeed);
@@ -4771,6 +4807,8 @@ Stats Game::quitGame() {
     if(Config::getInstance().getBool("AutoTest")){
     	this->saveGame(GameConstants::saveGameFileAutoTestDefault);
     }
+    // the rings still hold the last frames of the game
+    GameTrace::exportTrace("_game_end");
 
 	//Stats stats = *(world.getStats());
 	Stats endStats;
@@ -4990,8 +5028,9 @@ string Game::getDebugStats(std::map<int,string> &factionDebugInfo) {
 		str+= "Log buffer count: " + intToStr(SystemFlags::getLogEntryBufferCount())+"\n";
 	}
 
-	str+= "UnitRangeCellsLookupItemCache: " + world.getUnitUpdater()->getUnitRangeCellsLookupItemCacheStats()+"\n";
-	str+= "ExploredCellsLookupItemCache: " 	+ world.getExploredCellsLookupItemCacheStats()+"\n";
+	str+= "UnitSpatialIndex: " + world.getMap()->getUnitSpatialIndex()->getStats()+"\n";
+	str+= "ResourceSpatialIndex: " + world.getMap()->getResourceSpatialIndex()->getStats()+"\n";
+	str+= "FogOfWarMap: " 	+ world.getFogOfWarMapStats()+"\n";
 	str+= "FowAlphaCellsLookupItemCache: "  + world.getFowAlphaCellsLookupItemCacheStats()+"\n";
 
 	str += "Selection type: "+toLower(Config::getInstance().getString("SelectionType",Config::selectBufPicking))+"\n";
@@ -5695,6 +5734,10 @@ int Game::getUpdateLoops() {
 	if(commander.hasReplayCommandListForFrame() == true) {
 		return 1;
 	}
+	// the benchmark always runs at normal game speed, only unthrottled
+	if(Benchmark::isEnabled() == true) {
+		return 1;
+	}
 
 	if(getPaused()) {
 		return 0;
@@ -5782,10 +5825,70 @@ void Game::toggleTeamColorMarker() {
 	renderExtraTeamColor=renderExtraTeamColor%4;
 }
 
+// Named after the process so several instances on one machine, like a
+// headless server next to a client, each stream to their own file
+string Game::getReplayStreamFileName() const {
+#ifdef WIN32
+	int processId = _getpid();
+#else
+	int processId = getpid();
+#endif
+	char szBuf[8096]="";
+	snprintf(szBuf,8096,GameConstants::replayStreamFilePattern,processId);
+	string replayFile = szBuf;
+	if(getGameReadWritePath(GameConstants::path_logs_CacheLookupKey) != "") {
+		replayFile = getGameReadWritePath(GameConstants::path_logs_CacheLookupKey) + replayFile;
+	}
+	else {
+		string userData = Config::getInstance().getString("UserData_Root","");
+		if(userData != "") {
+			endPathWithSlash(userData);
+		}
+		replayFile = userData + replayFile;
+	}
+	return replayFile;
+}
+
 void Game::addNetworkCommandToReplayList(NetworkCommand* networkCommand, int worldFrameCount) {
-	Config &config= Config::getInstance();
-	if(config.getBool("SaveCommandsForReplay","false") == true) {
-		replayCommandList.push_back(make_pair(worldFrameCount,*networkCommand));
+	if(saveCommandsForReplay == true) {
+		if(replayWriter.isOpen() == false) {
+			replayWriter.open(getReplayStreamFileName());
+		}
+		replayWriter.addCommand(worldFrameCount,*networkCommand);
+	}
+}
+
+void Game::updateReplayKeyframe() {
+	int frame = world.getFrameCount();
+	// keyframes are only loaded for a replay, every one of them is checked
+	// including those after the last replayed command
+	for(; replayKeyframeIndex < replayKeyframeList.size() &&
+		  replayKeyframeList[replayKeyframeIndex].frame < frame; ++replayKeyframeIndex) {
+	}
+	bool verifyKeyframe = (replayKeyframeIndex < replayKeyframeList.size() &&
+						   replayKeyframeList[replayKeyframeIndex].frame == frame);
+	bool recordKeyframe = (saveCommandsForReplay == true && replayKeyframeFrames > 0 &&
+						   frame % replayKeyframeFrames == 0);
+	if(verifyKeyframe == false && recordKeyframe == false) {
+		return;
+	}
+
+	uint32 checksum = Benchmark::computeWorldChecksum(&world);
+	if(verifyKeyframe == true) {
+		const ReplayKeyframe &keyframe = replayKeyframeList[replayKeyframeIndex];
+		if(keyframe.checksum != checksum) {
+			char szBuf[8096]="";
+			snprintf(szBuf,8096,"Replay out of synch at frame %d, checksum %u expected %u",frame,checksum,keyframe.checksum);
+			SystemFlags::OutputDebug(SystemFlags::debugError,"In [%s::%s Line: %d] %s\n",__FILE__,__FUNCTION__,__LINE__,szBuf);
+			console.addLine(szBuf);
+		}
+		replayKeyframeIndex++;
+	}
+	if(recordKeyframe == true) {
+		if(replayWriter.isOpen() == false) {
+			replayWriter.open(getReplayStreamFileName());
+		}
+		replayWriter.addKeyframe(frame,checksum);
 	}
 }
 
@@ -5972,19 +6075,18 @@ string Game::saveGame(string name, string path) {
 
 		gameNodeReplay->addAttribute("LastWorldFrameCount",intToStr(world.getFrameCount()), mapTagReplacements);
 
-		for(unsigned int i = 0; i < replayCommandList.size(); ++i) {
-			std::pair<int,NetworkCommand> &cmd = replayCommandList[i];
-			XmlNode *networkCommandNode = cmd.second.saveGame(gameNodeReplay);
-			networkCommandNode->addAttribute("worldFrameCount",intToStr(cmd.first), mapTagReplacements);
-		}
-
+		// The commands themselves are in the binary replay streamed
+		// while playing, the xml only holds the game settings
 		string replayFile = saveGameFile + ".replay";
 		if(SystemFlags::VERBOSE_MODE_ENABLED) printf("Saving game replay commands to [%s]\n",replayFile.c_str());
 		xmlTreeSaveGame.save(replayFile);
+		replayWriter.save(replayFile + ".bin");
 	}
 
 	//XmlTree xmlTree(XML_XERCES_ENGINE);
-	XmlTree xmlTree;
+	// set SaveGameBinaryFormat=false for a readable xml save when debugging
+	XmlTree xmlTree(config.getBool("SaveGameBinaryFormat","true") == true ? XML_BINARY_ENGINE : DEFAULT_XML_ENGINE);
+	xmlTree.setBinaryCompressionLevel(config.getInt("SaveGameCompressionLevel","0"));
 	xmlTree.init("megaglest-saved-game");
 	XmlNode *rootNode = xmlTree.getRootNode();
 
@@ -6204,21 +6306,36 @@ void Game::loadGame(string name,Program *programPtr,bool isMasterserverMode,cons
 		Game *newGame = new Game(programPtr, &newGameSettingsReplay, isMasterserverMode);
 		newGame->lastworldFrameCountForReplay = gameNode->getAttribute("LastWorldFrameCount")->getIntValue();
 
-		vector<XmlNode *> networkCommandNodeList = gameNode->getChildList("NetworkCommand");
-		if(SystemFlags::VERBOSE_MODE_ENABLED) printf("networkCommandNodeList.size() = " MG_SIZE_T_SPECIFIER "\n",networkCommandNodeList.size());
-		for(unsigned int i = 0; i < networkCommandNodeList.size(); ++i) {
-			XmlNode *node = networkCommandNodeList[i];
-			int worldFrameCount = node->getAttribute("worldFrameCount")->getIntValue();
-			NetworkCommand command;
-			command.loadGame(node);
-			newGame->commander.addToReplayCommandList(command,worldFrameCount);
+		string replayBinaryFile = name + ".replay.bin";
+		if(fileExists(replayBinaryFile) == true) {
+			ReplayReader replayReader;
+			replayReader.load(replayBinaryFile);
+
+			const std::vector<std::pair<int,NetworkCommand> > &commandList = replayReader.getCommandList();
+			for(unsigned int i = 0; i < commandList.size(); ++i) {
+				NetworkCommand command = commandList[i].second;
+				newGame->commander.addToReplayCommandList(command,commandList[i].first);
+			}
+			newGame->replayKeyframeList = replayReader.getKeyframeList();
+		}
+		else {
+			// replays saved before the binary format keep their commands in the xml
+			vector<XmlNode *> networkCommandNodeList = gameNode->getChildList("NetworkCommand");
+			if(SystemFlags::VERBOSE_MODE_ENABLED) printf("networkCommandNodeList.size() = " MG_SIZE_T_SPECIFIER "\n",networkCommandNodeList.size());
+			for(unsigned int i = 0; i < networkCommandNodeList.size(); ++i) {
+				XmlNode *node = networkCommandNodeList[i];
+				int worldFrameCount = node->getAttribute("worldFrameCount")->getIntValue();
+				NetworkCommand command;
+				command.loadGame(node);
+				newGame->commander.addToReplayCommandList(command,worldFrameCount);
+			}
 		}
 
 		programPtr->setState(newGame);
 		return;
 	}
 
-	XmlTree	xmlTree(XML_RAPIDXML_ENGINE);
+	XmlTree	xmlTree(XmlIoBinary::isBinaryFile(name) == true ? XML_BINARY_ENGINE : XML_RAPIDXML_ENGINE);
 
 	if(SystemFlags::VERBOSE_MODE_ENABLED) printf("Before load of XML\n");
 	std::map<string,string> mapExtraTagReplacementValues;
@@ -29,6 +29,7 @@
 #include "network_interface.h"
 #include "data_types.h"
 #include "selection.h"
+#include "replay_file.h"
 #include "leak_dumper.h"
 
 using std::vector;
@@ -191,7 +192,11 @@ private:
 
 	XmlNode *loadGameNode;
 	int lastworldFrameCountForReplay;
-	std::vector<std::pair<int,NetworkCommand> > replayCommandList;
+	bool saveCommandsForReplay;
+	int replayKeyframeFrames;
+	ReplayWriter replayWriter;
+	std::vector<ReplayKeyframe> replayKeyframeList;
+	unsigned int replayKeyframeIndex;
 
 	std::vector<string> streamingVideos;
 	Shared::Graphics::VideoPlayer *videoPlayer;
@@ -362,6 +367,9 @@ private:
 
 	void renderVideoPlayer();
 
+	string getReplayStreamFileName() const;
+	void updateReplayKeyframe();
+
 	void updateNetworkMarkedCells();
 	void updateNetworkUnMarkedCells();
 	void updateNetworkHighligtedCells();
@@ -171,6 +171,7 @@ public:
 	static const char *saveGameFileDefault;
 	static const char *saveGameFileAutoTestDefault;
 	static const char *saveGameFilePattern;
+	static const char *replayStreamFilePattern;
 
 	// VC++ Chokes on init of non integral static types
 	static const float normalMultiplier;
@@ -64,11 +64,23 @@ enum FlagTypes1 {
     ft1_none                = 0x00,
     ft1_show_map_resources  = 0x01,
     ft1_allow_team_switching  = 0x02,
-    ft1_allow_in_game_joining = 0x04
-    //ft1_xx                  = 0x08,
-    //ft1_xx                  = 0x10,
+    ft1_allow_in_game_joining = 0x04,
+    ft1_pathfinder_hierarchy  = 0x08,
+    ft1_pathfinder_jump_point = 0x10,
+    ft1_pathfinder_connectivity = 0x20,
+    ft1_pathfinder_flow_field = 0x40
+    //ft1_xx                  = 0x80,
 };
 
+// Bits 24 to 30 of the flags hold the pathfinder cluster size so it is sent
+// to every client with the other launch settings, 0 means the default size
+const int ft1_pathfinder_cluster_size_shift	= 24;
+const uint32 ft1_pathfinder_cluster_size_mask	= 0x7F000000;
+// Sizes outside this range are clamped when set or received, smaller
+// clusters would blow up the graph and larger ones do not fit the bits
+const int pathFinderClusterSizeMin	= 4;
+const int pathFinderClusterSizeMax	= (int)(ft1_pathfinder_cluster_size_mask >> ft1_pathfinder_cluster_size_shift);
+
 enum NetworkPlayerStatusType {
 	npst_None					= 0,
 	npst_PickSettings			= 1,
@@ -334,6 +346,7 @@ public:
 	bool getNetworkPauseGameForLaggedClients()	  const {return networkPauseGameForLaggedClients; }
 	PathFinderType getPathFinderType() const { return pathFinderType; }
 	uint32 getFlagTypes1() const             { return flagTypes1;}
+	int getPathFinderClusterSize() const     { return (int)((flagTypes1 & ft1_pathfinder_cluster_size_mask) >> ft1_pathfinder_cluster_size_shift); }
 
 	uint32 getMapCRC() const { return mapCRC; }
 	uint32 getTilesetCRC() const { return tilesetCRC; }
@@ -450,7 +463,24 @@ public:
 	void setNetworkPauseGameForLaggedClients(bool value)			{this->networkPauseGameForLaggedClients = value; }
 	void setPathFinderType(PathFinderType value)					{this->pathFinderType = value; }
 
-	void setFlagTypes1(uint32 value)                                {this->flagTypes1 = value; }
+	void setFlagTypes1(uint32 value) {
+		this->flagTypes1 = value;
+		// the flags may come from a peer, keep the packed cluster size valid
+		setPathFinderClusterSize(getPathFinderClusterSize());
+	}
+	void setPathFinderClusterSize(int value) {
+		if(value < 0) {
+			value = 0;
+		}
+		else if(value > 0 && value < pathFinderClusterSizeMin) {
+			value = pathFinderClusterSizeMin;
+		}
+		else if(value > pathFinderClusterSizeMax) {
+			value = pathFinderClusterSizeMax;
+		}
+		this->flagTypes1 = (this->flagTypes1 & ~ft1_pathfinder_cluster_size_mask) |
+				(((uint32)value << ft1_pathfinder_cluster_size_shift) & ft1_pathfinder_cluster_size_mask);
+	}
 
 	void setMapCRC(uint32 value)     { mapCRC = value; }
 	void setTilesetCRC(uint32 value) { tilesetCRC = value; }
@@ -749,7 +779,7 @@ public:
 //		PathFinderType pathFinderType;
 		pathFinderType = static_cast<PathFinderType>(gameSettingsNode->getAttribute("pathFinderType")->getIntValue());
 //		uint32 flagTypes1;
-		flagTypes1 = gameSettingsNode->getAttribute("flagTypes1")->getIntValue();
+		setFlagTypes1(gameSettingsNode->getAttribute("flagTypes1")->getIntValue());
 //	    int32 mapCRC;
 		mapCRC = gameSettingsNode->getAttribute("mapCRC")->getUIntValue();
 //	    int32 tilesetCRC;
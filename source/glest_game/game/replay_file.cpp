@@ -0,0 +1,250 @@
+// ==============================================================
+//	This file is part of Glest (www.glest.org)
+//
+//	Copyright (C) 2001-2008 Martiño Figueroa
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#include "replay_file.h"
+
+#include <cstring>
+#include "platform_util.h"
+#include "conversion.h"
+#include "util.h"
+
+#include "leak_dumper.h"
+
+using namespace Shared::Platform;
+using namespace Shared::Util;
+
+namespace Glest{ namespace Game{
+
+// The file is a header followed by records, each starting with its type.
+// Values are little endian so replays move between platforms.
+static const char replayFileMagic[4] = { 'M', 'G', 'R', 'P' };
+static const uint32 replayFileVersion = 1;
+
+enum ReplayRecordType {
+	rrtCommand = 1,
+	rrtKeyframe = 2
+};
+
+static const int replayCommandRecordSize	= 4 + 2 + 4 + 2 + 2 + 2 + 2 + 4 + 1 + 1 + 2 + 1 + 1 + 4 + 4;
+static const int replayKeyframeRecordSize	= 4 + 4 + 4;
+
+static FILE * openReplayFile(const string &fileName, bool forWrite) {
+#ifdef WIN32
+	return _wfopen(utf8_decode(fileName).c_str(), (forWrite == true ? L"wb" : L"rb"));
+#else
+	return fopen(fileName.c_str(), (forWrite == true ? "wb" : "rb"));
+#endif
+}
+
+static void writeValue(unsigned char *&buf, uint32 value, int size) {
+	for(int i = 0; i < size; ++i) {
+		*buf++ = (unsigned char)((value >> (i * 8)) & 0xFF);
+	}
+}
+
+static uint32 readValue(const unsigned char *&buf, int size) {
+	uint32 value = 0;
+	for(int i = 0; i < size; ++i) {
+		value |= ((uint32)*buf++) << (i * 8);
+	}
+	return value;
+}
+
+static void writeHeader(FILE *fp) {
+	unsigned char header[8];
+	unsigned char *buf = header;
+	memcpy(buf, replayFileMagic, sizeof(replayFileMagic));
+	buf += sizeof(replayFileMagic);
+	writeValue(buf, replayFileVersion, 4);
+	fwrite(header, sizeof(header), 1, fp);
+}
+
+// =====================================================
+//	class ReplayWriter
+// =====================================================
+
+ReplayWriter::ReplayWriter() {
+	file = NULL;
+	fileName = "";
+	commandCount = 0;
+}
+
+// the stream only lives as long as its game, saves copy it out
+ReplayWriter::~ReplayWriter() {
+	close();
+	if(fileName != "") {
+		removeFile(fileName);
+	}
+}
+
+void ReplayWriter::open(const string &fileName) {
+	close();
+
+	this->file = openReplayFile(fileName, true);
+	if(this->file == NULL) {
+		throw megaglest_runtime_error("Can not open replay file for writing: [" + fileName + "]");
+	}
+	this->fileName = fileName;
+	this->commandCount = 0;
+	writeHeader(this->file);
+}
+
+void ReplayWriter::close() {
+	if(file != NULL) {
+		fclose(file);
+		file = NULL;
+	}
+}
+
+void ReplayWriter::addCommand(int frame, const NetworkCommand &command) {
+	if(file == NULL) {
+		return;
+	}
+	unsigned char record[1 + replayCommandRecordSize];
+	unsigned char *buf = record;
+	writeValue(buf, rrtCommand, 1);
+	writeValue(buf, frame, 4);
+	writeValue(buf, (uint16)command.networkCommandType, 2);
+	writeValue(buf, command.unitId, 4);
+	writeValue(buf, (uint16)command.unitTypeId, 2);
+	writeValue(buf, (uint16)command.commandTypeId, 2);
+	writeValue(buf, (uint16)command.positionX, 2);
+	writeValue(buf, (uint16)command.positionY, 2);
+	writeValue(buf, command.targetId, 4);
+	writeValue(buf, (uint8)command.wantQueue, 1);
+	writeValue(buf, (uint8)command.fromFactionIndex, 1);
+	writeValue(buf, command.unitFactionUnitCount, 2);
+	writeValue(buf, (uint8)command.unitFactionIndex, 1);
+	writeValue(buf, (uint8)command.commandStateType, 1);
+	writeValue(buf, command.commandStateValue, 4);
+	writeValue(buf, command.unitCommandGroupId, 4);
+	fwrite(record, sizeof(record), 1, file);
+
+	commandCount++;
+}
+
+void ReplayWriter::addKeyframe(int frame, uint32 checksum) {
+	if(file == NULL) {
+		return;
+	}
+	unsigned char record[1 + replayKeyframeRecordSize];
+	unsigned char *buf = record;
+	writeValue(buf, rrtKeyframe, 1);
+	writeValue(buf, frame, 4);
+	writeValue(buf, checksum, 4);
+	writeValue(buf, commandCount, 4);
+	fwrite(record, sizeof(record), 1, file);
+
+	// keep what was recorded so far if the game goes down
+	fflush(file);
+}
+
+void ReplayWriter::save(const string &destFileName) {
+	FILE *fpOut = openReplayFile(destFileName, true);
+	if(fpOut == NULL) {
+		throw megaglest_runtime_error("Can not open replay file for writing: [" + destFileName + "]");
+	}
+	if(file == NULL) {
+		writeHeader(fpOut);
+		fclose(fpOut);
+		return;
+	}
+
+	fflush(file);
+	FILE *fpIn = openReplayFile(fileName, false);
+	if(fpIn == NULL) {
+		fclose(fpOut);
+		throw megaglest_runtime_error("Can not open replay file for reading: [" + fileName + "]");
+	}
+	char buf[8192];
+	for(size_t readBytes = fread(buf, 1, sizeof(buf), fpIn); readBytes > 0;
+		readBytes = fread(buf, 1, sizeof(buf), fpIn)) {
+		fwrite(buf, 1, readBytes, fpOut);
+	}
+	fclose(fpIn);
+	fclose(fpOut);
+}
+
+// =====================================================
+//	class ReplayReader
+// =====================================================
+
+void ReplayReader::load(const string &fileName) {
+	commandList.clear();
+	keyframeList.clear();
+
+	FILE *fp = openReplayFile(fileName, false);
+	if(fp == NULL) {
+		throw megaglest_runtime_error("Can not open replay file for reading: [" + fileName + "]");
+	}
+	std::vector<unsigned char> data;
+	unsigned char readBuf[8192];
+	for(size_t readBytes = fread(readBuf, 1, sizeof(readBuf), fp); readBytes > 0;
+		readBytes = fread(readBuf, 1, sizeof(readBuf), fp)) {
+		data.insert(data.end(), readBuf, readBuf + readBytes);
+	}
+	fclose(fp);
+
+	if(data.size() < 8 || memcmp(&data[0], replayFileMagic, sizeof(replayFileMagic)) != 0) {
+		throw megaglest_runtime_error("Invalid replay file: [" + fileName + "]");
+	}
+	const unsigned char *buf = &data[0] + sizeof(replayFileMagic);
+	const unsigned char *bufEnd = &data[0] + data.size();
+	uint32 version = readValue(buf, 4);
+	if(version != replayFileVersion) {
+		throw megaglest_runtime_error("Unsupported replay file version " + uIntToStr(version) + ": [" + fileName + "]");
+	}
+
+	// A replay streamed by a game that did not end cleanly may stop in the
+	// middle of a record, everything before it is still usable
+	while(buf < bufEnd) {
+		int recordType = readValue(buf, 1);
+		if(recordType == rrtCommand) {
+			if(bufEnd - buf < replayCommandRecordSize) {
+				break;
+			}
+			int frame = (int32)readValue(buf, 4);
+			NetworkCommand command;
+			command.networkCommandType		= (int16)readValue(buf, 2);
+			command.unitId					= (int32)readValue(buf, 4);
+			command.unitTypeId				= (int16)readValue(buf, 2);
+			command.commandTypeId			= (int16)readValue(buf, 2);
+			command.positionX				= (int16)readValue(buf, 2);
+			command.positionY				= (int16)readValue(buf, 2);
+			command.targetId				= (int32)readValue(buf, 4);
+			command.wantQueue				= (int8)readValue(buf, 1);
+			command.fromFactionIndex		= (int8)readValue(buf, 1);
+			command.unitFactionUnitCount	= (uint16)readValue(buf, 2);
+			command.unitFactionIndex		= (int8)readValue(buf, 1);
+			command.commandStateType		= (int8)readValue(buf, 1);
+			command.commandStateValue		= (int32)readValue(buf, 4);
+			command.unitCommandGroupId		= (int32)readValue(buf, 4);
+			commandList.push_back(make_pair(frame, command));
+		}
+		else if(recordType == rrtKeyframe) {
+			if(bufEnd - buf < replayKeyframeRecordSize) {
+				break;
+			}
+			ReplayKeyframe keyframe;
+			keyframe.frame			= (int32)readValue(buf, 4);
+			keyframe.checksum		= readValue(buf, 4);
+			keyframe.commandIndex	= readValue(buf, 4);
+			keyframeList.push_back(keyframe);
+		}
+		else {
+			throw megaglest_runtime_error("Invalid record type " + intToStr(recordType) + " in replay file: [" + fileName + "]");
+		}
+	}
+
+	if(SystemFlags::VERBOSE_MODE_ENABLED) printf("Loaded replay [%s] commands: %d keyframes: %d\n",fileName.c_str(),(int)commandList.size(),(int)keyframeList.size());
+}
+
+}}//end namespace
@@ -0,0 +1,94 @@
+// ==============================================================
+//	This file is part of Glest (www.glest.org)
+//
+//	Copyright (C) 2001-2008 Martiño Figueroa
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#ifndef _GLEST_GAME_REPLAYFILE_H_
+#define _GLEST_GAME_REPLAYFILE_H_
+
+#ifdef WIN32
+    #include <winsock2.h>
+    #include <winsock.h>
+#endif
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "network_types.h"
+#include "data_types.h"
+#include "leak_dumper.h"
+
+using namespace std;
+using Shared::Platform::uint32;
+
+namespace Glest{ namespace Game{
+
+// =====================================================
+//	class ReplayKeyframe
+//
+///	World checksum recorded every few frames, commandIndex is
+///	the number of commands given before the keyframe
+// =====================================================
+
+class ReplayKeyframe {
+public:
+	int frame;
+	uint32 checksum;
+	uint32 commandIndex;
+};
+
+// =====================================================
+//	class ReplayWriter
+//
+///	Streams the commands of a running game to a binary
+///	replay file as they are given
+// =====================================================
+
+class ReplayWriter {
+private:
+	FILE *file;
+	string fileName;
+	uint32 commandCount;
+
+public:
+	ReplayWriter();
+	~ReplayWriter();
+
+	void open(const string &fileName);
+	void close();
+	bool isOpen() const				{return file != NULL;}
+	const string & getFileName() const	{return fileName;}
+
+	void addCommand(int frame, const NetworkCommand &command);
+	void addKeyframe(int frame, uint32 checksum);
+	void save(const string &destFileName);
+};
+
+// =====================================================
+//	class ReplayReader
+//
+///	Loads a binary replay file into a frame ordered command
+///	table and its keyframes
+// =====================================================
+
+class ReplayReader {
+private:
+	std::vector<std::pair<int,NetworkCommand> > commandList;
+	std::vector<ReplayKeyframe> keyframeList;
+
+public:
+	void load(const string &fileName);
+
+	const std::vector<std::pair<int,NetworkCommand> > & getCommandList() const	{return commandList;}
+	const std::vector<ReplayKeyframe> & getKeyframeList() const					{return keyframeList;}
+};
+
+}}//end namespace
+
+#endif
@@ -78,6 +78,7 @@ const char *GameConstants::saveNetworkGameFileClientCompressed 	= "megaglest-sav
 const char *GameConstants::saveGameFileDefault 			= "megaglest-saved.xml";
 const char *GameConstants::saveGameFileAutoTestDefault 	= "megaglest-auto-saved_%s.xml";
 const char *GameConstants::saveGameFilePattern 			= "megaglest-saved_%s.xml";
+const char *GameConstants::replayStreamFilePattern 	= "megaglest-replay_%d.mgrp";
 
 const char *Config::glest_ini_filename                  = "glest.ini";
 const char *Config::glestuser_ini_filename              = "glestuser.ini";
@@ -93,6 +94,45 @@ const char *Config::ACTIVE_MOD_PROPERTY_NAME			= "current_mod_name";
 
 map<string,string> Config::customRuntimeProperties;
 
+// =====================================================
+// 	class CachedConfigValues
+// =====================================================
+
+// the defaults are the ones the settings are read with
+CachedConfigValues::CachedConfigValues() {
+	showPerfStats					= false;
+	enableNewThreadManager			= false;
+	autoTest						= false;
+	disableWaterSounds				= false;
+	enableFowCache					= true;
+	enablePathfinderCache			= false;
+	enablePathfinderDistanceOutput	= false;
+	enableBailoutPathfinding		= true;
+	mouseMoveScrollsWorld			= true;
+	enableFrustrumCache				= false;
+	recordMode						= false;
+	inGameClock						= true;
+	inGameLocalClock				= true;
+	debugGameSynchUI				= false;
+}
+
+void CachedConfigValues::load(const Config &config) {
+	showPerfStats					= config.getBool("ShowPerfStats","false");
+	enableNewThreadManager			= config.getBool("EnableNewThreadManager","false");
+	autoTest						= config.getBool("AutoTest","false");
+	disableWaterSounds				= config.getBool("DisableWaterSounds","false");
+	enableFowCache					= config.getBool("EnableFowCache","true");
+	enablePathfinderCache			= config.getBool("EnablePathfinderCache","false");
+	enablePathfinderDistanceOutput	= config.getBool("EnablePathfinderDistanceOutput","false");
+	enableBailoutPathfinding		= config.getBool("EnableBailoutPathfinding","true");
+	mouseMoveScrollsWorld			= config.getBool("MouseMoveScrollsWorld","true");
+	enableFrustrumCache				= config.getBool("EnableFrustrumCache","false");
+	recordMode						= config.getBool("RecordMode","false");
+	inGameClock						= config.getBool("InGameClock","true");
+	inGameLocalClock				= config.getBool("InGameLocalClock","true");
+	debugGameSynchUI				= config.getBool("DebugGameSynchUI","false");
+}
+
 // =====================================================
 // 	class Config
 // =====================================================
@@ -100,6 +140,7 @@ map<string,string> Config::customRuntimeProperties;
 const string defaultNotFoundValue = "~~NOT FOUND~~";
 
 map<ConfigType,Config> Config::configList;
+CachedConfigValues Config::cachedValues;
 
 Config::Config() {
 	fileLoaded.first 			= false;
@@ -299,6 +340,7 @@ Config &Config::getInstance(std::pair<ConfigType,ConfigType> type, std::pair<str
 		if(SystemFlags::VERBOSE_MODE_ENABLED) if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d]\n",__FILE__,__FUNCTION__,__LINE__);
 
 		configList.insert(map<ConfigType,Config>::value_type(type.first,config));
+		configList.find(type.first)->second.refreshCachedValues();
 
 		if(SystemFlags::VERBOSE_MODE_ENABLED) if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d]\n",__FILE__,__FUNCTION__,__LINE__);
 	}
@@ -325,6 +367,7 @@ void Config::reload() {
 
 	Config &oldconfig = configList.find(type.first)->second;
 	CopyAll(&newconfig, &oldconfig);
+	oldconfig.refreshCachedValues();
 
 	if(SystemFlags::VERBOSE_MODE_ENABLED) if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d]\n",__FILE__,__FUNCTION__,__LINE__);
 }
@@ -581,55 +624,67 @@ SDLKey Config::getSDLKey(const char *key) const {
 void Config::setInt(const string &key, int value, bool tempBuffer) {
 	if(tempBuffer == true) {
 		tempProperties.setInt(key, value);
+		refreshCachedValues();
 		return;
 	}
 	if(fileLoaded.second == true) {
 		properties.second.setInt(key, value);
+		refreshCachedValues();
 		return;
 	}
 	properties.first.setInt(key, value);
+	refreshCachedValues();
 }
 
 void Config::setBool(const string &key, bool value, bool tempBuffer) {
 	if(tempBuffer == true) {
 		tempProperties.setBool(key, value);
+		refreshCachedValues();
 		return;
 	}
 
 	if(fileLoaded.second == true) {
 		properties.second.setBool(key, value);
+		refreshCachedValues();
 		return;
 	}
 
 	properties.first.setBool(key, value);
+	refreshCachedValues();
 }
 
 void Config::setFloat(const string &key, float value, bool tempBuffer) {
 	if(tempBuffer == true) {
 		tempProperties.setFloat(key, value);
+		refreshCachedValues();
 		return;
 	}
 
 	if(fileLoaded.second == true) {
 		properties.second.setFloat(key, value);
+		refreshCachedValues();
 		return;
 	}
 
 	properties.first.setFloat(key, value);
+	refreshCachedValues();
 }
 
 void Config::setString(const string &key, const string &value, bool tempBuffer) {
 	if(tempBuffer == true) {
 		tempProperties.setString(key, value);
+		refreshCachedValues();
 		return;
 	}
 
 	if(fileLoaded.second == true) {
 		properties.second.setString(key, value);
+		refreshCachedValues();
 		return;
 	}
 
 	properties.first.setString(key, value);
+	refreshCachedValues();
 }
 
 vector<pair<string,string> > Config::getPropertiesFromContainer(const Properties &propertiesObj) const {
@@ -684,6 +739,15 @@ void Config::setUserProperties(const vector<pair<string,string> > &valueList) {
 		const pair<string,string> &nameValuePair = valueList[idx];
 		propertiesObj.setString(nameValuePair.first,nameValuePair.second);
 	}
+	refreshCachedValues();
+}
+
+// only the game config the game reads through getInstance() feeds the cache
+void Config::refreshCachedValues() {
+	map<ConfigType,Config>::iterator iterFind = configList.find(cfgMainGame);
+	if(iterFind != configList.end() && &iterFind->second == this) {
+		cachedValues.load(*this);
+	}
 }
 
 string Config::getFileName(bool userFilename) const {
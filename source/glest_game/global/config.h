@@ -42,6 +42,36 @@ enum ConfigType {
     cfgTempKeys
 };
 
+class Config;
+
+// =====================================================
+// 	class CachedConfigValues
+//
+///	Game settings read every frame, looked up once and then
+///	again each time the game config is loaded or changed
+// =====================================================
+
+class CachedConfigValues {
+public:
+	bool showPerfStats;
+	bool enableNewThreadManager;
+	bool autoTest;
+	bool disableWaterSounds;
+	bool enableFowCache;
+	bool enablePathfinderCache;
+	bool enablePathfinderDistanceOutput;
+	bool enableBailoutPathfinding;
+	bool mouseMoveScrollsWorld;
+	bool enableFrustrumCache;
+	bool recordMode;
+	bool inGameClock;
+	bool inGameLocalClock;
+	bool debugGameSynchUI;
+
+	CachedConfigValues();
+	void load(const Config &config);
+};
+
 class Config {
 private:
 
@@ -58,6 +88,7 @@ private:
     static const char *glestuser_ini_filename;
 
     static map<string,string> customRuntimeProperties;
+    static CachedConfigValues cachedValues;
 
 public:
 
@@ -78,6 +109,7 @@ protected:
 	static void CopyAll(Config *src,Config *dest);
 	vector<pair<string,string> > getPropertiesFromContainer(const Properties &propertiesObj) const;
 	static bool replaceFileWithLocalFile(const vector<string> &dirList, string fileNamePart, string &resultToReplace);
+	void refreshCachedValues();
 
 public:
 
@@ -87,6 +119,9 @@ public:
 	void save(const string &path="");
 	void reload();
 
+	// the hot settings of the game config, no string lookups
+	static const CachedConfigValues & getCachedValues()	{ return cachedValues; }
+
 	int getInt(const string &key,const char *defaultValueIfNotFound=NULL) const;
 	bool getBool(const string &key,const char *defaultValueIfNotFound=NULL) const;
 	float getFloat(const string &key,const char *defaultValueIfNotFound=NULL) const;
@@ -29,6 +29,7 @@
 #include "network_manager.h"
 #include <algorithm>
 #include <iterator>
+#include "game_trace.h"
 #include "leak_dumper.h"
 
 using namespace Shared::Graphics;
@@ -254,6 +255,7 @@ Renderer::Renderer() : BaseRenderer() {
 			fontManager[i]= graphicsFactory->newFontManager();
 		}
 		particleManager[i]= graphicsFactory->newParticleManager();
+		particleManager[i]->setWorkerCount(config.getInt("ParticleWorkerThreads","-1"));
 	}
 
 	if(GlobalStaticFlags::getIsNonGraphicalModeEnabled() == false) {
@@ -956,6 +958,7 @@ void Renderer::cleanupUnitParticleSystems(vector<UnitParticleSystem *> &particle
 }
 
 void Renderer::updateParticleManager(ResourceScope rs, int renderFps) {
+	TRACE_SCOPE_ARG(tevParticleUpdate,(int)rs);
 	particleManager[rs]->update(renderFps);
 }
 
@@ -1328,7 +1331,7 @@ bool Renderer::ExtractFrustum(VisibleQuadContainerCache &quadCacheItem) {
 //   }
 
    // Check the frustum cache
-   const bool useFrustumCache = Config::getInstance().getBool("EnableFrustrumCache","false");
+   const bool useFrustumCache = Config::getCachedValues().enableFrustrumCache;
    pair<vector<float>,vector<float> > lookupKey;
    if(useFrustumCache == true) {
 	   lookupKey = make_pair(proj,modl);
@@ -1878,8 +1881,7 @@ void Renderer::renderMouse3d() {
 		return;
 	}
 
-	Config &config= Config::getInstance();
-	if(config.getBool("RecordMode","false") == true) {
+	if(Config::getCachedValues().recordMode == true) {
 		return;
 	}
 
@@ -2352,8 +2354,7 @@ void Renderer::renderClock() {
 		return;
 	}
 
-	Config &config= Config::getInstance();
-	if(config.getBool("InGameClock","true") == false && config.getBool("InGameLocalClock","true") == false) {
+	if(Config::getCachedValues().inGameClock == false && Config::getCachedValues().inGameLocalClock == false) {
 		return;
 	}
 
@@ -2362,7 +2363,7 @@ void Renderer::renderClock() {
 	const World *world = game->getWorld();
 	const Vec4f fontColor = game->getGui()->getDisplay()->getColor();
 
-	if(config.getBool("InGameClock","true") == true) {
+	if(Config::getCachedValues().inGameClock == true) {
 		int hours = world->getTimeFlow()->getTime();
 		int minutes = (world->getTimeFlow()->getTime() - hours) * 100 * 0.6; // scale 100 to 60
 
@@ -2375,7 +2376,7 @@ void Renderer::renderClock() {
 		str += szBuf;
 	}
 
-	if(config.getBool("InGameLocalClock","true") == true) {
+	if(Config::getCachedValues().inGameLocalClock == true) {
 		time_t nowTime = time(NULL);
 		struct tm *loctime = localtime(&nowTime);
 		char szBuf2[100]="";
@@ -2516,8 +2517,7 @@ void Renderer::renderSelectionQuad() {
 		return;
 	}
 
-	Config &config= Config::getInstance();
-	if(config.getBool("RecordMode","false") == true) {
+	if(Config::getCachedValues().recordMode == true) {
 		return;
 	}
 
@@ -5291,8 +5291,7 @@ void Renderer::renderSelectionEffects() {
 		return;
 	}
 
-	Config &config= Config::getInstance();
-	if(config.getBool("RecordMode","false") == true) {
+	if(Config::getCachedValues().recordMode == true) {
 		return;
 	}
 
@@ -5928,7 +5927,7 @@ void Renderer::renderMinimap(){
 	VisibleQuadContainerCache &qCache = getQuadCache();
 	std::vector<Unit *> visibleUnitList = qCache.visibleUnitList;
 
-	const bool showAllUnitsInMinimap = Config::getInstance().getBool("DebugGameSynchUI","false");
+	const bool showAllUnitsInMinimap = Config::getCachedValues().debugGameSynchUI;
 	if(showAllUnitsInMinimap == true) {
 		visibleUnitList.clear();
 
@@ -8250,8 +8249,7 @@ void Renderer::renderArrow(const Vec3f &pos1, const Vec3f &pos2,
 		return;
 	}
 
-	Config &config= Config::getInstance();
-	if(config.getBool("RecordMode","false") == true) {
+	if(Config::getCachedValues().recordMode == true) {
 		return;
 	}
 
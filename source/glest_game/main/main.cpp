@@ -53,6 +53,8 @@
 #include <locale.h>
 #include "string_utils.h"
 #include "auto_test.h"
+#include "benchmark.h"
+#include "game_trace.h"
 #include "lua_script.h"
 
 // To handle signal catching
@@ -187,6 +189,8 @@ void cleanupCRCThread() {
 		preCacheThread = NULL;
 		if(SystemFlags::VERBOSE_MODE_ENABLED) printf("In [%s::%s Line: %d]\n",__FILE__,__FUNCTION__,__LINE__);
 	}
+	// keeps the CRCs hashed since the last precache pass
+	Checksum::cleanupFileCache();
 	if(SystemFlags::VERBOSE_MODE_ENABLED) printf("In [%s::%s Line: %d]\n",__FILE__,__FUNCTION__,__LINE__);
 }
 
@@ -243,6 +247,7 @@ static void cleanupProcessObjects() {
 
     if(SystemFlags::VERBOSE_MODE_ENABLED) printf("In [%s::%s Line: %d]\n",__FILE__,__FUNCTION__,__LINE__);
 
+	GameTrace::exportTrace();
 	SystemFlags::Close();
 	SystemFlags::SHUTDOWN_PROGRAM_MODE=true;
 
@@ -285,6 +290,7 @@ static void cleanupProcessObjects() {
 	deleteMapValues(list3d.begin(),list3d.end());
 
 	XmlIo::getInstance().cleanup();
+	Tracer::cleanup();
 
 	//printf("Closing IRC CLient %d\n",__LINE__);
 
@@ -1457,6 +1463,8 @@ void setupLogging(Config &config, bool haveSpecialOutputCommandLineOption) {
     SystemFlags::getSystemSettingType(SystemFlags::debugSound).enabled  		= config.getBool("DebugSound","false");
     SystemFlags::getSystemSettingType(SystemFlags::debugError).enabled  		= config.getBool("DebugError","true");
 
+    GameTrace::init(config);
+
     string userData = config.getString("UserData_Root","");
     if(userData != "") {
     	endPathWithSlash(userData);
@@ -3213,6 +3221,37 @@ int glestMain(int argc, char** argv) {
 		}
     }
 
+    if( hasCommandArgument(argc, argv,string(GAME_ARGS[GAME_ARG_BENCHMARK])) == true) {
+    	// A benchmark is a headless LAN game that quits when done
+    	GlobalStaticFlags::setIsNonGraphicalModeEnabled(true);
+    	GlobalStaticFlags::setFlag(gsft_lan_mode);
+    	disableheadless_console = true;
+    	Program::setWantShutdownApplicationAfterGame(true);
+    	Benchmark::setEnabled(true);
+
+    	int foundParamIndIndex = -1;
+		hasCommandArgument(argc, argv,string(GAME_ARGS[GAME_ARG_BENCHMARK]) + string("="),&foundParamIndIndex);
+		if(foundParamIndIndex < 0) {
+			hasCommandArgument(argc, argv,string(GAME_ARGS[GAME_ARG_BENCHMARK]),&foundParamIndIndex);
+		}
+		string paramValue = argv[foundParamIndIndex];
+		vector<string> paramPartTokens;
+		Tokenize(paramValue,paramPartTokens,"=");
+		if(paramPartTokens.size() >= 2 && paramPartTokens[1].length() > 0) {
+			vector<string> paramPartTokens2;
+			Tokenize(paramPartTokens[1],paramPartTokens2,",");
+			if(paramPartTokens2.size() >= 1 && paramPartTokens2[0].length() > 0) {
+				Benchmark::setLoadGameSettingsFile(paramPartTokens2[0]);
+			}
+			if(paramPartTokens2.size() >= 2 && paramPartTokens2[1].length() > 0) {
+				Benchmark::setMaxFrames(strToInt(paramPartTokens2[1]));
+			}
+			if(paramPartTokens2.size() >= 3 && paramPartTokens2[2].length() > 0) {
+				Benchmark::setOutputFile(paramPartTokens2[2]);
+			}
+		}
+    }
+
 	PlatformExceptionHandler::application_binary= executable_path(argv[0],true);
 	mg_app_name = GameConstants::application_name;
 	mailStringSupport = mailString;
@@ -3535,6 +3574,7 @@ int glestMain(int argc, char** argv) {
 		if(Socket::DEFAULT_SOCKET_RECVBUF_SIZE >= 0) {
 			printf("*WARNING users wants to set default socket receive buffer size to: %d\n",Socket::DEFAULT_SOCKET_RECVBUF_SIZE);
 		}
+		Socket::enableReceiveBuffer = config.getBool("EnableSocketReceiveBuffer","true");
 
 		shutdownFadeSoundMilliseconds = config.getInt("ShutdownFadeSoundMilliseconds",intToStr(shutdownFadeSoundMilliseconds).c_str());
 
@@ -3635,7 +3675,8 @@ int glestMain(int argc, char** argv) {
         }
 
 	    if( hasCommandArgument(argc, argv,GAME_ARGS[GAME_ARG_DISABLE_SOUND]) == true ||
-	    	hasCommandArgument(argc, argv,string(GAME_ARGS[GAME_ARG_MASTERSERVER_MODE])) == true) {
+	    	hasCommandArgument(argc, argv,string(GAME_ARGS[GAME_ARG_MASTERSERVER_MODE])) == true ||
+	    	hasCommandArgument(argc, argv,string(GAME_ARGS[GAME_ARG_BENCHMARK])) == true) {
 	    	config.setString("FactorySound","None",true);
 	    	if(hasCommandArgument(argc, argv,string(GAME_ARGS[GAME_ARG_MASTERSERVER_MODE])) == true) {
 	    		//Logger::getInstance().setMasterserverMode(true);
@@ -4545,6 +4586,23 @@ int glestMain(int argc, char** argv) {
 			program->initServer(mainWindow,false,true);
 			gameInitialized = true;
 		}
+		else if(hasCommandArgument(argc, argv,string(GAME_ARGS[GAME_ARG_BENCHMARK])) == true) {
+			string gameSettingsFile = Benchmark::getLoadGameSettingsFile();
+			if(gameSettingsFile == "") {
+				printf("\nNo game settings file specified on commandline [%s]\n\n",GAME_ARGS[GAME_ARG_BENCHMARK]);
+				printParameterHelp(argv[0],foundInvalidArgs);
+				delete mainWindow;
+				mainWindow=NULL;
+				return 1;
+			}
+			if(CoreData::getInstance().loadGameSettingsFromFile(gameSettingsFile, &startupGameSettings) == false) {
+				throw megaglest_runtime_error("Specified game settings file [" + gameSettingsFile + "] was NOT found!");
+			}
+			printf("Running benchmark of %d frames using game settings file [%s]\n",Benchmark::getMaxFrames(),gameSettingsFile.c_str());
+
+			program->initServer(mainWindow,&startupGameSettings,true);
+			gameInitialized = true;
+		}
 		else if(hasCommandArgument(argc, argv,string(GAME_ARGS[GAME_ARG_MASTERSERVER_MODE])) == true) {
 			program->initServer(mainWindow,false,true,true);
 			gameInitialized = true;
@@ -28,6 +28,7 @@
 #include "menu_state_custom_game.h"
 #include "menu_state_join_game.h"
 #include "menu_state_scenario.h"
+#include "benchmark.h"
 #include "leak_dumper.h"
 
 using namespace Shared::Util;
@@ -72,6 +73,11 @@ void ProgramState::tick() {
 }
 
 bool ProgramState::canRender(bool sleepIfCannotRender) {
+	// the benchmark runs as fast as it can, a sleep here would end up in
+	// its frame timings
+	if(Benchmark::isEnabled() == true) {
+		return true;
+	}
 	int maxFPSCap = Config::getInstance().getInt("RenderFPSCap","500");
 	int sleepMillis = Config::getInstance().getInt("RenderFPSCapSleepMillis","1");
 	//Renderer &renderer= Renderer::getInstance();
@@ -243,11 +249,11 @@ void Program::initServer(WindowGl *window, bool autostart,bool openNetworkSlots,
 	mainMenu->setState(new MenuStateCustomGame(this, mainMenu, openNetworkSlots, pNewGame, autostart, NULL, masterserverMode));
 }
 
-void Program::initServer(WindowGl *window, GameSettings *settings) {
+void Program::initServer(WindowGl *window, GameSettings *settings, bool masterserverMode) {
 	init(window);
 	MainMenu *mainMenu= new MainMenu(this);
 	setState(mainMenu);
-	mainMenu->setState(new MenuStateCustomGame(this, mainMenu, false, pNewGame, true, settings));
+	mainMenu->setState(new MenuStateCustomGame(this, mainMenu, false, pNewGame, true, settings, masterserverMode));
 }
 
 void Program::initClient(WindowGl *window, const Ip &serverIp, int portNumber) {
@@ -383,7 +389,7 @@ void Program::loopWorker() {
 		}
 	}
 
-	bool showPerfStats = Config::getInstance().getBool("ShowPerfStats","false");
+	bool showPerfStats = Config::getCachedValues().showPerfStats;
 	Chrono chronoPerf;
 	char perfBuf[8096]="";
 	std::vector<string> perfList;
@@ -446,7 +452,10 @@ void Program::loopWorker() {
 	//update world
 	if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled) chrono.start();
 	int updateCount = 0;
-	while(prevState == this->programState && updateTimer.isTime()) {
+	// the benchmark is not frame rate limited, it updates once per loop
+	bool unthrottledUpdate = Benchmark::isEnabled();
+	while(prevState == this->programState &&
+		(updateTimer.isTime() == true || (unthrottledUpdate == true && updateCount == 0))) {
 		Chrono chronoUpdateLoop;
 		if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled) chronoUpdateLoop.start();
 		if(showPerfStats) {
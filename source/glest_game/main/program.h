@@ -175,7 +175,7 @@ public:
     GraphicMessageBox * getMsgBox() { return &msgBox; }
 	void initNormal(WindowGl *window);
 	void initServer(WindowGl *window,bool autostart=false,bool openNetworkSlots=false,bool masterserverMode=false);
-	void initServer(WindowGl *window, GameSettings *settings);
+	void initServer(WindowGl *window, GameSettings *settings,bool masterserverMode=false);
 	void initSavedGame(WindowGl *window,bool masterserverMode=false,string saveGameFile="");
 	void initClient(WindowGl *window, const Ip &serverIp,int portNumber=-1);
 	void initClientAutoFindHost(WindowGl *window);
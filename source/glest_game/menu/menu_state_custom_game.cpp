@@ -32,6 +32,7 @@
 #include "map_preview.h"
 #include "string_utils.h"
 #include "network_message.h"
+#include "hierarchical_path_graph.h"
 #include "leak_dumper.h"
 
 namespace Glest{ namespace Game{
@@ -3213,6 +3214,42 @@ void MenuStateCustomGame::loadGameSettings(GameSettings *gameSettings,bool force
         gameSettings->setFlagTypes1(valueFlags1);
 	}
 
+	// Pathfinder search modes change unit paths so the server decides for everyone
+	if(Config::getInstance().getBool("EnablePathfinderJPS","false") == true) {
+        valueFlags1 |= ft1_pathfinder_jump_point;
+        gameSettings->setFlagTypes1(valueFlags1);
+	}
+	else {
+        valueFlags1 &= ~ft1_pathfinder_jump_point;
+        gameSettings->setFlagTypes1(valueFlags1);
+	}
+	if(Config::getInstance().getBool("EnablePathfinderHierarchy","false") == true) {
+        valueFlags1 |= ft1_pathfinder_hierarchy;
+        gameSettings->setFlagTypes1(valueFlags1);
+	}
+	else {
+        valueFlags1 &= ~ft1_pathfinder_hierarchy;
+        gameSettings->setFlagTypes1(valueFlags1);
+	}
+	if(Config::getInstance().getBool("EnablePathfinderConnectivity","false") == true) {
+        valueFlags1 |= ft1_pathfinder_connectivity;
+        gameSettings->setFlagTypes1(valueFlags1);
+	}
+	else {
+        valueFlags1 &= ~ft1_pathfinder_connectivity;
+        gameSettings->setFlagTypes1(valueFlags1);
+	}
+	if(Config::getInstance().getBool("EnablePathfinderFlowField","false") == true) {
+        valueFlags1 |= ft1_pathfinder_flow_field;
+        gameSettings->setFlagTypes1(valueFlags1);
+	}
+	else {
+        valueFlags1 &= ~ft1_pathfinder_flow_field;
+        gameSettings->setFlagTypes1(valueFlags1);
+	}
+	gameSettings->setPathFinderClusterSize(Config::getInstance().getInt("PathfinderHierarchyClusterSize",intToStr(HierarchicalPathGraph::defaultClusterSize).c_str()));
+	valueFlags1 = gameSettings->getFlagTypes1();
+
 	// First save Used slots
     //for(int i=0; i<mapInfo.players; ++i)
 	int AIPlayerCount = 0;
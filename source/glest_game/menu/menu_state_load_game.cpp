@@ -276,7 +276,7 @@ void MenuStateLoadGame::mouseClick(int x, int y, MouseButton mouseButton){
 					if(fileExists(filename)) {
 						Lang &lang= Lang::getInstance();
 
-						XmlTree	xmlTree(XML_RAPIDXML_ENGINE);
+						XmlTree	xmlTree(XmlIoBinary::isBinaryFile(filename) == true ? XML_BINARY_ENGINE : XML_RAPIDXML_ENGINE);
 						if(SystemFlags::VERBOSE_MODE_ENABLED) printf("Before load of XML\n");
 						std::map<string,string> mapExtraTagReplacementValues;
 						xmlTree.load(filename, Properties::getTagReplacementValues(&mapExtraTagReplacementValues),true);
@@ -455,6 +455,7 @@ void ClientInterface::updateLobby() {
 
 				MutexSafeWrapper safeMutexFlags(flagAccessor,CODE_AT_LINE);
 				this->joinGameInProgress = networkMessageIntro.getGameInProgress();
+				this->setPeerProtocolVersion(networkMessageIntro.getProtocolVersion());
 				this->joinGameInProgressLaunch = false;
 				safeMutexFlags.ReleaseLock();
 
@@ -1870,6 +1871,7 @@ void ClientInterface::close(bool lockMutex) {
 
 	connectedTime = 0;
 	gotIntro = false;
+	peerProtocolVersion = nmpvBase;
 
 	MutexSafeWrapper safeMutexFlags(flagAccessor,CODE_AT_LINE);
 	this->joinGameInProgress = false;
@@ -858,6 +858,7 @@ void ConnectionSlot::update(bool checkForNewClients,int lockedSlotIndex) {
 								this->versionString = networkMessageIntro.getVersionString();
 								this->connectedRemoteIPAddress = networkMessageIntro.getExternalIp();
 								this->playerLanguage = networkMessageIntro.getPlayerLanguage();
+								this->setPeerProtocolVersion(networkMessageIntro.getProtocolVersion());
 
 								//printf("\n\n\n ##### GOT this->playerLanguage [%s]\n\n\n",this->playerLanguage.c_str());
 								if(SystemFlags::getSystemSettingType(SystemFlags::debugNetwork).enabled) SystemFlags::OutputDebug(SystemFlags::debugNetwork,"In [%s::%s] got name [%s] versionString [%s], msgSessionId = %d\n",__FILE__,__FUNCTION__,name.c_str(),versionString.c_str(),msgSessionId);
@@ -1463,6 +1464,7 @@ void ConnectionSlot::close() {
 	this->gotIntro = false;
 	this->skipLagCheck = false;
 	this->joinGameInProgress = false;
+	this->peerProtocolVersion = nmpvBase;
 	this->sentSavedGameInfo = false;
 	this->pauseForInGameConnection = false;
 	this->unPauseForInGameConnection = false;
@@ -1516,6 +1518,10 @@ void ConnectionSlot::signalUpdate(ConnectionSlotEvent *event) {
 }
 
 bool ConnectionSlot::updateCompleted(ConnectionSlotEvent *event) {
+	// handled by the caller without the slot thread
+	if(event != NULL && event->eventCompleted == true) {
+		return true;
+	}
 	bool waitingForThread = (slotThreadWorker != NULL &&
 							 slotThreadWorker->isSignalCompleted(event) == false &&
 							 slotThreadWorker->getQuitStatus() 		    == false &&
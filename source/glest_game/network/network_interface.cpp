@@ -42,6 +42,7 @@ Vec3f MarkedCell::static_system_marker_color(MAGENTA.x,MAGENTA.y,MAGENTA.z);
 
 NetworkInterface::NetworkInterface() {
 	networkAccessMutex = new Mutex();
+	peerProtocolVersion = nmpvBase;
 }
 
 NetworkInterface::~NetworkInterface() {
@@ -69,10 +70,20 @@ void NetworkInterface::addUnMarkedCell(const UnMarkedCell &msg) {
 	unmarkedCellList.push_back(msg);
 }
 
+void NetworkInterface::setPeerProtocolVersion(int value) {
+	peerProtocolVersion = min(value, (int)NetworkMessage::getLocalProtocolVersion());
+}
+
 void NetworkInterface::sendMessage(NetworkMessage* networkMessage){
 	Socket* socket= getSocket(false);
 
-	networkMessage->send(socket);
+	NetworkMessageCommandList *commandList = dynamic_cast<NetworkMessageCommandList *>(networkMessage);
+	if(commandList != NULL && peerProtocolVersion >= nmpvCompactCommandList) {
+		commandList->sendCompact(socket);
+	}
+	else {
+		networkMessage->send(socket);
+	}
 }
 
 NetworkMessageType NetworkInterface::getNextMessageType(int waitMilliseconds)
@@ -105,6 +116,10 @@ NetworkMessageType NetworkInterface::getNextMessageType(int waitMilliseconds)
         		if(SystemFlags::getSystemSettingType(SystemFlags::debugNetwork).enabled) SystemFlags::OutputDebug(SystemFlags::debugNetwork,"In [%s::%s Line: %d] Invalid message type = %d (no packet handshake yet so ignored)\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,messageType);
         	}
         }
+        // NetworkMessageCommandList reads both encodings
+        else if(messageType == nmtCommandListCompact) {
+        	messageType = nmtCommandList;
+        }
     }
 
 	return static_cast<NetworkMessageType>(messageType);
@@ -187,6 +187,9 @@ protected:
 
 	Mutex *networkAccessMutex;
 
+	// lowest NetworkProtocolVersion of both ends, from the peer's intro
+	int peerProtocolVersion;
+
 public:
 	static const int readyWaitTimeout;
 	GameSettings gameSettings;
@@ -208,6 +211,8 @@ public:
 
 	virtual void sendMessage(NetworkMessage* networkMessage);
 	NetworkMessageType getNextMessageType(int waitMilliseconds=0);
+	void setPeerProtocolVersion(int value);
+	int getPeerProtocolVersion() const { return peerProtocolVersion; }
 	bool receiveMessage(NetworkMessage* networkMessage);
 
 	virtual bool isConnected();
@@ -65,6 +65,24 @@ bool NetworkMessage::receive(Socket* socket, void* data, int dataSize, bool tryR
 
 }
 
+unsigned char * NetworkMessage::receivePacked(Socket* socket, int dataSize) {
+	if(socket != NULL) {
+		unsigned char *data = reinterpret_cast<unsigned char *>(socket->receiveInPlace(dataSize));
+		if(data == NULL) {
+			if(SystemFlags::getSystemSettingType(SystemFlags::debugNetwork).enabled) SystemFlags::OutputDebug(SystemFlags::debugNetwork,"In [%s::%s Line: %d] WARNING, could not receive dataSize = %d\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,dataSize);
+
+			if(socket->getSocketId() > 0) {
+				throw megaglest_runtime_error("Error receiving NetworkMessage, dataSize = " + intToStr(dataSize));
+			}
+		}
+		else {
+			dump_packet("\nINCOMING PACKET:\n",data, dataSize);
+		}
+		return data;
+	}
+	return NULL;
+}
+
 void NetworkMessage::send(Socket* socket, const void* data, int dataSize) {
 	if(SystemFlags::getSystemSettingType(SystemFlags::debugNetwork).enabled) SystemFlags::OutputDebug(SystemFlags::debugNetwork,"In [%s::%s Line: %d] socket = %p, data = %p, dataSize = %d\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,socket,data,dataSize);
 
@@ -84,6 +102,13 @@ void NetworkMessage::send(Socket* socket, const void* data, int dataSize) {
 	}
 }
 
+int8 NetworkMessage::getLocalProtocolVersion() {
+	if(Config::getInstance().getBool("NetworkCompactCommandList","true") == false) {
+		return nmpvBase;
+	}
+	return nmpvCompactCommandList;
+}
+
 void NetworkMessage::dump_packet(string label, const void* data, int dataSize) {
 	Config &config = Config::getInstance();
 	if(config.getBool("DebugNetworkPackets","false") == true) {
@@ -131,6 +156,13 @@ NetworkMessageIntro::NetworkMessageIntro(int32 sessionId,const string &versionSt
 	data.ftpPort		= ftpPort;
 	data.language		= playerLanguage;
 	data.gameInProgress = gameInProgress;
+	setIntroProtocolVersion(data.language.getBuffer(), maxLanguageStringSize, getLocalProtocolVersion());
+}
+
+// peers that predate protocol versions send a zero, which is nmpvBase
+int8 NetworkMessageIntro::getProtocolVersion() const {
+	int8 result = getIntroProtocolVersion(data.language.getBuffer(), maxLanguageStringSize);
+	return (result >= nmpvBase && result < nmpvCount ? result : nmpvBase);
 }
 
 const char * NetworkMessageIntro::getPackedMessageFormat() const {
@@ -152,7 +184,7 @@ unsigned int NetworkMessageIntro::getPackedSize() {
 				packedData.externalIp,
 				packedData.ftpPort,
 				packedData.language.getBuffer(),
-				data.gameInProgress);
+				packedData.gameInProgress);
 		delete [] buf;
 	}
 	return result;
@@ -202,6 +234,7 @@ string NetworkMessageIntro::toString() const {
 	result += " ftpPort = " + uIntToStr(data.ftpPort);
 	result += " language = " + data.language.getString();
 	result += " gameInProgress = " + uIntToStr(data.gameInProgress);
+	result += " protocolVersion = " + intToStr(getProtocolVersion());
 	return result;
 }
 
@@ -211,11 +244,12 @@ bool NetworkMessageIntro::receive(Socket* socket) {
 		result = NetworkMessage::receive(socket, &data, sizeof(data), true);
 	}
 	else {
-		unsigned char *buf = new unsigned char[getPackedSize()+1];
-		result = NetworkMessage::receive(socket, buf, getPackedSize(), true);
-		unpackMessage(buf);
+		unsigned char *buf = receivePacked(socket, getPackedSize());
+		result = (buf != NULL);
+		if(result == true) {
+			unpackMessage(buf);
+		}
 		//printf("Got packet size = %u data.messageType = %d\n%s\n",getPackedSize(),data.messageType,buf);
-		delete [] buf;
 	}
 	fromEndian();
 
@@ -329,11 +363,12 @@ bool NetworkMessagePing::receive(Socket* socket){
 		result = NetworkMessage::receive(socket, &data, sizeof(data), true);
 	}
 	else {
-		unsigned char *buf = new unsigned char[getPackedSize()+1];
-		result = NetworkMessage::receive(socket, buf, getPackedSize(), true);
-		unpackMessage(buf);
+		unsigned char *buf = receivePacked(socket, getPackedSize());
+		result = (buf != NULL);
+		if(result == true) {
+			unpackMessage(buf);
+		}
 		//printf("Got packet size = %u data.messageType = %d\n%s\n",getPackedSize(),data.messageType,buf);
-		delete [] buf;
 	}
 	fromEndian();
 
@@ -426,11 +461,12 @@ bool NetworkMessageReady::receive(Socket* socket){
 		result = NetworkMessage::receive(socket, &data, sizeof(data), true);
 	}
 	else {
-		unsigned char *buf = new unsigned char[getPackedSize()+1];
-		bool result = NetworkMessage::receive(socket, buf, getPackedSize(), true);
-		unpackMessage(buf);
+		unsigned char *buf = receivePacked(socket, getPackedSize());
+		bool result = (buf != NULL);
+		if(result == true) {
+			unpackMessage(buf);
+		}
 		//printf("Got packet size = %u data.messageType = %d\n%s\n",getPackedSize(),data.messageType,buf);
-		delete [] buf;
 	}
 	fromEndian();
 	return result;
@@ -1033,11 +1069,12 @@ bool NetworkMessageLaunch::receive(Socket* socket) {
 		result = NetworkMessage::receive(socket, &data, sizeof(data), true);
 	}
 	else {
-		unsigned char *buf = new unsigned char[getPackedSize()+1];
-		result = NetworkMessage::receive(socket, buf, getPackedSize(), true);
-		unpackMessage(buf);
+		unsigned char *buf = receivePacked(socket, getPackedSize());
+		result = (buf != NULL);
+		if(result == true) {
+			unpackMessage(buf);
+		}
 		//printf("Got packet size = %u data.messageType = %d\n%s\n",getPackedSize(),data.messageType,buf);
-		delete [] buf;
 	}
 	fromEndian();
 
@@ -1154,8 +1191,65 @@ void NetworkMessageLaunch::fromEndian() {
 	}
 }
 
+
 // =====================================================
-//	class NetworkMessageLaunch
+//	Compact command list encoding
+// =====================================================
+
+static const uint32 maxCompactCommandListSize = 4 * 1024 * 1024;
+
+static void writeVarUInt(vector<unsigned char> &buf, uint32 value) {
+	while(value >= 0x80) {
+		buf.push_back(static_cast<unsigned char>(value | 0x80));
+		value >>= 7;
+	}
+	buf.push_back(static_cast<unsigned char>(value));
+}
+
+// zigzag so small negative values, like the -1 defaults, stay small
+static void writeVarInt(vector<unsigned char> &buf, int32 value) {
+	writeVarUInt(buf, (static_cast<uint32>(value) << 1) ^ static_cast<uint32>(value >> 31));
+}
+
+static uint32 readVarUInt(const unsigned char *buf, uint32 size, uint32 &offset) {
+	uint32 value = 0;
+	for(int shift = 0; shift < 35; shift += 7) {
+		if(offset >= size) {
+			throw megaglest_runtime_error("Truncated compact command list, size = " + uIntToStr(size));
+		}
+		unsigned char byte = buf[offset++];
+		value |= static_cast<uint32>(byte & 0x7F) << shift;
+		if((byte & 0x80) == 0) {
+			return value;
+		}
+	}
+	throw megaglest_runtime_error("Invalid varint in compact command list");
+}
+
+static int32 readVarInt(const unsigned char *buf, uint32 size, uint32 &offset) {
+	uint32 value = readVarUInt(buf, size, offset);
+	return static_cast<int32>(value >> 1) ^ -static_cast<int32>(value & 1);
+}
+
+// Everything but the unit matches, as for a group order
+static bool isSameCommandForOtherUnit(const NetworkCommand &command, const NetworkCommand &other) {
+	return (command.networkCommandType == other.networkCommandType &&
+			command.unitTypeId == other.unitTypeId &&
+			command.commandTypeId == other.commandTypeId &&
+			command.positionX == other.positionX &&
+			command.positionY == other.positionY &&
+			command.targetId == other.targetId &&
+			command.wantQueue == other.wantQueue &&
+			command.fromFactionIndex == other.fromFactionIndex &&
+			command.unitFactionUnitCount == other.unitFactionUnitCount &&
+			command.unitFactionIndex == other.unitFactionIndex &&
+			command.commandStateType == other.commandStateType &&
+			command.commandStateValue == other.commandStateValue &&
+			command.unitCommandGroupId == other.unitCommandGroupId);
+}
+
+// =====================================================
+//	class NetworkMessageCommandList
 // =====================================================
 
 NetworkMessageCommandList::NetworkMessageCommandList(int32 frameCount) {
@@ -1291,6 +1385,14 @@ unsigned char * NetworkMessageCommandList::packMessageDetail(uint16 totalCommand
 bool NetworkMessageCommandList::receive(Socket* socket) {
 	if(SystemFlags::getSystemSettingType(SystemFlags::debugNetwork).enabled) SystemFlags::OutputDebug(SystemFlags::debugNetwork,"In [%s::%s Line: %d]\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__);
 
+	if(socket != NULL) {
+		int8 messageType = nmtInvalid;
+		if(socket->peek(&messageType, sizeof(messageType)) == sizeof(messageType) &&
+			messageType == nmtCommandListCompact) {
+			return receiveCompact(socket);
+		}
+	}
+
 	unsigned char *buf = NULL;
 	bool result = false;
 	if(useOldProtocol == true) {
@@ -1298,11 +1400,12 @@ bool NetworkMessageCommandList::receive(Socket* socket) {
 	}
 	else {
 		//fromEndianHeader();
-		buf = new unsigned char[getPackedSizeHeader()+1];
-		result = NetworkMessage::receive(socket, buf, getPackedSizeHeader(), true);
-		unpackMessageHeader(buf);
+		buf = receivePacked(socket, getPackedSizeHeader());
+		result = (buf != NULL);
+		if(result == true) {
+			unpackMessageHeader(buf);
+		}
 		//if(data.header.commandCount) printf("\n\nGot packet size = %u data.messageType = %d\n%s\ncommandcount [%u] framecount [%d]\n",getPackedSizeHeader(),data.header.messageType,buf,data.header.commandCount,data.header.frameCount);
-		delete [] buf;
 	}
 	fromEndianHeader();
 
@@ -1319,11 +1422,12 @@ bool NetworkMessageCommandList::receive(Socket* socket) {
 			else {
 				//int totalMsgSize = (sizeof(NetworkCommand) * data.header.commandCount);
 				//result = NetworkMessage::receive(socket, &data.commands[0], totalMsgSize, true);
-				buf = new unsigned char[getPackedSizeDetail(data.header.commandCount)+1];
-				result = NetworkMessage::receive(socket, buf, getPackedSizeDetail(data.header.commandCount), true);
-				unpackMessageDetail(buf,data.header.commandCount);
+				buf = receivePacked(socket, getPackedSizeDetail(data.header.commandCount));
+				result = (buf != NULL);
+				if(result == true) {
+					unpackMessageDetail(buf,data.header.commandCount);
+				}
 				//printf("Got packet size = %u data.messageType = %d\n%s\n",getPackedSize(),data.messageType,buf);
-				delete [] buf;
 			}
 			fromEndianDetail();
 
@@ -1417,6 +1521,136 @@ void NetworkMessageCommandList::send(Socket* socket) {
 	}
 }
 
+bool NetworkMessageCommandList::receiveCompact(Socket* socket) {
+	int8 messageType = nmtInvalid;
+	if(NetworkMessage::receive(socket, &messageType, sizeof(messageType), true) == false) {
+		return false;
+	}
+	uint32 payloadSize = 0;
+	for(int shift = 0;; shift += 7) {
+		uint8 byte = 0;
+		if(shift >= 35) {
+			throw megaglest_runtime_error("Invalid compact command list size");
+		}
+		if(NetworkMessage::receive(socket, &byte, sizeof(byte), true) == false) {
+			return false;
+		}
+		payloadSize |= static_cast<uint32>(byte & 0x7F) << shift;
+		if((byte & 0x80) == 0) {
+			break;
+		}
+	}
+	if(payloadSize == 0 || payloadSize > maxCompactCommandListSize) {
+		throw megaglest_runtime_error("Invalid compact command list size = " + uIntToStr(payloadSize));
+	}
+
+	const unsigned char *buf = receivePacked(socket, payloadSize);
+	if(buf == NULL) {
+		return false;
+	}
+
+	uint32 offset = 0;
+	data.header.messageType = nmtCommandList;
+	data.header.frameCount = readVarInt(buf, payloadSize, offset);
+	uint32 commandCount = readVarUInt(buf, payloadSize, offset);
+	if(commandCount > 0xFFFF) {
+		throw megaglest_runtime_error("Invalid compact command list command count = " + uIntToStr(commandCount));
+	}
+	data.header.commandCount = static_cast<uint16>(commandCount);
+	data.commands.clear();
+	data.commands.reserve(commandCount);
+
+	int32 lastUnitId = 0;
+	while(data.commands.size() < commandCount) {
+		uint32 unitCount = readVarUInt(buf, payloadSize, offset);
+		if(unitCount == 0 || data.commands.size() + unitCount > commandCount) {
+			throw megaglest_runtime_error("Invalid compact command list unit count = " + uIntToStr(unitCount));
+		}
+
+		NetworkCommand command;
+		command.networkCommandType = static_cast<int16>(readVarInt(buf, payloadSize, offset));
+		command.unitTypeId = static_cast<int16>(readVarInt(buf, payloadSize, offset));
+		command.commandTypeId = static_cast<int16>(readVarInt(buf, payloadSize, offset));
+		command.positionX = static_cast<int16>(readVarInt(buf, payloadSize, offset));
+		command.positionY = static_cast<int16>(readVarInt(buf, payloadSize, offset));
+		command.targetId = readVarInt(buf, payloadSize, offset);
+		command.wantQueue = static_cast<int8>(readVarInt(buf, payloadSize, offset));
+		command.fromFactionIndex = static_cast<int8>(readVarInt(buf, payloadSize, offset));
+		command.unitFactionUnitCount = static_cast<uint16>(readVarUInt(buf, payloadSize, offset));
+		command.unitFactionIndex = static_cast<int8>(readVarInt(buf, payloadSize, offset));
+		command.commandStateType = static_cast<int8>(readVarInt(buf, payloadSize, offset));
+		command.commandStateValue = readVarInt(buf, payloadSize, offset);
+		command.unitCommandGroupId = readVarInt(buf, payloadSize, offset);
+
+		for(uint32 i = 0; i < unitCount; ++i) {
+			command.unitId = static_cast<int32>(static_cast<uint32>(lastUnitId) + static_cast<uint32>(readVarInt(buf, payloadSize, offset)));
+			lastUnitId = command.unitId;
+			data.commands.push_back(command);
+		}
+	}
+	if(offset != payloadSize) {
+		throw megaglest_runtime_error("Invalid compact command list, unread bytes = " + uIntToStr(payloadSize - offset));
+	}
+
+	if(SystemFlags::getSystemSettingType(SystemFlags::debugNetwork).enabled == true) {
+		for(int idx = 0 ; idx < data.header.commandCount; ++idx) {
+			SystemFlags::OutputDebug(SystemFlags::debugNetwork,"In [%s::%s Line: %d] index = %d, received compact networkCommand [%s]\n",
+					extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,idx, data.commands[idx].toString().c_str());
+		}
+	}
+	return true;
+}
+
+void NetworkMessageCommandList::sendCompact(Socket* socket) {
+	uint16 totalCommand = data.header.commandCount;
+
+	vector<unsigned char> payload;
+	payload.reserve(16 + totalCommand * 4);
+	writeVarInt(payload, data.header.frameCount);
+	writeVarUInt(payload, totalCommand);
+
+	// unit ids are sent as the difference to the previous one in the frame
+	int32 lastUnitId = 0;
+	for(unsigned int i = 0; i < totalCommand;) {
+		const NetworkCommand &command = data.commands[i];
+		unsigned int groupEnd = i + 1;
+		while(groupEnd < totalCommand && isSameCommandForOtherUnit(command, data.commands[groupEnd]) == true) {
+			groupEnd++;
+		}
+
+		writeVarUInt(payload, groupEnd - i);
+		writeVarInt(payload, command.networkCommandType);
+		writeVarInt(payload, command.unitTypeId);
+		writeVarInt(payload, command.commandTypeId);
+		writeVarInt(payload, command.positionX);
+		writeVarInt(payload, command.positionY);
+		writeVarInt(payload, command.targetId);
+		writeVarInt(payload, command.wantQueue);
+		writeVarInt(payload, command.fromFactionIndex);
+		writeVarUInt(payload, command.unitFactionUnitCount);
+		writeVarInt(payload, command.unitFactionIndex);
+		writeVarInt(payload, command.commandStateType);
+		writeVarInt(payload, command.commandStateValue);
+		writeVarInt(payload, command.unitCommandGroupId);
+
+		for(unsigned int j = i; j < groupEnd; ++j) {
+			writeVarInt(payload, static_cast<int32>(static_cast<uint32>(data.commands[j].unitId) - static_cast<uint32>(lastUnitId)));
+			lastUnitId = data.commands[j].unitId;
+		}
+		i = groupEnd;
+	}
+
+	vector<unsigned char> buf;
+	buf.reserve(payload.size() + 6);
+	buf.push_back(static_cast<unsigned char>(nmtCommandListCompact));
+	writeVarUInt(buf, static_cast<uint32>(payload.size()));
+	buf.insert(buf.end(), payload.begin(), payload.end());
+
+	if(SystemFlags::getSystemSettingType(SystemFlags::debugNetwork).enabled) SystemFlags::OutputDebug(SystemFlags::debugNetwork,"In [%s::%s Line: %d] nmtCommandListCompact, frameCount = %d, commandCount = %d, size = %d\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,data.header.frameCount,totalCommand,(int)buf.size());
+
+	NetworkMessage::send(socket, &buf[0], (int)buf.size());
+}
+
 void NetworkMessageCommandList::toEndianHeader() {
 	static bool bigEndianSystem = Shared::PlatformByteOrder::isBigEndian();
 	if(bigEndianSystem == true) {
@@ -1526,11 +1760,12 @@ bool NetworkMessageText::receive(Socket* socket) {
 		result = NetworkMessage::receive(socket, &data, sizeof(data), true);
 	}
 	else {
-		unsigned char *buf = new unsigned char[getPackedSize()+1];
-		result = NetworkMessage::receive(socket, buf, getPackedSize(), true);
-		unpackMessage(buf);
+		unsigned char *buf = receivePacked(socket, getPackedSize());
+		result = (buf != NULL);
+		if(result == true) {
+			unpackMessage(buf);
+		}
 		//printf("Got packet size = %u data.messageType = %d\n%s\n",getPackedSize(),data.messageType,buf);
-		delete [] buf;
 	}
 	fromEndian();
 
@@ -1617,11 +1852,12 @@ bool NetworkMessageQuit::receive(Socket* socket) {
 	}
 	else {
 		//fromEndian();
-		unsigned char *buf = new unsigned char[getPackedSize()+1];
-		result = NetworkMessage::receive(socket, buf, getPackedSize(), true);
-		unpackMessage(buf);
+		unsigned char *buf = receivePacked(socket, getPackedSize());
+		result = (buf != NULL);
+		if(result == true) {
+			unpackMessage(buf);
+		}
 		//printf("Got packet size = %u data.messageType = %d\n%s\n",getPackedSize(),data.messageType,buf);
-		delete [] buf;
 	}
 	fromEndian();
 
@@ -2250,11 +2486,12 @@ bool NetworkMessageSynchNetworkGameDataFileCRCCheck::receive(Socket* socket) {
 		result = NetworkMessage::receive(socket, &data, sizeof(data),true);
 	}
 	else {
-		unsigned char *buf = new unsigned char[getPackedSize()+1];
-		result = NetworkMessage::receive(socket, buf, getPackedSize(), true);
-		unpackMessage(buf);
+		unsigned char *buf = receivePacked(socket, getPackedSize());
+		result = (buf != NULL);
+		if(result == true) {
+			unpackMessage(buf);
+		}
 		//printf("Got packet size = %u data.messageType = %d\n%s\n",getPackedSize(),data.messageType,buf);
-		delete [] buf;
 	}
 	fromEndian();
 	data.fileName.nullTerminate();
@@ -2343,11 +2580,12 @@ bool NetworkMessageSynchNetworkGameDataFileGet::receive(Socket* socket) {
 		result = NetworkMessage::receive(socket, &data, sizeof(data),true);
 	}
 	else {
-		unsigned char *buf = new unsigned char[getPackedSize()+1];
-		result = NetworkMessage::receive(socket, buf, getPackedSize(), true);
-		unpackMessage(buf);
+		unsigned char *buf = receivePacked(socket, getPackedSize());
+		result = (buf != NULL);
+		if(result == true) {
+			unpackMessage(buf);
+		}
 		//printf("Got packet size = %u data.messageType = %d\n%s\n",getPackedSize(),data.messageType,buf);
-		delete [] buf;
 	}
 	fromEndian();
 	data.fileName.nullTerminate();
@@ -2474,11 +2712,12 @@ bool SwitchSetupRequest::receive(Socket* socket) {
 	}
 	else {
 		//fromEndian();
-		unsigned char *buf = new unsigned char[getPackedSize()+1];
-		result = NetworkMessage::receive(socket, buf, getPackedSize(), true);
-		unpackMessage(buf);
+		unsigned char *buf = receivePacked(socket, getPackedSize());
+		result = (buf != NULL);
+		if(result == true) {
+			unpackMessage(buf);
+		}
 		//printf("Got packet size = %u data.messageType = %d\n%s\nTeam = %d faction [%s] currentFactionIndex = %d toFactionIndex = %d\n",getPackedSize(),data.messageType,buf,data.toTeam,data.selectedFactionName.getBuffer(),data.currentFactionIndex,data.toFactionIndex);
-		delete [] buf;
 	}
 	fromEndian();
 
@@ -2578,11 +2817,12 @@ bool PlayerIndexMessage::receive(Socket* socket) {
 	}
 	else {
 		//fromEndian();
-		unsigned char *buf = new unsigned char[getPackedSize()+1];
-		result = NetworkMessage::receive(socket, buf, getPackedSize(), true);
-		unpackMessage(buf);
+		unsigned char *buf = receivePacked(socket, getPackedSize());
+		result = (buf != NULL);
+		if(result == true) {
+			unpackMessage(buf);
+		}
 		//printf("Got packet size = %u data.messageType = %d\n%s\n",getPackedSize(),data.messageType,buf);
-		delete [] buf;
 	}
 	fromEndian();
 
@@ -2668,11 +2908,12 @@ bool NetworkMessageLoadingStatus::receive(Socket* socket) {
 	}
 	else {
 		//fromEndian();
-		unsigned char *buf = new unsigned char[getPackedSize()+1];
-		result = NetworkMessage::receive(socket, buf, getPackedSize(), true);
-		unpackMessage(buf);
+		unsigned char *buf = receivePacked(socket, getPackedSize());
+		result = (buf != NULL);
+		if(result == true) {
+			unpackMessage(buf);
+		}
 		//printf("Got packet size = %u data.messageType = %d\n%s\n",getPackedSize(),data.messageType,buf);
-		delete [] buf;
 	}
 	fromEndian();
 
@@ -2782,11 +3023,12 @@ bool NetworkMessageMarkCell::receive(Socket* socket){
 		result = NetworkMessage::receive(socket, &data, sizeof(data), true);
 	}
 	else {
-		unsigned char *buf = new unsigned char[getPackedSize()+1];
-		result = NetworkMessage::receive(socket, buf, getPackedSize(), true);
-		unpackMessage(buf);
+		unsigned char *buf = receivePacked(socket, getPackedSize());
+		result = (buf != NULL);
+		if(result == true) {
+			unpackMessage(buf);
+		}
 		//printf("Got packet size = %u data.messageType = %d\n%s\n",getPackedSize(),data.messageType,buf);
-		delete [] buf;
 	}
 	fromEndian();
 
@@ -2897,11 +3139,12 @@ bool NetworkMessageUnMarkCell::receive(Socket* socket){
 		result = NetworkMessage::receive(socket, &data, sizeof(data), true);
 	}
 	else {
-		unsigned char *buf = new unsigned char[getPackedSize()+1];
-		result = NetworkMessage::receive(socket, buf, getPackedSize(), true);
-		unpackMessage(buf);
+		unsigned char *buf = receivePacked(socket, getPackedSize());
+		result = (buf != NULL);
+		if(result == true) {
+			unpackMessage(buf);
+		}
 		//printf("Got packet size = %u data.messageType = %d\n%s\n",getPackedSize(),data.messageType,buf);
-		delete [] buf;
 	}
 	fromEndian();
 
@@ -3004,11 +3247,12 @@ bool NetworkMessageHighlightCell::receive(Socket* socket) {
 		result = NetworkMessage::receive(socket, &data, sizeof(data), true);
 	}
 	else {
-		unsigned char *buf = new unsigned char[getPackedSize()+1];
-		result = NetworkMessage::receive(socket, buf, getPackedSize(), true);
-		unpackMessage(buf);
+		unsigned char *buf = receivePacked(socket, getPackedSize());
+		result = (buf != NULL);
+		if(result == true) {
+			unpackMessage(buf);
+		}
 		//printf("Got packet size = %u data.messageType = %d\n%s\n",getPackedSize(),data.messageType,buf);
-		delete [] buf;
 	}
 	fromEndian();
 	return result;
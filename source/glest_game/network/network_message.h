@@ -47,10 +47,19 @@ enum NetworkMessageType {
 	nmtMarkCell,
 	nmtUnMarkCell,
 	nmtHighlightCell,
+	nmtCommandListCompact,
 
 	nmtCount
 };
 
+// Protocol features a peer announces in its NetworkMessageIntro
+enum NetworkProtocolVersion {
+	nmpvBase,
+	nmpvCompactCommandList,
+
+	nmpvCount
+};
+
 enum NetworkGameStateType {
 	nmgstInvalid,
 	nmgstOk,
@@ -75,9 +84,13 @@ public:
 
 	void dump_packet(string label, const void* data, int dataSize);
 
+	static int8 getLocalProtocolVersion();
+
 protected:
 	//bool peek(Socket* socket, void* data, int dataSize);
 	bool receive(Socket* socket, void* data, int dataSize,bool tryReceiveUntilDataSizeMet);
+	// packed data read straight from the socket receive buffer, NULL on failure
+	unsigned char * receivePacked(Socket* socket, int dataSize);
 	void send(Socket* socket, const void* data, int dataSize);
 
 	virtual const char * getPackedMessageFormat() const = 0;
@@ -145,6 +158,7 @@ public:
 	uint32 getFtpPort() const					{ return data.ftpPort; }
 	string getPlayerLanguage() const			{ return data.language.getString(); }
 	uint8 getGameInProgress() const				{ return data.gameInProgress; }
+	int8 getProtocolVersion() const;
 
 	virtual bool receive(Socket* socket);
 	virtual void send(Socket* socket);
@@ -372,6 +386,8 @@ protected:
 	void unpackMessageDetail(unsigned char *buf,int count);
 	unsigned char * packMessageDetail(uint16 totalCommand);
 
+	bool receiveCompact(Socket* socket);
+
 public:
 	NetworkMessageCommandList(int32 frameCount= -1);
 
@@ -386,6 +402,9 @@ public:
 
 	virtual bool receive(Socket* socket);
 	virtual void send(Socket* socket);
+	// varint encoding with consecutive orders for several units sent once,
+	// only for peers announcing nmpvCompactCommandList
+	void sendCompact(Socket* socket);
 };
 #pragma pack(pop)
 
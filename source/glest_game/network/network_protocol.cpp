@@ -579,6 +579,16 @@ unsigned int unpack(unsigned char *buf, const char *format, ...) {
 	return size;
 }
 
+// the last byte is cut by the string packing, the one before it is still sent
+void setIntroProtocolVersion(char *language, int languageSize, signed char version) {
+	language[languageSize - 3] = '\0';
+	language[languageSize - 2] = version;
+}
+
+signed char getIntroProtocolVersion(const char *language, int languageSize) {
+	return language[languageSize - 2];
+}
+
 #pragma pack(pop)
 
 }}
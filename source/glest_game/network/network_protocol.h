@@ -17,6 +17,12 @@ namespace Glest{ namespace Game{
 unsigned int pack(unsigned char *buf, const char *format, ...);
 unsigned int unpack(unsigned char *buf, const char *format, ...);
 
+// The intro message keeps the layout of older releases. The protocol version
+// of a peer travels in the spare end of its language string, which older
+// peers leave zeroed and never read past the terminator.
+void setIntroProtocolVersion(char *language, int languageSize, signed char version);
+signed char getIntroProtocolVersion(const char *language, int languageSize);
+
 }};
 
 #endif /* NETWORK_PROTOCOL_H_ */
@@ -62,6 +62,7 @@ public:
 	}
 
 	char *getBuffer() { return &buffer[0]; }
+	const char *getBuffer() const { return &buffer[0]; }
 	string getString() const { return (buffer[0] != '\0' ? buffer : ""); }
 };
 #pragma pack(pop)
@@ -28,6 +28,7 @@
 #include <iostream>
 #include "map_preview.h"
 #include <iterator>
+#include "game_trace.h"
 #include "leak_dumper.h"
 
 using namespace std;
@@ -68,6 +69,9 @@ ServerInterface::ServerInterface(bool publishEnabled) :GameNetworkInterface() {
 	nextEventId 					= 1;
 	gameHasBeenInitiated 			= false;
 	exitServer 						= false;
+	// Off by default: the inline path still runs ConnectionSlot::update, whose
+	// blocking receives would serialize every slot on the server thread
+	networkReactor 					= Config::getInstance().getBool("EnableNetworkReactor","false");
 	gameSettingsUpdateCount 		= 0;
 	currentFrameCount 				= 0;
 	gameStartTime 					= 0;
@@ -794,6 +798,23 @@ void ServerInterface::updateSocketTriggeredList(std::map<PLATFORM_SOCKET,bool> &
 	}
 }
 
+// Messages already read into a slot's receive buffer do not make its socket readable
+bool ServerInterface::triggerSocketsWithBufferedData(std::map<PLATFORM_SOCKET,bool> & socketTriggeredList) {
+	bool result = false;
+	for(int i= 0; exitServer == false && i < GameConstants::maxPlayers; ++i) {
+		MutexSafeWrapper safeMutexSlot(slotAccessorMutexes[i],CODE_AT_LINE_X(i));
+		ConnectionSlot* connectionSlot= slots[i];
+		if(connectionSlot != NULL) {
+			Socket *socket = connectionSlot->getSocket();
+			if(socket != NULL && socket->getReceiveBufferedSize() > 0) {
+				socketTriggeredList[socket->getSocketId()] = true;
+				result = true;
+			}
+		}
+	}
+	return result;
+}
+
 void ServerInterface::validateConnectedClients() {
 	for(int i= 0; exitServer == false && i < GameConstants::maxPlayers; ++i) {
 		MutexSafeWrapper safeMutexSlot(slotAccessorMutexes[i],CODE_AT_LINE_X(i));
@@ -814,10 +835,21 @@ bool ServerInterface::signalClientReceiveCommands(ConnectionSlot *connectionSlot
 	event.socketTriggered 	= socketTriggered;
 	event.triggerId 		= slotIndex;
 	event.eventId 			= getNextEventId();
+	event.eventCompleted 	= false;
 
 	if(connectionSlot != NULL) {
 		if(socketTriggered == true || connectionSlot->isConnected() == false) {
-			connectionSlot->signalUpdate(&event);
+			// Only read inline from connected slots the poller found readable.
+			// Accepting a new client stays on the slot thread, which may be
+			// updating that slot at the same time.
+			if(networkReactor == true && socketTriggered == true &&
+				connectionSlot->isConnected() == true) {
+				connectionSlot->updateSlot(&event);
+				event.eventCompleted = true;
+			}
+			else {
+				connectionSlot->signalUpdate(&event);
+			}
 			slotSignalled = true;
 		}
 	}
@@ -1328,6 +1360,7 @@ void ServerInterface::dispatchPendingUnMarkCellMessages(std::vector <string> &er
 }
 
 void ServerInterface::update() {
+	TRACE_SCOPE(tevServerUpdate);
 	bool miniDebugPerf = false;
 	Chrono chrono;
 	if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled || miniDebugPerf) chrono.start();
@@ -1370,7 +1403,10 @@ void ServerInterface::update() {
 			//printf("START Server update #1\n");
 
 			std::map<int,ConnectionSlotEvent> eventList;
-			bool hasData = Socket::hasDataToRead(socketTriggeredList);
+			bool hasData = socketPoller.hasDataToRead(socketTriggeredList);
+			if(triggerSocketsWithBufferedData(socketTriggeredList) == true) {
+				hasData = true;
+			}
 
 			//if(this->getGameHasBeenInitiated() == true &&
 			//   this->getAllowInGameConnections() == true) {
@@ -93,6 +93,11 @@ private:
 
 	ServerSocket *serverSocketAdmin;
 	MasterSlaveThreadController masterController;
+	// client sockets stay registered between updates
+	SocketPoller socketPoller;
+	// received data is handled on the server update thread, only for testing
+	// until slots receive without blocking
+	bool networkReactor;
 
 	bool gameHasBeenInitiated;
 	int gameSettingsUpdateCount;
@@ -184,6 +189,7 @@ public:
     std::pair<bool,bool> clientLagCheck(ConnectionSlot *connectionSlot, bool skipNetworkBroadCast = false);
     bool signalClientReceiveCommands(ConnectionSlot *connectionSlot, int slotIndex, bool socketTriggered, ConnectionSlotEvent & event);
     void updateSocketTriggeredList(std::map<PLATFORM_SOCKET,bool> & socketTriggeredList);
+    bool triggerSocketsWithBufferedData(std::map<PLATFORM_SOCKET,bool> & socketTriggeredList);
     bool isPortBound() const {
         return serverSocket.isPortBound();
     }
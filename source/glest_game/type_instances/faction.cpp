@@ -23,6 +23,7 @@
 #include "game.h"
 #include "config.h"
 #include "randomgen.h"
+#include "game_trace.h"
 #include "leak_dumper.h"
 
 using namespace Shared::Util;
@@ -53,6 +54,11 @@ bool CommandGroupUnitSorterId::operator()(const int l, const int r) {
 	return sorter.compare(lUnit, rUnit);
 }
 
+// Most units first
+bool FactionUnitCountSorter::operator()(Faction *l, Faction *r) {
+	return l->getUnitCount() > r->getUnitCount();
+}
+
 bool CommandGroupUnitSorter::operator()(const Unit *l, const Unit *r) {
 	return compare(l, r);
 }
@@ -292,9 +298,6 @@ void FactionThread::execute() {
 		if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d]\n",__FILE__,__FUNCTION__,__LINE__);
 		if(SystemFlags::VERBOSE_MODE_ENABLED) printf("In [%s::%s Line: %d] ****************** STARTING worker thread this = %p\n",__FILE__,__FUNCTION__,__LINE__,this);
 
-		bool minorDebugPerformance = false;
-		Chrono chrono;
-
 		//unsigned int idx = 0;
 		for(;this->faction != NULL;) {
 			if(getQuitStatus() == true) {
@@ -332,63 +335,8 @@ void FactionThread::execute() {
 				if(this->faction == NULL) {
 					throw megaglest_runtime_error("this->faction == NULL");
 				}
-				World *world = this->faction->getWorld();
-				if(world == NULL) {
-					throw megaglest_runtime_error("world == NULL");
-				}
-
-				//Config &config= Config::getInstance();
-				//bool sortedUnitsAllowed = config.getBool("AllowGroupedUnitCommands","true");
-				bool sortedUnitsAllowed = false;
-				if(sortedUnitsAllowed == true) {
-					this->faction->sortUnitsByCommandGroups();
-				}
-
-				static string mutexOwnerId2 = string(__FILE__) + string("_") + intToStr(__LINE__);
-				MutexSafeWrapper safeMutex(faction->getUnitMutex(),mutexOwnerId2);
-
-				//if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled) chrono.start();
-				if(minorDebugPerformance) chrono.start();
-
-				//printf("In [%s::%s Line: %d]\n",__FILE__,__FUNCTION__,__LINE__);
-
-				int unitCount = this->faction->getUnitCount();
-				for(int j = 0; j < unitCount; ++j) {
-					Unit *unit = this->faction->getUnit(j);
-					if(unit == NULL) {
-						throw megaglest_runtime_error("unit == NULL");
-					}
-
-					int64 elapsed1 = 0;
-					if(minorDebugPerformance) elapsed1 = chrono.getMillis();
-
-					bool update = unit->needToUpdate();
-
-					if(minorDebugPerformance && (chrono.getMillis() - elapsed1) >= 1) printf("Faction [%d - %s] #1-unit threaded updates on frame: %d for [%d] unit # %d, unitCount = %d, took [%lld] msecs\n",faction->getStartLocationIndex(),faction->getType()->getName().c_str(),currentTriggeredFrameIndex,faction->getUnitPathfindingListCount(),j,unitCount,(long long int)chrono.getMillis() - elapsed1);
-
-					//update = true;
-					if(update == true) {
-
-						int64 elapsed2 = 0;
-						if(minorDebugPerformance) elapsed2 = chrono.getMillis();
-
-						if(world->getUnitUpdater() == NULL) {
-							throw megaglest_runtime_error("world->getUnitUpdater() == NULL");
-						}
-
-						world->getUnitUpdater()->updateUnitCommand(unit,currentTriggeredFrameIndex);
-
-						if(minorDebugPerformance && (chrono.getMillis() - elapsed2) >= 1) printf("Faction [%d - %s] #2-unit threaded updates on frame: %d for [%d] unit # %d, unitCount = %d, took [%lld] msecs\n",faction->getStartLocationIndex(),faction->getType()->getName().c_str(),currentTriggeredFrameIndex,faction->getUnitPathfindingListCount(),j,unitCount,(long long int)chrono.getMillis() - elapsed2);
-					}
-				}
-
-				if(minorDebugPerformance && chrono.getMillis() >= 1) printf("Faction [%d - %s] threaded updates on frame: %d for [%d] units took [%lld] msecs\n",faction->getStartLocationIndex(),faction->getType()->getName().c_str(),currentTriggeredFrameIndex,faction->getUnitPathfindingListCount(),(long long int)chrono.getMillis());
-
-				//printf("In [%s::%s Line: %d]\n",__FILE__,__FUNCTION__,__LINE__);
-
-				safeMutex.ReleaseLock();
 
-				//printf("In [%s::%s Line: %d]\n",__FILE__,__FUNCTION__,__LINE__);
+				this->faction->preprocessUnitCommands(currentTriggeredFrameIndex);
 
 				setTaskCompleted(currentTriggeredFrameIndex);
 
@@ -425,6 +373,33 @@ void FactionThread::execute() {
 }
 
 
+// =====================================================
+//	class FactionPreprocessJob
+// =====================================================
+
+FactionPreprocessJob::FactionPreprocessJob(Faction *faction, int frameIndex) {
+	this->faction = faction;
+	this->frameIndex = frameIndex;
+}
+
+void FactionPreprocessJob::runJob() {
+	TRACE_SCOPE_ARGS(tevFactionPreprocess,faction->getIndex(),faction->getUnitCount());
+	faction->preprocessUnitCommands(frameIndex);
+}
+
+// =====================================================
+//	class UnitChunkPreprocessJob
+// =====================================================
+
+UnitChunkPreprocessJob::UnitChunkPreprocessJob(Faction *faction, int frameIndex, const std::vector<Unit *> &units) :
+	FactionPreprocessJob(faction, frameIndex), units(units) {
+}
+
+void UnitChunkPreprocessJob::runJob() {
+	TRACE_SCOPE_ARGS(tevFactionPreprocess,faction->getIndex(),(int)units.size());
+	faction->preprocessUnitCommands(frameIndex, units);
+}
+
 // =====================================================
 // 	class Faction
 // =====================================================
@@ -557,10 +532,15 @@ void Faction::clearUnitsPathfinding() {
 	}
 }
 
+// AI factions only start a few searches per frame
+bool Faction::isUnitPathfindingLimited() const {
+	return (control == ctCpuEasy  || control == ctCpu ||
+			control == ctCpuUltra || control == ctCpuMega);
+}
+
 bool Faction::canUnitsPathfind() {
 	bool result = true;
-	if(control == ctCpuEasy  || control == ctCpu ||
-	   control == ctCpuUltra || control == ctCpuMega) {
+	if(isUnitPathfindingLimited() == true) {
 		//printf("AI player for faction index: %d (%s) current pathfinding: %d\n",index,factionType->getName().c_str(),getUnitPathfindingListCount());
 
 		const int MAX_UNITS_PATHFINDING_PER_FRAME = 10;
@@ -586,6 +566,80 @@ bool Faction::isWorkerThreadSignalCompleted(int frameIndex) {
 }
 
 
+// Threaded pre-processing of unit commands (pathfinding) for one frame,
+// called by the faction worker thread or a job of the world's job system
+void Faction::preprocessUnitCommands(int frameIndex) {
+	if(world == NULL) {
+		throw megaglest_runtime_error("world == NULL");
+	}
+
+	//Config &config= Config::getInstance();
+	//bool sortedUnitsAllowed = config.getBool("AllowGroupedUnitCommands","true");
+	bool sortedUnitsAllowed = false;
+	if(sortedUnitsAllowed == true) {
+		sortUnitsByCommandGroups();
+	}
+
+	bool minorDebugPerformance = false;
+	Chrono chrono;
+
+	static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
+	MutexSafeWrapper safeMutex(getUnitMutex(),mutexOwnerId);
+
+	if(minorDebugPerformance) chrono.start();
+
+	int unitCount = getUnitCount();
+	for(int j = 0; j < unitCount; ++j) {
+		Unit *unit = getUnit(j);
+		if(unit == NULL) {
+			throw megaglest_runtime_error("unit == NULL");
+		}
+
+		int64 elapsed1 = 0;
+		if(minorDebugPerformance) elapsed1 = chrono.getMillis();
+
+		bool update = unit->needToUpdate();
+
+		if(minorDebugPerformance && (chrono.getMillis() - elapsed1) >= 1) printf("Faction [%d - %s] #1-unit threaded updates on frame: %d for [%d] unit # %d, unitCount = %d, took [%lld] msecs\n",getStartLocationIndex(),getType()->getName().c_str(),frameIndex,getUnitPathfindingListCount(),j,unitCount,(long long int)chrono.getMillis() - elapsed1);
+
+		if(update == true) {
+			int64 elapsed2 = 0;
+			if(minorDebugPerformance) elapsed2 = chrono.getMillis();
+
+			if(world->getUnitUpdater() == NULL) {
+				throw megaglest_runtime_error("world->getUnitUpdater() == NULL");
+			}
+
+			world->getUnitUpdater()->updateUnitCommand(unit,frameIndex);
+
+			if(minorDebugPerformance && (chrono.getMillis() - elapsed2) >= 1) printf("Faction [%d - %s] #2-unit threaded updates on frame: %d for [%d] unit # %d, unitCount = %d, took [%lld] msecs\n",getStartLocationIndex(),getType()->getName().c_str(),frameIndex,getUnitPathfindingListCount(),j,unitCount,(long long int)chrono.getMillis() - elapsed2);
+		}
+	}
+
+	if(minorDebugPerformance && chrono.getMillis() >= 1) printf("Faction [%d - %s] threaded updates on frame: %d for [%d] units took [%lld] msecs\n",getStartLocationIndex(),getType()->getName().c_str(),frameIndex,getUnitPathfindingListCount(),(long long int)chrono.getMillis());
+
+	safeMutex.ReleaseLock();
+}
+
+// Pre-processing of one slice of this faction's units. The world holds the
+// unit list still until every slice is done, so no lock is taken here and
+// the slices of one faction run side by side.
+void Faction::preprocessUnitCommands(int frameIndex, const std::vector<Unit *> &units) {
+	if(world == NULL) {
+		throw megaglest_runtime_error("world == NULL");
+	}
+	if(world->getUnitUpdater() == NULL) {
+		throw megaglest_runtime_error("world->getUnitUpdater() == NULL");
+	}
+
+	for(unsigned int i = 0; i < units.size(); ++i) {
+		Unit *unit = units[i];
+		if(unit->needToUpdate() == true) {
+			world->getUnitUpdater()->updateUnitCommand(unit,frameIndex);
+		}
+	}
+}
+
 void Faction::init(
 	FactionType *factionType, ControlType control, TechTree *techTree, Game *game,
 	int factionIndex, int teamIndex, int startLocationIndex, bool thisFaction, bool giveResources,
@@ -628,8 +682,10 @@ void Faction::init(
 		loadGame(loadWorldNode, this->index,game->getGameSettings(),game->getWorld());
 	}
 
+	// Without the master / slave thread manager the world's job system does the work
 	if( game->getGameSettings()->getPathFinderType() == pfBasic &&
-		Config::getInstance().getBool("EnableFactionWorkerThreads","true") == true) {
+		Config::getInstance().getBool("EnableFactionWorkerThreads","true") == true &&
+		Config::getInstance().getBool("EnableNewThreadManager","false") == true) {
 		if(workerThread != NULL) {
 			workerThread->signalQuit();
 			if(workerThread->shutdownAndWait() == true) {
@@ -1845,7 +1901,7 @@ bool Faction::canCreateUnit(const UnitType *ut, bool checkBuild, bool checkProdu
 void Faction::clearCaches() {
 	cacheResourceTargetList.clear();
 	cachedCloseResourceTargetLookupList.clear();
-	mapSharedPathFinderCache.clear();
+	aproxCellStateCache.endFrame();
 
 	unsigned int unitCount = this->getUnitCount();
 	for(unsigned int i = 0; i < unitCount; ++i) {
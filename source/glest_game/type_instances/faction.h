@@ -25,6 +25,7 @@
 #include "game_constants.h"
 #include "command_type.h"
 #include "base_thread.h"
+#include "job_system.h"
 #include <set>
 #include "faction_type.h"
 #include "leak_dumper.h"
@@ -76,6 +77,10 @@ struct CommandGroupUnitSorterId {
 	bool operator()(const int l, const int r);
 };
 
+struct FactionUnitCountSorter {
+	bool operator()(Faction *l, Faction *r);
+};
+
 class FactionThread : public BaseThread, public SlaveThreadControllerInterface {
 protected:
 
@@ -101,6 +106,39 @@ public:
     bool isSignalPathfinderCompleted(int frameIndex);
 };
 
+// =====================================================
+//	class FactionPreprocessJob
+//
+///	The threaded unit command pre-processing of one
+///	faction, run by the world's job system
+// =====================================================
+
+class FactionPreprocessJob : public Job {
+protected:
+	Faction *faction;
+	int frameIndex;
+
+public:
+	FactionPreprocessJob(Faction *faction, int frameIndex);
+	virtual void runJob();
+};
+
+// =====================================================
+//	class UnitChunkPreprocessJob
+//
+///	The same pre-processing for a fixed-size slice of a
+///	large faction, so one army is spread over the workers
+// =====================================================
+
+class UnitChunkPreprocessJob : public FactionPreprocessJob {
+protected:
+	std::vector<Unit *> units;
+
+public:
+	UnitChunkPreprocessJob(Faction *faction, int frameIndex, const std::vector<Unit *> &units);
+	virtual void runJob();
+};
+
 class SwitchTeamVote {
 public:
 
@@ -111,6 +149,70 @@ public:
 	bool allowSwitchTeam;
 };
 
+// =====================================================
+//	class AproxCellStateCache
+//
+///	Team view of each cell as seen by Map::aproxCanMoveSoon,
+///	valid for one frame of unit command pre-processing
+// =====================================================
+
+class AproxCellStateCache {
+public:
+	enum CellState {
+		csUnknown,
+		csFree,
+		csBlocked,
+		// free for units more than a few cells away
+		csMobileUnit
+	};
+
+private:
+	static const int stateBits = 2;
+	static const uint32 stateMask = (1 << stateBits) - 1;
+	static const uint32 maxGeneration = (0xFFFFFFFF >> stateBits);
+
+	int cellCount;
+	uint32 generation;
+	bool enabled;
+	// generation and state of a cell in one word, the unit chunks of a
+	// faction fill cells from several threads and always store the same
+	// state, so a reader sees either the old or the new word but never a
+	// stamp without its state
+	vector<uint32> cells;
+
+public:
+	AproxCellStateCache() {
+		cellCount = 0;
+		generation = 0;
+		enabled = false;
+	}
+
+	// only call while no unit can move, a new generation invalidates every cell
+	void beginFrame(int cellCount) {
+		if(this->cellCount != cellCount) {
+			this->cellCount = cellCount;
+			cells.assign(cellCount * fieldCount, 0);
+			generation = 0;
+		}
+		generation++;
+		if(generation > maxGeneration) {
+			cells.assign(cells.size(), 0);
+			generation = 1;
+		}
+		enabled = true;
+	}
+	void endFrame() { enabled = false; }
+	inline bool isEnabled() const { return enabled; }
+
+	inline CellState getState(Field field, int cellIndex) const {
+		uint32 cell = cells[field * cellCount + cellIndex];
+		return ((cell >> stateBits) == generation ? (CellState)(cell & stateMask) : csUnknown);
+	}
+	inline void setState(Field field, int cellIndex, CellState state) {
+		cells[field * cellCount + cellIndex] = (generation << stateBits) | (uint32)state;
+	}
+};
+
 class Faction {
 private:
     typedef vector<Resource> Resources;
@@ -165,7 +267,7 @@ private:
 	TechTree *techTree;
 	const XmlNode *loadWorldNode;
 
-	std::map<int,std::map<Field, std::map<Vec2i,bool> > > mapSharedPathFinderCache;
+	AproxCellStateCache aproxCellStateCache;
 
 public:
 	Faction();
@@ -180,26 +282,7 @@ public:
 		throw megaglest_runtime_error("class Faction is NOT safe to assign!");
 	}
 
-	inline const bool * aproxCanMoveSoonCached(int size, Field field, const Vec2i &pos1, const Vec2i &pos2) const {
-		const bool *result = NULL;
-//		std::map<int,std::map<Field, std::map<Vec2i,bool> > >::const_iterator iterFind1 = mapSharedPathFinderCache.find(size);
-//		if(iterFind1 != mapSharedPathFinderCache.end()) {
-//			std::map<Field, std::map<Vec2i,bool> >::const_iterator iterFind2 = iterFind1->second.find(field);
-//			if(iterFind2 != iterFind1->second.end()) {
-//				std::map<Vec2i,bool>::const_iterator iterFind3 = iterFind2->second.find(pos2);
-//				if(iterFind3 != iterFind2->second.end()) {
-//					result = &iterFind3->second;
-//				}
-//			}
-//		}
-		return result;
-	}
-	inline void addAproxCanMoveSoonCached(int size, Field field, const Vec2i &pos1, const Vec2i &pos2,bool result) {
-		//mapSharedPathFinderCache[size][field][pos2]=result;
-	}
-	inline void clearAproxCanMoveSoonCached() {
-		//mapSharedPathFinderCache.clear();
-	}
+	inline AproxCellStateCache * getAproxCellStateCache() { return &aproxCellStateCache; }
 
 	inline void addLivingUnits(int id) { livingUnits.insert(id); }
 	inline void addLivingUnitsp(Unit *unit) { livingUnitsp.insert(unit); }
@@ -218,6 +301,7 @@ public:
 	int getUnitPathfindingListCount();
 	void clearUnitsPathfinding();
 	bool canUnitsPathfind();
+	bool isUnitPathfindingLimited() const;
 
     void init(
 		FactionType *factionType, ControlType control, TechTree *techTree, Game *game,
@@ -328,6 +412,8 @@ public:
 
 	void signalWorkerThread(int frameIndex);
 	bool isWorkerThreadSignalCompleted(int frameIndex);
+	void preprocessUnitCommands(int frameIndex);
+	void preprocessUnitCommands(int frameIndex, const std::vector<Unit *> &units);
 	FactionThread *getWorkerThread() { return workerThread; }
 
 	void limitResourcesToStore();
@@ -137,7 +137,7 @@ void UnitPathBasic::addToLastPathCache(const Vec2i &path) {
 		}
 	}
 
-	const bool tryLastPathCache = Config::getInstance().getBool("EnablePathfinderCache","false");
+	const bool tryLastPathCache = Config::getCachedValues().enablePathfinderCache;
 	if(tryLastPathCache == true) {
 		lastPathCacheQueue.push_back(path);
 	}
@@ -1134,7 +1134,7 @@ void Unit::refreshPos() {
 }
 
 FowAlphaCellsLookupItem Unit::getFogOfWarRadius(bool useCache) const {
-	if(useCache == true && Config::getInstance().getBool("EnableFowCache","true") == true) {
+	if(useCache == true && Config::getCachedValues().enableFowCache == true) {
 		return cachedFow;
 	}
 
@@ -1169,7 +1169,7 @@ FowAlphaCellsLookupItem Unit::getFogOfWarRadius(bool useCache) const {
 
 void Unit::calculateFogOfWarRadius() {
 	if(game->getWorld()->getFogOfWar() == true) {
-		if(Config::getInstance().getBool("EnableFowCache","true") == true && this->pos != this->cachedFowPos) {
+		if(Config::getCachedValues().enableFowCache == true && this->pos != this->cachedFowPos) {
 			cachedFow = getFogOfWarRadius(false);
 
 			static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
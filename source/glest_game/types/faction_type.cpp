@@ -11,6 +11,7 @@
 
 #include "faction_type.h"
 
+#include <set>
 #include "logger.h"
 #include "util.h"
 #include "xml_parser.h"
@@ -19,13 +20,168 @@
 #include "platform_util.h"
 #include "game_util.h"
 #include "conversion.h"
+#include "job_system.h"
+#include "model.h"
+#include "pixmap.h"
+#include "texture.h"
 #include "leak_dumper.h"
 
 using namespace Shared::Util;
 using namespace Shared::Xml;
+using namespace Shared::Graphics;
+using namespace Shared::PlatformCommon;
 
 namespace Glest{ namespace Game{
 
+// ======================================================
+//          Class UnitTypePrefetchJob
+//
+//	Parses a unit xml and decodes the images, model
+//	meshes and textures and particle xml files it refers
+//	to on a loader thread. UnitType::loaddd still runs in
+//	order on the main thread and picks up what was
+//	prefetched, so checksums and registries are filled in
+//	the same order
+// ======================================================
+
+class UnitTypePrefetchJob : public Job {
+private:
+	string unitPath;
+	string unitName;
+	std::map<string,string> mapTagReplacementValues;
+	bool loadGraphics;
+	vector<string> preloadedMeshList;
+
+	void prefetchFile(const string &path, set<string> &prefetchedList) {
+		if(prefetchedList.insert(path).second == false || fileExists(path) == false) {
+			return;
+		}
+		string extension = toLower(extractExtension(path));
+		if(extension == "xml") {
+			XmlTree::preload(path, mapTagReplacementValues);
+		}
+		else if(loadGraphics == true && extension == "g3d") {
+			vector<pair<string,int> > textureList;
+			Model::getG3dTextureFileList(path, textureList, &preloadedMeshList);
+			for(unsigned int i = 0; i < textureList.size(); ++i) {
+				if(prefetchedList.insert(textureList[i].first).second == true) {
+					Pixmap2D::preload(textureList[i].first, textureList[i].second);
+				}
+			}
+		}
+		else if(loadGraphics == true &&
+				(extension == "png" || extension == "jpg" || extension == "tga" || extension == "bmp")) {
+			Pixmap2D::preload(path, Texture::defaultComponents);
+		}
+	}
+
+	void prefetchNode(const XmlNode *node, set<string> &prefetchedList) {
+		for(unsigned int i = 0; i < node->getAttributeCount(); ++i) {
+			const XmlAttribute *attribute = node->getAttribute(i);
+			if(attribute->getName() != "path") {
+				continue;
+			}
+			try {
+				prefetchFile(attribute->getRestrictedValue(unitPath), prefetchedList);
+			}
+			catch(const exception &ex) {
+				// the main thread reports bad entries when it loads the unit
+				if(SystemFlags::VERBOSE_MODE_ENABLED) printf("Skipped prefetch of [%s]: %s\n",attribute->getValue().c_str(),ex.what());
+			}
+		}
+		for(unsigned int i = 0; i < node->getChildCount(); ++i) {
+			prefetchNode(node->getChild(i), prefetchedList);
+		}
+	}
+
+public:
+	UnitTypePrefetchJob(const string &unitPath, const string &unitName,
+			const std::map<string,string> &mapTagReplacementValues) {
+		this->unitPath = unitPath;
+		endPathWithSlash(this->unitPath);
+		this->unitName = unitName;
+		this->mapTagReplacementValues = mapTagReplacementValues;
+		this->loadGraphics = (GlobalStaticFlags::getIsNonGraphicalModeEnabled() == false);
+	}
+
+	const vector<string> &getPreloadedMeshList() const { return preloadedMeshList; }
+
+	virtual void runJob() {
+		string path = unitPath + unitName + ".xml";
+		try {
+			XmlNode *rootNode = XmlIoRapid::getInstance().load(path, mapTagReplacementValues, false, true);
+			set<string> prefetchedList;
+			try {
+				prefetchNode(rootNode, prefetchedList);
+			}
+			catch(...) {
+				delete rootNode;
+				throw;
+			}
+			XmlTree::addPreloaded(path, mapTagReplacementValues, rootNode);
+		}
+		catch(const exception &ex) {
+			// prefetching is best effort, the main thread loads the file again
+			if(SystemFlags::VERBOSE_MODE_ENABLED) printf("Prefetch of unit [%s] failed: %s\n",path.c_str(),ex.what());
+		}
+	}
+};
+
+// ======================================================
+//          Class UnitTypePrefetcher
+//
+//	Owns the prefetch jobs of one faction's units, the
+//	jobs are always waited on before being deleted
+// ======================================================
+
+class UnitTypePrefetcher {
+private:
+	JobSystem *jobSystem;
+	vector<UnitTypePrefetchJob *> jobList;
+	vector<JobBarrier *> barrierList;
+	vector<bool> waitedList;
+
+public:
+	UnitTypePrefetcher(JobSystem *jobSystem) {
+		this->jobSystem = jobSystem;
+	}
+
+	~UnitTypePrefetcher() {
+		for(unsigned int i = 0; i < jobList.size(); ++i) {
+			waitFor(i);
+			// meshes the unit never attached to are freed here
+			Model::releasePreloadedMeshes(jobList[i]->getPreloadedMeshList());
+			delete jobList[i];
+			delete barrierList[i];
+		}
+	}
+
+	void add(const string &unitPath, const string &unitName,
+			const std::map<string,string> &mapTagReplacementValues) {
+		if(jobSystem == NULL) {
+			return;
+		}
+		UnitTypePrefetchJob *job = new UnitTypePrefetchJob(unitPath, unitName, mapTagReplacementValues);
+		JobBarrier *barrier = new JobBarrier();
+		barrier->reset(1);
+		jobList.push_back(job);
+		barrierList.push_back(barrier);
+		waitedList.push_back(false);
+		jobSystem->submit(job, barrier);
+	}
+
+	void waitFor(unsigned int index) {
+		if(index >= jobList.size() || waitedList[index] == true) {
+			return;
+		}
+		// keep the window responsive while a loader thread finishes the unit
+		for(;barrierList[index]->waitTillCompleted(10) == false;) {
+			SDL_PumpEvents();
+		}
+		waitedList[index] = true;
+	}
+};
+
 // ======================================================
 //          Class FactionType
 // ======================================================
@@ -156,12 +312,23 @@ void FactionType::load(const string &factionName, const TechTree *techTree, Chec
 			SDL_PumpEvents();
 		}
 
-		// b1) load units
+		// b1) load units, loader threads parse and decode ahead of the
+		// main thread which still loads them one by one in order
 		try {
+			std::map<string,string> mapExtraTagReplacementValues;
+			mapExtraTagReplacementValues["$COMMONDATAPATH"] = techTreePath + "/commondata/";
+			std::map<string,string> mapTagReplacementValues = Properties::getTagReplacementValues(&mapExtraTagReplacementValues);
+
+			UnitTypePrefetcher prefetcher(techTree->getLoaderJobSystem());
+			for(int i = 0; i < unitTypes.size(); ++i) {
+				prefetcher.add(currentPath + "units/" + unitTypes[i].getName(), unitTypes[i].getName(), mapTagReplacementValues);
+			}
+
 			Logger &logger= Logger::getInstance();
 			int progressBaseValue=logger.getProgress();
 			for(int i = 0; i < unitTypes.size(); ++i) {
 				string str= currentPath + "units/" + unitTypes[i].getName();
+				prefetcher.waitFor(i);
 				unitTypes[i].loaddd(i, str, techTree,techTreePath, this, checksum,techtreeChecksum,
 						loadedFileList);
 				logger.setProgress(progressBaseValue+(int)((((double)i + 1.0) / (double)unitTypes.size()) * 100.0/techTree->getTypeCount()));
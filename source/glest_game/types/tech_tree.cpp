@@ -21,10 +21,15 @@
 #include "platform_util.h"
 #include "game_util.h"
 #include "window.h"
+#include "config.h"
+#include "model.h"
+#include "pixmap.h"
 #include "leak_dumper.h"
 
 using namespace Shared::Util;
 using namespace Shared::Xml;
+using namespace Shared::Graphics;
+using namespace Shared::PlatformCommon;
 
 namespace Glest{ namespace Game{
 
@@ -38,6 +43,10 @@ TechTree::TechTree(const vector<string> pathList) {
 	name="";
 	treePath="";
 	this->pathList.assign(pathList.begin(), pathList.end());
+	loaderJobSystem = NULL;
+	treeCacheFile = "";
+	treeCacheRecording = false;
+	loadingCaches = false;
 
     resourceTypes.clear();
     factionTypes.clear();
@@ -94,6 +103,8 @@ void TechTree::load(const string &dir, set<string> &factions, Checksum* checksum
 	snprintf(szBuf,8096,Lang::getInstance().get("LogScreenGameLoadingTechtree","",true).c_str(),formatString(name).c_str());
 	Logger::getInstance().add(szBuf, true);
 
+	startTreeCache();
+
 	vector<string> filenames;
 	//load resources
 	string str= currentPath + "resources/*.";
@@ -117,6 +128,7 @@ void TechTree::load(const string &dir, set<string> &factions, Checksum* checksum
     }
     catch(const exception &e){
     	SystemFlags::OutputDebug(SystemFlags::debugError,"In [%s::%s Line: %d] Error [%s]\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,e.what());
+		endLoad(false);
 		throw megaglest_runtime_error("Error loading Resource Types in: [" + currentPath + "]\n" + e.what());
     }
 
@@ -186,6 +198,7 @@ void TechTree::load(const string &dir, set<string> &factions, Checksum* checksum
     }
     catch(const exception &e){
     	SystemFlags::OutputDebug(SystemFlags::debugError,"In [%s::%s Line: %d] Error [%s]\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,e.what());
+		endLoad(false);
 		throw megaglest_runtime_error("Error loading Tech Tree: "+ currentPath + "\n" + e.what());
     }
 
@@ -197,6 +210,12 @@ void TechTree::load(const string &dir, set<string> &factions, Checksum* checksum
     try{
 		factionTypes.resize(factions.size());
 
+		// 0 loads everything on the main thread
+		int loaderThreads = Config::getInstance().getInt("TechTreeLoaderThreads","-1");
+		if(loaderThreads != 0) {
+			loaderJobSystem = new JobSystem(loaderThreads);
+		}
+
 		int i=0;
 		for ( set<string>::iterator it = factions.begin(); it != factions.end(); ++it ) {
 			string factionName = *it;
@@ -223,12 +242,15 @@ void TechTree::load(const string &dir, set<string> &factions, Checksum* checksum
     	//printf("1111111b ex.wantStackTrace() = %d\n",ex.wantStackTrace());
 		SystemFlags::OutputDebug(SystemFlags::debugError,"In [%s::%s Line: %d] Error [%s]\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,ex.what());
 		//printf("222222b\n");
+		endLoad(false);
 		throw megaglest_runtime_error("Error loading Faction Types: "+ currentPath + "\n" + ex.what(),!ex.wantStackTrace());
     }
 	catch(const exception &e){
 		SystemFlags::OutputDebug(SystemFlags::debugError,"In [%s::%s Line: %d] Error [%s]\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,e.what());
+		endLoad(false);
 		throw megaglest_runtime_error("Error loading Faction Types: "+ currentPath + "\n" + e.what());
     }
+    endLoad(true);
 
     if(techtreeChecksum != NULL) {
         *techtreeChecksum = checksumValue;
@@ -240,8 +262,93 @@ void TechTree::load(const string &dir, set<string> &factions, Checksum* checksum
     if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d]\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__);
 }
 
+// The xml of a tech tree seen before is built from a cache of its parsed
+// trees, the cache file name holds the crc of the tech tree's xml files so
+// any change to them starts a new one. Files the cache misses, like those
+// of factions not played before, are recorded and merged into it
+void TechTree::startTreeCache() {
+	treeCacheFile = "";
+	treeCacheRecording = false;
+	loadingCaches = true;
+	XmlTreeCache::clear();
+
+	string cachePath = getCRCCacheFilePath();
+	if(Config::getInstance().getBool("TechTreeCache","true") == false || cachePath == "") {
+		return;
+	}
+
+	uint32 techCRC = getFolderTreeContentsCheckSumRecursively(pathList, string("/") + name + string("/*"), ".xml", NULL);
+	string cacheFilePrefix = "techtree_" + name + "_";
+	treeCacheFile = cachePath + cacheFilePrefix + uIntToStr(techCRC) + ".mgxc";
+
+	bool cacheLoaded = false;
+	if(fileExists(treeCacheFile) == true) {
+		try {
+			XmlTreeCache::load(treeCacheFile);
+			cacheLoaded = true;
+			if(SystemFlags::VERBOSE_MODE_ENABLED) printf("Loading techtree [%s] from cache [%s]\n",name.c_str(),treeCacheFile.c_str());
+		}
+		catch(const exception &ex) {
+			SystemFlags::OutputDebug(SystemFlags::debugError,"In [%s::%s Line: %d] Error [%s]\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,ex.what());
+			XmlTreeCache::clear();
+		}
+	}
+
+	if(cacheLoaded == false) {
+		// caches of older versions of this tech tree are no longer needed,
+		// only names ending in a crc are ours, techtree_<name>_*.mgxc also
+		// matches tech trees whose name starts with <name>_
+		vector<string> oldCacheFiles;
+		findAll(cachePath + cacheFilePrefix + "*.mgxc", oldCacheFiles, false, false);
+		for(unsigned int i = 0; i < oldCacheFiles.size(); ++i) {
+			const string &oldCacheFile = oldCacheFiles[i];
+			if(oldCacheFile.size() <= cacheFilePrefix.size() + 5) {
+				continue;
+			}
+			string oldCRC = oldCacheFile.substr(cacheFilePrefix.size(), oldCacheFile.size() - cacheFilePrefix.size() - 5);
+			if(oldCRC.find_first_not_of("0123456789") == string::npos) {
+				removeFile(cachePath + oldCacheFile);
+			}
+		}
+	}
+
+	XmlTreeCache::startRecording(treePath);
+	treeCacheRecording = true;
+}
+
+// Leaves the global caches alone unless this tree is the one loading, so
+// the tech trees the menus build and throw away never clear the caches of
+// a load in progress
+void TechTree::endLoad(bool loaded) {
+	delete loaderJobSystem;
+	loaderJobSystem = NULL;
+
+	if(loadingCaches == false) {
+		return;
+	}
+	loadingCaches = false;
+
+	// anything prefetched but not picked up by the loaders
+	XmlTree::clearPreloadCache();
+	Pixmap2D::clearPreloadCache();
+
+	if(loaded == true && treeCacheRecording == true && XmlTreeCache::hasNewTrees() == true) {
+		try {
+			XmlTreeCache::save(treeCacheFile);
+		}
+		catch(const exception &ex) {
+			SystemFlags::OutputDebug(SystemFlags::debugError,"In [%s::%s Line: %d] Error [%s]\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,ex.what());
+			removeFile(treeCacheFile);
+		}
+	}
+	XmlTreeCache::clear();
+	treeCacheFile = "";
+	treeCacheRecording = false;
+}
+
 TechTree::~TechTree() {
 	if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d]\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__);
+	endLoad(false);
 	Logger::getInstance().add(Lang::getInstance().get("LogScreenGameUnLoadingTechtree","",true), true);
 	resourceTypes.clear();
 	factionTypes.clear();
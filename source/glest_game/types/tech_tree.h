@@ -22,6 +22,7 @@
 #include "resource_type.h"
 #include "faction_type.h"
 #include "damage_multiplier.h"
+#include "job_system.h"
 #include "leak_dumper.h"
 
 namespace Glest{ namespace Game{
@@ -52,6 +53,15 @@ private:
 	AttackTypes attackTypes;
 	DamageMultiplierTable damageMultiplierTable;
 	Checksum checksumValue;
+	Shared::PlatformCommon::JobSystem *loaderJobSystem;
+	string treeCacheFile;
+	bool treeCacheRecording;
+	// true from startTreeCache until endLoad, the global xml caches belong
+	// to this tree only while it loads
+	bool loadingCaches;
+
+	void startTreeCache();
+	void endLoad(bool loaded);
 
 public:
     Checksum loadTech(const string &techName,
@@ -64,6 +74,8 @@ public:
     TechTree(const vector<string> pathList);
     ~TechTree();
     Checksum * getChecksumValue() { return &checksumValue; }
+    // Worker pool prefetching faction data, only set during load
+    Shared::PlatformCommon::JobSystem * getLoaderJobSystem() const { return loaderJobSystem; }
 
     //get
 	int getResourceTypeCount() const							{return resourceTypes.size();}
@@ -0,0 +1,227 @@
+// ==============================================================
+//	This file is part of Glest (www.glest.org)
+//
+//	Copyright (C) 2001-2008 Martiño Figueroa
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#include "fog_of_war_map.h"
+
+#include "map.h"
+#include "conversion.h"
+#include "platform_common.h"
+#include "leak_dumper.h"
+
+using namespace std;
+using namespace Shared::Util;
+using namespace Shared::PlatformCommon;
+
+namespace Glest{ namespace Game{
+
+// =====================================================
+// 	class FogOfWarMap
+// =====================================================
+
+// ===================== PUBLIC ========================
+
+FogOfWarMap::FogOfWarMap() {
+	map = NULL;
+	surfaceW = 0;
+	surfaceH = 0;
+	indirectSightRange = 0;
+	fullUpdateRequired = true;
+	fogOfWar = false;
+	thisTeamIndex = -1;
+	updatePass = 0;
+	restampCount = 0;
+}
+
+void FogOfWarMap::init(Map *map, int indirectSightRange) {
+	if(map == NULL) {
+		throw megaglest_runtime_error("map == NULL");
+	}
+	this->map = map;
+	this->surfaceW = map->getSurfaceW();
+	this->surfaceH = map->getSurfaceH();
+	this->indirectSightRange = indirectSightRange;
+
+	for(int k = 0; k < teamCount; ++k) {
+		visibleCounts[k].assign(surfaceW * surfaceH, 0);
+	}
+	unitStamps.clear();
+	exploredOutsideUpdate.clear();
+	fullUpdateRequired = true;
+	restampCount = 0;
+}
+
+// Explores right away, as a unit does when it moves between two updates.
+// The next update recomputes the visibility of these cells.
+void FogOfWarMap::exploreCells(const Vec2i &surfPos, int surfSightRange, int teamIndex) {
+	if(map == NULL) {
+		throw megaglest_runtime_error("map == NULL");
+	}
+	const SightOffsets &offsets = getSightOffsets(surfSightRange);
+
+	for(unsigned int i = 0; i < offsets.exploredOffsets.size(); ++i) {
+		Vec2i currPos = surfPos + offsets.exploredOffsets[i];
+		if(map->isInsideSurface(currPos)) {
+			map->getSurfaceCell(currPos)->setExplored(teamIndex, true);
+		}
+	}
+	for(unsigned int i = 0; i < offsets.visibleOffsets.size(); ++i) {
+		Vec2i currPos = surfPos + offsets.visibleOffsets[i];
+		if(map->isInsideSurface(currPos)) {
+			int cellIndex = currPos.y * surfaceW + currPos.x;
+			map->getSurfaceCell(currPos)->setVisible(teamIndex, true);
+			if(visibleCounts[teamIndex][cellIndex] == 0) {
+				exploredOutsideUpdate.push_back(std::make_pair(cellIndex, teamIndex));
+			}
+		}
+	}
+}
+
+void FogOfWarMap::beginUpdate(bool fogOfWar, int thisTeamIndex) {
+	if(map == NULL) {
+		throw megaglest_runtime_error("map == NULL");
+	}
+	updatePass++;
+
+	// the teams whose visibility is reset depend on these, start over when they change
+	if(fullUpdateRequired == true || this->fogOfWar != fogOfWar || this->thisTeamIndex != thisTeamIndex) {
+		this->fogOfWar = fogOfWar;
+		this->thisTeamIndex = thisTeamIndex;
+
+		for(int k = 0; k < teamCount; ++k) {
+			visibleCounts[k].assign(surfaceW * surfaceH, 0);
+		}
+		unitStamps.clear();
+		exploredOutsideUpdate.clear();
+
+		for(int i = 0; i < surfaceW; ++i) {
+			for(int j = 0; j < surfaceH; ++j) {
+				SurfaceCell *sc = map->getSurfaceCell(i, j);
+				for(int k = 0; k < teamCount; ++k) {
+					if(isManagedTeam(k) == true) {
+						sc->setVisible(k, false);
+					}
+				}
+			}
+		}
+		fullUpdateRequired = false;
+	}
+}
+
+void FogOfWarMap::updateUnitSight(int unitId, const Vec2i &surfPos, int surfSightRange, int teamIndex) {
+	SightStamp &stamp = unitStamps[unitId];
+	bool isNewStamp = (stamp.updatePass == 0);
+	stamp.updatePass = updatePass;
+
+	if(isNewStamp == false &&
+		stamp.surfPos == surfPos && stamp.surfSightRange == surfSightRange &&
+		stamp.teamIndex == teamIndex) {
+		return;
+	}
+	if(isNewStamp == false) {
+		removeStamp(stamp);
+	}
+	stamp.surfPos = surfPos;
+	stamp.surfSightRange = surfSightRange;
+	stamp.teamIndex = teamIndex;
+	applyStamp(stamp);
+}
+
+void FogOfWarMap::endUpdate() {
+	// units that died or were removed since the last update
+	for(std::map<int, SightStamp>::iterator iterMap = unitStamps.begin(); iterMap != unitStamps.end();) {
+		if(iterMap->second.updatePass != updatePass) {
+			removeStamp(iterMap->second);
+			unitStamps.erase(iterMap++);
+		}
+		else {
+			++iterMap;
+		}
+	}
+
+	for(unsigned int i = 0; i < exploredOutsideUpdate.size(); ++i) {
+		int cellIndex = exploredOutsideUpdate[i].first;
+		int teamIndex = exploredOutsideUpdate[i].second;
+		if(isManagedTeam(teamIndex) == true && visibleCounts[teamIndex][cellIndex] == 0) {
+			map->getSurfaceCell(cellIndex % surfaceW, cellIndex / surfaceW)->setVisible(teamIndex, false);
+		}
+	}
+	exploredOutsideUpdate.clear();
+}
+
+string FogOfWarMap::getStats() const {
+	return "sights [" + intToStr(unitStamps.size()) + "] ranges [" + intToStr(sightOffsets.size()) + "] restamps [" + intToStr(restampCount) + "]";
+}
+
+// ==================== PRIVATE ====================
+
+const FogOfWarMap::SightOffsets & FogOfWarMap::getSightOffsets(int surfSightRange) {
+	std::map<int, SightOffsets>::iterator iterFind = sightOffsets.find(surfSightRange);
+	if(iterFind != sightOffsets.end()) {
+		return iterFind->second;
+	}
+
+	// same circle test as the former per unit cell scan
+	SightOffsets &offsets = sightOffsets[surfSightRange];
+	for(int i = -surfSightRange - indirectSightRange -1; i <= surfSightRange + indirectSightRange +1; ++i) {
+		for(int j = -surfSightRange - indirectSightRange -1; j <= surfSightRange + indirectSightRange +1; ++j) {
+			Vec2i currRelPos= Vec2i(i, j);
+			float posLength = currRelPos.length();
+			if(posLength < surfSightRange + indirectSightRange + 1) {
+				offsets.exploredOffsets.push_back(currRelPos);
+			}
+			if(posLength < surfSightRange) {
+				offsets.visibleOffsets.push_back(currRelPos);
+			}
+		}
+	}
+	return offsets;
+}
+
+void FogOfWarMap::applyStamp(const SightStamp &stamp) {
+	const SightOffsets &offsets = getSightOffsets(stamp.surfSightRange);
+	vector<unsigned short> &counts = visibleCounts[stamp.teamIndex];
+
+	// exploring is never undone, so only new sight positions need it
+	for(unsigned int i = 0; i < offsets.exploredOffsets.size(); ++i) {
+		Vec2i currPos = stamp.surfPos + offsets.exploredOffsets[i];
+		if(map->isInsideSurface(currPos)) {
+			map->getSurfaceCell(currPos)->setExplored(stamp.teamIndex, true);
+		}
+	}
+	for(unsigned int i = 0; i < offsets.visibleOffsets.size(); ++i) {
+		Vec2i currPos = stamp.surfPos + offsets.visibleOffsets[i];
+		if(map->isInsideSurface(currPos)) {
+			int cellIndex = currPos.y * surfaceW + currPos.x;
+			if(counts[cellIndex]++ == 0) {
+				map->getSurfaceCell(currPos)->setVisible(stamp.teamIndex, true);
+			}
+		}
+	}
+	restampCount++;
+}
+
+void FogOfWarMap::removeStamp(const SightStamp &stamp) {
+	const SightOffsets &offsets = getSightOffsets(stamp.surfSightRange);
+	vector<unsigned short> &counts = visibleCounts[stamp.teamIndex];
+	bool managedTeam = isManagedTeam(stamp.teamIndex);
+
+	for(unsigned int i = 0; i < offsets.visibleOffsets.size(); ++i) {
+		Vec2i currPos = stamp.surfPos + offsets.visibleOffsets[i];
+		if(map->isInsideSurface(currPos)) {
+			int cellIndex = currPos.y * surfaceW + currPos.x;
+			if(--counts[cellIndex] == 0 && managedTeam == true) {
+				map->getSurfaceCell(currPos)->setVisible(stamp.teamIndex, false);
+			}
+		}
+	}
+}
+
+}}//end namespace
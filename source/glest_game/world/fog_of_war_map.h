@@ -0,0 +1,105 @@
+// ==============================================================
+//	This file is part of Glest (www.glest.org)
+//
+//	Copyright (C) 2001-2008 Martiño Figueroa
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#ifndef _GLEST_GAME_FOGOFWARMAP_H_
+#define _GLEST_GAME_FOGOFWARMAP_H_
+
+#ifdef WIN32
+    #include <winsock2.h>
+    #include <winsock.h>
+#endif
+
+#include "vec.h"
+#include <vector>
+#include <map>
+#include <string>
+#include "game_constants.h"
+#include "leak_dumper.h"
+
+using std::vector;
+using std::string;
+using Shared::Graphics::Vec2i;
+
+namespace Glest { namespace Game {
+
+class Map;
+
+// =====================================================
+// 	class FogOfWarMap
+//
+///	Per team count of the unit sight circles covering each
+///	surface cell, only moved sights are restamped per update
+// =====================================================
+
+class FogOfWarMap {
+public:
+	static const int teamCount = GameConstants::maxPlayers + GameConstants::specialFactions;
+
+private:
+	class SightStamp {
+	public:
+		SightStamp() { surfSightRange = 0; teamIndex = 0; updatePass = 0; }
+
+		Vec2i surfPos;
+		int surfSightRange;
+		int teamIndex;
+		int updatePass;
+	};
+
+	class SightOffsets {
+	public:
+		vector<Vec2i> visibleOffsets;
+		vector<Vec2i> exploredOffsets;
+	};
+
+	Map *map;
+	int surfaceW;
+	int surfaceH;
+	int indirectSightRange;
+
+	vector<unsigned short> visibleCounts[teamCount];
+	std::map<int, SightStamp> unitStamps;
+	std::map<int, SightOffsets> sightOffsets;
+	// cells set visible outside of an update, recomputed by the next one
+	vector<std::pair<int,int> > exploredOutsideUpdate;
+
+	bool fullUpdateRequired;
+	bool fogOfWar;
+	int thisTeamIndex;
+	int updatePass;
+	int restampCount;
+
+public:
+	FogOfWarMap();
+
+	void init(Map *map, int indirectSightRange);
+	void invalidate() { fullUpdateRequired = true; }
+
+	void exploreCells(const Vec2i &surfPos, int surfSightRange, int teamIndex);
+
+	void beginUpdate(bool fogOfWar, int thisTeamIndex);
+	void updateUnitSight(int unitId, const Vec2i &surfPos, int surfSightRange, int teamIndex);
+	void endUpdate();
+
+	string getStats() const;
+
+private:
+	inline bool isManagedTeam(int teamIndex) const {
+		return (fogOfWar || teamIndex != thisTeamIndex);
+	}
+	const SightOffsets & getSightOffsets(int surfSightRange);
+	void applyStamp(const SightStamp &stamp);
+	void removeStamp(const SightStamp &stamp);
+};
+
+}}//end namespace
+
+#endif
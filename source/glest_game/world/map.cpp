@@ -13,6 +13,7 @@
 #include "map.h"
 
 #include <cassert>
+#include <algorithm>
 
 #include "tileset.h"
 #include "unit.h"
@@ -236,10 +237,8 @@ void SurfaceCell::saveGame(XmlNode *rootNode,int index) const {
 	}
 }
 
-void SurfaceCell::loadGame(const XmlNode *rootNode, int index, World *world) {
-	if(rootNode->hasChild("SurfaceCell" + intToStr(index)) == true) {
-		const XmlNode *surfaceCellNode = rootNode->getChild("SurfaceCell" + intToStr(index));
-
+void SurfaceCell::loadGame(const XmlNode *surfaceCellNode, World *world) {
+	if(surfaceCellNode != NULL) {
 		if(surfaceCellNode->hasAttribute("vertex") == true) {
 			vertex = Vec3f::strToVec3(surfaceCellNode->getAttribute("vertex")->getValue());
 		}
@@ -279,6 +278,19 @@ void SurfaceCell::loadGame(const XmlNode *rootNode, int index, World *world) {
 // 	class Map
 // =====================================================
 
+static int hexDigitValue(char c) {
+	if(c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	else if(c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	else if(c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+	throw megaglest_runtime_error("Invalid hex digit in saved game: " + string(1,c));
+}
+
 // ===================== PUBLIC ========================
 
 const int Map::cellScale= 2;
@@ -425,6 +437,8 @@ Checksum Map::load(const string &path, TechTree *techTree, Tileset *tileset) {
 
 			//cells
 			cells= new Cell[getCellArraySize()];
+			unitSpatialIndex.init(w, h);
+			resourceSpatialIndex.init(surfaceW, surfaceH);
 			surfaceCells= new SurfaceCell[getSurfaceCellArraySize()];
 
 			//read heightmap
@@ -519,6 +533,7 @@ void Map::init(Tileset *tileset) {
 	computeInterpolatedHeights();
 	computeNearSubmerged();
 	computeCellColors();
+	buildResourceSpatialIndex();
 }
 
 
@@ -795,6 +810,26 @@ bool Map::isFreeCells(const Vec2i & pos, int size, Field field) const  {
     return true;
 }
 
+bool Map::isStaticFreeCell(const Vec2i &pos, Field field) const {
+	return
+		isInside(pos) &&
+		isInsideSurface(toSurfCoords(pos)) &&
+		getCell(pos)->isStaticFree(field) &&
+		(field==fAir || getSurfaceCell(toSurfCoords(pos))->isFree()) &&
+		(field!=fLand || getDeepSubmerged(getCell(pos)) == false);
+}
+
+bool Map::isStaticFreeCells(const Vec2i &pos, int size, Field field) const {
+	for(int i=pos.x; i<pos.x+size; ++i) {
+		for(int j=pos.y; j<pos.y+size; ++j) {
+			if(isStaticFreeCell(Vec2i(i,j), field) == false) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
 bool Map::isFreeCellsOrHasUnit(const Vec2i &pos, int size, Field field,
 		const Unit *unit, const UnitType *munit,bool allowNullUnit) const {
 	if(unit == NULL && allowNullUnit == false) {
@@ -1326,11 +1361,11 @@ void Map::putUnitCellsPrivate(Unit *unit, const Vec2i &pos, const UnitType *ut,
 				                   getCell(currPos)->getUnit(field) == unit) {
 					if(isMorph){
                     	// unit is beeing morphed to another unit with maybe other field.
-                    	getCell(currPos)->setUnit(field, unit);
+                    	setCellUnit(currPos, field, unit);
                     	canPutInCell = false;
 					}
 	                if(canPutInCell == true) {
-	                    getCell(currPos)->setUnit(unit->getCurrField(), unit);
+	                    setCellUnit(currPos, unit->getCurrField(), unit);
 	                }
 				}
 				else {
@@ -1355,6 +1390,10 @@ void Map::putUnitCellsPrivate(Unit *unit, const Vec2i &pos, const UnitType *ut,
 	if(canPutInCell == true) {
         unit->setPos(pos);
 	}
+
+	if(ut->isMobile() == false) {
+		notifyCellsChanged(pos, ut->getSize());
+	}
 }
 
 //removes a unit from cells
@@ -1405,7 +1444,7 @@ void Map::clearUnitCells(Unit *unit, const Vec2i &pos, bool ignoreSkill) {
 
                 // Only clear the cell if its the unit we expect to clear out of it
                 if(getCell(currPos)->getUnit(currentField) == unit) {
-                    getCell(currPos)->setUnit(currentField, NULL);
+                    setCellUnit(currPos, currentField, NULL);
                 }
 			}
 			else if(ut->hasCellMap() == true &&
@@ -1420,6 +1459,46 @@ void Map::clearUnitCells(Unit *unit, const Vec2i &pos, bool ignoreSkill) {
 			}
 		}
 	}
+
+	if(ut->isMobile() == false) {
+		notifyCellsChanged(pos, ut->getSize());
+	}
+}
+
+// every unit change of a cell goes through here to keep the unit index in step
+void Map::setCellUnit(const Vec2i &pos, int field, Unit *unit) {
+	Cell *cell = getCell(pos);
+	Unit *oldUnit = cell->getUnit(field);
+	if(oldUnit == unit) {
+		return;
+	}
+	if(oldUnit != NULL) {
+		unitSpatialIndex.removeUnitCell(oldUnit, pos, static_cast<Field>(field));
+	}
+	cell->setUnit(field, unit);
+	if(unit != NULL) {
+		unitSpatialIndex.addUnitCell(unit, pos, static_cast<Field>(field));
+	}
+}
+
+void Map::addCellChangeCallback(MapCellChangeCallbackInterface *callback) {
+	if(callback != NULL &&
+		std::find(cellChangeCallbacks.begin(),cellChangeCallbacks.end(),callback) == cellChangeCallbacks.end()) {
+		cellChangeCallbacks.push_back(callback);
+	}
+}
+
+void Map::removeCellChangeCallback(MapCellChangeCallbackInterface *callback) {
+	std::vector<MapCellChangeCallbackInterface *>::iterator iterFind = std::find(cellChangeCallbacks.begin(),cellChangeCallbacks.end(),callback);
+	if(iterFind != cellChangeCallbacks.end()) {
+		cellChangeCallbacks.erase(iterFind);
+	}
+}
+
+void Map::notifyCellsChanged(const Vec2i &pos, int size) {
+	for(unsigned int i = 0; i < cellChangeCallbacks.size(); ++i) {
+		cellChangeCallbacks[i]->mapCellsChanged(pos, size);
+	}
 }
 
 // ==================== misc ====================
@@ -1681,6 +1760,27 @@ void Map::computeCellColors(){
 	}
 }
 
+void Map::buildResourceSpatialIndex() {
+	resourceSpatialIndex.clear();
+	for(int i = 0; i < surfaceW; ++i) {
+		for(int j = 0; j < surfaceH; ++j) {
+			Resource *r = getSurfaceCell(i, j)->getResource();
+			if(r != NULL && r->getType() != NULL) {
+				resourceSpatialIndex.addResourceCell(r->getType(), Vec2i(i, j));
+			}
+		}
+	}
+}
+
+void Map::deleteResource(const Vec2i &surfPos) {
+	SurfaceCell *sc = getSurfaceCell(surfPos);
+	Resource *r = sc->getResource();
+	if(r != NULL && r->getType() != NULL) {
+		resourceSpatialIndex.removeResourceCell(r->getType(), surfPos);
+	}
+	sc->deleteResource();
+}
+
 // static
 string Map::getMapPath(const string &mapName, string scenarioDir, bool errorOnNotFound) {
 
@@ -1742,55 +1842,36 @@ void Map::saveGame(XmlNode *rootNode) const {
 //	SurfaceCell *surfaceCells;
 	//printf("getSurfaceCellArraySize() = %d\n",getSurfaceCellArraySize());
 
-	string exploredList = "";
-	string visibleList = "";
+	// explored and visible flags of all cells as one bulk array each,
+	// two hex digits per cell holding a bit per player
+	static const char *hexDigits = "0123456789abcdef";
+	string exploredBits(getSurfaceCellArraySize() * 2,'0');
+	string visibleBits(getSurfaceCellArraySize() * 2,'0');
 
 	for(unsigned int i = 0; i < getSurfaceCellArraySize(); ++i) {
 		SurfaceCell &surfaceCell = surfaceCells[i];
 
-		if(exploredList != "") {
-			exploredList += ",";
-		}
-
+		int explored = 0;
+		int visible = 0;
 		for(unsigned int j = 0; j < GameConstants::maxPlayers; ++j) {
-			if(j > 0) {
-				exploredList += "|";
+			if(surfaceCell.isExplored(j) == true) {
+				explored |= (1 << j);
 			}
-
-			exploredList += intToStr(surfaceCell.isExplored(j));
-		}
-
-		if(visibleList != "") {
-			visibleList += ",";
-		}
-
-		for(unsigned int j = 0; j < GameConstants::maxPlayers; ++j) {
-			if(j > 0) {
-				visibleList += "|";
+			if(surfaceCell.isVisible(j) == true) {
+				visible |= (1 << j);
 			}
-
-			visibleList += intToStr(surfaceCell.isVisible(j));
 		}
+		exploredBits[i * 2]		= hexDigits[explored >> 4];
+		exploredBits[i * 2 + 1]	= hexDigits[explored & 0xF];
+		visibleBits[i * 2]		= hexDigits[visible >> 4];
+		visibleBits[i * 2 + 1]	= hexDigits[visible & 0xF];
 
 		surfaceCell.saveGame(mapNode,i);
-
-		if(i > 0 && i % 100 == 0) {
-			XmlNode *surfaceCellNode = mapNode->addChild("SurfaceCell");
-			surfaceCellNode->addAttribute("batchIndex",intToStr(i), mapTagReplacements);
-			surfaceCellNode->addAttribute("exploredList",exploredList, mapTagReplacements);
-			surfaceCellNode->addAttribute("visibleList",visibleList, mapTagReplacements);
-
-			exploredList = "";
-			visibleList = "";
-		}
 	}
 
-	if(exploredList != "") {
-		XmlNode *surfaceCellNode = mapNode->addChild("SurfaceCell");
-		surfaceCellNode->addAttribute("batchIndex",intToStr(getSurfaceCellArraySize()), mapTagReplacements);
-		surfaceCellNode->addAttribute("exploredList",exploredList, mapTagReplacements);
-		surfaceCellNode->addAttribute("visibleList",visibleList, mapTagReplacements);
-	}
+	XmlNode *surfaceCellVisibilityNode = mapNode->addChild("SurfaceCellVisibility");
+	surfaceCellVisibilityNode->addAttribute("exploredBits",exploredBits, mapTagReplacements);
+	surfaceCellVisibilityNode->addAttribute("visibleBits",visibleBits, mapTagReplacements);
 
 //	Vec2i *startLocations;
 	for(unsigned int i = 0; i < maxPlayers; ++i) {
@@ -1826,11 +1907,42 @@ void Map::loadGame(const XmlNode *rootNode, World *world) {
 //	}
 
 //	printf("getSurfaceCellArraySize() = %d\n",getSurfaceCellArraySize());
-	for(unsigned int i = 0; i < getSurfaceCellArraySize(); ++i) {
-		SurfaceCell &surfaceCell = surfaceCells[i];
-		surfaceCell.loadGame(mapNode,i,world);
+	// Only changed cells are saved, as SurfaceCell<index> nodes. Visit the
+	// children once instead of searching them for every cell of the map.
+	const string surfaceCellPrefix = "SurfaceCell";
+	for(unsigned int i = 0; i < mapNode->getChildCount(); ++i) {
+		const XmlNode *childNode = mapNode->getChild(i);
+		const string &childName = childNode->getName();
+		if(childName.size() <= surfaceCellPrefix.size() ||
+			childName.compare(0,surfaceCellPrefix.size(),surfaceCellPrefix) != 0 ||
+			IsNumeric(childName.substr(surfaceCellPrefix.size()).c_str(),false) == false) {
+			continue;
+		}
+		int surfaceCellIndex = strToInt(childName.substr(surfaceCellPrefix.size()));
+		if(surfaceCellIndex >= 0 && surfaceCellIndex < (int)getSurfaceCellArraySize()) {
+			surfaceCells[surfaceCellIndex].loadGame(childNode,world);
+		}
+	}
+
+	if(mapNode->hasChild("SurfaceCellVisibility") == true) {
+		const XmlNode *surfaceCellVisibilityNode = mapNode->getChild("SurfaceCellVisibility");
+		string exploredBits = surfaceCellVisibilityNode->getAttribute("exploredBits")->getValue();
+		string visibleBits = surfaceCellVisibilityNode->getAttribute("visibleBits")->getValue();
+		if(exploredBits.size() != getSurfaceCellArraySize() * 2 || visibleBits.size() != getSurfaceCellArraySize() * 2) {
+			throw megaglest_runtime_error("Saved surface cell visibility does not match the map size");
+		}
+		for(unsigned int i = 0; i < getSurfaceCellArraySize(); ++i) {
+			SurfaceCell &surfaceCell = surfaceCells[i];
+			int explored = (hexDigitValue(exploredBits[i * 2]) << 4) | hexDigitValue(exploredBits[i * 2 + 1]);
+			int visible = (hexDigitValue(visibleBits[i * 2]) << 4) | hexDigitValue(visibleBits[i * 2 + 1]);
+			for(unsigned int j = 0; j < GameConstants::maxPlayers; ++j) {
+				surfaceCell.setExplored(j,(explored & (1 << j)) != 0);
+				surfaceCell.setVisible(j,(visible & (1 << j)) != 0);
+			}
+		}
 	}
 
+	// saves made before the bulk arrays list the flags as text
 	int surfaceCellIndexExplored = 0;
 	int surfaceCellIndexVisible = 0;
 	vector<XmlNode *> surfaceCellNodeList = mapNode->getChildList("SurfaceCell");
@@ -1901,6 +2013,7 @@ void Map::loadGame(const XmlNode *rootNode, World *world) {
 
     computeNormals();
 	computeInterpolatedHeights();
+	buildResourceSpatialIndex();
 }
 
 // =====================================================
@@ -28,6 +28,8 @@
 #include "unit_type.h"
 #include "command.h"
 #include "checksum.h"
+#include "unit_spatial_index.h"
+#include "resource_spatial_index.h"
 #include "leak_dumper.h"
 
 
@@ -102,6 +104,12 @@ public:
 		return result;
 	}
 
+	// free of everything except mobile units, which only block a cell temporarily
+	inline bool isStaticFree(Field field) const {
+		Unit *unit = getUnit(field);
+		return (unit == NULL || unit->isPutrefacting() || unit->getType()->isMobile() == true);
+	}
+
 	void saveGame(XmlNode *rootNode,int index) const;
 	void loadGame(const XmlNode *rootNode, int index, World *world);
 };
@@ -187,7 +195,7 @@ public:
 	bool getCellChangedFromOriginalMapLoad() const { return cellChangedFromOriginalMapLoad; }
 
 	void saveGame(XmlNode *rootNode,int index) const;
-	void loadGame(const XmlNode *rootNode, int index, World *world);
+	void loadGame(const XmlNode *surfaceCellNode, World *world);
 };
 
 
@@ -197,6 +205,19 @@ public:
 ///	Represents the game map (and loads it from a gbm file)
 // =====================================================
 
+// =====================================================
+// 	class MapCellChangeCallbackInterface
+//
+///	Notified when static obstacles (buildings, resources)
+///	are added to or removed from a block of cells
+// =====================================================
+
+class MapCellChangeCallbackInterface {
+public:
+	virtual void mapCellsChanged(const Vec2i &pos, int size) = 0;
+	virtual ~MapCellChangeCallbackInterface() {}
+};
+
 class FastAINodeCache {
 public:
 	FastAINodeCache(Unit *unit) {
@@ -230,6 +251,9 @@ private:
 	Checksum checksumValue;
 	float maxMapHeight;
 	string mapFile;
+	std::vector<MapCellChangeCallbackInterface *> cellChangeCallbacks;
+	UnitSpatialIndex unitSpatialIndex;
+	ResourceSpatialIndex resourceSpatialIndex;
 
 private:
 	Map(Map&);
@@ -240,6 +264,8 @@ public:
 	~Map();
 	void end(); //to kill particles
 	Checksum * getChecksumValue() { return &checksumValue; }
+	inline const UnitSpatialIndex * getUnitSpatialIndex() const { return &unitSpatialIndex; }
+	inline const ResourceSpatialIndex * getResourceSpatialIndex() const { return &resourceSpatialIndex; }
 
 	void init(Tileset *tileset);
 	Checksum load(const string &path, TechTree *techTree, Tileset *tileset);
@@ -330,6 +356,8 @@ public:
 	bool isFreeCells(const Vec2i &pos, int size, Field field) const;
 	bool isFreeCellsOrHasUnit(const Vec2i &pos, int size, Field field, const Unit *unit, const UnitType *munit, bool allowNullUnit=false) const;
 	bool isAproxFreeCells(const Vec2i &pos, int size, Field field, int teamIndex) const;
+	bool isStaticFreeCell(const Vec2i &pos, Field field) const;
+	bool isStaticFreeCells(const Vec2i &pos, int size, Field field) const;
 
 	bool canOccupy(const Vec2i &pos, Field field, const UnitType *ut, CardinalDir facing);
 
@@ -339,6 +367,11 @@ public:
     void putUnitCells(Unit *unit, const Vec2i &pos,bool ignoreSkill = false);
 	void clearUnitCells(Unit *unit, const Vec2i &pos,bool ignoreSkill = false);
 
+	//static obstacle change notifications
+	void addCellChangeCallback(MapCellChangeCallbackInterface *callback);
+	void removeCellChangeCallback(MapCellChangeCallbackInterface *callback);
+	void notifyCellsChanged(const Vec2i &pos, int size);
+
 	Vec2i computeRefPos(const Selection *selection) const;
 	Vec2i computeDestPos(	const Vec2i &refUnitPos, const Vec2i &unitPos,
 							const Vec2i &commandPos) const;
@@ -393,6 +426,48 @@ public:
 		return false;
 	}
 
+	// the unit independent part of isAproxFreeCellOrMightBeFreeSoon, pos must be inside
+	inline AproxCellStateCache::CellState getAproxCellState(const Vec2i &pos, Field field, int teamIndex) const {
+		const SurfaceCell *sc= getSurfaceCell(toSurfCoords(pos));
+
+		if(sc->isVisible(teamIndex)) {
+			if((field!=fAir && sc->isFree() == false) ||
+			   (field==fLand && getDeepSubmerged(getCell(pos)) == true)) {
+				return AproxCellStateCache::csBlocked;
+			}
+			Unit *cellUnit = getCell(pos)->getUnit(field);
+			if(cellUnit == NULL || cellUnit->isPutrefacting()) {
+				return AproxCellStateCache::csFree;
+			}
+			return (cellUnit->getType()->isMobile() == true ? AproxCellStateCache::csMobileUnit : AproxCellStateCache::csBlocked);
+		}
+		else if(sc->isExplored(teamIndex)) {
+			bool isFree = (field==fLand? sc->isFree() && !getDeepSubmerged(getCell(pos)): true);
+			return (isFree == true ? AproxCellStateCache::csFree : AproxCellStateCache::csBlocked);
+		}
+		return AproxCellStateCache::csFree;
+	}
+
+	// same result as isAproxFreeCellOrMightBeFreeSoon, the cell state is shared by
+	// all units of the faction while the unit commands are pre-processed
+	inline bool isAproxFreeCellOrMightBeFreeSoonCached(const Unit *unit,const Vec2i &pos, Field field, int teamIndex) const {
+		AproxCellStateCache *cache = unit->getFaction()->getAproxCellStateCache();
+		if(cache->isEnabled() == false || isInside(pos) == false || isInsideSurface(toSurfCoords(pos)) == false) {
+			return isAproxFreeCellOrMightBeFreeSoon(unit->getPosNotThreadSafe(),pos, field, teamIndex);
+		}
+
+		int cellIndex = pos.y * w + pos.x;
+		AproxCellStateCache::CellState state = cache->getState(field, cellIndex);
+		if(state == AproxCellStateCache::csUnknown) {
+			state = getAproxCellState(pos, field, teamIndex);
+			cache->setState(field, cellIndex, state);
+		}
+		if(state == AproxCellStateCache::csMobileUnit) {
+			return (unit->getPosNotThreadSafe().dist(pos) > 5);
+		}
+		return (state == AproxCellStateCache::csFree);
+	}
+
 	//checks if a unit can move from between 2 cells using only visible cells (for pathfinding)
 	inline bool aproxCanMoveSoon(const Unit *unit, const Vec2i &pos1, const Vec2i &pos2) const {
 		if(isInside(pos1) == false || isInsideSurface(toSurfCoords(pos1)) == false ||
@@ -410,33 +485,25 @@ public:
 		int teamIndex= unit->getTeam();
 		Field field= unit->getCurrField();
 
-		const bool *cachedResult = unit->getFaction()->aproxCanMoveSoonCached(size,field,pos1,pos2);
-		if(cachedResult != NULL) {
-			return *cachedResult;
-		}
-
 		//single cell units
 		if(size == 1) {
-			if(isAproxFreeCellOrMightBeFreeSoon(unit->getPosNotThreadSafe(),pos2, field, teamIndex) == false) {
+			if(isAproxFreeCellOrMightBeFreeSoonCached(unit,pos2, field, teamIndex) == false) {
 
 				//printf("[%s] Line: %d returning false\n",__FUNCTION__,__LINE__);
-				unit->getFaction()->addAproxCanMoveSoonCached(size,field, pos1, pos2, false);
 				return false;
 			}
 			if(pos1.x != pos2.x && pos1.y != pos2.y) {
-				if(isAproxFreeCellOrMightBeFreeSoon(unit->getPosNotThreadSafe(),Vec2i(pos1.x, pos2.y), field, teamIndex) == false) {
+				if(isAproxFreeCellOrMightBeFreeSoonCached(unit,Vec2i(pos1.x, pos2.y), field, teamIndex) == false) {
 
 					//Unit *cellUnit = getCell(Vec2i(pos1.x, pos2.y))->getUnit(field);
 					//Object * obj = getSurfaceCell(toSurfCoords(Vec2i(pos1.x, pos2.y)))->getObject();
 
 					//printf("[%s] Line: %d returning false cell [%s] free [%d] cell unitid = %d object class = %d\n",__FUNCTION__,__LINE__,Vec2i(pos1.x, pos2.y).getString().c_str(),this->isFreeCell(Vec2i(pos1.x, pos2.y),field),(cellUnit != NULL ? cellUnit->getId() : -1),(obj != NULL ? obj->getType()->getClass() : -1));
 					//printf("[%s] Line: %d returning false\n",__FUNCTION__,__LINE__);
-					unit->getFaction()->addAproxCanMoveSoonCached(size,field, pos1, pos2, false);
 					return false;
 				}
-				if(isAproxFreeCellOrMightBeFreeSoon(unit->getPosNotThreadSafe(),Vec2i(pos2.x, pos1.y), field, teamIndex) == false) {
+				if(isAproxFreeCellOrMightBeFreeSoonCached(unit,Vec2i(pos2.x, pos1.y), field, teamIndex) == false) {
 					//printf("[%s] Line: %d returning false\n",__FUNCTION__,__LINE__);
-					unit->getFaction()->addAproxCanMoveSoonCached(size,field, pos1, pos2, false);
 					return false;
 				}
 			}
@@ -444,9 +511,9 @@ public:
 			bool isBadHarvestPos = false;
 			//if(unit != NULL) {
 				Command *command= unit->getCurrCommand();
-				if(command != NULL) {
+				if(command != NULL && unit->isBadHarvestPos(pos2) == true) {
 					const HarvestCommandType *hct = dynamic_cast<const HarvestCommandType*>(command->getCommandType());
-					if(hct != NULL && unit->isBadHarvestPos(pos2) == true) {
+					if(hct != NULL) {
 						isBadHarvestPos = true;
 					}
 				}
@@ -455,11 +522,9 @@ public:
 			if(unit == NULL || isBadHarvestPos == true) {
 
 				//printf("[%s] Line: %d returning false\n",__FUNCTION__,__LINE__);
-				unit->getFaction()->addAproxCanMoveSoonCached(size,field, pos1, pos2, false);
 				return false;
 			}
 
-			unit->getFaction()->addAproxCanMoveSoonCached(size,field, pos1, pos2, true);
 			return true;
 		}
 		//multi cell units
@@ -470,10 +535,9 @@ public:
 					Vec2i cellPos = Vec2i(i,j);
 					if(isInside(cellPos) && isInsideSurface(toSurfCoords(cellPos))) {
 						if(getCell(cellPos)->getUnit(unit->getCurrField()) != unit) {
-							if(isAproxFreeCellOrMightBeFreeSoon(unit->getPosNotThreadSafe(),cellPos, field, teamIndex) == false) {
+							if(isAproxFreeCellOrMightBeFreeSoonCached(unit,cellPos, field, teamIndex) == false) {
 
 								//printf("[%s] Line: %d returning false\n",__FUNCTION__,__LINE__);
-								unit->getFaction()->addAproxCanMoveSoonCached(size,field, pos1, pos2, false);
 								return false;
 							}
 						}
@@ -481,7 +545,6 @@ public:
 					else {
 
 						//printf("[%s] Line: %d returning false\n",__FUNCTION__,__LINE__);
-						unit->getFaction()->addAproxCanMoveSoonCached(size,field, pos1, pos2, false);
 						return false;
 					}
 				}
@@ -489,9 +552,9 @@ public:
 
 			bool isBadHarvestPos = false;
 			Command *command= unit->getCurrCommand();
-			if(command != NULL) {
+			if(command != NULL && unit->isBadHarvestPos(pos2) == true) {
 				const HarvestCommandType *hct = dynamic_cast<const HarvestCommandType*>(command->getCommandType());
-				if(hct != NULL && unit->isBadHarvestPos(pos2) == true) {
+				if(hct != NULL) {
 					isBadHarvestPos = true;
 				}
 			}
@@ -499,17 +562,18 @@ public:
 			if(isBadHarvestPos == true) {
 
 				//printf("[%s] Line: %d returning false\n",__FUNCTION__,__LINE__);
-				unit->getFaction()->addAproxCanMoveSoonCached(size,field, pos1, pos2, false);
 				return false;
 			}
 
 		}
-		unit->getFaction()->addAproxCanMoveSoonCached(size,field, pos1, pos2, true);
 		return true;
 	}
 
 	string getMapFile() const { return mapFile; }
 
+	//removes a depleted resource from its surface cell and the resource index
+	void deleteResource(const Vec2i &surfPos);
+
 	void saveGame(XmlNode *rootNode) const;
 	void loadGame(const XmlNode *rootNode,World *world);
 
@@ -518,7 +582,9 @@ private:
 	void smoothSurface(Tileset *tileset);
 	void computeNearSubmerged();
 	void computeCellColors();
+	void buildResourceSpatialIndex();
     void putUnitCellsPrivate(Unit *unit, const Vec2i &pos, const UnitType *ut, bool isMorph);
+	void setCellUnit(const Vec2i &pos, int field, Unit *unit);
 };
 
 
@@ -0,0 +1,184 @@
+// ==============================================================
+//	This file is part of Glest (www.glest.org)
+//
+//	Copyright (C) 2001-2008 Martiño Figueroa
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#include "resource_spatial_index.h"
+
+#include <algorithm>
+
+#include "map.h"
+#include "conversion.h"
+#include "platform_common.h"
+#include "leak_dumper.h"
+
+using namespace std;
+using namespace Shared::Util;
+using namespace Shared::PlatformCommon;
+
+namespace Glest{ namespace Game{
+
+// =====================================================
+// 	class ResourceSpatialIndex
+// =====================================================
+
+const int ResourceSpatialIndex::bucketSize = 8;
+
+// ===================== PUBLIC ========================
+
+ResourceSpatialIndex::ResourceSpatialIndex() {
+	surfaceW = 0;
+	surfaceH = 0;
+	bucketsW = 0;
+	bucketsH = 0;
+	entryCount = 0;
+}
+
+void ResourceSpatialIndex::init(int surfaceW, int surfaceH) {
+	this->surfaceW = surfaceW;
+	this->surfaceH = surfaceH;
+	bucketsW = (surfaceW + bucketSize - 1) / bucketSize;
+	bucketsH = (surfaceH + bucketSize - 1) / bucketSize;
+
+	typeBuckets.clear();
+	entryCount = 0;
+}
+
+void ResourceSpatialIndex::clear() {
+	typeBuckets.clear();
+	entryCount = 0;
+}
+
+void ResourceSpatialIndex::addResourceCell(const ResourceType *rt, const Vec2i &surfPos) {
+	if(surfPos.x < 0 || surfPos.y < 0 || surfPos.x >= surfaceW || surfPos.y >= surfaceH) {
+		throw megaglest_runtime_error("Invalid resource index pos: " + surfPos.getString());
+	}
+	TypeBuckets &typeBucket = typeBuckets[rt];
+	if(typeBucket.buckets.empty() == true) {
+		typeBucket.buckets.resize(bucketsW * bucketsH);
+	}
+	typeBucket.buckets[getBucketIndex(surfPos)].push_back(surfPos);
+	typeBucket.entryCount++;
+	entryCount++;
+}
+
+void ResourceSpatialIndex::removeResourceCell(const ResourceType *rt, const Vec2i &surfPos) {
+	if(surfPos.x < 0 || surfPos.y < 0 || surfPos.x >= surfaceW || surfPos.y >= surfaceH) {
+		throw megaglest_runtime_error("Invalid resource index pos: " + surfPos.getString());
+	}
+	TypeBucketsMap::iterator iterFind = typeBuckets.find(rt);
+	if(iterFind == typeBuckets.end()) {
+		return;
+	}
+	vector<Vec2i> &bucket = iterFind->second.buckets[getBucketIndex(surfPos)];
+	for(unsigned int i = 0; i < bucket.size(); ++i) {
+		if(bucket[i] == surfPos) {
+			// bucket order does not matter, queries do not depend on it
+			bucket[i] = bucket.back();
+			bucket.pop_back();
+			iterFind->second.entryCount--;
+			entryCount--;
+			return;
+		}
+	}
+}
+
+void ResourceSpatialIndex::findResourceCells(const ResourceType *rt, const Vec2i &minSurfPos, const Vec2i &maxSurfPos, vector<Vec2i> &surfPosList) const {
+	int minX = max(minSurfPos.x, 0);
+	int minY = max(minSurfPos.y, 0);
+	int maxX = min(maxSurfPos.x, surfaceW - 1);
+	int maxY = min(maxSurfPos.y, surfaceH - 1);
+	if(minX > maxX || minY > maxY) {
+		return;
+	}
+
+	for(TypeBucketsMap::const_iterator iterMap = typeBuckets.begin();
+		iterMap != typeBuckets.end(); ++iterMap) {
+		if(rt != NULL && iterMap->first != rt) {
+			continue;
+		}
+		for(int by = minY / bucketSize; by <= maxY / bucketSize; ++by) {
+			for(int bx = minX / bucketSize; bx <= maxX / bucketSize; ++bx) {
+				const vector<Vec2i> &bucket = iterMap->second.buckets[by * bucketsW + bx];
+				for(unsigned int i = 0; i < bucket.size(); ++i) {
+					const Vec2i &surfPos = bucket[i];
+					if(surfPos.x >= minX && surfPos.x <= maxX &&
+						surfPos.y >= minY && surfPos.y <= maxY) {
+						surfPosList.push_back(surfPos);
+					}
+				}
+			}
+		}
+	}
+}
+
+bool ResourceSpatialIndex::findNearestResourceCell(const ResourceType *rt, const Vec2i &pos, const Map *map, int teamIndex, Vec2i &resultPos) const {
+	TypeBucketsMap::const_iterator iterFind = typeBuckets.find(rt);
+	if(iterFind == typeBuckets.end() || iterFind->second.entryCount <= 0) {
+		return false;
+	}
+	const vector<vector<Vec2i> > &buckets = iterFind->second.buckets;
+
+	Vec2i surfPos = Map::toSurfCoords(pos);
+	int centerX = max(0, min(surfPos.x / bucketSize, bucketsW - 1));
+	int centerY = max(0, min(surfPos.y / bucketSize, bucketsH - 1));
+	int maxRing = max(max(centerX, bucketsW - 1 - centerX), max(centerY, bucketsH - 1 - centerY));
+	const int bucketCells = bucketSize * Map::cellScale;
+
+	bool found = false;
+	float nearestDist = 0;
+	for(int ring = 0; ring <= maxRing; ++ring) {
+		// every cell of this ring is at least this far away, so
+		// a closer cell than the one found can not be in it
+		if(found == true && ring > 0 && nearestDist < (float)((ring - 1) * bucketCells + 1)) {
+			break;
+		}
+
+		for(int by = centerY - ring; by <= centerY + ring; ++by) {
+			if(by < 0 || by >= bucketsH) {
+				continue;
+			}
+			bool edgeRow = (by == centerY - ring || by == centerY + ring);
+			for(int bx = centerX - ring; bx <= centerX + ring; bx += (edgeRow == true ? 1 : 2 * ring)) {
+				if(bx >= 0 && bx < bucketsW) {
+					const vector<Vec2i> &bucket = buckets[by * bucketsW + bx];
+					for(unsigned int i = 0; i < bucket.size(); ++i) {
+						const Vec2i &resourceSurfPos = bucket[i];
+						if(teamIndex >= 0 && map->getSurfaceCell(resourceSurfPos)->isExplored(teamIndex) == false) {
+							continue;
+						}
+						for(int cellX = 0; cellX < Map::cellScale; ++cellX) {
+							for(int cellY = 0; cellY < Map::cellScale; ++cellY) {
+								Vec2i resPos = Map::toUnitCoords(resourceSurfPos) + Vec2i(cellX, cellY);
+								if(map->isInside(resPos) == false) {
+									continue;
+								}
+								float tmpDist = pos.dist(resPos);
+								if(found == false || tmpDist < nearestDist ||
+									(tmpDist == nearestDist &&
+									 (resPos.x < resultPos.x || (resPos.x == resultPos.x && resPos.y < resultPos.y)))) {
+									found = true;
+									nearestDist = tmpDist;
+									resultPos = resPos;
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+	return found;
+}
+
+string ResourceSpatialIndex::getStats() const {
+	return "cells [" + intToStr(entryCount) + "] types [" + intToStr(typeBuckets.size()) + "] buckets [" + intToStr(bucketsW * bucketsH) + "]";
+}
+
+}}//end namespace
@@ -0,0 +1,90 @@
+// ==============================================================
+//	This file is part of Glest (www.glest.org)
+//
+//	Copyright (C) 2001-2008 Martiño Figueroa
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#ifndef _GLEST_GAME_RESOURCESPATIALINDEX_H_
+#define _GLEST_GAME_RESOURCESPATIALINDEX_H_
+
+#ifdef WIN32
+    #include <winsock2.h>
+    #include <winsock.h>
+#endif
+
+#include "vec.h"
+#include <vector>
+#include <map>
+#include <string>
+#include "leak_dumper.h"
+
+using std::vector;
+using std::string;
+using Shared::Graphics::Vec2i;
+
+namespace Glest { namespace Game {
+
+class Map;
+class ResourceType;
+
+// =====================================================
+// 	class ResourceSpatialIndex
+//
+///	Buckets of the resource surface cells of the map, one
+///	grid per resource type, kept in step by the map
+// =====================================================
+
+class ResourceSpatialIndex {
+public:
+	static const int bucketSize;
+
+private:
+	class TypeBuckets {
+	public:
+		TypeBuckets() { entryCount = 0; }
+
+		vector<vector<Vec2i> > buckets;
+		int entryCount;
+	};
+	typedef std::map<const ResourceType *, TypeBuckets> TypeBucketsMap;
+
+	int surfaceW;
+	int surfaceH;
+	int bucketsW;
+	int bucketsH;
+	TypeBucketsMap typeBuckets;
+	int entryCount;
+
+public:
+	ResourceSpatialIndex();
+
+	void init(int surfaceW, int surfaceH);
+	void clear();
+
+	void addResourceCell(const ResourceType *rt, const Vec2i &surfPos);
+	void removeResourceCell(const ResourceType *rt, const Vec2i &surfPos);
+
+	// resource surface cells inside the box, of any type if rt is NULL
+	void findResourceCells(const ResourceType *rt, const Vec2i &minSurfPos, const Vec2i &maxSurfPos, vector<Vec2i> &surfPosList) const;
+
+	// nearest cell of a resource of type rt to pos, only on surface cells
+	// explored by the team unless teamIndex is -1. Of cells at the same
+	// distance the one found first by a scan with x as outer loop wins.
+	bool findNearestResourceCell(const ResourceType *rt, const Vec2i &pos, const Map *map, int teamIndex, Vec2i &resultPos) const;
+
+	string getStats() const;
+
+private:
+	inline int getBucketIndex(const Vec2i &surfPos) const {
+		return (surfPos.y / bucketSize) * bucketsW + (surfPos.x / bucketSize);
+	}
+};
+
+}}//end namespace
+
+#endif
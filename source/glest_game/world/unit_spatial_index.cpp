@@ -0,0 +1,129 @@
+// ==============================================================
+//	This file is part of Glest (www.glest.org)
+//
+//	Copyright (C) 2001-2008 Martiño Figueroa
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#include "unit_spatial_index.h"
+
+#include <algorithm>
+
+#include "conversion.h"
+#include "platform_common.h"
+#include "leak_dumper.h"
+
+using namespace std;
+using namespace Shared::Util;
+using namespace Shared::PlatformCommon;
+
+namespace Glest{ namespace Game{
+
+struct UnitSpatialIndexScanOrder {
+	bool operator()(const UnitSpatialIndex::Entry &l, const UnitSpatialIndex::Entry &r) const {
+		if(l.pos.x != r.pos.x) return l.pos.x < r.pos.x;
+		if(l.pos.y != r.pos.y) return l.pos.y < r.pos.y;
+		return l.field < r.field;
+	}
+};
+
+// =====================================================
+// 	class UnitSpatialIndex
+// =====================================================
+
+const int UnitSpatialIndex::bucketSize = 8;
+
+// ===================== PUBLIC ========================
+
+UnitSpatialIndex::UnitSpatialIndex() {
+	w = 0;
+	h = 0;
+	bucketsW = 0;
+	bucketsH = 0;
+	entryCount = 0;
+}
+
+void UnitSpatialIndex::init(int w, int h) {
+	this->w = w;
+	this->h = h;
+	bucketsW = (w + bucketSize - 1) / bucketSize;
+	bucketsH = (h + bucketSize - 1) / bucketSize;
+
+	buckets.clear();
+	buckets.resize(bucketsW * bucketsH);
+	entryCount = 0;
+}
+
+void UnitSpatialIndex::clear() {
+	for(unsigned int i = 0; i < buckets.size(); ++i) {
+		buckets[i].clear();
+	}
+	entryCount = 0;
+}
+
+void UnitSpatialIndex::addUnitCell(Unit *unit, const Vec2i &pos, Field field) {
+	if(pos.x < 0 || pos.y < 0 || pos.x >= w || pos.y >= h) {
+		throw megaglest_runtime_error("Invalid unit index pos: " + pos.getString());
+	}
+	buckets[getBucketIndex(pos)].push_back(Entry(unit, pos, field));
+	entryCount++;
+}
+
+void UnitSpatialIndex::removeUnitCell(Unit *unit, const Vec2i &pos, Field field) {
+	if(pos.x < 0 || pos.y < 0 || pos.x >= w || pos.y >= h) {
+		throw megaglest_runtime_error("Invalid unit index pos: " + pos.getString());
+	}
+	vector<Entry> &bucket = buckets[getBucketIndex(pos)];
+	for(unsigned int i = 0; i < bucket.size(); ++i) {
+		if(bucket[i].unit == unit && bucket[i].pos == pos && bucket[i].field == field) {
+			// bucket order does not matter, queries sort their result
+			bucket[i] = bucket.back();
+			bucket.pop_back();
+			entryCount--;
+			return;
+		}
+	}
+}
+
+void UnitSpatialIndex::findUnitCells(const Vec2i &minPos, const Vec2i &maxPos, vector<Entry> &entries) const {
+	int minX = max(minPos.x, 0);
+	int minY = max(minPos.y, 0);
+	int maxX = min(maxPos.x, w - 1);
+	int maxY = min(maxPos.y, h - 1);
+	if(minX > maxX || minY > maxY) {
+		return;
+	}
+
+	size_t firstEntry = entries.size();
+	for(int by = minY / bucketSize; by <= maxY / bucketSize; ++by) {
+		for(int bx = minX / bucketSize; bx <= maxX / bucketSize; ++bx) {
+			const vector<Entry> &bucket = buckets[by * bucketsW + bx];
+			for(unsigned int i = 0; i < bucket.size(); ++i) {
+				const Entry &entry = bucket[i];
+				if(entry.pos.x >= minX && entry.pos.x <= maxX &&
+					entry.pos.y >= minY && entry.pos.y <= maxY) {
+					entries.push_back(entry);
+				}
+			}
+		}
+	}
+	std::sort(entries.begin() + firstEntry, entries.end(), UnitSpatialIndexScanOrder());
+}
+
+string UnitSpatialIndex::getStats() const {
+	int usedBuckets = 0;
+	unsigned int largestBucket = 0;
+	for(unsigned int i = 0; i < buckets.size(); ++i) {
+		if(buckets[i].empty() == false) {
+			usedBuckets++;
+			largestBucket = max(largestBucket, (unsigned int)buckets[i].size());
+		}
+	}
+	return "cells [" + intToStr(entryCount) + "] buckets [" + intToStr(usedBuckets) + "/" + intToStr(buckets.size()) + "] largest [" + intToStr(largestBucket) + "]";
+}
+
+}}//end namespace
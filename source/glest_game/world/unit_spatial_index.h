@@ -0,0 +1,90 @@
+// ==============================================================
+//	This file is part of Glest (www.glest.org)
+//
+//	Copyright (C) 2001-2008 Martiño Figueroa
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#ifndef _GLEST_GAME_UNITSPATIALINDEX_H_
+#define _GLEST_GAME_UNITSPATIALINDEX_H_
+
+#ifdef WIN32
+    #include <winsock2.h>
+    #include <winsock.h>
+#endif
+
+#include "vec.h"
+#include <vector>
+#include <string>
+#include "skill_type.h"
+#include "leak_dumper.h"
+
+using std::vector;
+using std::string;
+using Shared::Graphics::Vec2i;
+
+namespace Glest { namespace Game {
+
+class Unit;
+
+// =====================================================
+// 	class UnitSpatialIndex
+//
+///	Buckets of the occupied unit cells of the map, kept
+///	in step with Cell::setUnit by the map
+// =====================================================
+
+class UnitSpatialIndex {
+public:
+	static const int bucketSize;
+
+	class Entry {
+	public:
+		Entry() { unit = NULL; field = fLand; }
+		Entry(Unit *unit, const Vec2i &pos, Field field) {
+			this->unit = unit;
+			this->pos = pos;
+			this->field = field;
+		}
+
+		Unit *unit;
+		Vec2i pos;
+		Field field;
+	};
+
+private:
+	int w;
+	int h;
+	int bucketsW;
+	int bucketsH;
+	vector<vector<Entry> > buckets;
+	int entryCount;
+
+public:
+	UnitSpatialIndex();
+
+	void init(int w, int h);
+	void clear();
+
+	void addUnitCell(Unit *unit, const Vec2i &pos, Field field);
+	void removeUnitCell(Unit *unit, const Vec2i &pos, Field field);
+
+	// occupied cells inside the box, in the order of a cell scan
+	// with x as outer loop, then y, then field
+	void findUnitCells(const Vec2i &minPos, const Vec2i &maxPos, vector<Entry> &entries) const;
+
+	string getStats() const;
+
+private:
+	inline int getBucketIndex(const Vec2i &pos) const {
+		return (pos.y / bucketSize) * bucketsW + (pos.x / bucketSize);
+	}
+};
+
+}}//end namespace
+
+#endif
@@ -28,6 +28,7 @@
 #include "upgrade.h"
 #include "unit.h"
 
+#include "game_trace.h"
 #include "leak_dumper.h"
 
 using namespace Shared::Graphics;
@@ -71,6 +72,12 @@ void UnitUpdater::init(Game *game){
 		case pfBasic:
 			pathFinder = new PathFinder();
 			pathFinder->init(map);
+			pathFinder->setUseJumpPointSearch((game->getGameSettings()->getFlagTypes1() & ft1_pathfinder_jump_point) == ft1_pathfinder_jump_point);
+			pathFinder->setUseHierarchy((game->getGameSettings()->getFlagTypes1() & ft1_pathfinder_hierarchy) == ft1_pathfinder_hierarchy,
+					game->getGameSettings()->getPathFinderClusterSize());
+			pathFinder->setUseConnectivity((game->getGameSettings()->getFlagTypes1() & ft1_pathfinder_connectivity) == ft1_pathfinder_connectivity);
+			pathFinder->setUseFlowField((game->getGameSettings()->getFlagTypes1() & ft1_pathfinder_flow_field) == ft1_pathfinder_flow_field);
+			map->addCellChangeCallback(pathFinder);
 			break;
 		default:
 			throw megaglest_runtime_error("detected unsupported pathfinder type!");
@@ -89,9 +96,24 @@ void UnitUpdater::removeUnitPrecache(Unit *unit) {
 	}
 }
 
+void UnitUpdater::addPreprocessChunk(Faction *faction, int chunkIndex, const vector<Unit *> &units, int frameIndex) {
+	if(pathFinder != NULL) {
+		pathFinder->addPreprocessChunk(faction, chunkIndex, units, frameIndex);
+	}
+}
+
+void UnitUpdater::applyPreprocessChunks() {
+	if(pathFinder != NULL) {
+		pathFinder->applyPreprocessChunks();
+	}
+}
+
 UnitUpdater::~UnitUpdater() {
 	//UnitRangeCellsLookupItemCache.clear();
 
+	if(map != NULL && pathFinder != NULL) {
+		map->removeCellChangeCallback(pathFinder);
+	}
 	delete pathFinder;
 	pathFinder = NULL;
 
@@ -107,13 +129,9 @@ UnitUpdater::~UnitUpdater() {
 
 //skill dependent actions
 bool UnitUpdater::updateUnit(Unit *unit) {
+	TRACE_SCOPE_ARG(tevUnitUpdate,unit->getId());
 	bool processUnitCommand = false;
 
-	Chrono chrono;
-	if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled) chrono.start();
-
-	if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s] Line: %d took msecs: %lld --------------------------- [START OF METHOD] ---------------------------\n",__FILE__,__FUNCTION__,__LINE__,chrono.getMillis());
-
 	SoundRenderer &soundRenderer= SoundRenderer::getInstance();
 
 	//play skill sound
@@ -128,12 +146,8 @@ bool UnitUpdater::updateUnit(Unit *unit) {
 		}
 	}
 
-	if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s] Line: %d took msecs: %lld [after playsound]\n",__FILE__,__FUNCTION__,__LINE__,chrono.getMillis());
-
 	unit->updateTimedParticles();
 
-	if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s] Line: %d took msecs: %lld [after playsound]\n",__FILE__,__FUNCTION__,__LINE__,chrono.getMillis());
-
 	//start attack particle system
 	if(unit->getCurrSkill()->getClass() == scAttack) {
 		const AttackSkillType *ast= static_cast<const AttackSkillType*>(unit->getCurrSkill());
@@ -143,11 +157,11 @@ bool UnitUpdater::updateUnit(Unit *unit) {
 		}
 	}
 
-	if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s] Line: %d took msecs: %lld [after attack particle system]\n",__FILE__,__FUNCTION__,__LINE__,chrono.getMillis());
-
-	bool update = unit->update();
-
-	if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s] Line: %d took msecs: %lld [after unit->update()]\n",__FILE__,__FUNCTION__,__LINE__,chrono.getMillis());
+	bool update = false;
+	{
+		TRACE_SCOPE_ARG(tevUnitUpdateSkill,unit->getId());
+		update = unit->update();
+	}
 
 	//printf("Update Unit [%d - %s] = %d\n",unit->getId(),unit->getType()->getName().c_str(),update);
 
@@ -158,8 +172,6 @@ bool UnitUpdater::updateUnit(Unit *unit) {
 		processUnitCommand = true;
 		updateUnitCommand(unit,-1);
 
-		if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s] Line: %d took msecs: %lld [after updateUnitCommand()]\n",__FILE__,__FUNCTION__,__LINE__,chrono.getMillis());
-
 		//if unit is out of EP, it stops
 		if(unit->computeEp() == true) {
 			bool reQueueHoldPosition = false;
@@ -248,8 +260,6 @@ bool UnitUpdater::updateUnit(Unit *unit) {
 								spawned->giveCommand(new Command(ct, unit->getMeetingPos()));
 							}
 							scriptManager->onUnitCreated(spawned);
-
-							if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s] Line: %d took msecs: %lld\n",__FILE__,__FUNCTION__,__LINE__,chrono.getMillis());
 						}
 					}
 				}
@@ -260,32 +270,24 @@ bool UnitUpdater::updateUnit(Unit *unit) {
 		if(unit->getCurrSkill()->getClass() == scMove) {
 			world->moveUnitCells(unit);
 
-			if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s] Line: %d took msecs: %lld [after world->moveUnitCells()]\n",__FILE__,__FUNCTION__,__LINE__,chrono.getMillis());
-
 			//play water sound
 			if(map->getCell(unit->getPos())->getHeight() < map->getWaterLevel() && unit->getCurrField() == fLand) {
-				if(Config::getInstance().getBool("DisableWaterSounds","false") == false) {
+				if(Config::getCachedValues().disableWaterSounds == false) {
 					soundRenderer.playFx(
 						CoreData::getInstance().getWaterSound(),
 						unit->getCurrVector(),
 						gameCamera->getPos()
 					);
-
-					if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s] Line: %d took msecs: %lld [after soundFx()]\n",__FILE__,__FUNCTION__,__LINE__,chrono.getMillis());
 				}
 			}
 		}
 	}
 
-	if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s] Line: %d took msecs: %lld\n",__FILE__,__FUNCTION__,__LINE__,chrono.getMillis());
-
 	//unit death
 	if(unit->isDead() && unit->getCurrSkill()->getClass() != scDie) {
 		unit->kill();
 	}
 
-	if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s] Line: %d took msecs: %lld --------------------------- [END OF METHOD] ---------------------------\n",__FILE__,__FUNCTION__,__LINE__,chrono.getMillis());
-
 	return processUnitCommand;
 }
 
@@ -293,9 +295,10 @@ bool UnitUpdater::updateUnit(Unit *unit) {
 
 //VERY IMPORTANT: compute next state depending on the first order of the list
 void UnitUpdater::updateUnitCommand(Unit *unit, int frameIndex) {
+	TRACE_SCOPE_ARGS(tevUnitUpdateCommand,unit->getId(),frameIndex);
 	bool minorDebugPerformance = false;
 	Chrono chrono;
-	if((minorDebugPerformance == true && frameIndex > 0) || SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled) chrono.start();
+	if(minorDebugPerformance == true && frameIndex > 0) chrono.start();
 
 	//if unit has command process it
     bool hasCommand = (unit->anyCommand());
@@ -331,8 +334,6 @@ void UnitUpdater::updateUnitCommand(Unit *unit, int frameIndex) {
     	}
 	}
 
-    if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s Line: %d] took msecs: %lld\n",__FILE__,__FUNCTION__,__LINE__,chrono.getMillis());
-
     if(frameIndex < 0) {
 		//if no commands stop and add stop command
 		if(unit->anyCommand() == false && unit->isOperative()) {
@@ -347,7 +348,6 @@ void UnitUpdater::updateUnitCommand(Unit *unit, int frameIndex) {
 			}
 		}
     }
-    if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s] Line: %d took msecs: %lld --------------------------- [END OF METHOD] ---------------------------\n",__FILE__,__FUNCTION__,__LINE__,chrono.getMillis());
     if((minorDebugPerformance && frameIndex > 0) && chrono.getMillis() >= 1) printf("UnitUpdate [%d - %s] #3-unit threaded updates on frame: %d took [%lld] msecs\n",unit->getId(),unit->getType()->getName().c_str(),frameIndex,(long long int)chrono.getMillis());
 }
 
@@ -360,17 +360,13 @@ void UnitUpdater::updateStop(Unit *unit, int frameIndex) {
 		return;
 	}
 
-	Chrono chrono;
-	if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled) chrono.start();
-
+	TRACE_SCOPE_ARGS(tevUnitStop,unit->getId(),frameIndex);
 	Command *command= unit->getCurrCommand();
     const StopCommandType *sct = static_cast<const StopCommandType*>(command->getCommandType());
     Unit *sighted=NULL;
 
     unit->setCurrSkill(sct->getStopSkillType());
 
-    if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s Line: %d] took msecs: %lld\n",__FILE__,__FUNCTION__,__LINE__,chrono.getMillis());
-
 	//we can attack any unit => attack it
    	if(unit->getType()->hasSkillClass(scAttack)) {
    		int cmdTypeCount = unit->getType()->getCommandTypeCount();
@@ -396,30 +392,20 @@ void UnitUpdater::updateStop(Unit *unit, int frameIndex) {
 				}
 			}
 		}
-
-		if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s Line: %d] took msecs: %lld\n",__FILE__,__FUNCTION__,__LINE__,chrono.getMillis());
 	}
 	//see any unit and cant attack it => run
 	else if(unit->getType()->hasCommandClass(ccMove)) {
-		if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s Line: %d] took msecs: %lld\n",__FILE__,__FUNCTION__,__LINE__,chrono.getMillis());
-
 		if(attackerOnSight(unit, &sighted, (frameIndex >= 0))) {
-			if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s Line: %d] took msecs: %lld\n",__FILE__,__FUNCTION__,__LINE__,chrono.getMillis());
 			Vec2i escapePos = unit->getPos() * 2 - sighted->getPos();
 			//SystemFlags::OutputDebug(SystemFlags::debugUnitCommands,"In [%s::%s Line: %d]\n",__FILE__,__FUNCTION__,__LINE__);
 			unit->giveCommand(new Command(unit->getType()->getFirstCtOfClass(ccMove), escapePos));
 		}
-
-		if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s Line: %d] took msecs: %lld\n",__FILE__,__FUNCTION__,__LINE__,chrono.getMillis());
 	}
-
-   	if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s] Line: %d took msecs: %lld --------------------------- [END OF METHOD] ---------------------------\n",__FILE__,__FUNCTION__,__LINE__,chrono.getMillis());
 }
 
 // ==================== updateMove ====================
 void UnitUpdater::updateMove(Unit *unit, int frameIndex) {
-	Chrono chrono;
-	if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled) chrono.start();
+	TRACE_SCOPE_ARGS(tevUnitMove,unit->getId(),frameIndex);
 
     Command *command= unit->getCurrCommand();
     const MoveCommandType *mct= static_cast<const MoveCommandType*>(command->getCommandType());
@@ -432,8 +418,6 @@ void UnitUpdater::updateMove(Unit *unit, int frameIndex) {
 		unit->logSynchData(__FILE__,__LINE__,szBuf);
 	}
 
-	if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s Line: %d] took msecs: %lld\n",__FILE__,__FUNCTION__,__LINE__,chrono.getMillis());
-
 	TravelState tsValue = tsImpossible;
 	switch(this->game->getGameSettings()->getPathFinderType()) {
 		case pfBasic:
@@ -443,8 +427,6 @@ void UnitUpdater::updateMove(Unit *unit, int frameIndex) {
 			throw megaglest_runtime_error("detected unsupported pathfinder type!");
     }
 
-	if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s Line: %d] took msecs: %lld\n",__FILE__,__FUNCTION__,__LINE__,chrono.getMillis());
-
 	if(frameIndex < 0) {
 		switch (tsValue) {
 		case tsMoving:
@@ -463,7 +445,6 @@ void UnitUpdater::updateMove(Unit *unit, int frameIndex) {
 			break;
 		}
 	}
-	if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled && chrono.getMillis() > 0) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s] Line: %d took msecs: %lld --------------------------- [END OF METHOD] ---------------------------\n",__FILE__,__FUNCTION__,__LINE__,chrono.getMillis());
 }
 
 
@@ -1368,8 +1349,9 @@ void UnitUpdater::updateHarvest(Unit *unit, int frameIndex) {
 							//if resource exausted, then delete it and stop
 							if (sc->decAmount(1)) {
 								//const ResourceType *rt = r->getType();
-								sc->deleteResource();
+								map->deleteResource(Map::toSurfCoords(unitTargetPos));
 								world->removeResourceTargetFromCache(unitTargetPos);
+								map->notifyCellsChanged(Map::toUnitCoords(Map::toSurfCoords(unitTargetPos)),Map::cellScale);
 
 								switch(this->game->getGameSettings()->getPathFinderType()) {
 									case pfBasic:
@@ -2151,32 +2133,58 @@ void UnitUpdater::startAttackParticleSystem(Unit *unit){
 
 // ==================== misc ====================
 
+static bool compareResourceSearchCandidates(const std::pair<int,Vec2i> &a, const std::pair<int,Vec2i> &b) {
+	if(a.first != b.first) {
+		return a.first < b.first;
+	}
+	if(a.second.x != b.second.x) {
+		return a.second.x < b.second.x;
+	}
+	return a.second.y < b.second.y;
+}
+
 //looks for a resource of type rt, if rt==NULL looks for any
 //resource the unit can harvest
 bool UnitUpdater::searchForResource(Unit *unit, const HarvestCommandType *hct) {
-    Vec2i pos= unit->getCurrCommand()->getPos();
-
-    for(int radius= 0; radius < maxResSearchRadius; radius++) {
-        for(int i = pos.x - radius; i <= pos.x + radius; ++i) {
-            for(int j=pos.y - radius; j <= pos.y + radius; ++j) {
-				if(map->isInside(i, j)) {
-					Resource *r= map->getSurfaceCell(Map::toSurfCoords(Vec2i(i, j)))->getResource();
-                    if(r != NULL) {
-						if(hct->canHarvest(r->getType())) {
-							const Vec2i newPos = Vec2i(i, j);
-							if(unit->isBadHarvestPos(newPos) == false) {
-								unit->getCurrCommand()->setPos(newPos);
-
-								return true;
-							}
-                        }
-                    }
-                }
-            }
-        }
-    }
+	Vec2i pos= unit->getCurrCommand()->getPos();
+	const int searchRadius= maxResSearchRadius - 1;
+
+	// resource cells in the search box, from the resource index of the map
+	vector<Vec2i> surfPosList;
+	map->getResourceSpatialIndex()->findResourceCells(NULL,
+			Map::toSurfCoords(pos - Vec2i(searchRadius)),
+			Map::toSurfCoords(pos + Vec2i(searchRadius)), surfPosList);
+
+	// cells are tried by growing box around pos, then by x and y
+	// inside each box
+	vector<std::pair<int,Vec2i> > candidateList;
+	for(unsigned int i = 0; i < surfPosList.size(); ++i) {
+		Resource *r= map->getSurfaceCell(surfPosList[i])->getResource();
+		if(r == NULL || hct->canHarvest(r->getType()) == false) {
+			continue;
+		}
+		for(int cellX = 0; cellX < Map::cellScale; ++cellX) {
+			for(int cellY = 0; cellY < Map::cellScale; ++cellY) {
+				Vec2i resPos= Map::toUnitCoords(surfPosList[i]) + Vec2i(cellX, cellY);
+				int radius= max(abs(resPos.x - pos.x), abs(resPos.y - pos.y));
+				if(radius <= searchRadius && map->isInside(resPos)) {
+					candidateList.push_back(std::make_pair(radius, resPos));
+				}
+			}
+		}
+	}
+	std::sort(candidateList.begin(), candidateList.end(), compareResourceSearchCandidates);
 
-    return false;
+	for(unsigned int i = 0; i < candidateList.size(); ++i) {
+		const Vec2i &newPos = candidateList[i].second;
+		if(unit->isBadHarvestPos(newPos) == false) {
+			unit->getCurrCommand()->setPos(newPos);
+
+			return true;
+		}
+	}
+
+	return false;
 }
 
 bool UnitUpdater::attackerOnSight(Unit *unit, Unit **rangedPtr, bool evalMode){
@@ -2194,88 +2202,71 @@ bool UnitUpdater::attackableOnRange(Unit *unit, Unit **rangedPtr, const AttackSk
 	return unitOnRange(unit, range, rangedPtr, ast, evalMode);
 }
 
-bool UnitUpdater::findCachedCellsEnemies(Vec2i center, int range, int size, vector<Unit*> &enemies,
-										 const AttackSkillType *ast, const Unit *unit,
-										 const Unit *commandTarget) {
-	bool result = false;
-	//return result;
-
-	//if(game->isMasterserverMode() == false) {
-	{
-		MutexSafeWrapper safeMutex(&mutexUnitRangeCellsLookupItemCache,string(__FILE__) + "_" + intToStr(__LINE__));
-		std::map<Vec2i, std::map<int, std::map<int, UnitRangeCellsLookupItem > > >::iterator iterFind = UnitRangeCellsLookupItemCache.find(center);
-
-		if(iterFind != UnitRangeCellsLookupItemCache.end()) {
-			std::map<int, std::map<int, UnitRangeCellsLookupItem > >::iterator iterFind3 = iterFind->second.find(size);
-			if(iterFind3 != iterFind->second.end()) {
-				std::map<int, UnitRangeCellsLookupItem>::iterator iterFind4 = iterFind3->second.find(range);
-				if(iterFind4 != iterFind3->second.end()) {
-					result = true;
-
-					std::vector<Cell *> &cellList = iterFind4->second.rangeCellList;
-					for(int idx = 0; idx < cellList.size(); ++idx) {
-						Cell *cell = cellList[idx];
-
-						findEnemiesForCell(ast,cell,unit,commandTarget,enemies);
-					}
-				}
-			}
+// The occupied cells of the range box that pass the distance test of the
+// former cell scan, in the order that scan visited them
+void UnitUpdater::findUnitCellsInRange(const Vec2i &center, int range, int size, const Vec2f &floatCenter,
+									   vector<UnitSpatialIndex::Entry> &unitCells) const {
+	vector<UnitSpatialIndex::Entry> boxCells;
+	map->getUnitSpatialIndex()->findUnitCells(Vec2i(center.x - range, center.y - range),
+			Vec2i(center.x + range + size - 1, center.y + range + size - 1), boxCells);
+
+	for(unsigned int i = 0; i < boxCells.size(); ++i) {
+		const Vec2i &cellPos = boxCells[i].pos;
+		//cells in range
+#ifdef USE_STREFLOP
+		if(streflop::floor(static_cast<streflop::Simple>(floatCenter.dist(Vec2f((float)cellPos.x, (float)cellPos.y)))) <= (range+1)){
+#else
+		if(floor(floatCenter.dist(Vec2f((float)cellPos.x, (float)cellPos.y))) <= (range+1)){
+#endif
+			unitCells.push_back(boxCells[i]);
 		}
-		safeMutex.ReleaseLock();
 	}
-
-	return result;
 }
 
-void UnitUpdater::findEnemiesForCell(const AttackSkillType *ast, Cell *cell, const Unit *unit,
-									 const Unit *commandTarget,vector<Unit*> &enemies) {
-	//all fields
-	for(int k = 0; k < fieldCount; k++) {
-		Field f= static_cast<Field>(k);
-
-		//check field
-		if((ast == NULL || ast->getAttackField(f))) {
-			Unit *possibleEnemy = cell->getUnit(f);
+void UnitUpdater::findEnemiesForCell(const AttackSkillType *ast, const UnitSpatialIndex::Entry &unitCell, const Unit *unit,
+									 const Unit *commandTarget,vector<Unit*> &enemies) const {
+	//check field
+	if((ast == NULL || ast->getAttackField(unitCell.field))) {
+		Unit *possibleEnemy = unitCell.unit;
 
-			//check enemy
-			if(possibleEnemy != NULL && possibleEnemy->isAlive()) {
-				if((unit->isAlly(possibleEnemy) == false && commandTarget == NULL) ||
-					commandTarget == possibleEnemy) {
+		//check enemy
+		if(possibleEnemy != NULL && possibleEnemy->isAlive()) {
+			if((unit->isAlly(possibleEnemy) == false && commandTarget == NULL) ||
+				commandTarget == possibleEnemy) {
 
-					enemies.push_back(possibleEnemy);
-				}
+				enemies.push_back(possibleEnemy);
 			}
 		}
 	}
 }
 
 void UnitUpdater::findEnemiesForCell(const Vec2i pos, int size, int sightRange, const Faction *faction, vector<Unit*> &enemies, bool attackersOnly) const {
+	vector<UnitSpatialIndex::Entry> boxCells;
+	map->getUnitSpatialIndex()->findUnitCells(Vec2i(pos.x - sightRange, pos.y - sightRange),
+			Vec2i(pos.x + size + sightRange - 1, pos.y + size + sightRange - 1), boxCells);
+
 	//all fields
 	for(int k = 0; k < fieldCount; k++) {
 		Field f= static_cast<Field>(k);
 
-		for(int i = pos.x - sightRange; i < pos.x + size + sightRange; ++i) {
-			for(int j = pos.y - sightRange; j < pos.y + size + sightRange; ++j) {
-				Vec2i testPos(i,j);
-				if( map->isInside(testPos) &&
-						map->isInsideSurface(map->toSurfCoords(testPos))) {
-					Cell *cell = map->getCell(testPos);
-					//check field
-					Unit *possibleEnemy = cell->getUnit(f);
-
-					//check enemy
-					if(possibleEnemy != NULL && possibleEnemy->isAlive()) {
-						if(faction->getTeam() != possibleEnemy->getTeam()) {
-							if(attackersOnly == true) {
-								if(possibleEnemy->getType()->hasCommandClass(ccAttack) || possibleEnemy->getType()->hasCommandClass(ccAttackStopped)) {
-									enemies.push_back(possibleEnemy);
-								}
-							}
-							else {
-								enemies.push_back(possibleEnemy);
-							}
+		for(unsigned int i = 0; i < boxCells.size(); ++i) {
+			if(boxCells[i].field != f ||
+				map->isInsideSurface(map->toSurfCoords(boxCells[i].pos)) == false) {
+				continue;
+			}
+			Unit *possibleEnemy = boxCells[i].unit;
+
+			//check enemy
+			if(possibleEnemy != NULL && possibleEnemy->isAlive()) {
+				if(faction->getTeam() != possibleEnemy->getTeam()) {
+					if(attackersOnly == true) {
+						if(possibleEnemy->getType()->hasCommandClass(ccAttack) || possibleEnemy->getType()->hasCommandClass(ccAttackStopped)) {
+							enemies.push_back(possibleEnemy);
 						}
 					}
+					else {
+						enemies.push_back(possibleEnemy);
+					}
 				}
 			}
 		}
@@ -2301,35 +2292,11 @@ bool UnitUpdater::unitOnRange(Unit *unit, int range, Unit **rangedPtr,
 	Vec2i center 		= unit->getPos();
 	Vec2f floatCenter	= unit->getFloatCenteredPos();
 
-	//bool foundInCache = true;
-	if(findCachedCellsEnemies(center,range,size,enemies,ast,
-							  unit,commandTarget) == false) {
-		//foundInCache = false;
-		//nearby cells
-		UnitRangeCellsLookupItem cacheItem;
-		for(int i = center.x - range; i < center.x + range + size; ++i) {
-			for(int j = center.y - range; j < center.y + range + size; ++j) {
-				//cells inside map and in range
-#ifdef USE_STREFLOP
-				if(map->isInside(i, j) && streflop::floor(static_cast<streflop::Simple>(floatCenter.dist(Vec2f((float)i, (float)j)))) <= (range+1)){
-#else
-				if(map->isInside(i, j) && floor(floatCenter.dist(Vec2f((float)i, (float)j))) <= (range+1)){
-#endif
-					Cell *cell = map->getCell(i,j);
-					findEnemiesForCell(ast,cell,unit,commandTarget,enemies);
-
-					cacheItem.rangeCellList.push_back(cell);
-				}
-			}
-		}
-
-		// Ok update our caches with the latest info
-		if(cacheItem.rangeCellList.empty() == false) {
-			MutexSafeWrapper safeMutex(&mutexUnitRangeCellsLookupItemCache,string(__FILE__) + "_" + intToStr(__LINE__));
-
-			//cacheItem.UnitRangeCellsLookupItemCacheTimerCountIndex = UnitRangeCellsLookupItemCacheTimerCount++;
-			UnitRangeCellsLookupItemCache[center][size][range] = cacheItem;
-		}
+	//nearby cells
+	vector<UnitSpatialIndex::Entry> unitCells;
+	findUnitCellsInRange(center,range,size,floatCenter,unitCells);
+	for(unsigned int i = 0; i < unitCells.size(); ++i) {
+		findEnemiesForCell(ast,unitCells[i],unit,commandTarget,enemies);
 	}
 
 	//attack enemies that can attack first
@@ -2492,57 +2459,17 @@ vector<Unit*> UnitUpdater::enemyUnitsOnRange(const Unit *unit,const AttackSkillT
 	Vec2i center 		= unit->getPosNotThreadSafe();
 	Vec2f floatCenter	= unit->getFloatCenteredPos();
 
-	//bool foundInCache = true;
-	if(findCachedCellsEnemies(center,range,size,enemies,ast,
-							  unit,commandTarget) == false) {
-		//foundInCache = false;
-		//nearby cells
-		UnitRangeCellsLookupItem cacheItem;
-		for(int i = center.x - range; i < center.x + range + size; ++i) {
-			for(int j = center.y - range; j < center.y + range + size; ++j) {
-				//cells inside map and in range
-#ifdef USE_STREFLOP
-				if(map->isInside(i, j) && streflop::floor(static_cast<streflop::Simple>(floatCenter.dist(Vec2f((float)i, (float)j)))) <= (range+1)){
-#else
-				if(map->isInside(i, j) && floor(floatCenter.dist(Vec2f((float)i, (float)j))) <= (range+1)){
-#endif
-					Cell *cell = map->getCell(i,j);
-					findEnemiesForCell(ast,cell,unit,commandTarget,enemies);
-
-					cacheItem.rangeCellList.push_back(cell);
-				}
-			}
-		}
-
-		// Ok update our caches with the latest info
-		if(cacheItem.rangeCellList.empty() == false) {
-			MutexSafeWrapper safeMutex(&mutexUnitRangeCellsLookupItemCache,string(__FILE__) + "_" + intToStr(__LINE__));
-
-			//cacheItem.UnitRangeCellsLookupItemCacheTimerCountIndex = UnitRangeCellsLookupItemCacheTimerCount++;
-			UnitRangeCellsLookupItemCache[center][size][range] = cacheItem;
-		}
+	//nearby cells
+	vector<UnitSpatialIndex::Entry> unitCells;
+	findUnitCellsInRange(center,range,size,floatCenter,unitCells);
+	for(unsigned int i = 0; i < unitCells.size(); ++i) {
+		findEnemiesForCell(ast,unitCells[i],unit,commandTarget,enemies);
 	}
 
 	return enemies;
 }
 
 
-void UnitUpdater::findUnitsForCell(Cell *cell, const Unit *unit,vector<Unit*> &units) {
-	//all fields
-	if(cell != NULL) {
-		for(int k = 0; k < fieldCount; k++) {
-			Field f= static_cast<Field>(k);
-
-			//check field
-			Unit *cellUnit = cell->getUnit(f);
-
-			if(cellUnit != NULL && cellUnit->isAlive()) {
-				units.push_back(cellUnit);
-			}
-		}
-	}
-}
-
 vector<Unit*> UnitUpdater::findUnitsInRange(const Unit *unit, int radius) {
 	int range = radius;
 	vector<Unit*> units;
@@ -2553,60 +2480,18 @@ vector<Unit*> UnitUpdater::findUnitsInRange(const Unit *unit, int radius) {
 	Vec2f floatCenter	= unit->getFloatCenteredPos();
 
 	//nearby cells
-	//UnitRangeCellsLookupItem cacheItem;
-	for(int i = center.x - range; i < center.x + range + size; ++i) {
-		for(int j = center.y - range; j < center.y + range + size; ++j) {
-			//cells inside map and in range
-#ifdef USE_STREFLOP
-			if(map->isInside(i, j) && streflop::floor(static_cast<streflop::Simple>(floatCenter.dist(Vec2f((float)i, (float)j)))) <= (range+1)){
-#else
-			if(map->isInside(i, j) && floor(floatCenter.dist(Vec2f((float)i, (float)j))) <= (range+1)){
-#endif
-				Cell *cell = map->getCell(i,j);
-				findUnitsForCell(cell,unit,units);
-			}
+	vector<UnitSpatialIndex::Entry> unitCells;
+	findUnitCellsInRange(center,range,size,floatCenter,unitCells);
+	for(unsigned int i = 0; i < unitCells.size(); ++i) {
+		Unit *cellUnit = unitCells[i].unit;
+		if(cellUnit != NULL && cellUnit->isAlive()) {
+			units.push_back(cellUnit);
 		}
 	}
 
 	return units;
 }
 
-string UnitUpdater::getUnitRangeCellsLookupItemCacheStats() {
-	string result = "";
-
-	int posCount = 0;
-	int sizeCount = 0;
-	int rangeCount = 0;
-	int rangeCountCellCount = 0;
-
-	MutexSafeWrapper safeMutex(&mutexUnitRangeCellsLookupItemCache,string(__FILE__) + "_" + intToStr(__LINE__));
-	//std::map<Vec2i, std::map<int, std::map<int, UnitRangeCellsLookupItem > > > UnitRangeCellsLookupItemCache;
-	for(std::map<Vec2i, std::map<int, std::map<int, UnitRangeCellsLookupItem > > >::iterator iterMap1 = UnitRangeCellsLookupItemCache.begin();
-		iterMap1 != UnitRangeCellsLookupItemCache.end(); ++iterMap1) {
-		posCount++;
-
-		for(std::map<int, std::map<int, UnitRangeCellsLookupItem > >::iterator iterMap2 = iterMap1->second.begin();
-			iterMap2 != iterMap1->second.end(); ++iterMap2) {
-			sizeCount++;
-
-			for(std::map<int, UnitRangeCellsLookupItem>::iterator iterMap3 = iterMap2->second.begin();
-				iterMap3 != iterMap2->second.end(); ++iterMap3) {
-				rangeCount++;
-
-				rangeCountCellCount += iterMap3->second.rangeCellList.size();
-			}
-		}
-	}
-
-	uint64 totalBytes = rangeCountCellCount * sizeof(Cell *);
-	totalBytes /= 1000;
-
-	char szBuf[8096]="";
-	snprintf(szBuf,8096,"pos [%d] size [%d] range [%d][%d] total KB: %s",posCount,sizeCount,rangeCount,rangeCountCellCount,formatNumber(totalBytes).c_str());
-	result = szBuf;
-	return result;
-}
-
 void UnitUpdater::saveGame(XmlNode *rootNode) {
 	std::map<string,string> mapTagReplacements;
 	XmlNode *unitupdaterNode = rootNode->addChild("UnitUpdater");
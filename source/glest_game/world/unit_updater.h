@@ -21,6 +21,7 @@
 #include "particle.h"
 #include "randomgen.h"
 #include "command.h"
+#include "unit_spatial_index.h"
 #include "leak_dumper.h"
 
 using Shared::Graphics::ParticleObserver;
@@ -44,15 +45,6 @@ class PathFinder;
 class ParticleDamager;
 class Cell;
 
-class UnitRangeCellsLookupItem {
-public:
-
-	//int UnitRangeCellsLookupItemCacheTimerCountIndex;
-	std::vector<Cell *> rangeCellList;
-
-	static time_t lastDebug;
-};
-
 class AttackWarningData {
 public:
 	Vec2f attackPosition;
@@ -84,17 +76,10 @@ private:
 	float attackWarnRange;
 	AttackWarnings attackWarnings;
 
-	Mutex mutexUnitRangeCellsLookupItemCache;
-	std::map<Vec2i, std::map<int, std::map<int, UnitRangeCellsLookupItem > > > UnitRangeCellsLookupItemCache;
-	//std::map<int,ExploredCellsLookupKey> ExploredCellsLookupItemCacheTimer;
-	//int UnitRangeCellsLookupItemCacheTimerCount;
-
-	bool findCachedCellsEnemies(Vec2i center, int range,
-								int size, vector<Unit*> &enemies,
-								const AttackSkillType *ast, const Unit *unit,
-								const Unit *commandTarget);
-	void findEnemiesForCell(const AttackSkillType *ast, Cell *cell, const Unit *unit,
-							const Unit *commandTarget,vector<Unit*> &enemies);
+	void findUnitCellsInRange(const Vec2i &center, int range, int size, const Vec2f &floatCenter,
+							  vector<UnitSpatialIndex::Entry> &unitCells) const;
+	void findEnemiesForCell(const AttackSkillType *ast, const UnitSpatialIndex::Entry &unitCell, const Unit *unit,
+							const Unit *commandTarget,vector<Unit*> &enemies) const;
 
 public:
 	UnitUpdater();
@@ -121,6 +106,8 @@ public:
 
 	void clearUnitPrecache(Unit *unit);
 	void removeUnitPrecache(Unit *unit);
+	void addPreprocessChunk(Faction *faction, int chunkIndex, const vector<Unit *> &units, int frameIndex);
+	void applyPreprocessChunks();
 
 	inline unsigned int getAttackWarningCount() const { return attackWarnings.size(); }
 	std::pair<bool,Unit *> unitBeingAttacked(const Unit *unit);
@@ -128,11 +115,8 @@ public:
 	vector<Unit*> enemyUnitsOnRange(const Unit *unit,const AttackSkillType *ast);
 	void findEnemiesForCell(const Vec2i pos, int size, int sightRange, const Faction *faction, vector<Unit*> &enemies, bool attackersOnly) const;
 
-	void findUnitsForCell(Cell *cell, const Unit *unit,vector<Unit*> &units);
 	vector<Unit*> findUnitsInRange(const Unit *unit, int radius);
 
-	string getUnitRangeCellsLookupItemCacheStats();
-
 	void saveGame(XmlNode *rootNode);
 	void loadGame(const XmlNode *rootNode);
 
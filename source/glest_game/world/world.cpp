@@ -25,6 +25,8 @@
 #include <iostream>
 #include "sound.h"
 #include "sound_renderer.h"
+#include "benchmark.h"
+#include "game_trace.h"
 
 #include "leak_dumper.h"
 
@@ -38,9 +40,6 @@ namespace Glest{ namespace Game{
 // =====================================================
 
 const float World::airHeight= 5.f;
-// This limit is to keep RAM use under control while offering better performance.
-int MaxExploredCellsLookupItemCache = 9500;
-time_t ExploredCellsLookupItem::lastDebug = 0;
 
 // ===================== PUBLIC ========================
 
@@ -51,9 +50,6 @@ World::World() {
 	staggeredFactionUpdates = config.getBool("StaggeredFactionUpdates","false");
 	unitParticlesEnabled=config.getBool("UnitParticles","true");
 
-	ExploredCellsLookupItemCache.clear();
-	ExploredCellsLookupItemCacheTimer.clear();
-	ExploredCellsLookupItemCacheTimerCount = 0;
 	// Disable this cache as it takes too much RAM (not sure if its worth the performance gain)
 	enableFowAlphaCellsLookupItemCache = config.getBool("EnableFowCache","true");
 
@@ -65,8 +61,6 @@ World::World() {
 	fogOfWarSmoothing= config.getBool("FogOfWarSmoothing");
 	fogOfWarSmoothingFrameSkip= config.getInt("FogOfWarSmoothingFrameSkip");
 
-	MaxExploredCellsLookupItemCache= config.getInt("MaxExploredCellsLookupItemCache",intToStr(MaxExploredCellsLookupItemCache).c_str());
-
 	frameCount= 0;
 	//nextUnitId= 0;
 
@@ -83,6 +77,7 @@ World::World() {
 	disableAttackEffects = false;
 
 	loadWorldNode = NULL;
+	jobSystem = NULL;
 
 	if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d]\n",__FILE__,__FUNCTION__,__LINE__);
 }
@@ -90,8 +85,6 @@ World::World() {
 void World::cleanup() {
 	if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d]\n",__FILE__,__FUNCTION__,__LINE__);
 
-	ExploredCellsLookupItemCache.clear();
-	ExploredCellsLookupItemCacheTimer.clear();
 	//FowAlphaCellsLookupItemCache.clear();
 
 	if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d]\n",__FILE__,__FUNCTION__,__LINE__);
@@ -101,6 +94,8 @@ void World::cleanup() {
 	}
 
 	masterController.clearSlaves(true);
+	delete jobSystem;
+	jobSystem = NULL;
 	if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d]\n",__FILE__,__FUNCTION__,__LINE__);
 	for(int i= 0; i<factions.size(); ++i){
 		delete factions[i];
@@ -149,9 +144,6 @@ void World::endScenario() {
 	if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d]\n",__FILE__,__FUNCTION__,__LINE__);
     Logger::getInstance().add(Lang::getInstance().get("LogScreenGameUnLoadingWorld","",true), true);
 
-    ExploredCellsLookupItemCache.clear();
-    ExploredCellsLookupItemCacheTimer.clear();
-
 	fogOfWarOverride = false;
 	originalGameFogOfWar = fogOfWar;
 	fogOfWarSkillTypeValue = -1;
@@ -166,14 +158,13 @@ void World::end(){
 	if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d]\n",__FILE__,__FUNCTION__,__LINE__);
     Logger::getInstance().add(Lang::getInstance().get("LogScreenGameUnLoadingWorld","",true), true);
 
-    ExploredCellsLookupItemCache.clear();
-    ExploredCellsLookupItemCacheTimer.clear();
-
 	for(int i= 0; i<factions.size(); ++i){
 		factions[i]->end();
 	}
 
 	masterController.clearSlaves(true);
+	delete jobSystem;
+	jobSystem = NULL;
 	for(int i= 0; i<factions.size(); ++i){
 		delete factions[i];
 	}
@@ -285,9 +276,6 @@ void World::init(Game *game, bool createUnits, bool initFactions){
 
 	if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d]\n",__FILE__,__FUNCTION__,__LINE__);
 
-	ExploredCellsLookupItemCache.clear();
-	ExploredCellsLookupItemCacheTimer.clear();
-
 	this->game = game;
 	scriptManager= game->getScriptManager();
 
@@ -368,6 +356,7 @@ void World::init(Game *game, bool createUnits, bool initFactions){
 					}
 		        }
 		    }
+			fogOfWarMap.invalidate();
 		}
 
 		minimap.loadGame(loadWorldNode);
@@ -484,13 +473,18 @@ void World::updateAllTilesetObjects() {
 }
 
 void World::updateAllFactionUnits() {
-	bool showPerfStats = Config::getInstance().getBool("ShowPerfStats","false");
+	BenchmarkPhaseTimer benchmarkTimer(bpUnits);
+	TRACE_SCOPE_ARGS(tevUpdateAllFactionUnits,frameCount,getFactionCount());
+	bool showPerfStats = Config::getCachedValues().showPerfStats;
 	Chrono chronoPerf;
 	if(showPerfStats) chronoPerf.start();
 	char perfBuf[8096]="";
 	std::vector<string> perfList;
 
-	scriptManager->onTimerTriggerEvent();
+	{
+		BenchmarkPhaseTimer benchmarkScriptTimer(bpScript);
+		scriptManager->onTimerTriggerEvent();
+	}
 
 	// Prioritize grouped command units so closest units to target go first
 	// units
@@ -512,11 +506,12 @@ void World::updateAllFactionUnits() {
 //		}
 //	}
 
-	// Clear pathfinder list restrictions
+	// Clear pathfinder list restrictions, units do not move until the
+	// pre-processing is done so the cell states can be cached meanwhile
 	for(int i = 0; i < factionCount; ++i) {
 		Faction *faction = getFaction(i);
 		faction->clearUnitsPathfinding();
-		faction->clearAproxCanMoveSoonCached();
+		faction->getAproxCellStateCache()->beginFrame(map.getW() * map.getH());
 	}
 
 	if(showPerfStats) {
@@ -527,7 +522,7 @@ void World::updateAllFactionUnits() {
 	Chrono chrono;
 	chrono.start();
 
-	const bool newThreadManager = Config::getInstance().getBool("EnableNewThreadManager","false");
+	const bool newThreadManager = Config::getCachedValues().enableNewThreadManager;
 	if(newThreadManager == true) {
 		masterController.signalSlaves(&frameCount);
 		bool slavesCompleted = masterController.waitTillSlavesTrigger(20000);
@@ -540,11 +535,42 @@ void World::updateAllFactionUnits() {
 		}
 
 	}
-	else {
-		// Signal the faction threads to do any pre-processing
+	else if(jobSystem != NULL) {
+		// Large factions are split into fixed-size unit chunks so the workers
+		// can share one big army, every other faction is a single job. Each
+		// chunk searches on its own pathfinder state which is merged back in
+		// chunk order once all jobs are done. AI factions stay whole since
+		// their per frame pathfinding limit depends on the unit order.
+		// Largest factions are queued first so a big army does not start last.
+		const int UNIT_PREPROCESS_CHUNK_SIZE = 32;
+		vector<Faction *> jobFactions;
 		for(int i = 0; i < factionCount; ++i) {
-			Faction *faction = getFaction(i);
-			faction->signalWorkerThread(frameCount);
+			jobFactions.push_back(getFaction(i));
+		}
+		std::stable_sort(jobFactions.begin(),jobFactions.end(),FactionUnitCountSorter());
+
+		vector<FactionPreprocessJob *> factionJobs;
+		for(int i = 0; i < factionCount; ++i) {
+			Faction *faction = jobFactions[i];
+			int unitCount = faction->getUnitCount();
+			if(faction->isUnitPathfindingLimited() == true || unitCount <= UNIT_PREPROCESS_CHUNK_SIZE) {
+				factionJobs.push_back(new FactionPreprocessJob(faction,frameCount));
+				continue;
+			}
+			for(int chunkIndex = 0; chunkIndex * UNIT_PREPROCESS_CHUNK_SIZE < unitCount; ++chunkIndex) {
+				int chunkStart = chunkIndex * UNIT_PREPROCESS_CHUNK_SIZE;
+				int chunkEnd = std::min(chunkStart + UNIT_PREPROCESS_CHUNK_SIZE, unitCount);
+				vector<Unit *> chunkUnits;
+				for(int j = chunkStart; j < chunkEnd; ++j) {
+					chunkUnits.push_back(faction->getUnit(j));
+				}
+				unitUpdater.addPreprocessChunk(faction,chunkIndex,chunkUnits,frameCount);
+				factionJobs.push_back(new UnitChunkPreprocessJob(faction,frameCount,chunkUnits));
+			}
+		}
+		factionJobBarrier.reset((int)factionJobs.size());
+		for(unsigned int i = 0; i < factionJobs.size(); ++i) {
+			jobSystem->submit(factionJobs[i],&factionJobBarrier);
 		}
 
 		if(showPerfStats) {
@@ -552,31 +578,38 @@ void World::updateAllFactionUnits() {
 			perfList.push_back(perfBuf);
 		}
 
-		bool workThreadsFinished = false;
-		Chrono chrono;
-		chrono.start();
-
 		const int MAX_FACTION_THREAD_WAIT_MILLISECONDS = 20000;
-		for(;chrono.getMillis() < MAX_FACTION_THREAD_WAIT_MILLISECONDS;) {
-			workThreadsFinished = true;
-			for(int i = 0; i < factionCount; ++i) {
-				Faction *faction = getFaction(i);
-				if(faction->isWorkerThreadSignalCompleted(frameCount) == false) {
-					workThreadsFinished = false;
-					break;
-				}
+		try {
+			bool workThreadsFinished = jobSystem->waitForJobs(&factionJobBarrier,MAX_FACTION_THREAD_WAIT_MILLISECONDS);
+			if(workThreadsFinished == false) {
+				// the units must not be updated while jobs still use them
+				SystemFlags::OutputDebug(SystemFlags::debugError,"In [%s::%s Line: %d] Faction jobs still running after %d msecs for frameCount = %d\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,MAX_FACTION_THREAD_WAIT_MILLISECONDS,frameCount);
+				jobSystem->waitForJobs(&factionJobBarrier);
 			}
-			if(workThreadsFinished == true) {
-				break;
+		}
+		catch(...) {
+			// waitForJobs only throws once every job has finished
+			for(unsigned int i = 0; i < factionJobs.size(); ++i) {
+				delete factionJobs[i];
 			}
+			unitUpdater.applyPreprocessChunks();
+			throw;
+		}
+		for(unsigned int i = 0; i < factionJobs.size(); ++i) {
+			delete factionJobs[i];
 		}
+		unitUpdater.applyPreprocessChunks();
 
 		if(showPerfStats) {
 			sprintf(perfBuf,"In [%s::%s] Line: %d took msecs: " MG_I64_SPECIFIER "\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,chronoPerf.getMillis());
 			perfList.push_back(perfBuf);
 		}
 
-		if(SystemFlags::VERBOSE_MODE_ENABLED && chrono.getMillis() >= 10) printf("In [%s::%s Line: %d] *** Faction thread preprocessing took [%lld] msecs for %d factions for frameCount = %d.\n",__FILE__,__FUNCTION__,__LINE__,(long long int)chrono.getMillis(),factionCount,frameCount);
+		if(SystemFlags::VERBOSE_MODE_ENABLED && chrono.getMillis() >= 10) printf("In [%s::%s Line: %d] *** Faction job preprocessing took [%lld] msecs for %d factions for frameCount = %d.\n",__FILE__,__FUNCTION__,__LINE__,(long long int)chrono.getMillis(),factionCount,frameCount);
+	}
+
+	for(int i = 0; i < factionCount; ++i) {
+		getFaction(i)->getAproxCellStateCache()->endFrame();
 	}
 
 	if(showPerfStats) {
@@ -739,13 +772,21 @@ void World::updateAllFactionConsumableCosts() {
 void World::update() {
 
 	if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d]\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__);
-	bool showPerfStats = Config::getInstance().getBool("ShowPerfStats","false");
+	bool showPerfStats = Config::getCachedValues().showPerfStats;
 	Chrono chronoPerf;
 	char perfBuf[8096]="";
 	std::vector<string> perfList;
 	if(showPerfStats) chronoPerf.start();
 
 	++frameCount;
+	TRACE_SCOPE_ARG(tevWorldUpdate,frameCount);
+	if(Tracer::isEnabled() == true) {
+		int unitCount = 0;
+		for(int i = 0; i < getFactionCount(); ++i) {
+			unitCount += getFaction(i)->getUnitCount();
+		}
+		TRACE_COUNTER(tevUnitCount,unitCount);
+	}
 
 	//time
 	timeFlow.update();
@@ -880,7 +921,8 @@ int World::tickFactionIndex() {
 }
 
 void World::tick() {
-	bool showPerfStats = Config::getInstance().getBool("ShowPerfStats","false");
+	TRACE_SCOPE_ARG(tevWorldTick,frameCount);
+	bool showPerfStats = Config::getCachedValues().showPerfStats;
 	Chrono chronoPerf;
 	char perfBuf[8096]="";
 	std::vector<string> perfList;
@@ -1045,6 +1087,7 @@ void World::moveUnitCells(Unit *unit) {
 	if(unit == NULL) {
     	throw megaglest_runtime_error("unit == NULL");
     }
+	TRACE_SCOPE_ARG(tevUnitMoveCells,unit->getId());
 
 	Vec2i newPos= unit->getTargetPos();
 
@@ -1070,6 +1113,7 @@ void World::moveUnitCells(Unit *unit) {
 		}
 	}
 
+	BenchmarkPhaseTimer benchmarkTimer(bpScript);
 	scriptManager->onCellTriggerEvent(unit);
 }
 
@@ -1550,10 +1594,6 @@ void World::moveToUnit(int unitId, int destUnitId) {
 }
 
 void World::clearCaches() {
-	ExploredCellsLookupItemCache.clear();
-	ExploredCellsLookupItemCacheTimer.clear();
-	ExploredCellsLookupItemCacheTimerCount = 0;
-
 	unitUpdater.clearCaches();
 }
 
@@ -1810,6 +1850,7 @@ void World::initCells(bool fogOfWar) {
 			}
 		}
     }
+	fogOfWarMap.init(&map, indirectSightRange);
     if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d]\n",__FILE__,__FUNCTION__,__LINE__);
 }
 
@@ -1908,6 +1949,11 @@ void World::initFactionTypes(GameSettings *gs) {
 		}
 		masterController.setSlaves(slaveThreadList);
 	}
+	else if(gs->getPathFinderType() == pfBasic &&
+			Config::getInstance().getBool("EnableFactionWorkerThreads","true") == true) {
+		delete jobSystem;
+		jobSystem = new JobSystem(Config::getInstance().getInt("FactionJobWorkerThreads","-1"));
+	}
 
 	if(loadWorldNode != NULL) {
 		stats.loadGame(loadWorldNode);
@@ -2150,128 +2196,10 @@ void World::initMap() {
 // ==================== exploration ====================
 
 void World::exploreCells(const Vec2i &newPos, int sightRange, int teamIndex) {
-	//bool cacheLookupPosResult 	= false;
-	//bool cacheLookupSightResult = false;
-
-	// cache lookup of previously calculated cells + sight range
-	//if(MaxExploredCellsLookupItemCache > 0 && game->isMasterserverMode() == false) {
-	if(MaxExploredCellsLookupItemCache > 0) {
-		if(difftime(time(NULL),ExploredCellsLookupItem::lastDebug) >= 10) {
-			ExploredCellsLookupItem::lastDebug = time(NULL);
-			//printf("In [%s::%s Line: %d] ExploredCellsLookupItemCache.size() = %d\n",__FILE__,__FUNCTION__,__LINE__,ExploredCellsLookupItemCache.size());
-			if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d] ExploredCellsLookupItemCache.size() = %d\n",__FILE__,__FUNCTION__,__LINE__,ExploredCellsLookupItemCache.size());
-			if(SystemFlags::getSystemSettingType(SystemFlags::debugPerformance).enabled) SystemFlags::OutputDebug(SystemFlags::debugPerformance,"In [%s::%s Line: %d] ExploredCellsLookupItemCache.size() = %d\n",__FILE__,__FUNCTION__,__LINE__,ExploredCellsLookupItemCache.size());
-		}
-
-		// Ok we limit the cache size due to possible RAM constraints when
-		// the threshold is met
-		bool MaxExploredCellsLookupItemCacheTriggered = false;
-		if(ExploredCellsLookupItemCache.size() >= MaxExploredCellsLookupItemCache) {
-			MaxExploredCellsLookupItemCacheTriggered = true;
-			// Snag the oldest entry in the list
-			std::map<int,ExploredCellsLookupKey>::reverse_iterator purgeItem = ExploredCellsLookupItemCacheTimer.rbegin();
-
-			ExploredCellsLookupItemCache[purgeItem->second.pos].erase(purgeItem->second.sightRange);
-
-			if(ExploredCellsLookupItemCache[purgeItem->second.pos].size() == 0) {
-				ExploredCellsLookupItemCache.erase(purgeItem->second.pos);
-			}
-
-			ExploredCellsLookupItemCacheTimer.erase(purgeItem->first);
-		}
-
-		// Check the cache for the pos, sightrange and use from
-		// cache if already found
-		std::map<Vec2i, std::map<int, ExploredCellsLookupItem> >::iterator iterFind = ExploredCellsLookupItemCache.find(newPos);
-		if(iterFind != ExploredCellsLookupItemCache.end()) {
-			//cacheLookupPosResult = true;
-
-			std::map<int, ExploredCellsLookupItem>::iterator iterFind2 = iterFind->second.find(sightRange);
-			if(iterFind2 != iterFind->second.end()) {
-				//cacheLookupSightResult = true;
-
-				std::vector<SurfaceCell *> &cellList = iterFind2->second.exploredCellList;
-				for(int idx2 = 0; idx2 < cellList.size(); ++idx2) {
-					SurfaceCell *sc = cellList[idx2];
-					sc->setExplored(teamIndex, true);
-				}
-				cellList = iterFind2->second.visibleCellList;
-				for(int idx2 = 0; idx2 < cellList.size(); ++idx2) {
-					SurfaceCell *sc = cellList[idx2];
-					sc->setVisible(teamIndex, true);
-				}
-
-				// Only start worrying about updating the cache timer if we
-				// have hit the threshold
-				if(MaxExploredCellsLookupItemCacheTriggered == true) {
-					// Remove the old timer entry since the search key id is stale
-					ExploredCellsLookupItemCacheTimer.erase(iterFind2->second.ExploredCellsLookupItemCacheTimerCountIndex);
-					iterFind2->second.ExploredCellsLookupItemCacheTimerCountIndex = ExploredCellsLookupItemCacheTimerCount++;
-
-					ExploredCellsLookupKey lookupKey;
-					lookupKey.pos = newPos;
-					lookupKey.sightRange = sightRange;
-					lookupKey.teamIndex = teamIndex;
-
-					// Add a new search key since we just used this item
-					ExploredCellsLookupItemCacheTimer[iterFind2->second.ExploredCellsLookupItemCacheTimerCountIndex] = lookupKey;
-				}
-
-				return;
-			}
-		}
-	}
-
 	Vec2i newSurfPos= Map::toSurfCoords(newPos);
 	int surfSightRange= sightRange/Map::cellScale+1;
 
-	// Explore, this code is quite expensive when we have lots of units
-	ExploredCellsLookupItem item;
-
-	int loopCount = 0;
-    for(int i = -surfSightRange - indirectSightRange -1; i <= surfSightRange + indirectSightRange +1; ++i) {
-        for(int j = -surfSightRange - indirectSightRange -1; j <= surfSightRange + indirectSightRange +1; ++j) {
-        	loopCount++;
-        	Vec2i currRelPos= Vec2i(i, j);
-            Vec2i currPos= newSurfPos + currRelPos;
-            if(map.isInsideSurface(currPos)){
-				SurfaceCell *sc= map.getSurfaceCell(currPos);
-				if(sc == NULL) {
-					throw megaglest_runtime_error("sc == NULL");
-				}
-
-				//explore
-				float posLength = currRelPos.length();
-				//if(Vec2i(0).dist(currRelPos) < surfSightRange + indirectSightRange + 1) {
-				if(posLength < surfSightRange + indirectSightRange + 1) {
-                    sc->setExplored(teamIndex, true);
-                    item.exploredCellList.push_back(sc);
-				}
-
-				//visible
-				//if(Vec2i(0).dist(currRelPos) < surfSightRange) {
-				if(posLength < surfSightRange) {
-					sc->setVisible(teamIndex, true);
-					item.visibleCellList.push_back(sc);
-				}
-            }
-        }
-    }
-
-    // Ok update our caches with the latest info for this position, sight and team
-    if(MaxExploredCellsLookupItemCache > 0) {
-		if(item.exploredCellList.empty() == false || item.visibleCellList.empty() == false) {
-			//ExploredCellsLookupItemCache.push_back(item);
-			item.ExploredCellsLookupItemCacheTimerCountIndex = ExploredCellsLookupItemCacheTimerCount++;
-			ExploredCellsLookupItemCache[newPos][sightRange] = item;
-
-			ExploredCellsLookupKey lookupKey;
-			lookupKey.pos 			= newPos;
-			lookupKey.sightRange 	= sightRange;
-			lookupKey.teamIndex 	= teamIndex;
-			ExploredCellsLookupItemCacheTimer[item.ExploredCellsLookupItemCacheTimerCountIndex] = lookupKey;
-		}
-    }
+	fogOfWarMap.exploreCells(newSurfPos, surfSightRange, teamIndex);
 }
 
 bool World::showWorldForPlayer(int factionIndex, bool excludeFogOfWarCheck) const {
@@ -2318,9 +2246,11 @@ bool World::showWorldForPlayer(int factionIndex, bool excludeFogOfWarCheck) cons
 
 //computes the fog of war texture, contained in the minimap
 void World::computeFow(int factionIdxToTick) {
+	BenchmarkPhaseTimer benchmarkTimer(bpFow);
+	TRACE_SCOPE_ARG(tevComputeFow,factionIdxToTick);
 	if(SystemFlags::VERBOSE_MODE_ENABLED) printf("In [%s::%s] Line: %d in frame: %d\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,getFrameCount());
 
-	bool showPerfStats = Config::getInstance().getBool("ShowPerfStats","false");
+	bool showPerfStats = Config::getCachedValues().showPerfStats;
 	Chrono chronoPerf;
 	char perfBuf[8096]="";
 	std::vector<string> perfList;
@@ -2339,36 +2269,38 @@ void World::computeFow(int factionIdxToTick) {
 	//reset cells
 	if(factionIdxToTick == -1 || factionIdxToTick == this->thisFactionIndex) {
 		if(SystemFlags::VERBOSE_MODE_ENABLED) printf("In [%s::%s] Line: %d in frame: %d\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,getFrameCount());
-		for(int i = 0; i < map.getSurfaceW(); ++i) {
-			for(int j = 0; j < map.getSurfaceH(); ++j) {
-				for(int k = 0; k < GameConstants::maxPlayers + GameConstants::specialFactions; ++k) {
-					if(fogOfWar || k != thisTeamIndex) {
-						map.getSurfaceCell(i, j)->setVisible(k, false);
-						if(showWorldForPlayer(k) == true) {
-							const Vec2i pos(i,j);
-							Vec2i surfPos= pos;
-
-							//compute max alpha
-							float maxAlpha= 0.0f;
-							if(surfPos.x > 1 && surfPos.y > 1 &&
-                               surfPos.x < map.getSurfaceW() - 2 &&
-                               surfPos.y < map.getSurfaceH() - 2) {
-								maxAlpha= 1.f;
-							}
-							else if(surfPos.x > 0 && surfPos.y > 0 &&
-                                    surfPos.x < map.getSurfaceW() - 1 &&
-                                    surfPos.y < map.getSurfaceH() - 1){
-								maxAlpha= 0.3f;
-							}
+		// visibility only changes for sights that moved since the last update
+		fogOfWarMap.beginUpdate(fogOfWar, thisTeamIndex);
 
-							//compute alpha
-							float alpha=maxAlpha;
-							minimap.incFowTextureAlphaSurface(surfPos, alpha);
-						}
-						//else {
-						//	map.getSurfaceCell(i, j)->setVisible(k, false);
-						//}
+		bool showWorldForAnyTeam = false;
+		for(int k = 0; k < GameConstants::maxPlayers + GameConstants::specialFactions; ++k) {
+			if((fogOfWar || k != thisTeamIndex) && showWorldForPlayer(k) == true) {
+				showWorldForAnyTeam = true;
+				break;
+			}
+		}
+		if(showWorldForAnyTeam == true) {
+			for(int i = 0; i < map.getSurfaceW(); ++i) {
+				for(int j = 0; j < map.getSurfaceH(); ++j) {
+					const Vec2i pos(i,j);
+					Vec2i surfPos= pos;
+
+					//compute max alpha
+					float maxAlpha= 0.0f;
+					if(surfPos.x > 1 && surfPos.y > 1 &&
+                       surfPos.x < map.getSurfaceW() - 2 &&
+                       surfPos.y < map.getSurfaceH() - 2) {
+						maxAlpha= 1.f;
+					}
+					else if(surfPos.x > 0 && surfPos.y > 0 &&
+                            surfPos.x < map.getSurfaceW() - 1 &&
+                            surfPos.y < map.getSurfaceH() - 1){
+						maxAlpha= 0.3f;
 					}
+
+					//compute alpha
+					float alpha=maxAlpha;
+					minimap.incFowTextureAlphaSurface(surfPos, alpha);
 				}
 			}
 		}
@@ -2419,15 +2351,19 @@ void World::computeFow(int factionIdxToTick) {
 	}
 
 	//compute cells
-	for(int i=0; i<getFactionCount(); ++i) {
-		if(factionIdxToTick == -1 || factionIdxToTick == this->thisFactionIndex) {
+	if(factionIdxToTick == -1 || factionIdxToTick == this->thisFactionIndex) {
+		for(int i=0; i<getFactionCount(); ++i) {
 			for(int j=0; j<getFaction(i)->getUnitCount(); ++j) {
 				Unit *unit= getFaction(i)->getUnit(j);
 
-				//exploration
-				unit->exploreCells();
+				//exploration, same sight as Unit::exploreCells
+				if(unit->isOperative()) {
+					fogOfWarMap.updateUnitSight(unit->getId(), Map::toSurfCoords(unit->getCenteredPos()),
+							unit->getType()->getSight()/Map::cellScale+1, unit->getTeam());
+				}
 			}
 		}
+		fogOfWarMap.endUpdate();
 	}
 
 	if(showPerfStats) {
@@ -2560,36 +2496,8 @@ void World::removeResourceTargetFromCache(const Vec2i &pos) {
 	}
 }
 
-string World::getExploredCellsLookupItemCacheStats() {
-	string result = "";
-
-	int posCount = 0;
-	int sightCount = 0;
-	int exploredCellCount = 0;
-	int visibleCellCount = 0;
-
-	for(std::map<Vec2i, std::map<int, ExploredCellsLookupItem > >::iterator iterMap1 = ExploredCellsLookupItemCache.begin();
-		iterMap1 != ExploredCellsLookupItemCache.end(); ++iterMap1) {
-		posCount++;
-
-		for(std::map<int, ExploredCellsLookupItem >::iterator iterMap2 = iterMap1->second.begin();
-			iterMap2 != iterMap1->second.end(); ++iterMap2) {
-			sightCount++;
-
-			exploredCellCount += iterMap2->second.exploredCellList.size();
-			visibleCellCount += iterMap2->second.visibleCellList.size();
-		}
-	}
-
-	uint64 totalBytes = exploredCellCount * sizeof(SurfaceCell *);
-	totalBytes += visibleCellCount * sizeof(SurfaceCell *);
-
-	totalBytes /= 1000;
-
-	char szBuf[8096]="";
-	snprintf(szBuf,8096,"pos [%d] sight [%d] [%d][%d] total KB: %s",posCount,sightCount,exploredCellCount,visibleCellCount,formatNumber(totalBytes).c_str());
-	result = szBuf;
-	return result;
+string World::getFogOfWarMapStats() const {
+	return fogOfWarMap.getStats();
 }
 
 string World::getFowAlphaCellsLookupItemCacheStats() {
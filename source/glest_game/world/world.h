@@ -26,6 +26,7 @@
 #include "map.h"
 #include "scenario.h"
 #include "minimap.h"
+#include "fog_of_war_map.h"
 #include "logger.h"
 #include "stats.h"
 #include "time_flow.h"
@@ -58,32 +59,10 @@ class StrSound;
 ///	The game world: Map + Tileset + TechTree
 // =====================================================
 
-class ExploredCellsLookupKey {
-public:
-
-	Vec2i pos;
-	int sightRange;
-	int teamIndex;
-};
-
-class ExploredCellsLookupItem {
-public:
-
-	int ExploredCellsLookupItemCacheTimerCountIndex;
-	std::vector<SurfaceCell *> exploredCellList;
-	std::vector<SurfaceCell *> visibleCellList;
-
-	static time_t lastDebug;
-};
-
 class World {
 private:
 	typedef vector<Faction *> Factions;
 
-	std::map<Vec2i, std::map<int, ExploredCellsLookupItem > > ExploredCellsLookupItemCache;
-	std::map<int,ExploredCellsLookupKey> ExploredCellsLookupItemCacheTimer;
-	int ExploredCellsLookupItemCacheTimerCount;
-
 	bool enableFowAlphaCellsLookupItemCache;
 	//std::map<Vec2i, std::map<int, FowAlphaCellsLookupItem > > FowAlphaCellsLookupItemCache;
 
@@ -105,6 +84,7 @@ private:
     WaterEffects waterEffects;
     WaterEffects attackEffects; // onMiniMap
 	Minimap minimap;
+	FogOfWarMap fogOfWarMap;
     Stats stats;	//BattleEnd will delete this object
 
 	Factions factions;
@@ -146,6 +126,8 @@ private:
 	const XmlNode *loadWorldNode;
 
 	MasterSlaveThreadController masterController;
+	JobSystem *jobSystem;
+	JobBarrier factionJobBarrier;
 
 	bool originalGameFogOfWar;
 	std::map<int,std::pair<const Unit *,const FogOfWarSkillType *> > mapFogOfWarUnitList;
@@ -310,7 +292,7 @@ public:
 
 	void removeResourceTargetFromCache(const Vec2i &pos);
 
-	string getExploredCellsLookupItemCacheStats();
+	string getFogOfWarMapStats() const;
 	string getFowAlphaCellsLookupItemCacheStats();
 	string getAllFactionsCacheStats();
 
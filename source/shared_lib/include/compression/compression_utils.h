@@ -13,6 +13,7 @@
 #define _SHARED_COMPRESSION_UTIL_CHECKSUM_H_
 
 #include <string>
+#include <vector>
 
 using std::string;
 
@@ -21,6 +22,10 @@ namespace Shared{ namespace CompressionUtil{
 bool compressFileToZIPFile(string inFile, string outFile, int compressionLevel=5);
 bool extractFileFromZIPFile(string inFile, string outFile);
 
+// zlib streams in memory, outputSize is the size the input was compressed from
+bool compressMemoryToMemory(const unsigned char *input, unsigned long inputSize, std::vector<unsigned char> &output, int compressionLevel=5);
+bool extractMemoryFromMemory(const unsigned char *input, unsigned long inputSize, std::vector<unsigned char> &output, unsigned long outputSize);
+
 }};
 
 #endif
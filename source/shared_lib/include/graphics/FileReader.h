@@ -62,6 +62,15 @@ public:
 		return fileReaderByExtension;
 	}
 
+	/*Returns the readers registered for an extension or NULL. Unlike
+	 * operator[] it never inserts, so loader threads can call it while
+	 * other threads read files too
+	 */
+	static vector<FileReader<T> const * >* findFileReaders(const string &extension) {
+		typename map<string, vector<FileReader<T> const * >* >::const_iterator iterFind = getFileReadersMap().find(extension);
+		return (iterFind != getFileReadersMap().end() ? iterFind->second : NULL);
+	}
+
 	static vector<FileReader<T> const * >& getFileReaders() {
 		static vector<FileReader<T> const*> fileReaders;
 		return fileReaders;
@@ -242,7 +251,7 @@ static inline T* readFromFileReaders(vector<FileReader<T> const *>* readers, con
 template <typename T>
 T* FileReader<T>::readPath(const string& filepath) {
 	const string& extension = extractExtension(filepath);
-	vector<FileReader<T> const * >* possibleReaders = (getFileReadersMap())[extension];
+	vector<FileReader<T> const * >* possibleReaders = findFileReaders(extension);
 	if (possibleReaders != NULL) {
 		//Search in these possible readers
 		T* ret = readFromFileReaders(possibleReaders, filepath);
@@ -265,7 +274,7 @@ T* FileReader<T>::readPath(const string& filepath) {
 template <typename T>
 T* FileReader<T>::readPath(const string& filepath, T* object) {
 	const string& extension = extractExtension(filepath);
-	vector<FileReader<T> const * >* possibleReaders = (getFileReadersMap())[extension];
+	vector<FileReader<T> const * >* possibleReaders = findFileReaders(extension);
 	if (possibleReaders != NULL) {
 		//Search in these possible readers
 		T* ret = readFromFileReaders(possibleReaders, filepath, object);
@@ -31,6 +31,7 @@ namespace Shared { namespace Graphics {
 
 class Model;
 class Mesh;
+class MeshVertexData;
 class ShadowVolumeData;
 class InterpolationData;
 class TextureManager;
@@ -61,6 +62,8 @@ private:
 	Vec2f *texCoords;
 	Vec3f *tangents;
 	uint32 *indices;
+	//set when the arrays above are shared with other meshes
+	MeshVertexData *sharedVertexData;
 
 	//material data
 	Vec3f diffuseColor;
@@ -106,6 +109,7 @@ public:
 	uint32	getVBONormals() const   { return m_nVBONormals;}
 	uint32	getVBOIndexes() const   { return m_nVBOIndexes;}
 	bool    hasBuiltVBOEntities() const { return hasBuiltVBOs;}
+	bool    hasSharedVertexData() const { return sharedVertexData != NULL;}
 	void BuildVBOs();
 	void ReleaseVBOs();
 
@@ -159,6 +163,10 @@ private:
 	string findAlternateTexture(vector<string> conversionList, string textureFile);
 	void computeTangents();
 
+	bool attachSharedVertexData(const string &key, uint32 textureFlags);
+	void publishSharedVertexData(const string &key, uint32 textureFlags);
+	void releaseVertexData();
+
 };
 
 // =====================================================
@@ -213,6 +221,9 @@ public:
 	void load(const string &path,bool deletePixMapAfterLoad=false,std::map<string,vector<pair<string, string> > > *loadedFileList=NULL, string *sourceLoader=NULL);
 	void save(const string &path, string convertTextureToFormat,bool keepsmallest);
 	void loadG3d(const string &path,bool deletePixMapAfterLoad=false,std::map<string,vector<pair<string, string> > > *loadedFileList=NULL, string sourceLoader="");
+	static void getG3dTextureFileList(const string &path, vector<pair<string,int> > &textureList,
+			vector<string> *preloadedMeshList=NULL);
+	static void releasePreloadedMeshes(const vector<string> &preloadedMeshList);
 	void saveG3d(const string &path, string convertTextureToFormat,bool keepsmallest);
 
 	void setTextureManager(TextureManager *textureManager)	{this->textureManager= textureManager;}
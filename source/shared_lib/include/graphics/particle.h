@@ -13,12 +13,14 @@
 #define _SHARED_GRAPHICS_PARTICLE_H_
 
 #include <list>
+#include <set>
 #include <cassert>
 #include "vec.h"
 #include "pixmap.h"
 #include "texture_manager.h"
 #include "randomgen.h"
 #include "xml_parser.h"
+#include "job_system.h"
 #include "leak_dumper.h"
 
 using std::list;
@@ -71,6 +73,53 @@ public:
 	void loadGame(const XmlNode *rootNode);
 };
 
+// =====================================================
+//	class ParticleArrays
+//
+///	The particles of a system, one array per attribute so the
+///	update steps run over contiguous floats
+// =====================================================
+
+class ParticleArrays {
+public:
+	//attributes
+	std::vector<float> posX, posY, posZ;
+	std::vector<float> lastPosX, lastPosY, lastPosZ;
+	std::vector<float> speedX, speedY, speedZ;
+	std::vector<float> accelX, accelY, accelZ;
+	std::vector<float> colorR, colorG, colorB, colorA;
+	std::vector<float> size;
+	std::vector<int> energy;
+
+	//scratch for the update steps
+	std::vector<float> energyRatio;
+
+public:
+	void resize(int particleCount);
+	void clear();
+	int getCount() const						{return (int)energy.size();}
+
+	//get
+	Vec3f getPos(int i) const					{return Vec3f(posX[i], posY[i], posZ[i]);}
+	Vec3f getLastPos(int i) const				{return Vec3f(lastPosX[i], lastPosY[i], lastPosZ[i]);}
+	Vec4f getColor(int i) const					{return Vec4f(colorR[i], colorG[i], colorB[i], colorA[i]);}
+
+	void setParticle(int i, const Particle &p);
+	void moveParticle(int dest, int source);
+
+	//update steps over the first count particles
+	void savePositions(int count);
+	void addSpeeds(int count, bool toLastPos);
+	void addToPositions(const Vec3f &value, int count);
+	void addAccels(int count);
+	void computeEnergyRatios(int maxEnergy, int count);
+	void blendColors(const Vec4f &color, const Vec4f &colorNoEnergy, int count);
+	void scaleColors(const Vec3f &value, int count);
+	void blendSizes(float size, float sizeNoEnergy, int count);
+	void decEnergies(int count);
+	void killBelowGround(int count);
+};
+
 // =====================================================
 //	class ParticleObserver
 // =====================================================
@@ -114,7 +163,7 @@ enum ParticleSystemType {
 
 protected:
 	
-	std::vector<Particle> particles;
+	ParticleArrays particles;
 	RandomGen random;
 
 	BlendMode blendMode;
@@ -161,8 +210,10 @@ public:
 	BlendMode getBlendMode() const				{return blendMode;}
 	Texture *getTexture() const					{return texture;}
 	Vec3f getPos() const						{return pos;}
-	Particle *getParticle(int i)				{return &particles[i];}
-	const Particle *getParticle(int i) const	{return &particles[i];}
+	Vec3f getParticlePos(int i) const			{return particles.getPos(i);}
+	Vec3f getParticleLastPos(int i) const		{return particles.getLastPos(i);}
+	Vec4f getParticleColor(int i) const			{return particles.getColor(i);}
+	float getParticleSize(int i) const			{return particles.size[i];}
 	int getAliveParticleCount() const			{return aliveParticleCount;}
 	bool getActive() const						{return active;}
 	virtual bool getVisible() const				{return visible;}
@@ -185,6 +236,7 @@ public:
 	void setSpeed(float speed);
 	virtual void setActive(bool active);
 	void setObserver(ParticleObserver *particleObserver);
+	ParticleObserver *getObserver() const				{return particleObserver;}
 	virtual void setVisible(bool visible);
 	void setBlendMode(BlendMode blendMode)				{this->blendMode= blendMode;}
 	void setTeamcolorNoEnergy(bool teamcolorNoEnergy)	{this->teamcolorNoEnergy= teamcolorNoEnergy;}
@@ -209,13 +261,12 @@ public:
 
 protected:
 	//protected
-	Particle *createParticle();
-	void killParticle(Particle *p);
+	int createParticle();
+	void removeDeadParticles();
 
 	//virtual protected
 	virtual void initParticle(Particle *p, int particleIndex);
-	virtual void updateParticle(Particle *p);
-	virtual bool deathTest(Particle *p);
+	virtual void updateParticles();
 };
 
 // =====================================================
@@ -234,7 +285,7 @@ public:
 
 	//virtual
 	virtual void initParticle(Particle *p, int particleIndex);
-	virtual void updateParticle(Particle *p);
+	virtual void updateParticles();
 
 	//set params
 	void setRadius(float radius);
@@ -347,7 +398,7 @@ public:
 
 	//virtual
 	virtual void initParticle(Particle *p, int particleIndex);
-	virtual void updateParticle(Particle *p);
+	virtual void updateParticles();
 	virtual void update();
 	virtual bool getVisible() const;
 	virtual void fade();
@@ -409,7 +460,7 @@ public:
 	virtual void render(ParticleRenderer *pr, ModelRenderer *mr);
 
 	virtual void initParticle(Particle *p, int particleIndex);
-	virtual bool deathTest(Particle *p);
+	virtual void updateParticles();
 
 	void setRadius(float radius);
 	void setWind(float windAngle, float windSpeed);	
@@ -430,7 +481,7 @@ public:
 	virtual ParticleSystemType getParticleSystemType() const { return pst_SnowParticleSystem;}
 
 	virtual void initParticle(Particle *p, int particleIndex);
-	virtual bool deathTest(Particle *p);
+	virtual void updateParticles();
 
 	void setRadius(float radius);
 	void setWind(float windAngle, float windSpeed);	
@@ -506,7 +557,7 @@ public:
 	
 	virtual void update();
 	virtual void initParticle(Particle *p, int particleIndex);
-	virtual void updateParticle(Particle *p);
+	virtual void updateParticles();
 	
 	void setTrajectory(Trajectory trajectory)				{this->trajectory= trajectory;}
 	void setTrajectorySpeed(float trajectorySpeed)			{this->trajectorySpeed= trajectorySpeed;}
@@ -546,7 +597,7 @@ public:
 	
 	virtual void update();
 	virtual void initParticle(Particle *p, int particleIndex);
-	virtual void updateParticle(Particle *p);
+	virtual void updateParticles();
 	
 	virtual void initParticleSystem();
 
@@ -568,10 +619,23 @@ public:
 class ParticleManager {
 private:
 	vector<ParticleSystem *> particleSystems;
+	std::set<const ParticleSystem *> particleSystemSet;
+	// systems managed while update() runs, their address may be one a
+	// callback just freed
+	bool updating;
+	std::set<const ParticleSystem *> addedWhileUpdatingSet;
+
+	int workerCount;
+	Shared::PlatformCommon::JobSystem *jobSystem;
+	Shared::PlatformCommon::JobBarrier jobBarrier;
+
+	bool canUpdateInParallel(ParticleSystem *ps);
+	void updateParticleSystems(const vector<ParticleSystem *> &particleSystemList);
 
 public:
 	ParticleManager();
 	~ParticleManager();
+	void setWorkerCount(int workerCount);
 	void update(int renderFps=-1);
 	void render(ParticleRenderer *pr, ModelRenderer *mr) const;	
 	void manage(ParticleSystem *ps);
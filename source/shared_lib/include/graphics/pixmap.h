@@ -244,6 +244,12 @@ public:
 	//load & save
 	static Pixmap2D* loadPath(const string& path);
 	void load(const string &path);
+	bool loadPreloaded(const string &path);
+
+	// Decodes an image ahead of time, from any thread, so a later load of
+	// the same path with the same component count skips the decode
+	static void preload(const string &path, int components);
+	static void clearPreloadCache();
 	/*void loadTga(const string &path);
 	void loadBmp(const string &path);*/
 	void save(const string &path);
@@ -0,0 +1,126 @@
+// ==============================================================
+//	This file is part of Glest Shared Library (www.glest.org)
+//
+//	Copyright (C) 2009-2010 Titus Tscharntke (info@titusgames.de) and
+//                          Mark Vejvoda (mark_vejvoda@hotmail.com)
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+#ifndef _SHARED_PLATFORMCOMMON_JOBSYSTEM_H_
+#define _SHARED_PLATFORMCOMMON_JOBSYSTEM_H_
+
+#include "base_thread.h"
+#include <vector>
+#include <deque>
+#include <string>
+#include "leak_dumper.h"
+
+using namespace std;
+
+namespace Shared { namespace PlatformCommon {
+
+// =====================================================
+//	class Job
+// =====================================================
+
+class Job {
+public:
+	virtual void runJob() = 0;
+	virtual ~Job() {}
+};
+
+// =====================================================
+//	class JobBarrier
+//
+///	Counts the outstanding jobs of one batch, the waiting
+///	thread sleeps until the last job completes
+// =====================================================
+
+class JobBarrier {
+private:
+	Mutex mutex;
+	Semaphore semCompleted;
+	int pendingCount;
+	string lastError;
+
+public:
+	JobBarrier();
+
+	void reset(int jobCount);
+	void jobCompleted(const string &error);
+	bool waitTillCompleted(int waitMilliseconds=-1);
+	int getPendingCount();
+	string getLastError();
+};
+
+class JobSystem;
+
+// =====================================================
+//	class JobWorkerThread
+// =====================================================
+
+class JobWorkerThread : public BaseThread {
+protected:
+	JobSystem *jobSystem;
+	int workerIndex;
+
+public:
+	JobWorkerThread(JobSystem *jobSystem, int workerIndex);
+	virtual void execute();
+};
+
+// =====================================================
+//	class JobSystem
+//
+///	Pool of worker threads with one job queue each, an
+///	idle worker steals the oldest job of another queue
+// =====================================================
+
+class JobSystem {
+private:
+	class JobEntry {
+	public:
+		JobEntry() { job = NULL; barrier = NULL; }
+		JobEntry(Job *job, JobBarrier *barrier) {
+			this->job = job;
+			this->barrier = barrier;
+		}
+		Job *job;
+		JobBarrier *barrier;
+	};
+
+	class JobQueue {
+	public:
+		Mutex mutex;
+		std::deque<JobEntry> jobs;
+	};
+
+	vector<JobWorkerThread *> workers;
+	vector<JobQueue *> queues;
+	Semaphore semJobsQueued;
+	Mutex nextQueueIndexMutex;
+	int nextQueueIndex;
+
+	bool popJob(int queueIndex, JobEntry &entry);
+	bool stealJob(int thiefIndex, JobEntry &entry);
+	void executeJob(const JobEntry &entry);
+
+public:
+	JobSystem(int workerCount=-1);
+	~JobSystem();
+
+	static int getDefaultWorkerCount();
+	int getWorkerCount() const { return (int)workers.size(); }
+
+	void submit(Job *job, JobBarrier *barrier);
+	bool runNextJob(int workerIndex);
+	bool waitForJobs(JobBarrier *barrier, int waitMilliseconds=-1);
+	bool waitForQueuedJob(int waitMilliseconds);
+};
+
+}}//end namespace
+
+#endif
@@ -27,6 +27,10 @@
 	#include <netinet/in.h>
 	#include <arpa/inet.h>
 	#include <netdb.h>
+	#include <poll.h>
+	#if defined(__linux__)
+		#include <sys/epoll.h>
+	#endif
 
 	typedef int PLATFORM_SOCKET;
 
@@ -132,6 +136,15 @@ protected:
 
 	bool isSocketBlocking;
 
+	// bytes already read from the socket that no message has asked for yet
+	std::vector<char> receiveBuffer;
+	int receiveBufferStart;
+	int receiveBufferEnd;
+
+	int fillReceiveBuffer(int minimumCapacity);
+	int receiveDirect(void *data, int dataSize, bool tryReceiveUntilDataSizeMet);
+	int peekDirect(void *data, int dataSize, bool mustGetData,int *pLastSocketError);
+
 public:
 	Socket(PLATFORM_SOCKET sock);
 	Socket();
@@ -140,6 +153,7 @@ public:
 	static bool disableNagle;
 	static int DEFAULT_SOCKET_SENDBUF_SIZE;
 	static int DEFAULT_SOCKET_RECVBUF_SIZE;
+	static bool enableReceiveBuffer;
 
 	//virtual void simpleTask(BaseThread *callingThread);
 
@@ -156,13 +170,18 @@ public:
     bool hasDataToReadWithWait(int waitMicroseconds);
 
     virtual void disconnectSocket();
+    // Changes whenever a socket is closed, its id may be reused from then on
+    static int getDisconnectCount();
 
     PLATFORM_SOCKET getSocketId() const { return sock; }
 
 	int getDataToRead(bool wantImmediateReply=false);
 	int send(const void *data, int dataSize);
 	int receive(void *data, int dataSize, bool tryReceiveUntilDataSizeMet);
+	// Returns the next dataSize bytes without copying them, valid until the next read
+	char * receiveInPlace(int dataSize);
 	int peek(void *data, int dataSize, bool mustGetData=true,int *pLastSocketError=NULL);
+	int getReceiveBufferedSize();
 
 	void setBlock(bool block);
 	static void setBlock(bool block, PLATFORM_SOCKET socket);
@@ -189,6 +208,33 @@ protected:
 	static void throwException(string str);
 };
 
+// =====================================================
+//	class SocketPoller
+//
+///	Keeps the polled sockets registered with epoll where
+///	available so a poll does not rebuild the socket set
+// =====================================================
+
+class SocketPoller {
+protected:
+#if defined(__linux__)
+	int epollFd;
+	std::vector<struct epoll_event> readyEvents;
+#endif
+	std::map<PLATFORM_SOCKET,bool> registeredSockets;
+	int lastDisconnectCount;
+
+	void updateRegisteredSockets(const std::map<PLATFORM_SOCKET,bool> &socketTriggeredList);
+	void clearRegisteredSockets();
+
+public:
+	SocketPoller();
+	~SocketPoller();
+
+	// Same contract as Socket::hasDataToRead for a list of sockets
+	bool hasDataToRead(std::map<PLATFORM_SOCKET,bool> &socketTriggeredList, int waitMicroseconds=0);
+};
+
 class SafeSocketBlockToggleWrapper {
 protected:
 	Socket *socket;
@@ -28,6 +28,7 @@ const char  *GAME_ARGS[] = {
 	"--autostart-lastgame",
 	"--load-saved-game",
 	"--auto-test",
+	"--benchmark",
 	"--connect",
 	"--connecthost",
 	"--starthost",
@@ -101,6 +102,7 @@ enum GAME_ARG_TYPE {
 	GAME_ARG_AUTOSTART_LASTGAME,
 	GAME_ARG_AUTOSTART_LAST_SAVED_GAME,
 	GAME_ARG_AUTO_TEST,
+	GAME_ARG_BENCHMARK,
 	GAME_ARG_CONNECT,
 	GAME_ARG_CLIENT,
 	GAME_ARG_SERVER,
@@ -198,6 +200,11 @@ void printParameterHelp(const char *argv0, bool foundInvalidArgs) {
 	printf("\n                     \t\tWhere z is the word exit indicating the game should exit after the game is finished or the time runs out.");
 	printf("\n                     \t\tIf z is not specified (or is empty) then auto test continues to cycle.");
 
+	printf("\n%s=x,y,z\t\t\tRun a headless simulation benchmark and exit.",GAME_ARGS[GAME_ARG_BENCHMARK]);
+	printf("\n                     \t\tWhere x is the game settings file to play.");
+	printf("\n                     \t\tWhere y is an optional # of frames to simulate, the default is 3000.");
+	printf("\n                     \t\tWhere z is an optional file to write the JSON timings to, the default is benchmark.json");
+
 	printf("\n%s=x:y\t\t\tAuto connect to host server at IP or hostname x using port y",GAME_ARGS[GAME_ARG_CONNECT]);
 	printf("\n                     \t\tShortcut version of using %s and %s.",GAME_ARGS[GAME_ARG_CLIENT],GAME_ARGS[GAME_ARG_USE_PORTS]);
 	printf("\n                     \t\t*NOTE: to automatically connect to the first LAN");
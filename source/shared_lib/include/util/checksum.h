@@ -21,8 +21,26 @@
 using std::string;
 using namespace Shared::Platform;
 
+namespace Shared {  namespace PlatformCommon {  class JobSystem;  }}
+
 namespace Shared{ namespace Util{
 
+// =====================================================
+//	class FileCRCIndexEntry
+//
+///	CRC of a file together with the size, modification and
+///	change times and inode it had when it was hashed
+// =====================================================
+
+class FileCRCIndexEntry {
+public:
+	uint32 crc;
+	int64 size;
+	int64 lastModified;
+	int64 lastChanged;
+	int64 inode;
+};
+
 // =====================================================
 //	class Checksum
 // =====================================================
@@ -36,11 +54,18 @@ private:
 	std::map<string,uint32> fileList;
 
 	static Mutex fileListCacheSynchAccessor;
-	static std::map<string,uint32> fileListCache;
+	static std::map<string,FileCRCIndexEntry> fileListCache;
+	static bool fileListCacheLoaded;
+	static bool fileListCacheChanged;
+	static Shared::PlatformCommon::JobSystem *fileListCacheJobSystem;
 
 	void addSum(uint32 value);
 	bool addFileToSum(const string &path);
 
+	static string getFileCacheIndexFile();
+	static void loadFileCacheIndex();
+	static void saveFileCacheIndex();
+
 public:
 	Checksum();
 
@@ -55,8 +80,14 @@ public:
 	uint32 addInt(const int32 &value);
 	void addFile(const string &path);
 
+	static uint32 getFileSum(const string &path);
+	// CRC32C, faster than the sums above but a different value,
+	// only for data that never leaves this machine
+	static uint32 getFastSum(const void *data, size_t size, uint32 previousSum=0);
 	static void removeFileFromCache(const string file);
 	static void clearFileCache();
+	static void saveFileCache();
+	static void cleanupFileCache();
 };
 
 }}//end namespace
@@ -0,0 +1,219 @@
+// ==============================================================
+//	This file is part of Glest Shared Library (www.glest.org)
+//
+//	Copyright (C) 2001-2008 Martiño Figueroa
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#ifndef _SHARED_UTIL_TRACE_H_
+#define _SHARED_UTIL_TRACE_H_
+
+//#define SL_DISABLE_TRACE
+//SL_DISABLE_TRACE compiles the TRACE_ macros out
+
+#include "data_types.h"
+#include <vector>
+#include <string>
+#include "leak_dumper.h"
+
+using std::vector;
+using std::string;
+
+using Shared::Platform::int64;
+using Shared::Platform::uint8;
+using Shared::Platform::uint16;
+using Shared::Platform::uint32;
+
+namespace Shared{ namespace Platform{ class Mutex; }}
+
+namespace Shared{ namespace Util{
+
+enum TracePhase {
+	tpBegin,
+	tpEnd,
+	tpInstant,
+	tpCounter
+};
+
+enum TraceArgType {
+	tatNone,
+	tatInt,
+	tatFloat
+};
+
+// =====================================================
+//	class TraceEventType
+//
+///	Name, category and argument names of an event id,
+///	the table of them is given to the tracer once
+// =====================================================
+
+class TraceEventType {
+public:
+	const char *name;
+	const char *category;
+	const char *argNames[2];
+};
+
+// =====================================================
+//	class TraceArg
+// =====================================================
+
+class TraceArg {
+public:
+	uint8 type;
+	union {
+		int64 intValue;
+		double floatValue;
+	};
+
+	TraceArg() 					{ type = tatNone; intValue = 0; }
+	// only int and float types so integer arguments are never ambiguous
+	TraceArg(int value)			{ type = tatInt; intValue = value; }
+	TraceArg(int64 value)		{ type = tatInt; intValue = value; }
+	TraceArg(float value)		{ type = tatFloat; floatValue = value; }
+	TraceArg(double value)		{ type = tatFloat; floatValue = value; }
+};
+
+// =====================================================
+//	class TraceEvent
+// =====================================================
+
+class TraceEvent {
+public:
+	int64 timestamp;
+	uint16 eventId;
+	uint8 phase;
+	TraceArg args[2];
+};
+
+// =====================================================
+//	class TraceBuffer
+//
+///	Ring of the last events of one thread, only that
+///	thread adds to it. The tracer reads and resets it
+///	under its mutex and never frees it, so the thread
+///	can keep using it at any time. When the thread ends
+///	the ring is handed to the next thread that traces.
+// =====================================================
+
+class TraceBuffer {
+public:
+	vector<TraceEvent> events;
+	uint32 writeCount;
+	uint32 threadId;
+	string threadName;
+	Shared::Platform::Mutex *mutex;
+
+	TraceBuffer(int eventCount, uint32 threadId);
+	~TraceBuffer();
+
+	// does nothing while the ring is empty after Tracer::cleanup
+	void addEvent(int64 timestamp, uint16 eventId, TracePhase phase, const TraceArg &arg0, const TraceArg &arg1);
+	// copies the events oldest first
+	void getEvents(vector<TraceEvent> &orderedEvents, string &name) const;
+};
+
+// =====================================================
+//	class Tracer
+//
+///	Binary per thread event recorder, exports the recorded
+///	events as Chrome trace JSON (chrome://tracing, Perfetto)
+// =====================================================
+
+class Tracer {
+private:
+	static bool enabled;
+	static int eventsPerThread;
+	static const TraceEventType *eventTypes;
+	static int eventTypeCount;
+
+	static TraceBuffer * createThreadBuffer();
+
+public:
+	static const int defaultEventsPerThread;
+
+	// eventsPerThread applies to threads that did not trace yet and to
+	// every thread after cleanup
+	static void init(const TraceEventType *eventTypes, int eventTypeCount, int eventsPerThread=defaultEventsPerThread);
+	static void cleanup();
+
+	inline static bool isEnabled()	{ return enabled; }
+	static void setEnabled(bool value);
+
+	static int64 getTimestamp();
+	static TraceBuffer * getThreadBuffer();
+	// called when a thread ends, its events stay in the export until
+	// another thread takes the buffer over
+	static void releaseThreadBuffer();
+	static void setThreadName(const string &name);
+
+	inline static void addEvent(uint16 eventId, TracePhase phase, const TraceArg &arg0=TraceArg(), const TraceArg &arg1=TraceArg()) {
+		getThreadBuffer()->addEvent(getTimestamp(), eventId, phase, arg0, arg1);
+	}
+
+	// Each ring is copied under its mutex, so other threads keep tracing
+	// while the file is written
+	static bool exportChromeTrace(const string &fileName);
+};
+
+// =====================================================
+//	class TraceScope
+//
+///	Records a begin event and, when it goes out of scope,
+///	the matching end event
+// =====================================================
+
+class TraceScope {
+private:
+	uint16 eventId;
+	bool active;
+
+public:
+	inline TraceScope(uint16 eventId, const TraceArg &arg0=TraceArg(), const TraceArg &arg1=TraceArg()) {
+		this->eventId = eventId;
+		this->active = Tracer::isEnabled();
+		if(this->active == true) {
+			Tracer::addEvent(eventId, tpBegin, arg0, arg1);
+		}
+	}
+	inline ~TraceScope() {
+		if(this->active == true) {
+			Tracer::addEvent(eventId, tpEnd);
+		}
+	}
+};
+
+#define TRACE_CONCAT_NAME(name,line)	name##line
+#define TRACE_SCOPE_NAME(line)			TRACE_CONCAT_NAME(traceScope,line)
+
+#ifndef SL_DISABLE_TRACE
+
+#define TRACE_SCOPE(eventId) \
+	Shared::Util::TraceScope TRACE_SCOPE_NAME(__LINE__)(eventId)
+#define TRACE_SCOPE_ARG(eventId,arg0) \
+	Shared::Util::TraceScope TRACE_SCOPE_NAME(__LINE__)(eventId,Shared::Util::TraceArg(arg0))
+#define TRACE_SCOPE_ARGS(eventId,arg0,arg1) \
+	Shared::Util::TraceScope TRACE_SCOPE_NAME(__LINE__)(eventId,Shared::Util::TraceArg(arg0),Shared::Util::TraceArg(arg1))
+#define TRACE_INSTANT(eventId,arg0) \
+	do { if(Shared::Util::Tracer::isEnabled() == true) Shared::Util::Tracer::addEvent(eventId,Shared::Util::tpInstant,Shared::Util::TraceArg(arg0)); } while(false)
+#define TRACE_COUNTER(eventId,value) \
+	do { if(Shared::Util::Tracer::isEnabled() == true) Shared::Util::Tracer::addEvent(eventId,Shared::Util::tpCounter,Shared::Util::TraceArg(value)); } while(false)
+
+#else
+
+#define TRACE_SCOPE(eventId)
+#define TRACE_SCOPE_ARG(eventId,arg0)
+#define TRACE_SCOPE_ARGS(eventId,arg0,arg1)
+#define TRACE_INSTANT(eventId,arg0)			do { } while(false)
+#define TRACE_COUNTER(eventId,value)		do { } while(false)
+
+#endif
+
+}}//end namespace
+
+#endif
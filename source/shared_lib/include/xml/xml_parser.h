@@ -42,7 +42,8 @@ namespace Shared { namespace Xml {
 
 enum xml_engine_parser_type {
 	XML_XERCES_ENGINE = 0,
-	XML_RAPIDXML_ENGINE = 1
+	XML_RAPIDXML_ENGINE = 1,
+	XML_BINARY_ENGINE = 2
 } ;
 
 static xml_engine_parser_type DEFAULT_XML_ENGINE = XML_RAPIDXML_ENGINE;
@@ -97,7 +98,6 @@ public:
 class XmlIoRapid {
 private:
 	static bool initialized;
-	xml_document<> *doc;
 
 private:
 	XmlIoRapid();
@@ -114,6 +114,48 @@ public:
 	void save(const string &path, const XmlNode *node);
 };
 
+// =====================================================
+//	class XmlIoBinary
+//
+///	Compact binary form of a tree, a table of its distinct
+///	strings followed by the nodes referring to them
+// =====================================================
+
+class XmlIoBinary {
+private:
+	XmlIoBinary();
+
+public:
+	static XmlIoBinary &getInstance();
+	static bool isBinaryFile(const string &path);
+
+	XmlNode *load(const string &path, const std::map<string,string> &mapTagReplacementValues);
+	void save(const string &path, const XmlNode *node, int compressionLevel=0);
+};
+
+// =====================================================
+//	class XmlTreeCache
+//
+///	The parsed trees of a set of files stored in one binary
+///	file, rapidxml loads of a cached file build the tree
+///	from it instead of parsing the file again
+// =====================================================
+
+class XmlTreeCache {
+public:
+	// records the trees of files under pathPrefix that are parsed because
+	// the cache has no tree for them, the trees already cached are kept
+	static void startRecording(const string &pathPrefix);
+	// true if trees were recorded since the cache was loaded
+	static bool hasNewTrees();
+	static void save(const string &path, int compressionLevel=0);
+	static void load(const string &path);
+	static void clear();
+
+	static XmlNode * findTree(const string &path, const std::map<string,string> &mapTagReplacementValues);
+	static void recordTree(const string &path, const std::map<string,string> &mapTagReplacementValues, xml_node<> *node);
+};
+
 // =====================================================
 //	class XmlTree
 // =====================================================
@@ -124,6 +166,7 @@ private:
 	string loadPath;
 	xml_engine_parser_type engine_type;
 	bool skipStackCheck;
+	int binaryCompressionLevel;
 private:
 	XmlTree(XmlTree&);
 	void operator =(XmlTree&);
@@ -137,6 +180,16 @@ public:
 	void load(const string &path, const std::map<string,string> &mapTagReplacementValues, bool noValidation=false,bool skipStackCheck=false);
 	void save(const string &path);
 
+	// Parses a file ahead of time, from any thread, so a later load of the
+	// same path with the same tag replacement values skips the parse
+	static void preload(const string &path, const std::map<string,string> &mapTagReplacementValues);
+	// Takes ownership of a root node parsed by XmlIoRapid for the same use
+	static void addPreloaded(const string &path, const std::map<string,string> &mapTagReplacementValues, XmlNode *rootNode);
+	static void clearPreloadCache();
+
+	// zlib level used when saving with XML_BINARY_ENGINE, 0 stores it uncompressed
+	void setBinaryCompressionLevel(int level)	{binaryCompressionLevel = level;}
+
 	XmlNode *getRootNode() const	{return rootNode;}
 };
 
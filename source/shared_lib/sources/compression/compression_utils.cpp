@@ -290,4 +290,29 @@ bool extractFileFromZIPFile(string inFile, string outFile) {
 	return(result == EXIT_SUCCESS ? true : false);
 }
 
+bool compressMemoryToMemory(const unsigned char *input, unsigned long inputSize, std::vector<unsigned char> &output, int compressionLevel) {
+	mz_ulong outputSize = mz_compressBound(inputSize);
+	output.resize(outputSize);
+	int result = mz_compress2(&output[0], &outputSize, input, inputSize, compressionLevel);
+	if(result != MZ_OK) {
+		if(SystemFlags::VERBOSE_MODE_ENABLED) printf("mz_compress2() failed: %d\n", result);
+		output.clear();
+		return false;
+	}
+	output.resize(outputSize);
+	return true;
+}
+
+bool extractMemoryFromMemory(const unsigned char *input, unsigned long inputSize, std::vector<unsigned char> &output, unsigned long outputSize) {
+	output.resize(outputSize);
+	mz_ulong extractedSize = outputSize;
+	int result = mz_uncompress((outputSize > 0 ? &output[0] : NULL), &extractedSize, input, inputSize);
+	if(result != MZ_OK || extractedSize != outputSize) {
+		if(SystemFlags::VERBOSE_MODE_ENABLED) printf("mz_uncompress() failed: %d\n", result);
+		output.clear();
+		return false;
+	}
+	return true;
+}
+
 }}
@@ -107,10 +107,9 @@ void ParticleRendererGl::renderSystem(ParticleSystem *ps){
 	int bufferIndex= 0;
 
 	for(int i=0; i<ps->getAliveParticleCount(); ++i){
-		const Particle *particle= ps->getParticle(i);
-		float size= particle->getSize()/2.0f;
-		Vec3f pos= particle->getPos();
-		Vec4f color= particle->getColor();
+		float size= ps->getParticleSize(i)/2.0f;
+		Vec3f pos= ps->getParticlePos(i);
+		Vec4f color= ps->getParticleColor(i);
 
 		vertexBuffer[bufferIndex] = pos - (rightVector - upVector) * size;
 		vertexBuffer[bufferIndex+1] = pos - (rightVector + upVector) * size;
@@ -140,8 +139,6 @@ void ParticleRendererGl::renderSystemLine(ParticleSystem *ps){
 	assert(rendering);
 
 	if(!ps->isEmpty()){
-		const Particle *particle= ps->getParticle(0);
-
 		setBlendMode(ps->getBlendMode());
 
 		glDisable(GL_TEXTURE_2D);
@@ -153,14 +150,13 @@ void ParticleRendererGl::renderSystemLine(ParticleSystem *ps){
 		//fill vertex buffer with lines
 		int bufferIndex= 0;
 
-		glLineWidth(particle->getSize());
+		glLineWidth(ps->getParticleSize(0));
 
 		for(int i=0; i<ps->getAliveParticleCount(); ++i){
-			particle= ps->getParticle(i);
-			Vec4f color= particle->getColor();
+			Vec4f color= ps->getParticleColor(i);
 
-			vertexBuffer[bufferIndex] = particle->getPos();
-			vertexBuffer[bufferIndex+1] = particle->getLastPos();
+			vertexBuffer[bufferIndex] = ps->getParticlePos(i);
+			vertexBuffer[bufferIndex+1] = ps->getParticleLastPos(i);
 
 			colorBuffer[bufferIndex]= color;
 			colorBuffer[bufferIndex+1]= color;
@@ -184,8 +180,6 @@ void ParticleRendererGl::renderSystemLineAlpha(ParticleSystem *ps){
 	assert(rendering);
 
 	if(!ps->isEmpty()){
-		const Particle *particle= ps->getParticle(0);
-
 		setBlendMode(ps->getBlendMode());
 
 		glDisable(GL_TEXTURE_2D);
@@ -197,14 +191,13 @@ void ParticleRendererGl::renderSystemLineAlpha(ParticleSystem *ps){
 		//fill vertex buffer with lines
 		int bufferIndex= 0;
 
-		glLineWidth(particle->getSize());
+		glLineWidth(ps->getParticleSize(0));
 
 		for(int i=0; i<ps->getAliveParticleCount(); ++i){
-			particle= ps->getParticle(i);
-			Vec4f color= particle->getColor();
+			Vec4f color= ps->getParticleColor(i);
 
-			vertexBuffer[bufferIndex] = particle->getPos();
-			vertexBuffer[bufferIndex+1] = particle->getLastPos();
+			vertexBuffer[bufferIndex] = ps->getParticlePos(i);
+			vertexBuffer[bufferIndex+1] = ps->getParticleLastPos(i);
 
 			colorBuffer[bufferIndex]= color;
 			colorBuffer[bufferIndex+1]= color;
@@ -21,6 +21,7 @@
 #include "platform_common.h"
 #include "opengl.h"
 #include "platform_util.h"
+#include "thread.h"
 #include <memory>
 #include "leak_dumper.h"
 
@@ -193,6 +194,49 @@ void fromEndianMeshHeaderV2(MeshHeaderV2 &header) {
 	}
 }
 
+// =====================================================
+//	class MeshVertexData
+//
+//	Vertex data read from a g3d mesh, models loaded from the
+//	same file share it read only instead of keeping a copy each
+// =====================================================
+
+class MeshVertexData {
+public:
+	string key;
+	uint32 frameCount;
+	uint32 vertexCount;
+	uint32 indexCount;
+	uint32 textureFlags;
+
+	Vec3f *vertices;
+	Vec3f *normals;
+	Vec2f *texCoords;
+	uint32 *indices;
+
+	int refCount;
+};
+
+typedef std::map<string, MeshVertexData *> MeshVertexDataMap;
+static MeshVertexDataMap meshVertexDataCache;
+static Mutex mutexMeshVertexDataCache;
+
+//drop one reference, the caller holds mutexMeshVertexDataCache
+static void unrefMeshVertexData(MeshVertexData *data) {
+	data->refCount--;
+	if(data->refCount <= 0) {
+		MeshVertexDataMap::iterator iterFind = meshVertexDataCache.find(data->key);
+		if(iterFind != meshVertexDataCache.end() && iterFind->second == data) {
+			meshVertexDataCache.erase(iterFind);
+		}
+		delete [] data->vertices;
+		delete [] data->normals;
+		delete [] data->texCoords;
+		delete [] data->indices;
+		delete data;
+	}
+}
+
 // =====================================================
 //	class Mesh
 // =====================================================
@@ -213,6 +257,7 @@ Mesh::Mesh() {
 	texCoords= NULL;
 	tangents= NULL;
 	indices= NULL;
+	sharedVertexData= NULL;
 	interpolationData= NULL;
 
 	for(int i=0; i<meshTextureCount; ++i){
@@ -276,16 +321,9 @@ void Mesh::init() {
 void Mesh::end() {
 	ReleaseVBOs();
 
-	delete [] vertices;
-	vertices=NULL;
-	delete [] normals;
-	normals=NULL;
-	delete [] texCoords;
-	texCoords=NULL;
+	releaseVertexData();
 	delete [] tangents;
 	tangents=NULL;
-	delete [] indices;
-	indices=NULL;
 
 	delete interpolationData;
 	interpolationData=NULL;
@@ -357,10 +395,7 @@ void Mesh::BuildVBOs() {
 			glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
 
 			// Our Copy Of The Data Is No Longer Necessary, It Is Safe In The Graphics Card
-			delete [] vertices; vertices = NULL;
-			delete [] texCoords; texCoords = NULL;
-			delete [] normals; normals = NULL;
-			delete [] indices; indices = NULL;
+			releaseVertexData();
 
 			delete interpolationData;
 			interpolationData = NULL;
@@ -382,6 +417,68 @@ void Mesh::ReleaseVBOs() {
 	}
 }
 
+// ==================== shared vertex data ====================
+
+bool Mesh::attachSharedVertexData(const string &key, uint32 textureFlags) {
+	MutexSafeWrapper safeMutex(&mutexMeshVertexDataCache,CODE_AT_LINE);
+	MeshVertexDataMap::iterator iterFind = meshVertexDataCache.find(key);
+	if(iterFind == meshVertexDataCache.end()) {
+		return false;
+	}
+	MeshVertexData *data = iterFind->second;
+	// the file changed on disk since it was shared, read it again
+	if(data->frameCount != frameCount || data->vertexCount != vertexCount ||
+		data->indexCount != indexCount || data->textureFlags != textureFlags) {
+		return false;
+	}
+	data->refCount++;
+	sharedVertexData = data;
+	vertices = data->vertices;
+	normals = data->normals;
+	texCoords = data->texCoords;
+	indices = data->indices;
+	return true;
+}
+
+void Mesh::publishSharedVertexData(const string &key, uint32 textureFlags) {
+	MutexSafeWrapper safeMutex(&mutexMeshVertexDataCache,CODE_AT_LINE);
+	// another thread may have read the same mesh meanwhile, keep our own copy
+	if(meshVertexDataCache.find(key) != meshVertexDataCache.end()) {
+		return;
+	}
+	MeshVertexData *data = new MeshVertexData();
+	data->key = key;
+	data->frameCount = frameCount;
+	data->vertexCount = vertexCount;
+	data->indexCount = indexCount;
+	data->textureFlags = textureFlags;
+	data->vertices = vertices;
+	data->normals = normals;
+	data->texCoords = texCoords;
+	data->indices = indices;
+	data->refCount = 1;
+	meshVertexDataCache[key] = data;
+	sharedVertexData = data;
+}
+
+void Mesh::releaseVertexData() {
+	if(sharedVertexData != NULL) {
+		MutexSafeWrapper safeMutex(&mutexMeshVertexDataCache,CODE_AT_LINE);
+		unrefMeshVertexData(sharedVertexData);
+		sharedVertexData = NULL;
+	}
+	else {
+		delete [] vertices;
+		delete [] normals;
+		delete [] texCoords;
+		delete [] indices;
+	}
+	vertices = NULL;
+	normals = NULL;
+	texCoords = NULL;
+	indices = NULL;
+}
+
 // ==================== load ====================
 
 string Mesh::findAlternateTexture(vector<string> conversionList, string textureFile) {
@@ -758,7 +855,11 @@ void Mesh::load(int meshIndex, const string &dir, FILE *f, TextureManager *textu
 	vertexCount= meshHeader.vertexCount;
 	indexCount= meshHeader.indexCount;
 
-	init();
+	// the same mesh of a model file loaded before shares its vertex data
+	string vertexDataKey = (modelFile != "" ? modelFile + "#" + intToStr(meshIndex) : "");
+	if(vertexDataKey == "" || attachSharedVertexData(vertexDataKey, meshHeader.textures) == false) {
+		init();
+	}
 
 	//properties
 	customColor= (meshHeader.properties & mpfCustomColor) != 0;
@@ -810,38 +911,55 @@ void Mesh::load(int meshIndex, const string &dir, FILE *f, TextureManager *textu
 	}
 
 	//read data
-	readBytes = fread(vertices, sizeof(Vec3f)*frameCount*vertexCount, 1, f);
-	if(readBytes != 1 && (frameCount * vertexCount) != 0) {
-		char szBuf[8096]="";
-		snprintf(szBuf,8096,"fread returned wrong size = " MG_SIZE_T_SPECIFIER " [%u][%u] on line: %d.",readBytes,frameCount,vertexCount,__LINE__);
-		throw megaglest_runtime_error(szBuf);
-	}
-	fromEndianVecArray<Vec3f>(vertices, frameCount*vertexCount);
-
-	readBytes = fread(normals, sizeof(Vec3f)*frameCount*vertexCount, 1, f);
-	if(readBytes != 1 && (frameCount * vertexCount) != 0) {
-		char szBuf[8096]="";
-		snprintf(szBuf,8096,"fread returned wrong size = " MG_SIZE_T_SPECIFIER " [%u][%u] on line: %d.",readBytes,frameCount,vertexCount,__LINE__);
-		throw megaglest_runtime_error(szBuf);
+	if(sharedVertexData != NULL) {
+		long dataSize = (long)(sizeof(Vec3f) * frameCount * vertexCount * 2 + sizeof(uint32) * indexCount);
+		if(meshHeader.textures != 0) {
+			dataSize += (long)(sizeof(Vec2f) * vertexCount);
+		}
+		if(fseek(f, dataSize, SEEK_CUR) != 0) {
+			char szBuf[8096]="";
+			snprintf(szBuf,8096,"fseek failed skipping %ld bytes of shared mesh data on line: %d.",dataSize,__LINE__);
+			throw megaglest_runtime_error(szBuf);
+		}
 	}
-	fromEndianVecArray<Vec3f>(normals, frameCount*vertexCount);
+	else {
+		readBytes = fread(vertices, sizeof(Vec3f)*frameCount*vertexCount, 1, f);
+		if(readBytes != 1 && (frameCount * vertexCount) != 0) {
+			char szBuf[8096]="";
+			snprintf(szBuf,8096,"fread returned wrong size = " MG_SIZE_T_SPECIFIER " [%u][%u] on line: %d.",readBytes,frameCount,vertexCount,__LINE__);
+			throw megaglest_runtime_error(szBuf);
+		}
+		fromEndianVecArray<Vec3f>(vertices, frameCount*vertexCount);
 
-	if(meshHeader.textures!=0){
-		readBytes = fread(texCoords, sizeof(Vec2f)*vertexCount, 1, f);
-		if(readBytes != 1 && vertexCount != 0) {
+		readBytes = fread(normals, sizeof(Vec3f)*frameCount*vertexCount, 1, f);
+		if(readBytes != 1 && (frameCount * vertexCount) != 0) {
 			char szBuf[8096]="";
 			snprintf(szBuf,8096,"fread returned wrong size = " MG_SIZE_T_SPECIFIER " [%u][%u] on line: %d.",readBytes,frameCount,vertexCount,__LINE__);
 			throw megaglest_runtime_error(szBuf);
 		}
-		fromEndianVecArray<Vec2f>(texCoords, vertexCount);
-	}
-	readBytes = fread(indices, sizeof(uint32)*indexCount, 1, f);
-	if(readBytes != 1 && indexCount != 0) {
-		char szBuf[8096]="";
-		snprintf(szBuf,8096,"fread returned wrong size = " MG_SIZE_T_SPECIFIER " [%u] on line: %d.",readBytes,indexCount,__LINE__);
-		throw megaglest_runtime_error(szBuf);
+		fromEndianVecArray<Vec3f>(normals, frameCount*vertexCount);
+
+		if(meshHeader.textures!=0){
+			readBytes = fread(texCoords, sizeof(Vec2f)*vertexCount, 1, f);
+			if(readBytes != 1 && vertexCount != 0) {
+				char szBuf[8096]="";
+				snprintf(szBuf,8096,"fread returned wrong size = " MG_SIZE_T_SPECIFIER " [%u][%u] on line: %d.",readBytes,frameCount,vertexCount,__LINE__);
+				throw megaglest_runtime_error(szBuf);
+			}
+			fromEndianVecArray<Vec2f>(texCoords, vertexCount);
+		}
+		readBytes = fread(indices, sizeof(uint32)*indexCount, 1, f);
+		if(readBytes != 1 && indexCount != 0) {
+			char szBuf[8096]="";
+			snprintf(szBuf,8096,"fread returned wrong size = " MG_SIZE_T_SPECIFIER " [%u] on line: %d.",readBytes,indexCount,__LINE__);
+			throw megaglest_runtime_error(szBuf);
+		}
+		Shared::PlatformByteOrder::fromEndianTypeArray<uint32>(indices, indexCount);
+
+		if(vertexDataKey != "") {
+			publishSharedVertexData(vertexDataKey, meshHeader.textures);
+		}
 	}
-	Shared::PlatformByteOrder::fromEndianTypeArray<uint32>(indices, indexCount);
 
 	//tangents
 	if(textures[mtNormal]!=NULL){
@@ -1306,6 +1424,160 @@ void Model::loadG3d(const string &path, bool deletePixMapAfterLoad,
 	}
 }
 
+//read the vertex data of one v4 mesh into the shared cache so a later
+//Mesh::load attaches to it, returns false if the data could not be read,
+//held tells if the data was kept in the cache
+static bool preloadMeshVertexData(const string &key, const MeshHeader &meshHeader, FILE *f, bool &held) {
+	held = false;
+	uint32 frameVertexCount = meshHeader.frameCount * meshHeader.vertexCount;
+
+	MeshVertexData *data = new MeshVertexData();
+	data->key = key;
+	data->frameCount = meshHeader.frameCount;
+	data->vertexCount = meshHeader.vertexCount;
+	data->indexCount = meshHeader.indexCount;
+	data->textureFlags = meshHeader.textures;
+	data->vertices = new Vec3f[frameVertexCount];
+	data->normals = new Vec3f[frameVertexCount];
+	data->texCoords = new Vec2f[meshHeader.vertexCount];
+	data->indices = new uint32[meshHeader.indexCount];
+	data->refCount = 1;
+
+	bool validData = ((fread(data->vertices, sizeof(Vec3f)*frameVertexCount, 1, f) == 1 || frameVertexCount == 0) &&
+					  (fread(data->normals, sizeof(Vec3f)*frameVertexCount, 1, f) == 1 || frameVertexCount == 0));
+	if(validData == true && meshHeader.textures != 0) {
+		validData = (fread(data->texCoords, sizeof(Vec2f)*meshHeader.vertexCount, 1, f) == 1 || meshHeader.vertexCount == 0);
+	}
+	if(validData == true) {
+		validData = (fread(data->indices, sizeof(uint32)*meshHeader.indexCount, 1, f) == 1 || meshHeader.indexCount == 0);
+	}
+	if(validData == true) {
+		fromEndianVecArray<Vec3f>(data->vertices, frameVertexCount);
+		fromEndianVecArray<Vec3f>(data->normals, frameVertexCount);
+		fromEndianVecArray<Vec2f>(data->texCoords, meshHeader.vertexCount);
+		Shared::PlatformByteOrder::fromEndianTypeArray<uint32>(data->indices, meshHeader.indexCount);
+
+		MutexSafeWrapper safeMutex(&mutexMeshVertexDataCache,CODE_AT_LINE);
+		// a model of this file is loaded already, nothing to hold
+		if(meshVertexDataCache.find(key) == meshVertexDataCache.end()) {
+			meshVertexDataCache[key] = data;
+			held = true;
+			return true;
+		}
+	}
+	delete [] data->vertices;
+	delete [] data->normals;
+	delete [] data->texCoords;
+	delete [] data->indices;
+	delete data;
+	return validData;
+}
+
+//list the textures a v4 g3d file refers to without loading its meshes,
+//if preloadedMeshList is set the mesh vertex data is read as well and
+//kept until releasePreloadedMeshes is called with the returned keys
+void Model::getG3dTextureFileList(const string &path, vector<pair<string,int> > &textureList,
+		vector<string> *preloadedMeshList) {
+#ifdef WIN32
+	FILE *f= _wfopen(utf8_decode(path).c_str(), L"rb");
+#else
+	FILE *f=fopen(path.c_str(),"rb");
+#endif
+	if(f == NULL) {
+		return;
+	}
+
+	string dir= extractDirectoryPathFromFile(path);
+
+	FileHeader fileHeader;
+	bool validFile = (fread(&fileHeader, sizeof(FileHeader), 1, f) == 1);
+	if(validFile == true) {
+		fromEndianFileHeader(fileHeader);
+		validFile = (strncmp(reinterpret_cast<char*>(fileHeader.id), "G3D", 3) == 0 && fileHeader.version == 4);
+	}
+	ModelHeader modelHeader;
+	if(validFile == true) {
+		validFile = (fread(&modelHeader, sizeof(ModelHeader), 1, f) == 1);
+		fromEndianModelHeader(modelHeader);
+		validFile = (validFile == true && modelHeader.type == mtMorphMesh);
+	}
+
+	for(uint32 meshIndex = 0; validFile == true && meshIndex < modelHeader.meshCount; ++meshIndex) {
+		MeshHeader meshHeader;
+		if(fread(&meshHeader, sizeof(MeshHeader), 1, f) != 1) {
+			break;
+		}
+		fromEndianMeshHeader(meshHeader);
+
+		uint32 flag= 1;
+		for(int i = 0; validFile == true && i < meshTextureCount; ++i) {
+			if(meshHeader.textures & flag) {
+				uint8 cMapPath[mapPathSize];
+				if(fread(cMapPath, mapPathSize, 1, f) != 1) {
+					validFile = false;
+					break;
+				}
+				Shared::PlatformByteOrder::fromEndianTypeArray<uint8>(cMapPath, mapPathSize);
+				cMapPath[mapPathSize-1] = 0;
+
+				string mapFullPath= dir;
+				if(mapFullPath != "") {
+					endPathWithSlash(mapFullPath);
+				}
+				mapFullPath += toLower(reinterpret_cast<char*>(cMapPath));
+				if(fileExists(mapFullPath) == true) {
+					int textureChannelCount = (meshTextureChannelCount[i] != -1 ? meshTextureChannelCount[i] : Texture::defaultComponents);
+					textureList.push_back(make_pair(mapFullPath,textureChannelCount));
+				}
+			}
+			flag *= 2;
+		}
+
+		if(validFile == false) {
+			break;
+		}
+		if(preloadedMeshList != NULL) {
+			string vertexDataKey = path + "#" + intToStr(meshIndex);
+			bool wasHeld = false;
+			{
+				MutexSafeWrapper safeMutex(&mutexMeshVertexDataCache,CODE_AT_LINE);
+				wasHeld = (meshVertexDataCache.find(vertexDataKey) != meshVertexDataCache.end());
+			}
+			if(wasHeld == false) {
+				bool held = false;
+				if(preloadMeshVertexData(vertexDataKey, meshHeader, f, held) == false) {
+					break;
+				}
+				if(held == true) {
+					preloadedMeshList->push_back(vertexDataKey);
+				}
+				continue;
+			}
+		}
+
+		//skip vertices, normals, texture coordinates and indices
+		long dataSize = (long)(sizeof(Vec3f) * meshHeader.frameCount * meshHeader.vertexCount * 2 +
+						(meshHeader.textures != 0 ? sizeof(Vec2f) * meshHeader.vertexCount : 0) +
+						sizeof(uint32) * meshHeader.indexCount);
+		if(fseek(f, dataSize, SEEK_CUR) != 0) {
+			break;
+		}
+	}
+	fclose(f);
+}
+
+//drop the hold getG3dTextureFileList kept on preloaded mesh vertex data,
+//data no model attached to meanwhile is freed
+void Model::releasePreloadedMeshes(const vector<string> &preloadedMeshList) {
+	MutexSafeWrapper safeMutex(&mutexMeshVertexDataCache,CODE_AT_LINE);
+	for(unsigned int i = 0; i < preloadedMeshList.size(); ++i) {
+		MeshVertexDataMap::iterator iterFind = meshVertexDataCache.find(preloadedMeshList[i]);
+		if(iterFind != meshVertexDataCache.end()) {
+			unrefMeshVertexData(iterFind->second);
+		}
+	}
+}
+
 //save a model to a g3d file
 void Model::saveG3d(const string &path, string convertTextureToFormat,
 		bool keepsmallest) {
@@ -15,6 +15,7 @@
 #include <stdexcept>
 #include <cassert>
 #include <algorithm>
+#include <cstring>
 
 #include "util.h"
 #include "particle_renderer.h"
@@ -24,6 +25,12 @@
 #include "model.h"
 #include "texture.h"
 #include "platform_util.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define PARTICLE_KERNELS_SSE2
+	#include <emmintrin.h>
+#endif
+
 #include "leak_dumper.h"
 
 using namespace std;
@@ -80,6 +87,259 @@ void Particle::loadGame(const XmlNode *rootNode) {
 	energy = particleNode->getAttribute("energy")->getIntValue();
 }
 
+// =====================================================
+//	class ParticleArrays
+// =====================================================
+
+// The kernels below do four particles per step with SSE2 where the build
+// has it. Each lane does the same single precision operations in the same
+// order as the scalar tail, so both give the same results.
+
+// values[i]+= add[i]
+static void addParticleValues(float *values, const float *add, int count) {
+	int i = 0;
+#ifdef PARTICLE_KERNELS_SSE2
+	for(; i + 4 <= count; i += 4) {
+		_mm_storeu_ps(values + i, _mm_add_ps(_mm_loadu_ps(values + i), _mm_loadu_ps(add + i)));
+	}
+#endif
+	for(; i < count; ++i) {
+		values[i]+= add[i];
+	}
+}
+
+// values[i]+= add
+static void addParticleValue(float *values, float add, int count) {
+	int i = 0;
+#ifdef PARTICLE_KERNELS_SSE2
+	__m128 add4 = _mm_set1_ps(add);
+	for(; i + 4 <= count; i += 4) {
+		_mm_storeu_ps(values + i, _mm_add_ps(_mm_loadu_ps(values + i), add4));
+	}
+#endif
+	for(; i < count; ++i) {
+		values[i]+= add;
+	}
+}
+
+// values[i]*= scale
+static void scaleParticleValues(float *values, float scale, int count) {
+	int i = 0;
+#ifdef PARTICLE_KERNELS_SSE2
+	__m128 scale4 = _mm_set1_ps(scale);
+	for(; i + 4 <= count; i += 4) {
+		_mm_storeu_ps(values + i, _mm_mul_ps(_mm_loadu_ps(values + i), scale4));
+	}
+#endif
+	for(; i < count; ++i) {
+		values[i]*= scale;
+	}
+}
+
+// values[i]*= scale where values[i] > 0
+static void fadeParticleValues(float *values, float scale, int count) {
+	int i = 0;
+#ifdef PARTICLE_KERNELS_SSE2
+	__m128 scale4 = _mm_set1_ps(scale);
+	__m128 zero4 = _mm_setzero_ps();
+	for(; i + 4 <= count; i += 4) {
+		__m128 value4 = _mm_loadu_ps(values + i);
+		__m128 positive4 = _mm_cmpgt_ps(value4, zero4);
+		__m128 scaled4 = _mm_mul_ps(value4, scale4);
+		_mm_storeu_ps(values + i, _mm_or_ps(_mm_and_ps(positive4, scaled4), _mm_andnot_ps(positive4, value4)));
+	}
+#endif
+	for(; i < count; ++i) {
+		if(values[i] > 0.0f) {
+			values[i]*= scale;
+		}
+	}
+}
+
+// values[i]= value * ratio[i] + valueNoEnergy * (1 - ratio[i])
+static void blendParticleValues(float *values, const float *ratio, float value, float valueNoEnergy, int count) {
+	int i = 0;
+#ifdef PARTICLE_KERNELS_SSE2
+	__m128 value4 = _mm_set1_ps(value);
+	__m128 valueNoEnergy4 = _mm_set1_ps(valueNoEnergy);
+	__m128 one4 = _mm_set1_ps(1.0f);
+	for(; i + 4 <= count; i += 4) {
+		__m128 ratio4 = _mm_loadu_ps(ratio + i);
+		_mm_storeu_ps(values + i, _mm_add_ps(_mm_mul_ps(value4, ratio4),
+				_mm_mul_ps(valueNoEnergy4, _mm_sub_ps(one4, ratio4))));
+	}
+#endif
+	for(; i < count; ++i) {
+		values[i]= value * ratio[i] + valueNoEnergy * (1.0f - ratio[i]);
+	}
+}
+
+void ParticleArrays::resize(int particleCount) {
+	posX.assign(particleCount, 0.0f);
+	posY.assign(particleCount, 0.0f);
+	posZ.assign(particleCount, 0.0f);
+	lastPosX.assign(particleCount, 0.0f);
+	lastPosY.assign(particleCount, 0.0f);
+	lastPosZ.assign(particleCount, 0.0f);
+	speedX.assign(particleCount, 0.0f);
+	speedY.assign(particleCount, 0.0f);
+	speedZ.assign(particleCount, 0.0f);
+	accelX.assign(particleCount, 0.0f);
+	accelY.assign(particleCount, 0.0f);
+	accelZ.assign(particleCount, 0.0f);
+	colorR.assign(particleCount, 0.0f);
+	colorG.assign(particleCount, 0.0f);
+	colorB.assign(particleCount, 0.0f);
+	colorA.assign(particleCount, 0.0f);
+	size.assign(particleCount, 0.0f);
+	energy.assign(particleCount, 0);
+	energyRatio.assign(particleCount, 0.0f);
+}
+
+void ParticleArrays::clear() {
+	resize(0);
+}
+
+void ParticleArrays::setParticle(int i, const Particle &p) {
+	posX[i]= p.pos.x;
+	posY[i]= p.pos.y;
+	posZ[i]= p.pos.z;
+	lastPosX[i]= p.lastPos.x;
+	lastPosY[i]= p.lastPos.y;
+	lastPosZ[i]= p.lastPos.z;
+	speedX[i]= p.speed.x;
+	speedY[i]= p.speed.y;
+	speedZ[i]= p.speed.z;
+	accelX[i]= p.accel.x;
+	accelY[i]= p.accel.y;
+	accelZ[i]= p.accel.z;
+	colorR[i]= p.color.x;
+	colorG[i]= p.color.y;
+	colorB[i]= p.color.z;
+	colorA[i]= p.color.w;
+	size[i]= p.size;
+	energy[i]= p.energy;
+}
+
+void ParticleArrays::moveParticle(int dest, int source) {
+	posX[dest]= posX[source];
+	posY[dest]= posY[source];
+	posZ[dest]= posZ[source];
+	lastPosX[dest]= lastPosX[source];
+	lastPosY[dest]= lastPosY[source];
+	lastPosZ[dest]= lastPosZ[source];
+	speedX[dest]= speedX[source];
+	speedY[dest]= speedY[source];
+	speedZ[dest]= speedZ[source];
+	accelX[dest]= accelX[source];
+	accelY[dest]= accelY[source];
+	accelZ[dest]= accelZ[source];
+	colorR[dest]= colorR[source];
+	colorG[dest]= colorG[source];
+	colorB[dest]= colorB[source];
+	colorA[dest]= colorA[source];
+	size[dest]= size[source];
+	energy[dest]= energy[source];
+}
+
+// lastPos= pos
+void ParticleArrays::savePositions(int count) {
+	memcpy(&lastPosX[0], &posX[0], count * sizeof(float));
+	memcpy(&lastPosY[0], &posY[0], count * sizeof(float));
+	memcpy(&lastPosZ[0], &posZ[0], count * sizeof(float));
+}
+
+// pos+= speed, and lastPos+= speed too if toLastPos
+void ParticleArrays::addSpeeds(int count, bool toLastPos) {
+	if(toLastPos == true) {
+		addParticleValues(&lastPosX[0], &speedX[0], count);
+		addParticleValues(&lastPosY[0], &speedY[0], count);
+		addParticleValues(&lastPosZ[0], &speedZ[0], count);
+	}
+	addParticleValues(&posX[0], &speedX[0], count);
+	addParticleValues(&posY[0], &speedY[0], count);
+	addParticleValues(&posZ[0], &speedZ[0], count);
+}
+
+// lastPos+= value and pos+= value
+void ParticleArrays::addToPositions(const Vec3f &value, int count) {
+	addParticleValue(&lastPosX[0], value.x, count);
+	addParticleValue(&lastPosY[0], value.y, count);
+	addParticleValue(&lastPosZ[0], value.z, count);
+	addParticleValue(&posX[0], value.x, count);
+	addParticleValue(&posY[0], value.y, count);
+	addParticleValue(&posZ[0], value.z, count);
+}
+
+// speed+= accel
+void ParticleArrays::addAccels(int count) {
+	addParticleValues(&speedX[0], &accelX[0], count);
+	addParticleValues(&speedY[0], &accelY[0], count);
+	addParticleValues(&speedZ[0], &accelZ[0], count);
+}
+
+// energyRatio= clamp(energy / maxEnergy, 0, 1)
+void ParticleArrays::computeEnergyRatios(int maxEnergy, int count) {
+	int i = 0;
+#ifdef PARTICLE_KERNELS_SSE2
+	__m128 maxEnergy4 = _mm_set1_ps(static_cast<float>(maxEnergy));
+	__m128 zero4 = _mm_setzero_ps();
+	__m128 one4 = _mm_set1_ps(1.0f);
+	for(; i + 4 <= count; i += 4) {
+		__m128 ratio4 = _mm_div_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)&energy[i])), maxEnergy4);
+		// operand order keeps a NaN ratio the way clamp does
+		_mm_storeu_ps(&energyRatio[i], _mm_min_ps(one4, _mm_max_ps(zero4, ratio4)));
+	}
+#endif
+	for(; i < count; ++i) {
+		energyRatio[i]= clamp(static_cast<float> (energy[i]) / maxEnergy, 0.f, 1.f);
+	}
+}
+
+// color= color * energyRatio + colorNoEnergy * (1 - energyRatio)
+void ParticleArrays::blendColors(const Vec4f &color, const Vec4f &colorNoEnergy, int count) {
+	blendParticleValues(&colorR[0], &energyRatio[0], color.x, colorNoEnergy.x, count);
+	blendParticleValues(&colorG[0], &energyRatio[0], color.y, colorNoEnergy.y, count);
+	blendParticleValues(&colorB[0], &energyRatio[0], color.z, colorNoEnergy.z, count);
+	blendParticleValues(&colorA[0], &energyRatio[0], color.w, colorNoEnergy.w, count);
+}
+
+// color.rgb*= value
+void ParticleArrays::scaleColors(const Vec3f &value, int count) {
+	scaleParticleValues(&colorR[0], value.x, count);
+	scaleParticleValues(&colorG[0], value.y, count);
+	scaleParticleValues(&colorB[0], value.z, count);
+}
+
+// size= size * energyRatio + sizeNoEnergy * (1 - energyRatio)
+void ParticleArrays::blendSizes(float size, float sizeNoEnergy, int count) {
+	blendParticleValues(&this->size[0], &energyRatio[0], size, sizeNoEnergy, count);
+}
+
+// energy--
+void ParticleArrays::decEnergies(int count) {
+	int i = 0;
+#ifdef PARTICLE_KERNELS_SSE2
+	__m128i one4 = _mm_set1_epi32(1);
+	for(; i + 4 <= count; i += 4) {
+		__m128i *energy4 = (__m128i *)&energy[i];
+		_mm_storeu_si128(energy4, _mm_sub_epi32(_mm_loadu_si128(energy4), one4));
+	}
+#endif
+	for(; i < count; ++i) {
+		energy[i]--;
+	}
+}
+
+// no energy left for particles that fell below the ground
+void ParticleArrays::killBelowGround(int count) {
+	for(int i = 0; i < count; ++i) {
+		if(posY[i] < 0) {
+			energy[i]= 0;
+		}
+	}
+}
+
 ParticleSystem::ParticleSystem(int particleCount) {
 	if(checkMemory) {
 		printf("++ Create ParticleSystem [%p]\n",this);
@@ -95,8 +355,6 @@ ParticleSystem::ParticleSystem(int particleCount) {
 	//init particle vector
 	blendMode= bmOne;
 	//particles= new Particle[particleCount];
-	particles.clear();
-	//particles.reserve(particleCount);
 	particles.resize(particleCount);
 
 	state= sPlay;
@@ -143,34 +401,25 @@ ParticleSystem::~ParticleSystem(){
 
 //updates all living particles and creates new ones
 void ParticleSystem::update(){
-	if(aliveParticleCount > (int) particles.size()){
-		throw megaglest_runtime_error("aliveParticleCount >= particles.size()");
+	if(aliveParticleCount > particles.getCount()){
+		throw megaglest_runtime_error("aliveParticleCount >= particles.getCount()");
 	}
     if(particleSystemStartDelay>0){
     	particleSystemStartDelay--;
     }
     else if(state != sPause){
-		for(int i= 0; i < aliveParticleCount; ++i){
-			updateParticle(&particles[i]);
-
-			if(deathTest(&particles[i])){
-
-				//kill the particle
-				killParticle(&particles[i]);
-
-				//maintain alive particles at front of the array
-				if(aliveParticleCount > 0){
-					particles[i]= particles[aliveParticleCount];
-				}
-			}
+		if(aliveParticleCount > 0){
+			updateParticles();
+			removeDeadParticles();
 		}
 
 		if(state != ParticleSystem::sFade){
 			emissionState= emissionState + emissionRate;
 			int emissionIntValue= (int) emissionState;
 			for(int i= 0; i < emissionIntValue; i++){
-				Particle *p= createParticle();
-				initParticle(p, i);
+				Particle p;
+				initParticle(&p, i);
+				particles.setParticle(createParticle(), p);
 			}
 			emissionState= emissionState - (float) emissionIntValue;
 		}
@@ -264,7 +513,7 @@ void ParticleSystem::setVisible(bool visible){
 string ParticleSystem::toString() const {
 	string result = "";
 
-	result += "particles = " + intToStr(particles.size());
+	result += "particles = " + intToStr(particles.getCount());
 
 //	for(unsigned int i = 0; i < particles.size(); ++i) {
 //		Particle &particle = particles[i];
@@ -399,7 +648,6 @@ void ParticleSystem::loadGame(const XmlNode *rootNode) {
 //		particle.saveGame(particleSystemNode);
 //	}
 
-	particles.clear();
 	particles.resize(particleCount);
 
 //	vector<XmlNode *> particleNodeList = particleSystemNode->getChildList("Particle");
@@ -505,48 +753,41 @@ int ParticleSystem::isEmpty() const{
 
 // =============== PROTECTED =========================
 
-// if there is one dead particle it returns it else, return the particle with 
-// less energy
-Particle * ParticleSystem::createParticle(){
+// if there is one dead particle it returns its index else, the index of the
+// particle with less energy
+int ParticleSystem::createParticle(){
 
 	//if any dead particles
 	if(aliveParticleCount < particleCount){
 		++aliveParticleCount;
-		return &particles[aliveParticleCount - 1];
+		return aliveParticleCount - 1;
 	}
 
 	//if not
-	int minEnergy= particles[0].energy;
+	int minEnergy= particles.energy[0];
 	int minEnergyParticle= 0;
 
 	for(int i= 0; i < particleCount; ++i){
-		if(particles[i].energy < minEnergy){
-			minEnergy= particles[i].energy;
+		if(particles.energy[i] < minEnergy){
+			minEnergy= particles.energy[i];
 			minEnergyParticle= i;
 		}
 	}
-	return &particles[minEnergyParticle];
-
-	/*
-	 //if any dead particles
-	 if(aliveParticleCount < particleCount) {
-	 ++aliveParticleCount;
-	 return &particles[aliveParticleCount-1];
-	 }
-
-	 //if not
-	 int minEnergy = particles[0].energy;
-	 int minEnergyParticle = 0;
-
-	 for(int i = 0; i < particleCount; ++i){
-	 if(particles[i].energy < minEnergy){
-	 minEnergy = particles[i].energy;
-	 minEnergyParticle = i;
-	 }
-	 }
+	return minEnergyParticle;
+}
 
-	 return &particles[minEnergyParticle];
-	 */
+//kills the particles without energy left
+void ParticleSystem::removeDeadParticles(){
+	for(int i= 0; i < aliveParticleCount;){
+		if(particles.energy[i] <= 0){
+			//maintain alive particles at front of the arrays
+			aliveParticleCount--;
+			particles.moveParticle(i, aliveParticleCount);
+		}
+		else{
+			++i;
+		}
+	}
 }
 
 void ParticleSystem::initParticle(Particle *p, int particleIndex){
@@ -559,19 +800,11 @@ void ParticleSystem::initParticle(Particle *p, int particleIndex){
 	p->energy= maxParticleEnergy + random.randRange(-varParticleEnergy, varParticleEnergy);
 }
 
-void ParticleSystem::updateParticle(Particle *p){
-	p->lastPos= p->pos;
-	p->pos= p->pos + p->speed;
-	p->speed= p->speed + p->accel;
-	p->energy--;
-}
-
-bool ParticleSystem::deathTest(Particle *p){
-	return p->energy <= 0;
-}
-
-void ParticleSystem::killParticle(Particle *p){
-	aliveParticleCount--;
+void ParticleSystem::updateParticles(){
+	particles.savePositions(aliveParticleCount);
+	particles.addSpeeds(aliveParticleCount, false);
+	particles.addAccels(aliveParticleCount);
+	particles.decEnergies(aliveParticleCount);
 }
 
 void ParticleSystem::setFactionColor(Vec3f factionColor){
@@ -633,20 +866,16 @@ void FireParticleSystem::initParticle(Particle *p, int particleIndex){
 	p->speed= Vec3f(0, speed + speed * random.randRange(-0.5f, 0.5f), 0) + windSpeed;
 }
 
-void FireParticleSystem::updateParticle(Particle *p){
-	p->lastPos= p->pos;
-	p->pos= p->pos + p->speed;
-	p->energy--;
-
-	if(p->color.x > 0.0f)
-		p->color.x*= 0.98f;
-	if(p->color.y > 0.0f)
-		p->color.y*= 0.98f;
-	if(p->color.w > 0.0f)
-		p->color.w*= 0.98f;
+void FireParticleSystem::updateParticles(){
+	particles.savePositions(aliveParticleCount);
+	particles.addSpeeds(aliveParticleCount, false);
+	particles.decEnergies(aliveParticleCount);
 
-	p->speed.x*= 1.001f;
+	fadeParticleValues(&particles.colorR[0], 0.98f, aliveParticleCount);
+	fadeParticleValues(&particles.colorG[0], 0.98f, aliveParticleCount);
+	fadeParticleValues(&particles.colorA[0], 0.98f, aliveParticleCount);
 
+	scaleParticleValues(&particles.speedX[0], 1.001f, aliveParticleCount);
 }
 
 // ================= SET PARAMS ====================
@@ -1090,56 +1319,58 @@ void UnitParticleSystem::update(){
 	ParticleSystem::update();
 }
 
-void UnitParticleSystem::updateParticle(Particle *p){
-	float energyRatio;
+void UnitParticleSystem::updateParticles(){
 	if(alternations > 0){
 		int interval= (maxParticleEnergy / alternations);
-		float moduloValue= (float)((int)(static_cast<float> (p->energy)) % interval);
+		for(int i= 0; i < aliveParticleCount; ++i){
+			float energyRatio;
+			float moduloValue= (float)((int)(static_cast<float> (particles.energy[i])) % interval);
 
-		if(moduloValue < interval / 2){
-			energyRatio= (interval - moduloValue) / interval;
-		}
-		else{
-			energyRatio= moduloValue / interval;
+			if(moduloValue < interval / 2){
+				energyRatio= (interval - moduloValue) / interval;
+			}
+			else{
+				energyRatio= moduloValue / interval;
+			}
+			particles.energyRatio[i]= clamp(energyRatio, 0.f, 1.f);
 		}
-		energyRatio= clamp(energyRatio, 0.f, 1.f);
 	}
 	else{
-		energyRatio= clamp(static_cast<float> (p->energy) / maxParticleEnergy, 0.f, 1.f);
+		particles.computeEnergyRatios(maxParticleEnergy, aliveParticleCount);
 	}
 
-	p->lastPos+= p->speed;
-	p->pos+= p->speed;
+	particles.addSpeeds(aliveParticleCount, true);
 	if(fixed){
-		p->lastPos+= fixedAddition;
-		p->pos+= fixedAddition;
+		particles.addToPositions(fixedAddition, aliveParticleCount);
 	}
-	p->speed+= p->accel;
-	p->color= color * energyRatio + colorNoEnergy * (1.0f - energyRatio);
+	particles.addAccels(aliveParticleCount);
+	particles.blendColors(color, colorNoEnergy, aliveParticleCount);
 	if(isDaylightAffected==true)
 	{
-		p->color.x=p->color.x*lightColor.x;
-		p->color.y=p->color.y*lightColor.y;
-		p->color.z=p->color.z*lightColor.z;
+		particles.scaleColors(lightColor, aliveParticleCount);
 	}
-	p->size= particleSize * energyRatio + sizeNoEnergy * (1.0f - energyRatio);
+	particles.blendSizes(particleSize, sizeNoEnergy, aliveParticleCount);
 	if(state == ParticleSystem::sFade || staticParticleCount < 1){
-		p->energy--;
+		particles.decEnergies(aliveParticleCount);
 	}
 	else{
 		if(maxParticleEnergy > 2){
-			if(energyUp){
-				p->energy++;
-			}
-			else{
-				p->energy--;
-			}
+			//energyUp is shared by the particles, so one after another
+			for(int i= 0; i < aliveParticleCount; ++i){
+				int &energy= particles.energy[i];
+				if(energyUp){
+					energy++;
+				}
+				else{
+					energy--;
+				}
 
-			if(p->energy == 1){
-				energyUp= true;
-			}
-			if(p->energy == maxParticleEnergy){
-				energyUp= false;
+				if(energy == 1){
+					energyUp= true;
+				}
+				if(energy == maxParticleEnergy){
+					energyUp= false;
+				}
 			}
 		}
 	}
@@ -1326,8 +1557,9 @@ void RainParticleSystem::initParticle(Particle *p, int particleIndex){
 	        + windSpeed;
 }
 
-bool RainParticleSystem::deathTest(Particle *p){
-	return p->pos.y < 0;
+void RainParticleSystem::updateParticles(){
+	ParticleSystem::updateParticles();
+	particles.killBelowGround(aliveParticleCount);
 }
 
 void RainParticleSystem::setRadius(float radius){
@@ -1378,8 +1610,9 @@ void SnowParticleSystem::initParticle(Particle *p, int particleIndex){
 	p->speed.y+= random.randRange(-0.005f, 0.005f);
 }
 
-bool SnowParticleSystem::deathTest(Particle *p){
-	return p->pos.y < 0;
+void SnowParticleSystem::updateParticles(){
+	ParticleSystem::updateParticles();
+	particles.killBelowGround(aliveParticleCount);
 }
 
 void SnowParticleSystem::setRadius(float radius){
@@ -1578,10 +1811,7 @@ void ProjectileParticleSystem::initParticle(Particle *p, int particleIndex){
 	        * speed;
 	p->accel= Vec3f(0.0f, -gravity, 0.0f);
 
-	updateParticle(p);
-}
-
-void ProjectileParticleSystem::updateParticle(Particle *p){
+	//first step of the particle, as updateParticles does it
 	float energyRatio= clamp(static_cast<float> (p->energy) / maxParticleEnergy, 0.f, 1.f);
 
 	p->lastPos+= p->speed;
@@ -1592,6 +1822,16 @@ void ProjectileParticleSystem::updateParticle(Particle *p){
 	p->energy--;
 }
 
+void ProjectileParticleSystem::updateParticles(){
+	particles.computeEnergyRatios(maxParticleEnergy, aliveParticleCount);
+
+	particles.addSpeeds(aliveParticleCount, true);
+	particles.addAccels(aliveParticleCount);
+	particles.blendColors(color, colorNoEnergy, aliveParticleCount);
+	particles.blendSizes(particleSize, sizeNoEnergy, aliveParticleCount);
+	particles.decEnergies(aliveParticleCount);
+}
+
 void ProjectileParticleSystem::setPath(Vec3f startPos, Vec3f endPos){
 
 	//compute axis
@@ -1779,15 +2019,15 @@ void SplashParticleSystem::initParticle(Particle *p, int particleIndex){
 	p->accel= Vec3f(0.0f, -gravity, 0.0f);
 }
 
-void SplashParticleSystem::updateParticle(Particle *p){
-	float energyRatio= clamp(static_cast<float> (p->energy) / maxParticleEnergy, 0.f, 1.f);
+void SplashParticleSystem::updateParticles(){
+	particles.computeEnergyRatios(maxParticleEnergy, aliveParticleCount);
 
-	p->lastPos= p->pos;
-	p->pos= p->pos + p->speed;
-	p->speed= p->speed + p->accel;
-	p->energy--;
-	p->color= color * energyRatio + colorNoEnergy * (1.0f - energyRatio);
-	p->size= particleSize * energyRatio + sizeNoEnergy * (1.0f - energyRatio);
+	particles.savePositions(aliveParticleCount);
+	particles.addSpeeds(aliveParticleCount, false);
+	particles.addAccels(aliveParticleCount);
+	particles.decEnergies(aliveParticleCount);
+	particles.blendColors(color, colorNoEnergy, aliveParticleCount);
+	particles.blendSizes(particleSize, sizeNoEnergy, aliveParticleCount);
 }
 
 void SplashParticleSystem::saveGame(XmlNode *rootNode) {
@@ -1849,12 +2089,107 @@ void SplashParticleSystem::loadGame(const XmlNode *rootNode) {
 //  ParticleManager
 // ===========================================================================
 
+// Below this many independent systems a frame they are updated on the
+// calling thread, the jobs would cost more than they save
+static const int particleSystemsPerJob = 16;
+
+// =====================================================
+//	class ParticleSystemUpdateJob
+// =====================================================
+
+class ParticleSystemUpdateJob : public Job {
+private:
+	const vector<ParticleSystem *> *particleSystemList;
+	int startIndex;
+	int endIndex;
+
+public:
+	ParticleSystemUpdateJob(const vector<ParticleSystem *> *particleSystemList, int startIndex, int endIndex) {
+		this->particleSystemList = particleSystemList;
+		this->startIndex = startIndex;
+		this->endIndex = endIndex;
+	}
+
+	virtual void runJob() {
+		for(int i = startIndex; i < endIndex; ++i) {
+			(*particleSystemList)[i]->update();
+		}
+	}
+};
+
 ParticleManager::ParticleManager() {
 	//assert(GlobalStaticFlags::getIsNonGraphicalModeEnabled() == false);
+	updating= false;
+	workerCount= -1;
+	jobSystem= NULL;
 }
 
 ParticleManager::~ParticleManager() {
 	end();
+
+	delete jobSystem;
+	jobSystem= NULL;
+}
+
+// -1 for one worker per extra cpu core, 0 updates every system on the
+// calling thread
+void ParticleManager::setWorkerCount(int workerCount) {
+	this->workerCount= workerCount;
+
+	delete jobSystem;
+	jobSystem= NULL;
+}
+
+static bool isParticleSystemShown(ParticleSystem *ps) {
+	switch(ps->getParticleSystemType()) {
+		case ParticleSystem::pst_UnitParticleSystem:
+		case ParticleSystem::pst_FireParticleSystem:
+			return ps->getVisible() || (ps->getState() == ParticleSystem::sFade);
+		default:
+			return true;
+	}
+}
+
+// true for systems whose update only changes the system itself: no
+// observer to call back into the game and no parent or children to move
+bool ParticleManager::canUpdateInParallel(ParticleSystem *ps) {
+	if(ps->getObserver() != NULL || ps->getChildCount() > 0) {
+		return false;
+	}
+	switch(ps->getParticleSystemType()) {
+		case ParticleSystem::pst_FireParticleSystem:
+		case ParticleSystem::pst_RainParticleSystem:
+		case ParticleSystem::pst_SnowParticleSystem:
+			return true;
+		case ParticleSystem::pst_UnitParticleSystem:
+			return static_cast<UnitParticleSystem *>(ps)->getParent() == NULL;
+		default:
+			return false;
+	}
+}
+
+void ParticleManager::updateParticleSystems(const vector<ParticleSystem *> &particleSystemList) {
+	int particleSystemCount= (int)particleSystemList.size();
+	if(workerCount == 0 || particleSystemCount < particleSystemsPerJob * 2) {
+		for(int i= 0; i < particleSystemCount; ++i) {
+			particleSystemList[i]->update();
+		}
+		return;
+	}
+
+	if(jobSystem == NULL) {
+		jobSystem= new JobSystem(workerCount);
+	}
+	int jobCount= (particleSystemCount + particleSystemsPerJob - 1) / particleSystemsPerJob;
+	vector<ParticleSystemUpdateJob> jobs;
+	jobs.reserve(jobCount);
+	jobBarrier.reset(jobCount);
+	for(int i= 0; i < jobCount; ++i) {
+		int startIndex= i * particleSystemsPerJob;
+		jobs.push_back(ParticleSystemUpdateJob(&particleSystemList, startIndex, min(startIndex + particleSystemsPerJob, particleSystemCount)));
+		jobSystem->submit(&jobs.back(), &jobBarrier);
+	}
+	jobSystem->waitForJobs(&jobBarrier);
 }
 
 void ParticleManager::render(ParticleRenderer *pr, ModelRenderer *mr) const{
@@ -1878,10 +2213,7 @@ bool ParticleManager::hasActiveParticleSystem(ParticleSystem::ParticleSystemType
 		if(ps != NULL){
 			//currentParticleCount+= ps->getAliveParticleCount();
 
-			bool showParticle= true;
-			if(dynamic_cast<UnitParticleSystem *> (ps) != NULL || dynamic_cast<FireParticleSystem *> (ps) != NULL){
-				showParticle= ps->getVisible() || (ps->getState() == ParticleSystem::sFade);
-			}
+			bool showParticle= isParticleSystemShown(ps);
 			if(showParticle == true){
 				//printf("Looking for [%d] current id [%d] i = %d\n",type,ps->getParticleSystemType(),i);
 
@@ -1904,17 +2236,24 @@ void ParticleManager::update(int renderFps){
 	size_t particleSystemCount= particleSystems.size();
 	int currentParticleCount= 0;
 
+	// Systems that may call back into the game are updated here in list
+	// order. The callbacks can remove systems, so the size is read again
+	// every step. Independent systems are kept for the parallel update.
 	vector<ParticleSystem *> cleanupParticleSystemsList;
+	vector<ParticleSystem *> parallelParticleSystemsList;
+	updating= true;
+	addedWhileUpdatingSet.clear();
 	for(unsigned int i= 0; i < particleSystems.size(); i++){
 		ParticleSystem *ps= particleSystems[i];
-		if(ps != NULL && validateParticleSystemStillExists(ps) == true) {
+		if(ps != NULL) {
 			currentParticleCount+= ps->getAliveParticleCount();
 
-			bool showParticle= true;
-			if(dynamic_cast<UnitParticleSystem *> (ps) != NULL || dynamic_cast<FireParticleSystem *> (ps) != NULL){
-				showParticle= ps->getVisible() || (ps->getState() == ParticleSystem::sFade);
-			}
+			bool showParticle= isParticleSystemShown(ps);
 			if(showParticle == true){
+				if(canUpdateInParallel(ps) == true) {
+					parallelParticleSystemsList.push_back(ps);
+					continue;
+				}
 				ps->update();
 				if(ps->isEmpty() && ps->getState() == ParticleSystem::sFade){
 					//delete ps;
@@ -1924,6 +2263,31 @@ void ParticleManager::update(int renderFps){
 			}
 		}
 	}
+
+	updating= false;
+
+	// A callback may have deleted one of the independent systems and a new
+	// system may have been managed at the same address, so systems added
+	// during the frame wait for the next one and each system is queued once
+	vector<ParticleSystem *> updateParticleSystemsList;
+	std::set<const ParticleSystem *> queuedSet;
+	for(unsigned int i= 0; i < parallelParticleSystemsList.size(); i++){
+		ParticleSystem *ps= parallelParticleSystemsList[i];
+		if(validateParticleSystemStillExists(ps) == true &&
+			addedWhileUpdatingSet.find(ps) == addedWhileUpdatingSet.end() &&
+			queuedSet.insert(ps).second == true) {
+			updateParticleSystemsList.push_back(ps);
+		}
+	}
+	addedWhileUpdatingSet.clear();
+	updateParticleSystems(updateParticleSystemsList);
+
+	for(unsigned int i= 0; i < updateParticleSystemsList.size(); i++){
+		ParticleSystem *ps= updateParticleSystemsList[i];
+		if(ps->isEmpty() && ps->getState() == ParticleSystem::sFade){
+			cleanupParticleSystemsList.push_back(ps);
+		}
+	}
 	//particleSystems.remove(NULL);
 	cleanupParticleSystems(cleanupParticleSystemsList);
 
@@ -1932,8 +2296,7 @@ void ParticleManager::update(int renderFps){
 }
 
 bool ParticleManager::validateParticleSystemStillExists(ParticleSystem * particleSystem) const{
-	int index= findParticleSystems(particleSystem, this->particleSystems);
-	return (index >= 0);
+	return particleSystemSet.find(particleSystem) != particleSystemSet.end();
 }
 
 int ParticleManager::findParticleSystems(ParticleSystem *psFind, const vector<ParticleSystem *> &particleSystems) const{
@@ -1950,8 +2313,8 @@ int ParticleManager::findParticleSystems(ParticleSystem *psFind, const vector<Pa
 
 void ParticleManager::cleanupParticleSystems(ParticleSystem *ps) {
 
-	int index= findParticleSystems(ps, this->particleSystems);
-	if(ps != NULL && index >= 0) {
+	if(ps != NULL && validateParticleSystemStillExists(ps) == true) {
+		int index= findParticleSystems(ps, this->particleSystems);
 //		printf("-- Delete cleanupParticleSystems [%p]\n",ps);
 //		static map<void *,int> deleteList;
 //		if(deleteList.find(ps) != deleteList.end()) {
@@ -1959,35 +2322,55 @@ void ParticleManager::cleanupParticleSystems(ParticleSystem *ps) {
 //		}
 //		deleteList[ps]++;
 
+		particleSystemSet.erase(ps);
 		delete ps;
 		this->particleSystems.erase(this->particleSystems.begin() + index);
 	}
 }
 
-void ParticleManager::cleanupParticleSystems(vector<ParticleSystem *> &particleSystems){
+// deletes the systems and removes them from the list in one pass,
+// keeping the order of the systems that stay
+template<typename T>
+static void cleanupParticleSystemList(vector<T *> &cleanupList, vector<ParticleSystem *> &particleSystems,
+									   std::set<const ParticleSystem *> &particleSystemSet) {
+	std::set<const ParticleSystem *> deletedSet;
+	for(int i= cleanupList.size()-1; i >= 0; i--){
+		ParticleSystem *ps= cleanupList[i];
+		if(ps != NULL && particleSystemSet.erase(ps) > 0) {
+			deletedSet.insert(ps);
+			delete ps;
+		}
+	}
+	cleanupList.clear();
 
-	for(int i= particleSystems.size()-1; i >= 0; i--){
-		ParticleSystem *ps= particleSystems[i];
-		cleanupParticleSystems(ps);
+	if(deletedSet.empty() == false) {
+		unsigned int keepCount= 0;
+		for(unsigned int i= 0; i < particleSystems.size(); i++){
+			if(deletedSet.find(particleSystems[i]) == deletedSet.end()) {
+				particleSystems[keepCount++]= particleSystems[i];
+			}
+		}
+		particleSystems.resize(keepCount);
 	}
+}
 
-	particleSystems.clear();
+void ParticleManager::cleanupParticleSystems(vector<ParticleSystem *> &particleSystems){
+	cleanupParticleSystemList(particleSystems, this->particleSystems, particleSystemSet);
 	//this->particleSystems.remove(NULL);
 }
 
 void ParticleManager::cleanupUnitParticleSystems(vector<UnitParticleSystem *> &particleSystems){
-
-	for(int i= particleSystems.size()-1; i >= 0; i--){
-		ParticleSystem *ps= particleSystems[i];
-		cleanupParticleSystems(ps);
-	}
-	particleSystems.clear();
+	cleanupParticleSystemList(particleSystems, this->particleSystems, particleSystemSet);
 	//this->particleSystems.remove(NULL);
 }
 
 void ParticleManager::manage(ParticleSystem *ps){
-	assert((std::find(particleSystems.begin(),particleSystems.end(),ps) == particleSystems.end()) && "particle cannot be added twice");
+	assert((particleSystemSet.find(ps) == particleSystemSet.end()) && "particle cannot be added twice");
 	particleSystems.push_back(ps);
+	particleSystemSet.insert(ps);
+	if(updating == true) {
+		addedWhileUpdatingSet.insert(ps);
+	}
 	for(int i=ps->getChildCount()-1; i>=0; i--)
 		manage(ps->getChild(i));
 }
@@ -2006,6 +2389,7 @@ void ParticleManager::end(){
 		delete ps;
 		particleSystems.pop_back();
 	}
+	particleSystemSet.clear();
 }
 
 }
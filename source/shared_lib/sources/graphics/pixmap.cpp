@@ -991,14 +991,84 @@ Pixmap2D* Pixmap2D::loadPath(const string& path) {
 	return pixmap;
 }
 
+// Images decoded ahead of time by Pixmap2D::preload, keyed by path
+typedef std::map<string, Pixmap2D *> PixmapPreloadCache;
+static Mutex mutexPixmapPreloadCache;
+static PixmapPreloadCache pixmapPreloadCache;
+
 void Pixmap2D::load(const string &path) {
 	//printf("Loading Pixmap2D [%s]\n",path.c_str());
 
+	if(loadPreloaded(path) == true) {
+		return;
+	}
 	FileReader<Pixmap2D>::readPath(path,this);
 	CalculatePixelsCRC(pixels,getPixelByteCount(), crc);
 	this->path = path;
 }
 
+bool Pixmap2D::loadPreloaded(const string &path) {
+	MutexSafeWrapper safeMutex(&mutexPixmapPreloadCache);
+	if(pixmapPreloadCache.empty() == true) {
+		return false;
+	}
+	PixmapPreloadCache::iterator iterFind = pixmapPreloadCache.find(path);
+	if(iterFind == pixmapPreloadCache.end()) {
+		return false;
+	}
+	Pixmap2D *pixmap = iterFind->second;
+	pixmapPreloadCache.erase(iterFind);
+	safeMutex.ReleaseLock();
+
+	bool result = false;
+	if(pixmap->components == this->components) {
+		deletePixels();
+		this->w = pixmap->w;
+		this->h = pixmap->h;
+		this->pixels = pixmap->pixels;
+		this->crc = pixmap->crc;
+		this->path = path;
+		pixmap->pixels = NULL;
+		result = true;
+	}
+	delete pixmap;
+	return result;
+}
+
+void Pixmap2D::preload(const string &path, int components) {
+	// only formats with a registered reader, the others are left to load
+	if(FileReader<Pixmap2D>::findFileReaders(extractExtension(path)) == NULL) {
+		return;
+	}
+
+	Pixmap2D *pixmap = new Pixmap2D(components);
+	try {
+		FileReader<Pixmap2D>::readPath(path,pixmap);
+		CalculatePixelsCRC(pixmap->pixels,pixmap->getPixelByteCount(), pixmap->crc);
+		pixmap->path = path;
+	}
+	catch(...) {
+		delete pixmap;
+		throw;
+	}
+
+	MutexSafeWrapper safeMutex(&mutexPixmapPreloadCache);
+	PixmapPreloadCache::iterator iterFind = pixmapPreloadCache.find(path);
+	if(iterFind != pixmapPreloadCache.end()) {
+		delete iterFind->second;
+	}
+	pixmapPreloadCache[path] = pixmap;
+}
+
+void Pixmap2D::clearPreloadCache() {
+	MutexSafeWrapper safeMutex(&mutexPixmapPreloadCache);
+	for(PixmapPreloadCache::iterator iterMap = pixmapPreloadCache.begin();
+		iterMap != pixmapPreloadCache.end(); ++iterMap) {
+		delete iterMap->second;
+	}
+	pixmapPreloadCache.clear();
+}
+
 void Pixmap2D::save(const string &path) {
 	string extension= path.substr(path.find_last_of('.')+1);
 	if(toLower(extension) == "bmp") {
@@ -0,0 +1,270 @@
+// ==============================================================
+//	This file is part of Glest Shared Library (www.glest.org)
+//
+//	Copyright (C) 2009-2010 Titus Tscharntke (info@titusgames.de) and
+//                          Mark Vejvoda (mark_vejvoda@hotmail.com)
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#include "job_system.h"
+
+#ifdef WIN32
+	#include <windows.h>
+#else
+	#include <unistd.h>
+#endif
+
+#include "util.h"
+#include "platform_common.h"
+#include "conversion.h"
+#include "platform_util.h"
+#include "trace.h"
+#include "leak_dumper.h"
+
+using namespace std;
+using namespace Shared::Util;
+
+namespace Shared { namespace PlatformCommon {
+
+// =====================================================
+//	class JobBarrier
+// =====================================================
+
+JobBarrier::JobBarrier() : semCompleted(0) {
+	pendingCount = 0;
+	lastError = "";
+}
+
+void JobBarrier::reset(int jobCount) {
+	static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
+	MutexSafeWrapper safeMutex(&mutex,mutexOwnerId);
+
+	semCompleted.resetSemValue(0);
+	pendingCount = jobCount;
+	lastError = "";
+	if(pendingCount <= 0) {
+		semCompleted.signal();
+	}
+}
+
+void JobBarrier::jobCompleted(const string &error) {
+	static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
+	MutexSafeWrapper safeMutex(&mutex,mutexOwnerId);
+
+	if(error != "") {
+		lastError = error;
+	}
+	pendingCount--;
+	if(pendingCount == 0) {
+		semCompleted.signal();
+	}
+}
+
+bool JobBarrier::waitTillCompleted(int waitMilliseconds) {
+	return (semCompleted.waitTillSignalled(waitMilliseconds) == 0);
+}
+
+int JobBarrier::getPendingCount() {
+	static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
+	MutexSafeWrapper safeMutex(&mutex,mutexOwnerId);
+	return pendingCount;
+}
+
+string JobBarrier::getLastError() {
+	static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
+	MutexSafeWrapper safeMutex(&mutex,mutexOwnerId);
+	return lastError;
+}
+
+// =====================================================
+//	class JobWorkerThread
+// =====================================================
+
+JobWorkerThread::JobWorkerThread(JobSystem *jobSystem, int workerIndex) : BaseThread() {
+	this->jobSystem = jobSystem;
+	this->workerIndex = workerIndex;
+}
+
+void JobWorkerThread::execute() {
+	RunningStatusSafeWrapper runningStatus(this);
+	if(SystemFlags::VERBOSE_MODE_ENABLED) printf("In [%s::%s Line: %d] ****************** STARTING job worker thread %d\n",__FILE__,__FUNCTION__,__LINE__,workerIndex);
+	if(Tracer::isEnabled() == true) {
+		Tracer::setThreadName(getUniqueID());
+	}
+
+	for(;getQuitStatus() == false;) {
+		// woken once per queued job, or by the shutdown
+		jobSystem->waitForQueuedJob(-1);
+		if(getQuitStatus() == true) {
+			break;
+		}
+
+		ExecutingTaskSafeWrapper safeExecutingTaskMutex(this);
+		for(;jobSystem->runNextJob(workerIndex) == true;) {
+		}
+	}
+
+	if(SystemFlags::VERBOSE_MODE_ENABLED) printf("In [%s::%s Line: %d] ****************** ENDING job worker thread %d\n",__FILE__,__FUNCTION__,__LINE__,workerIndex);
+}
+
+// =====================================================
+//	class JobSystem
+// =====================================================
+
+JobSystem::JobSystem(int workerCount) : semJobsQueued(0) {
+	if(workerCount < 0) {
+		workerCount = getDefaultWorkerCount();
+	}
+	nextQueueIndex = 0;
+
+	// the waiting thread helps out, it owns the last queue
+	for(int i = 0; i < workerCount + 1; ++i) {
+		queues.push_back(new JobQueue());
+	}
+	for(int i = 0; i < workerCount; ++i) {
+		static string mutexOwnerId = string(extractFileFromDirectoryPath(__FILE__).c_str()) + string("_") + intToStr(__LINE__);
+		JobWorkerThread *worker = new JobWorkerThread(this, i);
+		worker->setUniqueID(mutexOwnerId);
+		workers.push_back(worker);
+		worker->start();
+	}
+}
+
+JobSystem::~JobSystem() {
+	for(unsigned int i = 0; i < workers.size(); ++i) {
+		workers[i]->signalQuit();
+	}
+	for(unsigned int i = 0; i < workers.size(); ++i) {
+		semJobsQueued.signal();
+	}
+	for(unsigned int i = 0; i < workers.size(); ++i) {
+		if(workers[i]->shutdownAndWait() == true) {
+			delete workers[i];
+		}
+	}
+	workers.clear();
+
+	for(unsigned int i = 0; i < queues.size(); ++i) {
+		delete queues[i];
+	}
+	queues.clear();
+}
+
+int JobSystem::getDefaultWorkerCount() {
+	int cpuCount = 1;
+#ifdef WIN32
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo(&systemInfo);
+	cpuCount = systemInfo.dwNumberOfProcessors;
+#else
+	cpuCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	// the main thread runs jobs while it waits
+	return max(cpuCount - 1, 1);
+}
+
+void JobSystem::submit(Job *job, JobBarrier *barrier) {
+	// several threads may share one pool
+	static string mutexOwnerIdQueue = string(__FILE__) + string("_") + intToStr(__LINE__);
+	MutexSafeWrapper safeMutexQueueIndex(&nextQueueIndexMutex,mutexOwnerIdQueue);
+	JobQueue *queue = queues[nextQueueIndex];
+	nextQueueIndex = (nextQueueIndex + 1) % (int)queues.size();
+	safeMutexQueueIndex.ReleaseLock();
+
+	static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
+	MutexSafeWrapper safeMutex(&queue->mutex,mutexOwnerId);
+	queue->jobs.push_back(JobEntry(job, barrier));
+	safeMutex.ReleaseLock();
+
+	semJobsQueued.signal();
+}
+
+// Runs one job from the worker's own queue, else from another queue.
+// Jobs are taken in submission order so callers can queue the longest
+// work first. workerIndex < 0 is the waiting thread.
+bool JobSystem::runNextJob(int workerIndex) {
+	int queueIndex = (workerIndex >= 0 ? workerIndex : (int)queues.size() - 1);
+
+	JobEntry entry;
+	if(popJob(queueIndex, entry) == false && stealJob(queueIndex, entry) == false) {
+		return false;
+	}
+	executeJob(entry);
+	return true;
+}
+
+// Rethrows a job's error, but only after every job of the batch is done
+bool JobSystem::waitForJobs(JobBarrier *barrier, int waitMilliseconds) {
+	for(;runNextJob(-1) == true;) {
+	}
+	bool completed = barrier->waitTillCompleted(waitMilliseconds);
+
+	string error = barrier->getLastError();
+	if(error != "") {
+		// the other jobs of the batch may still use the caller's data
+		if(completed == false) {
+			barrier->waitTillCompleted(-1);
+		}
+		throw megaglest_runtime_error(error);
+	}
+	return completed;
+}
+
+bool JobSystem::waitForQueuedJob(int waitMilliseconds) {
+	return (semJobsQueued.waitTillSignalled(waitMilliseconds) == 0);
+}
+
+bool JobSystem::popJob(int queueIndex, JobEntry &entry) {
+	JobQueue *queue = queues[queueIndex];
+
+	static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
+	MutexSafeWrapper safeMutex(&queue->mutex,mutexOwnerId);
+	if(queue->jobs.empty() == true) {
+		return false;
+	}
+	entry = queue->jobs.front();
+	queue->jobs.pop_front();
+	return true;
+}
+
+bool JobSystem::stealJob(int thiefIndex, JobEntry &entry) {
+	for(unsigned int i = 1; i < queues.size(); ++i) {
+		JobQueue *queue = queues[(thiefIndex + i) % queues.size()];
+
+		static string mutexOwnerId = string(__FILE__) + string("_") + intToStr(__LINE__);
+		MutexSafeWrapper safeMutex(&queue->mutex,mutexOwnerId);
+		if(queue->jobs.empty() == false) {
+			entry = queue->jobs.front();
+			queue->jobs.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::executeJob(const JobEntry &entry) {
+	string error = "";
+	try {
+		entry.job->runJob();
+	}
+	catch(const exception &ex) {
+		SystemFlags::OutputDebug(SystemFlags::debugError,"In [%s::%s Line: %d] Error [%s]\n",__FILE__,__FUNCTION__,__LINE__,ex.what());
+		error = ex.what();
+	}
+	catch(...) {
+		char szBuf[8096]="";
+		snprintf(szBuf,8096,"In [%s::%s %d] UNKNOWN error\n",__FILE__,__FUNCTION__,__LINE__);
+		SystemFlags::OutputDebug(SystemFlags::debugError,szBuf);
+		error = szBuf;
+	}
+
+	if(entry.barrier != NULL) {
+		entry.barrier->jobCompleted(error);
+	}
+}
+
+}}//end namespace
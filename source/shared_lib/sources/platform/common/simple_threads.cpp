@@ -72,7 +72,8 @@ void FileCRCPreCacheThread::execute() {
         		if(SystemFlags::VERBOSE_MODE_ENABLED) printf("********************** CRC Controller thread START **********************\n");
         		time_t elapsedTime = time(NULL);
 
-        		Checksum::clearFileCache();
+        		// Cached CRCs are checked against the status of their files,
+        		// so the pass only hashes files changed since the last one
 
 				vector<string> techPaths;
 				findDirs(techDataPaths, techPaths);
@@ -209,6 +210,8 @@ void FileCRCPreCacheThread::execute() {
 			            if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d] unknown error\n",__FILE__,__FUNCTION__,__LINE__);
 			        }
 
+					Checksum::saveFileCache();
+
 					if(SystemFlags::VERBOSE_MODE_ENABLED) printf("********************** CRC Controller thread took %.2f seconds END **********************\n",difftime(time(NULL),elapsedTime));
                 }
             }
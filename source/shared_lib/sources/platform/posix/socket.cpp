@@ -67,6 +67,10 @@ namespace Shared{ namespace Platform{
 bool Socket::disableNagle = false;
 int Socket::DEFAULT_SOCKET_SENDBUF_SIZE = -1;
 int Socket::DEFAULT_SOCKET_RECVBUF_SIZE = -1;
+bool Socket::enableReceiveBuffer = true;
+static const int SOCKET_RECEIVE_BUFFER_CHUNK_SIZE = 65536;
+static int socketDisconnectCount = 0;
+static Mutex mutexSocketDisconnectCount;
 
 int Socket::broadcast_portno    = 61357;
 int ServerSocket::ftpServerPort = 61358;
@@ -798,6 +802,8 @@ Socket::Socket(PLATFORM_SOCKET sock) {
 	this->sock= sock;
 	this->isSocketBlocking = true;
 	this->connectedIpAddress = "";
+	this->receiveBufferStart = 0;
+	this->receiveBufferEnd = 0;
 }
 
 Socket::Socket() {
@@ -815,6 +821,8 @@ Socket::Socket() {
 	//this->pingThread = NULL;
 
 	this->connectedIpAddress = "";
+	this->receiveBufferStart = 0;
+	this->receiveBufferEnd = 0;
 
 	sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
 	if(isSocketValid() == false) {
@@ -968,6 +976,11 @@ void Socket::disconnectSocket() {
         ::closesocket(sock);
         sock = INVALID_SOCKET;
 #endif
+        receiveBufferStart = 0;
+        receiveBufferEnd = 0;
+        MutexSafeWrapper safeMutexCount(&mutexSocketDisconnectCount,CODE_AT_LINE);
+        socketDisconnectCount++;
+        safeMutexCount.ReleaseLock();
         }
         safeMutex.ReleaseLock();
         safeMutex1.ReleaseLock();
@@ -976,6 +989,11 @@ void Socket::disconnectSocket() {
     if(SystemFlags::getSystemSettingType(SystemFlags::debugNetwork).enabled) SystemFlags::OutputDebug(SystemFlags::debugNetwork,"In [%s::%s] END closing socket = %d...\n",__FILE__,__FUNCTION__,sock);
 }
 
+int Socket::getDisconnectCount() {
+	MutexSafeWrapper safeMutex(&mutexSocketDisconnectCount,CODE_AT_LINE);
+	return socketDisconnectCount;
+}
+
 // Int lookup is socket fd while bool result is whether or not that socket was signalled for reading
 bool Socket::hasDataToRead(std::map<PLATFORM_SOCKET,bool> &socketTriggeredList)
 {
@@ -1040,6 +1058,9 @@ bool Socket::hasDataToRead(std::map<PLATFORM_SOCKET,bool> &socketTriggeredList)
 bool Socket::hasDataToRead()
 {
 	MutexSafeWrapper safeMutex(dataSynchAccessorRead,CODE_AT_LINE);
+	if(receiveBufferEnd > receiveBufferStart) {
+		return true;
+	}
     return Socket::hasDataToRead(sock) ;
 }
 
@@ -1049,6 +1070,20 @@ bool Socket::hasDataToRead(PLATFORM_SOCKET socket)
 
     if(Socket::isSocketValid(&socket) == true)
     {
+#ifndef WIN32
+        // poll does not depend on the socket id being below FD_SETSIZE
+        struct pollfd pfd;
+        pfd.fd = socket;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        int retval = poll(&pfd, 1, 0);
+        // errors and hangups are reported by the read that follows
+        if(retval > 0 && pfd.revents != 0)
+        {
+            bResult = true;
+        }
+#else
         fd_set rfds;
         struct timeval tv;
 
@@ -1072,6 +1107,7 @@ bool Socket::hasDataToRead(PLATFORM_SOCKET socket)
                 bResult = true;
             }
         }
+#endif
     }
 
     return bResult;
@@ -1079,6 +1115,9 @@ bool Socket::hasDataToRead(PLATFORM_SOCKET socket)
 
 bool Socket::hasDataToReadWithWait(int waitMicroseconds) {
 	MutexSafeWrapper safeMutex(dataSynchAccessorRead,CODE_AT_LINE);
+	if(receiveBufferEnd > receiveBufferStart) {
+		return true;
+	}
     return Socket::hasDataToReadWithWait(sock,waitMicroseconds) ;
 }
 
@@ -1089,6 +1128,18 @@ bool Socket::hasDataToReadWithWait(PLATFORM_SOCKET socket,int waitMicroseconds)
     chono.start();
     if(Socket::isSocketValid(&socket) == true)
     {
+#ifndef WIN32
+        struct pollfd pfd;
+        pfd.fd = socket;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        int retval = poll(&pfd, 1, (waitMicroseconds + 999) / 1000);
+        if(retval > 0 && pfd.revents != 0)
+        {
+            bResult = true;
+        }
+#else
         fd_set rfds;
         struct timeval tv;
 
@@ -1112,15 +1163,143 @@ bool Socket::hasDataToReadWithWait(PLATFORM_SOCKET socket,int waitMicroseconds)
                 bResult = true;
             }
         }
+#endif
     }
 
     //printf("hasdata waited [%d] milliseconds [%d], bResult = %d\n",chono.getMillis(),waitMilliseconds,bResult);
     return bResult;
 }
 
+// =====================================================
+//	class SocketPoller
+// =====================================================
+
+#if defined(__linux__)
+// ignored by current kernels but has to be positive
+static const int socketPollerSizeHint = 16;
+#endif
+
+SocketPoller::SocketPoller() {
+#if defined(__linux__)
+	epollFd = epoll_create(socketPollerSizeHint);
+	if(epollFd < 0) {
+		if(SystemFlags::getSystemSettingType(SystemFlags::debugNetwork).enabled) SystemFlags::OutputDebug(SystemFlags::debugNetwork,"In [%s::%s] Line: %d, epoll_create failed error = %s, falling back to select\n",__FILE__,__FUNCTION__,__LINE__,getLastSocketErrorFormattedText().c_str());
+	}
+#endif
+	lastDisconnectCount = Socket::getDisconnectCount();
+}
+
+SocketPoller::~SocketPoller() {
+#if defined(__linux__)
+	if(epollFd >= 0) {
+		::close(epollFd);
+		epollFd = -1;
+	}
+#endif
+}
+
+void SocketPoller::clearRegisteredSockets() {
+#if defined(__linux__)
+	// a closed socket leaves the epoll set by itself, start over with a new set
+	// since a reused socket id would otherwise look already registered
+	if(epollFd >= 0) {
+		::close(epollFd);
+	}
+	epollFd = epoll_create(socketPollerSizeHint);
+#endif
+	registeredSockets.clear();
+}
+
+void SocketPoller::updateRegisteredSockets(const std::map<PLATFORM_SOCKET,bool> &socketTriggeredList) {
+	int disconnectCount = Socket::getDisconnectCount();
+	if(disconnectCount != lastDisconnectCount) {
+		lastDisconnectCount = disconnectCount;
+		clearRegisteredSockets();
+	}
+
+#if defined(__linux__)
+	for(std::map<PLATFORM_SOCKET,bool>::iterator iterMap = registeredSockets.begin();
+		iterMap != registeredSockets.end();) {
+		if(socketTriggeredList.find(iterMap->first) == socketTriggeredList.end()) {
+			struct epoll_event event;
+			memset(&event, 0, sizeof(event));
+			epoll_ctl(epollFd, EPOLL_CTL_DEL, iterMap->first, &event);
+			registeredSockets.erase(iterMap++);
+		}
+		else {
+			++iterMap;
+		}
+	}
+
+	for(std::map<PLATFORM_SOCKET,bool>::const_iterator iterMap = socketTriggeredList.begin();
+		iterMap != socketTriggeredList.end(); ++iterMap) {
+		PLATFORM_SOCKET socket = iterMap->first;
+		if(Socket::isSocketValid(&socket) == true &&
+			registeredSockets.find(socket) == registeredSockets.end()) {
+			struct epoll_event event;
+			memset(&event, 0, sizeof(event));
+			event.events = EPOLLIN;
+			event.data.fd = socket;
+			if(epoll_ctl(epollFd, EPOLL_CTL_ADD, socket, &event) == 0) {
+				registeredSockets[socket] = true;
+			}
+			else {
+				if(SystemFlags::getSystemSettingType(SystemFlags::debugNetwork).enabled) SystemFlags::OutputDebug(SystemFlags::debugNetwork,"In [%s::%s] Line: %d, epoll_ctl failed for socket = %d error = %s\n",__FILE__,__FUNCTION__,__LINE__,socket,getLastSocketErrorFormattedText().c_str());
+			}
+		}
+	}
+#endif
+}
+
+bool SocketPoller::hasDataToRead(std::map<PLATFORM_SOCKET,bool> &socketTriggeredList, int waitMicroseconds) {
+	if(socketTriggeredList.empty() == true) {
+		return false;
+	}
+
+#if defined(__linux__)
+	updateRegisteredSockets(socketTriggeredList);
+	if(epollFd < 0 || registeredSockets.size() != socketTriggeredList.size()) {
+		return Socket::hasDataToRead(socketTriggeredList);
+	}
+
+	if(readyEvents.size() < registeredSockets.size()) {
+		readyEvents.resize(registeredSockets.size());
+	}
+	int retval = epoll_wait(epollFd, &readyEvents[0], (int)readyEvents.size(), (waitMicroseconds + 999) / 1000);
+	if(retval < 0) {
+		if(SystemFlags::getSystemSettingType(SystemFlags::debugNetwork).enabled) SystemFlags::OutputDebug(SystemFlags::debugNetwork,"In [%s::%s] Line: %d, ERROR epoll_wait retval = %d error = %s\n",__FILE__,__FUNCTION__,__LINE__,retval,getLastSocketErrorFormattedText().c_str());
+		return false;
+	}
+	else if(retval == 0) {
+		return false;
+	}
+
+	for(std::map<PLATFORM_SOCKET,bool>::iterator iterMap = socketTriggeredList.begin();
+		iterMap != socketTriggeredList.end(); ++iterMap) {
+		iterMap->second = false;
+	}
+	// errors and hangups are reported by the read that follows
+	for(int i = 0; i < retval; ++i) {
+		std::map<PLATFORM_SOCKET,bool>::iterator iterFind = socketTriggeredList.find(readyEvents[i].data.fd);
+		if(iterFind != socketTriggeredList.end()) {
+			iterFind->second = true;
+		}
+	}
+	return true;
+#else
+	return Socket::hasDataToRead(socketTriggeredList);
+#endif
+}
+
 int Socket::getDataToRead(bool wantImmediateReply) {
 	unsigned long size = 0;
 
+	// at least this much can be read without a system call
+	int bufferedSize = getReceiveBufferedSize();
+	if(bufferedSize > 0) {
+		return bufferedSize;
+	}
+
     //fd_set rfds;
     //struct timeval tv;
     //int retval;
@@ -1359,7 +1538,101 @@ int Socket::send(const void *data, int dataSize) {
 	return static_cast<int>(bytesSent);
 }
 
+int Socket::getReceiveBufferedSize() {
+	MutexSafeWrapper safeMutex(dataSynchAccessorRead,CODE_AT_LINE);
+	return receiveBufferEnd - receiveBufferStart;
+}
+
+// Reads as much as the socket has into the receive buffer, the caller
+// holds dataSynchAccessorRead
+int Socket::fillReceiveBuffer(int minimumCapacity) {
+	if(receiveBufferStart > 0) {
+		if(receiveBufferEnd > receiveBufferStart) {
+			memmove(&receiveBuffer[0], &receiveBuffer[receiveBufferStart], receiveBufferEnd - receiveBufferStart);
+		}
+		receiveBufferEnd -= receiveBufferStart;
+		receiveBufferStart = 0;
+	}
+	int capacity = max(minimumCapacity, SOCKET_RECEIVE_BUFFER_CHUNK_SIZE);
+	if((int)receiveBuffer.size() < capacity) {
+		receiveBuffer.resize(capacity);
+	}
+
+	int bytesReceived = receiveDirect(&receiveBuffer[receiveBufferEnd], (int)receiveBuffer.size() - receiveBufferEnd, false);
+	if(bytesReceived > 0) {
+		receiveBufferEnd += bytesReceived;
+	}
+	return bytesReceived;
+}
+
 int Socket::receive(void *data, int dataSize, bool tryReceiveUntilDataSizeMet) {
+	if(enableReceiveBuffer == false) {
+		return receiveDirect(data, dataSize, tryReceiveUntilDataSizeMet);
+	}
+
+	MutexSafeWrapper safeMutex(dataSynchAccessorRead,CODE_AT_LINE);
+	char *dataAsCharPointer = reinterpret_cast<char *>(data);
+	int bytesReceived = 0;
+	while(bytesReceived < dataSize) {
+		int bufferedSize = receiveBufferEnd - receiveBufferStart;
+		if(bufferedSize > 0) {
+			int bytesToCopy = min(bufferedSize, dataSize - bytesReceived);
+			memcpy(&dataAsCharPointer[bytesReceived], &receiveBuffer[receiveBufferStart], bytesToCopy);
+			receiveBufferStart += bytesToCopy;
+			bytesReceived += bytesToCopy;
+			if(receiveBufferStart == receiveBufferEnd) {
+				receiveBufferStart = 0;
+				receiveBufferEnd = 0;
+			}
+		}
+		else if(bytesReceived > 0 && tryReceiveUntilDataSizeMet == false) {
+			break;
+		}
+		else if(dataSize - bytesReceived >= SOCKET_RECEIVE_BUFFER_CHUNK_SIZE) {
+			// large payloads are read straight into the caller's memory
+			int result = receiveDirect(&dataAsCharPointer[bytesReceived], dataSize - bytesReceived, tryReceiveUntilDataSizeMet);
+			if(result <= 0) {
+				return (bytesReceived > 0 ? bytesReceived : result);
+			}
+			bytesReceived += result;
+		}
+		else {
+			int result = fillReceiveBuffer(0);
+			if(result <= 0) {
+				return (bytesReceived > 0 ? bytesReceived : result);
+			}
+		}
+	}
+	return bytesReceived;
+}
+
+char * Socket::receiveInPlace(int dataSize) {
+	MutexSafeWrapper safeMutex(dataSynchAccessorRead,CODE_AT_LINE);
+	if(enableReceiveBuffer == false) {
+		if((int)receiveBuffer.size() < dataSize) {
+			receiveBuffer.resize(dataSize);
+		}
+		int bytesReceived = receiveDirect(&receiveBuffer[0], dataSize, true);
+		return (bytesReceived == dataSize ? &receiveBuffer[0] : NULL);
+	}
+
+	while(receiveBufferEnd - receiveBufferStart < dataSize) {
+		int result = fillReceiveBuffer(dataSize);
+		if(result <= 0) {
+			return NULL;
+		}
+	}
+	// the memory stays put until the next fill, which is after the caller is done
+	char *result = &receiveBuffer[receiveBufferStart];
+	receiveBufferStart += dataSize;
+	if(receiveBufferStart == receiveBufferEnd) {
+		receiveBufferStart = 0;
+		receiveBufferEnd = 0;
+	}
+	return result;
+}
+
+int Socket::receiveDirect(void *data, int dataSize, bool tryReceiveUntilDataSizeMet) {
 	const int MAX_RECV_WAIT_SECONDS = 3;
 
 	ssize_t bytesReceived = 0;
@@ -1427,7 +1700,7 @@ int Socket::receive(void *data, int dataSize, bool tryReceiveUntilDataSizeMet) {
 		if(SystemFlags::VERBOSE_MODE_ENABLED) printf("\nIn [%s::%s Line: %d] WARNING, attempting to receive MORE data, bytesReceived = %d, dataSize = %d, newBufferSize = %d\n",__FILE__,__FUNCTION__,__LINE__,(int)bytesReceived,dataSize,newBufferSize);
 
 		char *dataAsCharPointer = reinterpret_cast<char *>(data);
-		int additionalBytes = receive(&dataAsCharPointer[bytesReceived], newBufferSize, tryReceiveUntilDataSizeMet);
+		int additionalBytes = receiveDirect(&dataAsCharPointer[bytesReceived], newBufferSize, tryReceiveUntilDataSizeMet);
 
 		if(SystemFlags::getSystemSettingType(SystemFlags::debugNetwork).enabled) SystemFlags::OutputDebug(SystemFlags::debugNetwork,"In [%s::%s Line: %d] WARNING, additionalBytes = %d\n",__FILE__,__FUNCTION__,__LINE__,additionalBytes);
 		if(SystemFlags::VERBOSE_MODE_ENABLED) printf("\nIn [%s::%s Line: %d] WARNING, additionalBytes = %d\n",__FILE__,__FUNCTION__,__LINE__,additionalBytes);
@@ -1476,6 +1749,31 @@ SafeSocketBlockToggleWrapper::~SafeSocketBlockToggleWrapper() {
 }
 
 int Socket::peek(void *data, int dataSize,bool mustGetData,int *pLastSocketError) {
+	if(enableReceiveBuffer == true) {
+		MutexSafeWrapper safeMutex(dataSynchAccessorRead,CODE_AT_LINE);
+		// pull in what has arrived so the reads after the peek need no system call
+		if(receiveBufferEnd == receiveBufferStart && Socket::hasDataToRead(sock) == true) {
+			fillReceiveBuffer(0);
+		}
+		// once bytes are buffered the socket no longer holds the start of the stream
+		if(receiveBufferEnd > receiveBufferStart) {
+			if(receiveBufferEnd - receiveBufferStart < dataSize && Socket::hasDataToRead(sock) == true) {
+				fillReceiveBuffer(0);
+			}
+			int bytesToCopy = min(receiveBufferEnd - receiveBufferStart, dataSize);
+			if(bytesToCopy > 0) {
+				memcpy(data, &receiveBuffer[receiveBufferStart], bytesToCopy);
+			}
+			if(pLastSocketError != NULL) {
+				*pLastSocketError = 0;
+			}
+			return bytesToCopy;
+		}
+	}
+	return peekDirect(data, dataSize, mustGetData, pLastSocketError);
+}
+
+int Socket::peekDirect(void *data, int dataSize,bool mustGetData,int *pLastSocketError) {
 	Chrono chrono;
 	if(SystemFlags::getSystemSettingType(SystemFlags::debugNetwork).enabled) chrono.start();
 
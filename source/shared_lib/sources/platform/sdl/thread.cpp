@@ -16,6 +16,7 @@
 #include <algorithm>
 #include "platform_util.h"
 #include "platform_common.h"
+#include "trace.h"
 #include <memory>
 
 using namespace std;
@@ -86,6 +87,7 @@ int Thread::beginExecution(void* data) {
 		throw megaglest_runtime_error(szBuf);
 	}
 	thread->execute();
+	Shared::Util::Tracer::releaseThreadBuffer();
 	return 0;
 }
 
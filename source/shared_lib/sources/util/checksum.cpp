@@ -21,10 +21,15 @@
 
 #include <sys/stat.h> // for open()
 
+#if defined(__SSE4_2__)
+  #include <nmmintrin.h>
+#endif
+
 #include "util.h"
 #include "platform_common.h"
 #include "conversion.h"
 #include "platform_util.h"
+#include "job_system.h"
 #include "leak_dumper.h"
 
 using namespace std;
@@ -38,7 +43,57 @@ namespace Shared{ namespace Util{
 // =====================================================
 
 Mutex Checksum::fileListCacheSynchAccessor;
-std::map<string,uint32> Checksum::fileListCache;
+std::map<string,FileCRCIndexEntry> Checksum::fileListCache;
+bool Checksum::fileListCacheLoaded = false;
+bool Checksum::fileListCacheChanged = false;
+JobSystem *Checksum::fileListCacheJobSystem = NULL;
+
+// The index of file CRCs is kept on disk so that only files changed since
+// the last run are hashed again, one line per file:
+// crc size modified changed inode path
+static const char *fileCacheIndexFileName	= "file_crc_index.txt";
+static const char *fileCacheIndexHeader		= "MGCRCINDEX 2";
+
+// The change time and inode also catch files replaced by a copy or an
+// archive that kept the old size and modification time
+static bool getFileStatus(const string &path, FileCRCIndexEntry &entry) {
+#ifdef WIN32
+  #if defined(__MINGW32__)
+	struct _stat stbuf;
+  #else
+	struct _stat64i32 stbuf;
+  #endif
+	if(_wstat(utf8_decode(path).c_str(), &stbuf) == -1) {
+#else
+	struct stat stbuf;
+	if(stat(path.c_str(), &stbuf) == -1) {
+#endif
+		return false;
+	}
+	entry.size = stbuf.st_size;
+	entry.lastModified = stbuf.st_mtime;
+	entry.lastChanged = stbuf.st_ctime;
+	entry.inode = stbuf.st_ino;
+	return true;
+}
+
+// =====================================================
+//	class FileCRCJob
+// =====================================================
+
+class FileCRCJob : public Job {
+public:
+	string path;
+	uint32 crc;
+
+	FileCRCJob(const string &path) {
+		this->path = path;
+		this->crc = 0;
+	}
+	virtual void runJob() {
+		crc = Checksum::getFileSum(path);
+	}
+};
 
 int crc_table[256] =
 {
@@ -76,6 +131,48 @@ int crc_table[256] =
 	0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94, 0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
 };
 
+// Tables to process 8 bytes per step (slicing by 8), entry [k][i] is the
+// crc of byte i followed by k zero bytes. The first table of crcSliceTable
+// is crc_table so the result is the same as adding one byte at a time.
+static uint32 crcSliceTable[8][256];
+static uint32 crc32cSliceTable[8][256];
+
+static bool initCrcSliceTables() {
+	for(int i = 0; i < 256; ++i) {
+		crcSliceTable[0][i] = (uint32)crc_table[i];
+
+		uint32 crc = (uint32)i;
+		for(int bit = 0; bit < 8; ++bit) {
+			crc = (crc >> 1) ^ ((crc & 1) != 0 ? 0x82F63B78 : 0);
+		}
+		crc32cSliceTable[0][i] = crc;
+	}
+	for(int k = 1; k < 8; ++k) {
+		for(int i = 0; i < 256; ++i) {
+			crcSliceTable[k][i] = (crcSliceTable[k-1][i] >> 8) ^ crcSliceTable[0][crcSliceTable[k-1][i] & 0xff];
+			crc32cSliceTable[k][i] = (crc32cSliceTable[k-1][i] >> 8) ^ crc32cSliceTable[0][crc32cSliceTable[k-1][i] & 0xff];
+		}
+	}
+	return true;
+}
+static bool crcSliceTablesReady = initCrcSliceTables();
+
+// Bytes are combined explicitly so this works for any alignment and byte order
+static uint32 updateCrcSliced(uint32 crc, const unsigned char *data, size_t size, uint32 table[8][256]) {
+	for(; size >= 8; data += 8, size -= 8) {
+		uint32 low = crc ^ ((uint32)data[0] | ((uint32)data[1] << 8) | ((uint32)data[2] << 16) | ((uint32)data[3] << 24));
+		uint32 high = (uint32)data[4] | ((uint32)data[5] << 8) | ((uint32)data[6] << 16) | ((uint32)data[7] << 24);
+		crc = table[7][low & 0xff] ^ table[6][(low >> 8) & 0xff] ^
+			  table[5][(low >> 16) & 0xff] ^ table[4][low >> 24] ^
+			  table[3][high & 0xff] ^ table[2][(high >> 8) & 0xff] ^
+			  table[1][(high >> 16) & 0xff] ^ table[0][high >> 24];
+	}
+	for(; size > 0; ++data, --size) {
+		crc = (crc >> 8) ^ table[0][*data ^ (crc & 0xff)];
+	}
+	return crc;
+}
+
 Checksum::Checksum() {
 	sum= 0;
 	r= 55665;
@@ -101,15 +198,37 @@ uint32 Checksum::addByte(const char value) {
 
 uint32 Checksum::addBytes(const void *_data, size_t _size) {
 	const unsigned char *rVal = reinterpret_cast<const unsigned char *>(_data);
-	sum = ~sum;
-	while (_size--) {
-		sum = (sum >> 8) ^ crc_table[*rVal++ ^ (sum & 0xff)];
-	}
-	sum = ~sum;
+	sum = ~updateCrcSliced(~sum, rVal, _size, crcSliceTable);
 
 	return sum;
 }
 
+uint32 Checksum::getFastSum(const void *data, size_t size, uint32 previousSum) {
+	const unsigned char *buf = reinterpret_cast<const unsigned char *>(data);
+	uint32 crc = ~previousSum;
+#if defined(__SSE4_2__)
+	for(; size > 0 && ((size_t)buf & 7) != 0; ++buf, --size) {
+		crc = _mm_crc32_u8(crc, *buf);
+	}
+  #if defined(__x86_64__)
+	uint64 crc64 = crc;
+	for(; size >= 8; buf += 8, size -= 8) {
+		crc64 = _mm_crc32_u64(crc64, *reinterpret_cast<const uint64 *>(buf));
+	}
+	crc = (uint32)crc64;
+  #endif
+	for(; size >= 4; buf += 4, size -= 4) {
+		crc = _mm_crc32_u32(crc, *reinterpret_cast<const uint32 *>(buf));
+	}
+	for(; size > 0; ++buf, --size) {
+		crc = _mm_crc32_u8(crc, *buf);
+	}
+#else
+	crc = updateCrcSliced(crc, buf, size, crc32cSliceTable);
+#endif
+	return ~crc;
+}
+
 
 void Checksum::addSum(uint32 value) {
 	sum += value;
@@ -129,8 +248,8 @@ uint32 Checksum::addInt(const int32 &value) {
 }
 
 void Checksum::addString(const string &value) {
-	for(unsigned int i = 0; i < value.size(); ++i) {
-		addByte(value[i]);
+	if(value.empty() == false) {
+		addBytes(value.data(), value.size());
 	}
 }
 
@@ -277,41 +396,40 @@ bool Checksum::addFileToSum(const string &path) {
 		if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d] buf.size() = %d, path [%s], isXMLFile = %d\n",__FILE__,__FUNCTION__,__LINE__,buf.size(), path.c_str(),isXMLFile);
 
 		if(isXMLFile == true) {
+			// Ignore Spaces and comments in XML files as they are
+			// ONLY for formatting, the bytes in between are added
+			// a run at a time
+			std::size_t runStart = 0;
 			for(std::size_t i = 0; i < buf.size(); ++i) {
-				// Ignore Spaces in XML files as they are
-				// ONLY for formatting
-				//if(isXMLFile == true) {
-					if(inCommentTag == true) {
-						if(buf[i] == '>' && i >= 3 && buf[i-1] == '-' && buf[i-2] == '-') {
-							inCommentTag = false;
-							//printf("TURNING OFF comment TAG, i = %d [%c]",i,buf[i]);
-							if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d] i = %d\n",__FILE__,__FUNCTION__,__LINE__,i);
-						}
-						else {
-							//printf("SKIPPING XML comment character, i = %d [%c]",i,buf[i]);
-							if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d] i = %d\n",__FILE__,__FUNCTION__,__LINE__,i);
-						}
-						continue;
-					}
-					//else if(buf[i] == '-' && i >= 4 && buf[i-1] == '-' && buf[i-2] == '!' && buf[i-3] == '<') {
-					else if(buf[i] == '<' && i+4 < bufSize && buf[i+1] == '!' && buf[i+2] == '-' && buf[i+3] == '-') {
-						inCommentTag = true;
-						//printf("TURNING ON comment TAG, i = %d [%c]",i,buf[i]);
-						if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d] i = %d\n",__FILE__,__FUNCTION__,__LINE__,i);
-						continue;
+				bool skipByte = false;
+				if(inCommentTag == true) {
+					if(buf[i] == '>' && i >= 3 && buf[i-1] == '-' && buf[i-2] == '-') {
+						inCommentTag = false;
 					}
-					else if(buf[i] == ' ' || buf[i] == '\t' || buf[i] == '\n' || buf[i] == '\r') {
-						//printf("SKIPPING special character, i = %d [%c]",i,buf[i]);
-						if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d] i = %d\n",__FILE__,__FUNCTION__,__LINE__,i);
-						continue;
+					skipByte = true;
+				}
+				else if(buf[i] == '<' && i+4 < bufSize && buf[i+1] == '!' && buf[i+2] == '-' && buf[i+3] == '-') {
+					inCommentTag = true;
+					skipByte = true;
+				}
+				else if(buf[i] == ' ' || buf[i] == '\t' || buf[i] == '\n' || buf[i] == '\r') {
+					skipByte = true;
+				}
+
+				if(skipByte == true) {
+					if(i > runStart) {
+						addBytes(&buf[runStart], i - runStart);
 					}
-				//}
-				uint32 cipher = addByte(buf[i]);
-
-				if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d] %d / %d, cipher = %u\n",__FILE__,__FUNCTION__,__LINE__,i,buf.size(), cipher);
+					runStart = i + 1;
+				}
 			}
+			if(buf.size() > runStart) {
+				addBytes(&buf[runStart], buf.size() - runStart);
+			}
+
+			if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d] %d, cipher = %u\n",__FILE__,__FUNCTION__,__LINE__,buf.size(), sum);
 		}
-		else {
+		else if(buf.empty() == false) {
 			uint32 cipher = addBytes(&buf[0],buf.size());
 			if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d] %d, cipher = %u\n",__FILE__,__FUNCTION__,__LINE__,buf.size(), cipher);
 		}
@@ -333,25 +451,80 @@ uint32 Checksum::getSum() {
 	if(fileList.size() > 0) {
 		if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d] fileList.size() = %d\n",__FILE__,__FUNCTION__,__LINE__,fileList.size());
 
-		Checksum newResult;
-
-		{
-
+		// Files whose status still matches the index keep their CRC, only
+		// the others are hashed again
+		std::map<string,FileCRCIndexEntry> fileStatusList;
+		vector<FileCRCJob *> jobList;
 		for(std::map<string,uint32>::iterator iterMap = fileList.begin();
 			iterMap != fileList.end(); ++iterMap) {
+			FileCRCIndexEntry &entry = fileStatusList[iterMap->first];
+			entry.crc = 0;
+			if(getFileStatus(iterMap->first, entry) == false) {
+				entry.size = -1;
+				entry.lastModified = -1;
+				entry.lastChanged = -1;
+				entry.inode = -1;
+			}
+		}
+
+		MutexSafeWrapper safeMutex(&Checksum::fileListCacheSynchAccessor,string(__FILE__) + "_" + intToStr(__LINE__));
+		loadFileCacheIndex();
+		for(std::map<string,FileCRCIndexEntry>::iterator iterMap = fileStatusList.begin();
+			iterMap != fileStatusList.end(); ++iterMap) {
+			std::map<string,FileCRCIndexEntry>::iterator iterFind = Checksum::fileListCache.find(iterMap->first);
+			if(iterFind != Checksum::fileListCache.end() &&
+				iterFind->second.size == iterMap->second.size &&
+				iterFind->second.lastModified == iterMap->second.lastModified &&
+				iterFind->second.lastChanged == iterMap->second.lastChanged &&
+				iterFind->second.inode == iterMap->second.inode) {
+				iterMap->second.crc = iterFind->second.crc;
+			}
+			else {
+				jobList.push_back(new FileCRCJob(iterMap->first));
+			}
+		}
+		JobSystem *jobSystem = NULL;
+		if(jobList.size() > 1) {
+			// one pool for every caller, the precache threads hash in parallel
+			if(Checksum::fileListCacheJobSystem == NULL) {
+				Checksum::fileListCacheJobSystem = new JobSystem();
+			}
+			jobSystem = Checksum::fileListCacheJobSystem;
+		}
+		safeMutex.ReleaseLock();
 
-			MutexSafeWrapper safeMutexSocketDestructorFlag(&Checksum::fileListCacheSynchAccessor,string(__FILE__) + "_" + intToStr(__LINE__));
-			if(Checksum::fileListCache.find(iterMap->first) == Checksum::fileListCache.end()) {
-				Checksum fileResult;
-				bool fileAddedOk = fileResult.addFileToSum(iterMap->first);
-				Checksum::fileListCache[iterMap->first] = fileResult.getSum();
-				//printf("fileAddedOk = %d for file [%s] CRC [%d]\n",fileAddedOk,iterMap->first.c_str(),Checksum::fileListCache[iterMap->first]);
+		if(jobList.empty() == false) {
+			if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d] hashing %d changed files of %d\n",__FILE__,__FUNCTION__,__LINE__,(int)jobList.size(),(int)fileList.size());
+
+			if(jobSystem == NULL) {
+				jobList[0]->runJob();
 			}
 			else {
-				//printf("Getting checksum from CACHE for file [%s] CRC [%d]\n",iterMap->first.c_str(),Checksum::fileListCache[iterMap->first]);
+				JobBarrier barrier;
+				barrier.reset((int)jobList.size());
+				for(unsigned int i = 0; i < jobList.size(); ++i) {
+					jobSystem->submit(jobList[i], &barrier);
+				}
+				jobSystem->waitForJobs(&barrier);
+			}
+
+			safeMutex.setMutex(&Checksum::fileListCacheSynchAccessor,string(__FILE__) + "_" + intToStr(__LINE__));
+			for(unsigned int i = 0; i < jobList.size(); ++i) {
+				FileCRCIndexEntry &entry = fileStatusList[jobList[i]->path];
+				entry.crc = jobList[i]->crc;
+				Checksum::fileListCache[jobList[i]->path] = entry;
+				delete jobList[i];
 			}
-			newResult.addSum(Checksum::fileListCache[iterMap->first]);
+			jobList.clear();
+			// written by saveFileCache once per precache pass and on exit
+			Checksum::fileListCacheChanged = true;
+			safeMutex.ReleaseLock();
 		}
+
+		Checksum newResult;
+		for(std::map<string,FileCRCIndexEntry>::iterator iterMap = fileStatusList.begin();
+			iterMap != fileStatusList.end(); ++iterMap) {
+			newResult.addSum(iterMap->second.crc);
 		}
 
 		if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d] fileList.size() = %d\n",__FILE__,__FUNCTION__,__LINE__,fileList.size());
@@ -382,16 +555,142 @@ uint32 Checksum::getFileCount() {
 	return (uint32)fileList.size();
 }
 
+uint32 Checksum::getFileSum(const string &path) {
+	Checksum fileResult;
+	fileResult.addFileToSum(path);
+	return fileResult.getSum();
+}
+
+string Checksum::getFileCacheIndexFile() {
+	string crcCachePath = getCRCCacheFilePath();
+	if(crcCachePath == "") {
+		return "";
+	}
+	return crcCachePath + fileCacheIndexFileName;
+}
+
+void Checksum::loadFileCacheIndex() {
+	if(Checksum::fileListCacheLoaded == true) {
+		return;
+	}
+	string indexFile = getFileCacheIndexFile();
+	if(indexFile == "") {
+		return;
+	}
+	Checksum::fileListCacheLoaded = true;
+
+#ifdef WIN32
+	FILE *fp = _wfopen(utf8_decode(indexFile).c_str(), L"rb");
+#else
+	FILE *fp = fopen(indexFile.c_str(), "rb");
+#endif
+	if(fp == NULL) {
+		return;
+	}
+	string data;
+	char buf[8192];
+	for(size_t readBytes = fread(buf, 1, sizeof(buf), fp); readBytes > 0;
+		readBytes = fread(buf, 1, sizeof(buf), fp)) {
+		data.append(buf, readBytes);
+	}
+	fclose(fp);
+
+	size_t lineStart = data.find('\n');
+	if(lineStart == string::npos || data.compare(0, lineStart, fileCacheIndexHeader) != 0) {
+		return;
+	}
+	int loadedCount = 0;
+	// a line without its end of line was cut short and is ignored
+	for(size_t lineEnd = data.find('\n', lineStart + 1); lineEnd != string::npos;
+		lineStart = lineEnd, lineEnd = data.find('\n', lineStart + 1)) {
+		string line = data.substr(lineStart + 1, lineEnd - lineStart - 1);
+		unsigned int crc = 0;
+		int64 size = 0;
+		int64 lastModified = 0;
+		int64 lastChanged = 0;
+		int64 inode = 0;
+		int pathOffset = 0;
+		if(sscanf(line.c_str(), "%u " MG_I64_SPECIFIER " " MG_I64_SPECIFIER " " MG_I64_SPECIFIER " " MG_I64_SPECIFIER " %n",
+				&crc, &size, &lastModified, &lastChanged, &inode, &pathOffset) == 5 &&
+			pathOffset > 0 && pathOffset < (int)line.size()) {
+			string path = line.substr(pathOffset);
+			// entries hashed during this run are newer than the index
+			if(Checksum::fileListCache.find(path) == Checksum::fileListCache.end()) {
+				FileCRCIndexEntry &entry = Checksum::fileListCache[path];
+				entry.crc = crc;
+				entry.size = size;
+				entry.lastModified = lastModified;
+				entry.lastChanged = lastChanged;
+				entry.inode = inode;
+				loadedCount++;
+			}
+		}
+	}
+	if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d] loaded %d file CRCs from [%s]\n",__FILE__,__FUNCTION__,__LINE__,loadedCount,indexFile.c_str());
+}
+
+void Checksum::saveFileCacheIndex() {
+	if(Checksum::fileListCacheChanged == false) {
+		return;
+	}
+	string indexFile = getFileCacheIndexFile();
+	if(indexFile == "") {
+		return;
+	}
+#ifdef WIN32
+	FILE *fp = _wfopen(utf8_decode(indexFile).c_str(), L"wb");
+#else
+	FILE *fp = fopen(indexFile.c_str(), "wb");
+#endif
+	if(fp == NULL) {
+		if(SystemFlags::getSystemSettingType(SystemFlags::debugSystem).enabled) SystemFlags::OutputDebug(SystemFlags::debugSystem,"In [%s::%s Line: %d] can not write file CRC index [%s]\n",__FILE__,__FUNCTION__,__LINE__,indexFile.c_str());
+		return;
+	}
+	fprintf(fp, "%s\n", fileCacheIndexHeader);
+	for(std::map<string,FileCRCIndexEntry>::iterator iterMap = Checksum::fileListCache.begin();
+		iterMap != Checksum::fileListCache.end(); ++iterMap) {
+		// files that could not be read are hashed again next time
+		if(iterMap->second.size < 0) {
+			continue;
+		}
+		fprintf(fp, "%u " MG_I64_SPECIFIER " " MG_I64_SPECIFIER " " MG_I64_SPECIFIER " " MG_I64_SPECIFIER " %s\n", iterMap->second.crc,
+				iterMap->second.size, iterMap->second.lastModified, iterMap->second.lastChanged,
+				iterMap->second.inode, iterMap->first.c_str());
+	}
+	fclose(fp);
+	Checksum::fileListCacheChanged = false;
+}
+
 void Checksum::removeFileFromCache(const string file) {
 	MutexSafeWrapper safeMutexSocketDestructorFlag(&Checksum::fileListCacheSynchAccessor,string(__FILE__) + "_" + intToStr(__LINE__));
+    loadFileCacheIndex();
     if(Checksum::fileListCache.find(file) != Checksum::fileListCache.end()) {
         Checksum::fileListCache.erase(file);
+        Checksum::fileListCacheChanged = true;
+        saveFileCacheIndex();
     }
 }
 
 void Checksum::clearFileCache() {
 	MutexSafeWrapper safeMutexSocketDestructorFlag(&Checksum::fileListCacheSynchAccessor,string(__FILE__) + "_" + intToStr(__LINE__));
+    // Callers clear the cache after files were replaced, so the index on
+    // disk is emptied as well instead of being read again
     Checksum::fileListCache.clear();
+    Checksum::fileListCacheLoaded = true;
+    Checksum::fileListCacheChanged = true;
+    saveFileCacheIndex();
+}
+
+void Checksum::saveFileCache() {
+	MutexSafeWrapper safeMutexSocketDestructorFlag(&Checksum::fileListCacheSynchAccessor,string(__FILE__) + "_" + intToStr(__LINE__));
+	saveFileCacheIndex();
+}
+
+void Checksum::cleanupFileCache() {
+	MutexSafeWrapper safeMutexSocketDestructorFlag(&Checksum::fileListCacheSynchAccessor,string(__FILE__) + "_" + intToStr(__LINE__));
+	saveFileCacheIndex();
+	delete Checksum::fileListCacheJobSystem;
+	Checksum::fileListCacheJobSystem = NULL;
 }
 
 }}//end namespace
@@ -0,0 +1,323 @@
+// ==============================================================
+//	This file is part of Glest Shared Library (www.glest.org)
+//
+//	Copyright (C) 2001-2008 Martiño Figueroa
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#include "trace.h"
+
+#include <cstdio>
+#ifdef WIN32
+  #include <windows.h>
+#elif defined(__APPLE__)
+  #include <mach/mach_time.h>
+#else
+  #include <time.h>
+#endif
+
+#include "thread.h"
+#include "util.h"
+#include "conversion.h"
+#include "platform_util.h"
+#include "leak_dumper.h"
+
+using namespace std;
+using namespace Shared::Platform;
+
+namespace Shared{ namespace Util{
+
+#if defined(_MSC_VER)
+  #define TRACE_THREAD_LOCAL __declspec(thread)
+#else
+  #define TRACE_THREAD_LOCAL __thread
+#endif
+
+// the buffer of the calling thread, a plain pointer so it can be thread local
+static TRACE_THREAD_LOCAL TraceBuffer *threadTraceBuffer = NULL;
+
+// every buffer ever handed out, kept after its thread ends for the export
+// and never freed because a thread may be adding an event at any time
+static vector<TraceBuffer *> traceBufferList;
+// buffers of ended threads, so the number of buffers stays at the most
+// threads that traced at the same time
+static vector<TraceBuffer *> freeTraceBufferList;
+static Mutex traceBufferListMutex;
+
+static int64 traceStartTimestamp = 0;
+
+// monotonic so timestamps never jump when the system time is changed
+static int64 getMicroClock() {
+#ifdef WIN32
+	static LARGE_INTEGER frequency = { 0 };
+	if(frequency.QuadPart == 0) {
+		QueryPerformanceFrequency(&frequency);
+	}
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return (int64)(counter.QuadPart / frequency.QuadPart) * 1000000 +
+		   (int64)((counter.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart);
+#elif defined(__APPLE__)
+	static mach_timebase_info_data_t timebase = { 0, 0 };
+	if(timebase.denom == 0) {
+		mach_timebase_info(&timebase);
+	}
+	return (int64)(mach_absolute_time() * timebase.numer / timebase.denom / 1000);
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+static void writeJsonString(FILE *fp, const string &value) {
+	fputc('"', fp);
+	for(unsigned int i = 0; i < value.size(); ++i) {
+		unsigned char c = (unsigned char)value[i];
+		if(c == '"' || c == '\\') {
+			fputc('\\', fp);
+			fputc(c, fp);
+		}
+		else if(c < 0x20) {
+			fprintf(fp, "\\u%04x", c);
+		}
+		else {
+			fputc(c, fp);
+		}
+	}
+	fputc('"', fp);
+}
+
+// =====================================================
+//	class TraceBuffer
+// =====================================================
+
+TraceBuffer::TraceBuffer(int eventCount, uint32 threadId) {
+	this->events.resize(eventCount > 0 ? eventCount : 1);
+	this->writeCount = 0;
+	this->threadId = threadId;
+	this->threadName = "";
+	this->mutex = new Mutex(string(__FILE__) + "_" + intToStr(__LINE__));
+}
+
+TraceBuffer::~TraceBuffer() {
+	delete mutex;
+	mutex = NULL;
+}
+
+void TraceBuffer::addEvent(int64 timestamp, uint16 eventId, TracePhase phase, const TraceArg &arg0, const TraceArg &arg1) {
+	mutex->p();
+	if(events.empty() == false) {
+		TraceEvent &event = events[writeCount % events.size()];
+		event.timestamp = timestamp;
+		event.eventId = eventId;
+		event.phase = (uint8)phase;
+		event.args[0] = arg0;
+		event.args[1] = arg1;
+		writeCount++;
+	}
+	mutex->v();
+}
+
+void TraceBuffer::getEvents(vector<TraceEvent> &orderedEvents, string &name) const {
+	MutexSafeWrapper safeMutex(mutex,string(__FILE__) + "_" + intToStr(__LINE__));
+	// once the ring wrapped the oldest event is the next one to be overwritten
+	uint32 eventCount = (uint32)events.size();
+	uint32 count = (writeCount < eventCount ? writeCount : eventCount);
+	uint32 first = writeCount - count;
+	orderedEvents.clear();
+	orderedEvents.reserve(count);
+	for(uint32 i = 0; i < count; ++i) {
+		orderedEvents.push_back(events[(first + i) % eventCount]);
+	}
+	name = threadName;
+}
+
+// =====================================================
+//	class Tracer
+// =====================================================
+
+const int Tracer::defaultEventsPerThread = 65536;
+
+bool Tracer::enabled = false;
+int Tracer::eventsPerThread = Tracer::defaultEventsPerThread;
+const TraceEventType *Tracer::eventTypes = NULL;
+int Tracer::eventTypeCount = 0;
+
+void Tracer::init(const TraceEventType *eventTypes, int eventTypeCount, int eventsPerThread) {
+	MutexSafeWrapper safeMutex(&traceBufferListMutex,string(__FILE__) + "_" + intToStr(__LINE__));
+	Tracer::eventTypes = eventTypes;
+	Tracer::eventTypeCount = eventTypeCount;
+	Tracer::eventsPerThread = eventsPerThread;
+	if(traceStartTimestamp == 0) {
+		traceStartTimestamp = getMicroClock();
+	}
+	// rings emptied by cleanup take the new size
+	for(unsigned int i = 0; i < traceBufferList.size(); ++i) {
+		TraceBuffer *buffer = traceBufferList[i];
+		MutexSafeWrapper safeMutexBuffer(buffer->mutex,string(__FILE__) + "_" + intToStr(__LINE__));
+		if(buffer->events.empty() == true) {
+			buffer->events.resize(eventsPerThread > 0 ? eventsPerThread : 1);
+		}
+	}
+}
+
+void Tracer::cleanup() {
+	enabled = false;
+
+	// Threads may still be ending a TraceScope, so the buffers stay and only
+	// their events are released. An empty ring ignores new events until init.
+	MutexSafeWrapper safeMutex(&traceBufferListMutex,string(__FILE__) + "_" + intToStr(__LINE__));
+	for(unsigned int i = 0; i < traceBufferList.size(); ++i) {
+		TraceBuffer *buffer = traceBufferList[i];
+		MutexSafeWrapper safeMutexBuffer(buffer->mutex,string(__FILE__) + "_" + intToStr(__LINE__));
+		vector<TraceEvent>().swap(buffer->events);
+		buffer->writeCount = 0;
+	}
+}
+
+void Tracer::setEnabled(bool value) {
+	if(value == true && eventTypes == NULL) {
+		throw megaglest_runtime_error("Tracer::init must be called before tracing is enabled");
+	}
+	enabled = value;
+}
+
+int64 Tracer::getTimestamp() {
+	return getMicroClock() - traceStartTimestamp;
+}
+
+TraceBuffer * Tracer::getThreadBuffer() {
+	if(threadTraceBuffer == NULL) {
+		threadTraceBuffer = createThreadBuffer();
+	}
+	return threadTraceBuffer;
+}
+
+TraceBuffer * Tracer::createThreadBuffer() {
+	MutexSafeWrapper safeMutex(&traceBufferListMutex,string(__FILE__) + "_" + intToStr(__LINE__));
+	if(freeTraceBufferList.empty() == false) {
+		TraceBuffer *buffer = freeTraceBufferList.back();
+		freeTraceBufferList.pop_back();
+
+		MutexSafeWrapper safeMutexBuffer(buffer->mutex,string(__FILE__) + "_" + intToStr(__LINE__));
+		buffer->events.resize(eventsPerThread > 0 ? eventsPerThread : 1);
+		buffer->writeCount = 0;
+		buffer->threadId = SDL_ThreadID();
+		buffer->threadName = "";
+		return buffer;
+	}
+	TraceBuffer *buffer = new TraceBuffer(eventsPerThread, SDL_ThreadID());
+	traceBufferList.push_back(buffer);
+	return buffer;
+}
+
+void Tracer::releaseThreadBuffer() {
+	TraceBuffer *buffer = threadTraceBuffer;
+	if(buffer == NULL) {
+		return;
+	}
+	threadTraceBuffer = NULL;
+
+	MutexSafeWrapper safeMutex(&traceBufferListMutex,string(__FILE__) + "_" + intToStr(__LINE__));
+	freeTraceBufferList.push_back(buffer);
+}
+
+void Tracer::setThreadName(const string &name) {
+	TraceBuffer *buffer = getThreadBuffer();
+	MutexSafeWrapper safeMutex(buffer->mutex,string(__FILE__) + "_" + intToStr(__LINE__));
+	buffer->threadName = name;
+}
+
+bool Tracer::exportChromeTrace(const string &fileName) {
+#ifdef WIN32
+	FILE *fp = _wfopen(utf8_decode(fileName).c_str(), L"w");
+#else
+	FILE *fp = fopen(fileName.c_str(), "w");
+#endif
+	if(fp == NULL) {
+		if(SystemFlags::getSystemSettingType(SystemFlags::debugError).enabled) SystemFlags::OutputDebug(SystemFlags::debugError,"In [%s::%s Line: %d] Can not open trace file [%s]\n",__FILE__,__FUNCTION__,__LINE__,fileName.c_str());
+		return false;
+	}
+
+	MutexSafeWrapper safeMutex(&traceBufferListMutex,string(__FILE__) + "_" + intToStr(__LINE__));
+
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool firstEvent = true;
+	vector<TraceEvent> events;
+	string threadName;
+	for(unsigned int bufferIndex = 0; bufferIndex < traceBufferList.size(); ++bufferIndex) {
+		const TraceBuffer *buffer = traceBufferList[bufferIndex];
+		buffer->getEvents(events, threadName);
+
+		if(threadName != "") {
+			fprintf(fp, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":",
+					(firstEvent == true ? "" : ",\n"), buffer->threadId);
+			writeJsonString(fp, threadName);
+			fprintf(fp, "}}");
+			firstEvent = false;
+		}
+
+		for(unsigned int i = 0; i < events.size(); ++i) {
+			const TraceEvent &event = events[i];
+			if(event.eventId >= eventTypeCount) {
+				continue;
+			}
+			const TraceEventType &eventType = eventTypes[event.eventId];
+
+			const char *phase = "i";
+			switch(event.phase) {
+				case tpBegin:
+					phase = "B";
+					break;
+				case tpEnd:
+					phase = "E";
+					break;
+				case tpCounter:
+					phase = "C";
+					break;
+				default:
+					break;
+			}
+
+			fprintf(fp, "%s{\"ph\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":" MG_I64_SPECIFIER ",\"name\":\"%s\",\"cat\":\"%s\"",
+					(firstEvent == true ? "" : ",\n"), phase, buffer->threadId, event.timestamp,
+					eventType.name, eventType.category);
+			firstEvent = false;
+			if(event.phase == tpInstant) {
+				fprintf(fp, ",\"s\":\"t\"");
+			}
+
+			bool firstArg = true;
+			for(int argIndex = 0; argIndex < 2; ++argIndex) {
+				const TraceArg &arg = event.args[argIndex];
+				if(arg.type == tatNone) {
+					continue;
+				}
+				// a counter is drawn under the name of its value
+				const char *argName = (event.phase == tpCounter ? eventType.name : eventType.argNames[argIndex]);
+				fprintf(fp, "%s\"%s\":", (firstArg == true ? ",\"args\":{" : ","), (argName != NULL ? argName : "value"));
+				if(arg.type == tatInt) {
+					fprintf(fp, MG_I64_SPECIFIER, arg.intValue);
+				}
+				else {
+					fprintf(fp, "%.6g", arg.floatValue);
+				}
+				firstArg = false;
+			}
+			fprintf(fp, "%s}", (firstArg == true ? "" : "}"));
+		}
+	}
+	fprintf(fp, "\n]}\n");
+	fclose(fp);
+
+	if(SystemFlags::VERBOSE_MODE_ENABLED) printf("Wrote trace [%s] for %d threads\n",fileName.c_str(),(int)traceBufferList.size());
+
+	return true;
+}
+
+}}//end namespace
@@ -12,7 +12,9 @@
 #include "data_types.h"
 #include "xml_parser.h"
 
+#include <cstring>
 #include <fstream>
+#include <memory>
 #include <stdexcept>
 #include <vector>
 #include <algorithm>
@@ -26,6 +28,8 @@
 #include "platform_common.h"
 #include "platform_util.h"
 #include "cache_manager.h"
+#include "compression_utils.h"
+#include "checksum.h"
 
 #include "rapidxml/rapidxml_print.hpp"
 #include "leak_dumper.h"
@@ -34,6 +38,8 @@ XERCES_CPP_NAMESPACE_USE
 
 using namespace std;
 using namespace Shared::PlatformCommon;
+using namespace Shared::CompressionUtil;
+using Shared::Platform::uint32;
 
 namespace Shared { namespace Xml {
 
@@ -297,14 +303,6 @@ void XmlIoRapid::init() {
 		SystemFlags::OutputDebug(SystemFlags::debugError,"In [%s::%s Line: %d] Error initializing XML system, msg %s\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,e.what());
 		throw megaglest_runtime_error("Error initializing XML system");
 	}
-
-	try {
-		doc = new xml_document<>();
-	}
-	catch(const DOMException &ex) {
-		SystemFlags::OutputDebug(SystemFlags::debugError,"In [%s::%s Line: %d] Exception while creating XML parser, msg: %s\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,ex.getMessage());
-		throw megaglest_runtime_error("Exception while creating XML parser");
-	}
 }
 
 bool XmlIoRapid::isInitialized() {
@@ -324,8 +322,6 @@ void XmlIoRapid::cleanup() {
 	if(XmlIoRapid::initialized == true) {
 		XmlIoRapid::initialized= false;
 		//printf("XmlIo cleanup\n");
-		delete doc;
-		doc = NULL;
 	}
 }
 
@@ -342,6 +338,11 @@ XmlNode *XmlIoRapid::load(const string &path, const std::map<string,string> &map
 
 	XmlNode *rootNode = NULL;
 	try {
+		rootNode = XmlTreeCache::findTree(path, mapTagReplacementValues);
+		if(rootNode != NULL) {
+			if(showPerfStats) printf("In [%s::%s Line: %d] built from cache, took msecs: " MG_I64_SPECIFIER "\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,chrono.getMillis());
+			return rootNode;
+		}
 
 		if(folderExists(path) == true) {
 			throw megaglest_runtime_error("Can not open file: [" + path + "] as it is a folder!");
@@ -394,10 +395,14 @@ XmlNode *XmlIoRapid::load(const string &path, const std::map<string,string> &map
 
         if(showPerfStats) printf("In [%s::%s Line: %d] took msecs: " MG_I64_SPECIFIER "\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,chrono.getMillis());
 
+        // Each load parses into its own document so files can be parsed
+        // from several threads at once
+        auto_ptr<xml_document<> > doc(new xml_document<>());
         doc->parse<parse_no_data_nodes>(&buffer.front());
 
         if(showPerfStats) printf("In [%s::%s Line: %d] took msecs: " MG_I64_SPECIFIER "\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,chrono.getMillis());
 
+		XmlTreeCache::recordTree(path, mapTagReplacementValues, doc->first_node());
 		rootNode= new XmlNode(doc->first_node(),mapTagReplacementValues);
 
 		if(showPerfStats) printf("In [%s::%s Line: %d] took msecs: " MG_I64_SPECIFIER "\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,chrono.getMillis());
@@ -489,6 +494,460 @@ void XmlIoRapid::save(const string &path, const XmlNode *node){
 	}
 }
 
+// =====================================================
+//	class XmlIoBinary
+// =====================================================
+
+// Layout: magic, version, flags, uncompressed payload size, payload.
+// The payload holds the string table and then the nodes depth first,
+// every count and string index is an unsigned LEB128 varint.
+static const char xmlBinaryMagic[4] = { 'M', 'G', 'X', 'B' };
+static const unsigned char xmlBinaryVersion = 1;
+static const unsigned char xmlBinaryFlagCompressed = 0x01;
+static const int xmlBinaryHeaderSize = 4 + 1 + 1 + 4;
+
+static void writeVarUInt(vector<unsigned char> &buf, uint32 value) {
+	while(value >= 0x80) {
+		buf.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	buf.push_back((unsigned char)value);
+}
+
+static uint32 readVarUInt(const unsigned char *&buf, const unsigned char *bufEnd) {
+	uint32 value = 0;
+	for(int shift = 0; shift < 35; shift += 7) {
+		if(buf >= bufEnd) {
+			throw megaglest_runtime_error("Binary XML data is truncated");
+		}
+		unsigned char byte = *buf++;
+		value |= ((uint32)(byte & 0x7F)) << shift;
+		if((byte & 0x80) == 0) {
+			return value;
+		}
+	}
+	throw megaglest_runtime_error("Binary XML data has an invalid number");
+}
+
+static void writeRawString(vector<unsigned char> &buf, const string &value) {
+	writeVarUInt(buf, (uint32)value.size());
+	buf.insert(buf.end(), value.begin(), value.end());
+}
+
+static string readRawString(const unsigned char *&buf, const unsigned char *bufEnd) {
+	uint32 length = readVarUInt(buf, bufEnd);
+	if((uint32)(bufEnd - buf) < length) {
+		throw megaglest_runtime_error("Binary XML data is truncated");
+	}
+	string value((const char *)buf, length);
+	buf += length;
+	return value;
+}
+
+class XmlBinaryWriter {
+private:
+	std::map<string,uint32> stringIndexes;
+	vector<const string *> strings;
+	vector<unsigned char> nodeData;
+
+	void writeString(const string &value) {
+		std::map<string,uint32>::iterator iterFind = stringIndexes.find(value);
+		if(iterFind != stringIndexes.end()) {
+			writeVarUInt(nodeData, iterFind->second);
+			return;
+		}
+		uint32 index = (uint32)strings.size();
+		iterFind = stringIndexes.insert(make_pair(value,index)).first;
+		strings.push_back(&iterFind->first);
+		writeVarUInt(nodeData, index);
+	}
+
+public:
+	void writeNode(const XmlNode *node) {
+		writeString(node->getName());
+		writeString(node->getText());
+		writeVarUInt(nodeData, (uint32)node->getAttributeCount());
+		for(unsigned int i = 0; i < node->getAttributeCount(); ++i) {
+			XmlAttribute *attr = node->getAttribute(i);
+			writeString(attr->getName());
+			writeString(attr->getValue("",false));
+		}
+		writeVarUInt(nodeData, (uint32)node->getChildCount());
+		for(unsigned int i = 0; i < node->getChildCount(); ++i) {
+			writeNode(node->getChild(i));
+		}
+	}
+
+	void getPayload(vector<unsigned char> &payload) {
+		payload.clear();
+		writeVarUInt(payload, (uint32)strings.size());
+		for(unsigned int i = 0; i < strings.size(); ++i) {
+			writeRawString(payload, *strings[i]);
+		}
+		payload.insert(payload.end(), nodeData.begin(), nodeData.end());
+	}
+};
+
+class XmlBinaryReader {
+private:
+	const unsigned char *buf;
+	const unsigned char *bufEnd;
+	const std::map<string,string> &mapTagReplacementValues;
+	vector<string> strings;
+
+	uint32 readVarUInt() {
+		return Shared::Xml::readVarUInt(buf, bufEnd);
+	}
+
+	const string & readString() {
+		uint32 index = readVarUInt();
+		if(index >= strings.size()) {
+			throw megaglest_runtime_error("Binary XML data has an invalid string index: " + uIntToStr(index));
+		}
+		return strings[index];
+	}
+
+	void readAttributesAndChildren(XmlNode *node) {
+		uint32 attributeCount = readVarUInt();
+		for(uint32 i = 0; i < attributeCount; ++i) {
+			const string &name = readString();
+			const string &value = readString();
+			node->addAttribute(name, value, mapTagReplacementValues);
+		}
+		uint32 childCount = readVarUInt();
+		for(uint32 i = 0; i < childCount; ++i) {
+			const string &name = readString();
+			string text = readString();
+			Properties::applyTagsToValue(text,&mapTagReplacementValues);
+			readAttributesAndChildren(node->addChild(name, text));
+		}
+	}
+
+public:
+	XmlBinaryReader(const unsigned char *buf, const unsigned char *bufEnd, const std::map<string,string> &mapTagReplacementValues) :
+		buf(buf), bufEnd(bufEnd), mapTagReplacementValues(mapTagReplacementValues) {
+	}
+
+	XmlNode * readRootNode() {
+		uint32 stringCount = readVarUInt();
+		strings.resize(stringCount);
+		for(uint32 i = 0; i < stringCount; ++i) {
+			strings[i] = readRawString(buf, bufEnd);
+		}
+
+		XmlNode *rootNode = new XmlNode(readString());
+		try {
+			// the root text is dropped like the xml engines do for nodes with children
+			readString();
+			readAttributesAndChildren(rootNode);
+		}
+		catch(...) {
+			delete rootNode;
+			throw;
+		}
+		return rootNode;
+	}
+};
+
+static FILE * openXmlBinaryFile(const string &path, bool forWrite) {
+#if defined(WIN32) && !defined(__MINGW32__)
+	return _wfopen(utf8_decode(path).c_str(), (forWrite == true ? L"wb" : L"rb"));
+#else
+	return fopen(path.c_str(), (forWrite == true ? "wb" : "rb"));
+#endif
+}
+
+XmlIoBinary::XmlIoBinary() {
+}
+
+XmlIoBinary &XmlIoBinary::getInstance() {
+	static XmlIoBinary manager;
+	return manager;
+}
+
+bool XmlIoBinary::isBinaryFile(const string &path) {
+	FILE *fp = openXmlBinaryFile(path, false);
+	if(fp == NULL) {
+		return false;
+	}
+	char magic[4];
+	bool result = (fread(magic, 1, sizeof(magic), fp) == sizeof(magic) &&
+				   memcmp(magic, xmlBinaryMagic, sizeof(magic)) == 0);
+	fclose(fp);
+	return result;
+}
+
+// Reads a file written by writeXmlBinaryFile and returns its uncompressed payload
+static void readXmlBinaryFile(const string &path, const char *magic, vector<unsigned char> &payload) {
+	FILE *fp = openXmlBinaryFile(path, false);
+	if(fp == NULL) {
+		throw megaglest_runtime_error("Can not open file: [" + path + "]");
+	}
+	vector<unsigned char> data;
+	unsigned char readBuf[65536];
+	for(size_t readBytes = fread(readBuf, 1, sizeof(readBuf), fp); readBytes > 0;
+		readBytes = fread(readBuf, 1, sizeof(readBuf), fp)) {
+		data.insert(data.end(), readBuf, readBuf + readBytes);
+	}
+	fclose(fp);
+
+	if(data.size() < (size_t)xmlBinaryHeaderSize || memcmp(&data[0], magic, sizeof(xmlBinaryMagic)) != 0) {
+		throw megaglest_runtime_error("Not a binary XML file: [" + path + "]");
+	}
+	if(data[4] != xmlBinaryVersion) {
+		throw megaglest_runtime_error("Unsupported binary XML version " + intToStr(data[4]) + " in file: [" + path + "]");
+	}
+	unsigned char flags = data[5];
+	uint32 payloadSize = data[6] | (data[7] << 8) | (data[8] << 16) | ((uint32)data[9] << 24);
+
+	const unsigned char *stored = &data[0] + xmlBinaryHeaderSize;
+	unsigned long storedSize = (unsigned long)(data.size() - xmlBinaryHeaderSize);
+	if((flags & xmlBinaryFlagCompressed) != 0) {
+		if(extractMemoryFromMemory(stored, storedSize, payload, payloadSize) == false) {
+			throw megaglest_runtime_error("Can not uncompress file: [" + path + "]");
+		}
+	}
+	else if(storedSize != payloadSize) {
+		throw megaglest_runtime_error("Invalid payload size in file: [" + path + "]");
+	}
+	else {
+		payload.assign(stored, stored + storedSize);
+	}
+}
+
+// Writes the header followed by the payload, compressed when asked for and
+// when that makes it smaller
+static void writeXmlBinaryFile(const string &path, const char *magic, const vector<unsigned char> &payload, int compressionLevel) {
+	unsigned char flags = 0;
+	vector<unsigned char> compressed;
+	if(compressionLevel > 0 && compressMemoryToMemory((payload.empty() == false ? &payload[0] : NULL),
+			(unsigned long)payload.size(), compressed, compressionLevel) == true) {
+		flags |= xmlBinaryFlagCompressed;
+	}
+	const vector<unsigned char> &stored = ((flags & xmlBinaryFlagCompressed) != 0 ? compressed : payload);
+
+	unsigned char header[xmlBinaryHeaderSize];
+	memcpy(header, magic, sizeof(xmlBinaryMagic));
+	header[4] = xmlBinaryVersion;
+	header[5] = flags;
+	uint32 payloadSize = (uint32)payload.size();
+	for(int i = 0; i < 4; ++i) {
+		header[6 + i] = (unsigned char)((payloadSize >> (i * 8)) & 0xFF);
+	}
+
+	FILE *fp = openXmlBinaryFile(path, true);
+	if(fp == NULL) {
+		throw megaglest_runtime_error("Can not open file: [" + path + "]");
+	}
+	fwrite(header, 1, sizeof(header), fp);
+	if(stored.empty() == false) {
+		fwrite(&stored[0], 1, stored.size(), fp);
+	}
+	fclose(fp);
+}
+
+XmlNode *XmlIoBinary::load(const string &path, const std::map<string,string> &mapTagReplacementValues) {
+	bool showPerfStats = SystemFlags::VERBOSE_MODE_ENABLED;
+	Chrono chrono;
+	chrono.start();
+	if(SystemFlags::VERBOSE_MODE_ENABLED || showPerfStats) printf("Using binary XML to load file [%s]\n",path.c_str());
+
+	XmlNode *rootNode = NULL;
+	try {
+		vector<unsigned char> payload;
+		readXmlBinaryFile(path, xmlBinaryMagic, payload);
+
+		if(showPerfStats) printf("In [%s::%s Line: %d] took msecs: " MG_I64_SPECIFIER "\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,chrono.getMillis());
+
+		const unsigned char *buf = (payload.empty() == false ? &payload[0] : NULL);
+		XmlBinaryReader reader(buf, buf + payload.size(), mapTagReplacementValues);
+		rootNode = reader.readRootNode();
+
+		if(showPerfStats) printf("In [%s::%s Line: %d] took msecs: " MG_I64_SPECIFIER "\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,chrono.getMillis());
+	}
+	catch(const exception &ex) {
+		char szBuf[8096]="";
+		snprintf(szBuf,8096,"In [%s::%s Line: %d] Exception while loading: [%s], msg:\n%s",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,path.c_str(),ex.what());
+		SystemFlags::OutputDebug(SystemFlags::debugError,"%s\n",szBuf);
+
+		throw megaglest_runtime_error(szBuf);
+	}
+	return rootNode;
+}
+
+void XmlIoBinary::save(const string &path, const XmlNode *node, int compressionLevel) {
+	try {
+		if(node == NULL) {
+			throw megaglest_runtime_error("node == NULL during save!");
+		}
+
+		XmlBinaryWriter writer;
+		writer.writeNode(node);
+		vector<unsigned char> payload;
+		writer.getPayload(payload);
+
+		writeXmlBinaryFile(path, xmlBinaryMagic, payload, compressionLevel);
+	}
+	catch(const exception &e){
+		SystemFlags::OutputDebug(SystemFlags::debugError,"In [%s::%s Line: %d] Exception while saving: [%s], %s\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,path.c_str(),e.what());
+		throw megaglest_runtime_error("Exception while saving [" + path + "] msg: " + e.what());
+	}
+}
+
+// =====================================================
+//	class XmlTreeCache
+// =====================================================
+
+static const char xmlTreeCacheMagic[4] = { 'M', 'G', 'X', 'C' };
+// the payload ends with its fast sum so a damaged cache file is rebuilt
+// instead of feeding broken trees to the game
+static const int xmlTreeCacheSumSize = 4;
+
+// Trees are kept as they were before tag replacement so loading one from the
+// cache applies the tags the same way parsing the file does
+class XmlTreeCacheEntry {
+public:
+	std::map<string,string> mapTagReplacementValues;
+	vector<unsigned char> data;
+};
+
+typedef std::map<string, XmlTreeCacheEntry> XmlTreeCacheEntries;
+static Mutex mutexXmlTreeCache;
+static XmlTreeCacheEntries xmlTreeCacheEntries;
+static bool xmlTreeCacheRecording = false;
+static bool xmlTreeCacheHasNewTrees = false;
+static string xmlTreeCacheRecordPathPrefix = "";
+
+void XmlTreeCache::startRecording(const string &pathPrefix) {
+	MutexSafeWrapper safeMutex(&mutexXmlTreeCache);
+	xmlTreeCacheRecording = true;
+	xmlTreeCacheHasNewTrees = false;
+	xmlTreeCacheRecordPathPrefix = pathPrefix;
+}
+
+bool XmlTreeCache::hasNewTrees() {
+	MutexSafeWrapper safeMutex(&mutexXmlTreeCache);
+	return xmlTreeCacheHasNewTrees;
+}
+
+void XmlTreeCache::clear() {
+	MutexSafeWrapper safeMutex(&mutexXmlTreeCache);
+	xmlTreeCacheEntries.clear();
+	xmlTreeCacheRecording = false;
+	xmlTreeCacheHasNewTrees = false;
+	xmlTreeCacheRecordPathPrefix = "";
+}
+
+void XmlTreeCache::save(const string &path, int compressionLevel) {
+	MutexSafeWrapper safeMutex(&mutexXmlTreeCache);
+	vector<unsigned char> payload;
+	writeVarUInt(payload, (uint32)xmlTreeCacheEntries.size());
+	for(XmlTreeCacheEntries::const_iterator iterMap = xmlTreeCacheEntries.begin();
+		iterMap != xmlTreeCacheEntries.end(); ++iterMap) {
+		const XmlTreeCacheEntry &entry = iterMap->second;
+		writeRawString(payload, iterMap->first);
+		writeVarUInt(payload, (uint32)entry.mapTagReplacementValues.size());
+		for(std::map<string,string>::const_iterator iterTag = entry.mapTagReplacementValues.begin();
+			iterTag != entry.mapTagReplacementValues.end(); ++iterTag) {
+			writeRawString(payload, iterTag->first);
+			writeRawString(payload, iterTag->second);
+		}
+		writeVarUInt(payload, (uint32)entry.data.size());
+		payload.insert(payload.end(), entry.data.begin(), entry.data.end());
+	}
+	safeMutex.ReleaseLock();
+
+	uint32 payloadSum = Checksum::getFastSum((payload.empty() == false ? &payload[0] : NULL), payload.size());
+	for(int i = 0; i < xmlTreeCacheSumSize; ++i) {
+		payload.push_back((unsigned char)((payloadSum >> (i * 8)) & 0xFF));
+	}
+
+	writeXmlBinaryFile(path, xmlTreeCacheMagic, payload, compressionLevel);
+}
+
+void XmlTreeCache::load(const string &path) {
+	vector<unsigned char> payload;
+	readXmlBinaryFile(path, xmlTreeCacheMagic, payload);
+
+	if(payload.size() < (size_t)xmlTreeCacheSumSize) {
+		throw megaglest_runtime_error("Tech tree cache is truncated: [" + path + "]");
+	}
+	size_t dataSize = payload.size() - xmlTreeCacheSumSize;
+	const unsigned char *sumBytes = &payload[dataSize];
+	uint32 storedSum = sumBytes[0] | (sumBytes[1] << 8) | (sumBytes[2] << 16) | ((uint32)sumBytes[3] << 24);
+	if(Checksum::getFastSum((dataSize > 0 ? &payload[0] : NULL), dataSize) != storedSum) {
+		throw megaglest_runtime_error("Tech tree cache is damaged: [" + path + "]");
+	}
+	payload.resize(dataSize);
+
+	XmlTreeCacheEntries entries;
+	const unsigned char *buf = (payload.empty() == false ? &payload[0] : NULL);
+	const unsigned char *bufEnd = buf + payload.size();
+	uint32 entryCount = readVarUInt(buf, bufEnd);
+	for(uint32 i = 0; i < entryCount; ++i) {
+		XmlTreeCacheEntry &entry = entries[readRawString(buf, bufEnd)];
+		uint32 tagCount = readVarUInt(buf, bufEnd);
+		for(uint32 j = 0; j < tagCount; ++j) {
+			string tag = readRawString(buf, bufEnd);
+			entry.mapTagReplacementValues[tag] = readRawString(buf, bufEnd);
+		}
+		uint32 dataSize = readVarUInt(buf, bufEnd);
+		if((uint32)(bufEnd - buf) < dataSize) {
+			throw megaglest_runtime_error("Binary XML data is truncated");
+		}
+		entry.data.assign(buf, buf + dataSize);
+		buf += dataSize;
+	}
+
+	MutexSafeWrapper safeMutex(&mutexXmlTreeCache);
+	xmlTreeCacheEntries.swap(entries);
+	xmlTreeCacheRecording = false;
+	xmlTreeCacheHasNewTrees = false;
+	xmlTreeCacheRecordPathPrefix = "";
+}
+
+XmlNode * XmlTreeCache::findTree(const string &path, const std::map<string,string> &mapTagReplacementValues) {
+	MutexSafeWrapper safeMutex(&mutexXmlTreeCache);
+	if(xmlTreeCacheEntries.empty() == true) {
+		return NULL;
+	}
+	XmlTreeCacheEntries::const_iterator iterFind = xmlTreeCacheEntries.find(path);
+	if(iterFind == xmlTreeCacheEntries.end() ||
+		iterFind->second.mapTagReplacementValues != mapTagReplacementValues ||
+		iterFind->second.data.empty() == true) {
+		return NULL;
+	}
+	// a miss recorded meanwhile may replace the entry, build from a copy
+	vector<unsigned char> data = iterFind->second.data;
+	safeMutex.ReleaseLock();
+
+	XmlBinaryReader reader(&data[0], &data[0] + data.size(), mapTagReplacementValues);
+	return reader.readRootNode();
+}
+
+void XmlTreeCache::recordTree(const string &path, const std::map<string,string> &mapTagReplacementValues, xml_node<> *node) {
+	MutexSafeWrapper safeMutex(&mutexXmlTreeCache);
+	if(xmlTreeCacheRecording == false || path.find(xmlTreeCacheRecordPathPrefix) != 0) {
+		return;
+	}
+	safeMutex.ReleaseLock(true);
+
+	std::map<string,string> noTagReplacementValues;
+	XmlNode rawNode(node, noTagReplacementValues);
+	XmlBinaryWriter writer;
+	writer.writeNode(&rawNode);
+
+	XmlTreeCacheEntry entry;
+	entry.mapTagReplacementValues = mapTagReplacementValues;
+	writer.getPayload(entry.data);
+
+	safeMutex.Lock();
+	if(xmlTreeCacheRecording == true) {
+		xmlTreeCacheEntries[path] = entry;
+		xmlTreeCacheHasNewTrees = true;
+	}
+}
+
 // =====================================================
 //	class XmlTree
 // =====================================================
@@ -500,6 +959,8 @@ XmlTree::XmlTree(xml_engine_parser_type engine_type) {
 			break;
 		case XML_RAPIDXML_ENGINE:
 		break;
+		case XML_BINARY_ENGINE:
+		break;
 
 		default:
 			throw megaglest_runtime_error("Invalid XML parser engine: " + intToStr(engine_type));
@@ -507,6 +968,7 @@ XmlTree::XmlTree(xml_engine_parser_type engine_type) {
 
 	this->engine_type = engine_type;
 	this->skipStackCheck = false;
+	this->binaryCompressionLevel = 0;
 }
 
 void XmlTree::init(const string &name){
@@ -518,6 +980,54 @@ typedef std::vector<XmlTree*> LoadStack;
 //static LoadStack loadStack;
 static string loadStackCacheName = string(__FILE__) + string("_loadStackCacheName");
 
+// Trees parsed ahead of time by XmlTree::preload, keyed by path along with
+// the tag replacement values they were parsed with
+typedef std::map<string, std::pair<std::map<string,string>, XmlNode *> > XmlPreloadCache;
+static Mutex mutexXmlPreloadCache;
+static XmlPreloadCache xmlPreloadCache;
+
+static XmlNode * takePreloadedNode(const string &path, const std::map<string,string> &mapTagReplacementValues) {
+	MutexSafeWrapper safeMutex(&mutexXmlPreloadCache);
+	if(xmlPreloadCache.empty() == true) {
+		return NULL;
+	}
+	XmlPreloadCache::iterator iterFind = xmlPreloadCache.find(path);
+	if(iterFind == xmlPreloadCache.end()) {
+		return NULL;
+	}
+	XmlNode *rootNode = NULL;
+	if(iterFind->second.first == mapTagReplacementValues) {
+		rootNode = iterFind->second.second;
+	}
+	else {
+		delete iterFind->second.second;
+	}
+	xmlPreloadCache.erase(iterFind);
+	return rootNode;
+}
+
+void XmlTree::preload(const string &path, const std::map<string,string> &mapTagReplacementValues) {
+	addPreloaded(path, mapTagReplacementValues, XmlIoRapid::getInstance().load(path, mapTagReplacementValues, false, true));
+}
+
+void XmlTree::addPreloaded(const string &path, const std::map<string,string> &mapTagReplacementValues, XmlNode *rootNode) {
+	MutexSafeWrapper safeMutex(&mutexXmlPreloadCache);
+	XmlPreloadCache::iterator iterFind = xmlPreloadCache.find(path);
+	if(iterFind != xmlPreloadCache.end()) {
+		delete iterFind->second.second;
+	}
+	xmlPreloadCache[path] = make_pair(mapTagReplacementValues, rootNode);
+}
+
+void XmlTree::clearPreloadCache() {
+	MutexSafeWrapper safeMutex(&mutexXmlPreloadCache);
+	for(XmlPreloadCache::iterator iterMap = xmlPreloadCache.begin();
+		iterMap != xmlPreloadCache.end(); ++iterMap) {
+		delete iterMap->second.second;
+	}
+	xmlPreloadCache.clear();
+}
+
 void XmlTree::load(const string &path, const std::map<string,string> &mapTagReplacementValues, bool noValidation,bool skipStackCheck) {
 	if(SystemFlags::VERBOSE_MODE_ENABLED) printf("In [%s::%s Line: %d] about to load [%s] skipStackCheck = %d\n",extractFileFromDirectoryPath(__FILE__).c_str(),__FUNCTION__,__LINE__,path.c_str(),skipStackCheck);
 
@@ -540,9 +1050,16 @@ void XmlTree::load(const string &path, const std::map<string,string> &mapTagRepl
 	}
 
 	loadPath = path;
-	if(this->engine_type == XML_XERCES_ENGINE) {
+	if(this->engine_type == XML_RAPIDXML_ENGINE &&
+		(this->rootNode= takePreloadedNode(path, mapTagReplacementValues)) != NULL) {
+		if(SystemFlags::VERBOSE_MODE_ENABLED) printf("Using preloaded tree for file [%s]\n",path.c_str());
+	}
+	else if(this->engine_type == XML_XERCES_ENGINE) {
 		this->rootNode= XmlIo::getInstance().load(path, mapTagReplacementValues, noValidation);
 	}
+	else if(this->engine_type == XML_BINARY_ENGINE) {
+		this->rootNode= XmlIoBinary::getInstance().load(path, mapTagReplacementValues);
+	}
 	else {
 		this->rootNode= XmlIoRapid::getInstance().load(path, mapTagReplacementValues, noValidation,this->skipStackCheck);
 	}
@@ -554,6 +1071,9 @@ void XmlTree::save(const string &path){
 	if(this->engine_type == XML_XERCES_ENGINE) {
 		XmlIo::getInstance().save(path, rootNode);
 	}
+	else if(this->engine_type == XML_BINARY_ENGINE) {
+		XmlIoBinary::getInstance().save(path, rootNode, binaryCompressionLevel);
+	}
 	else {
 		XmlIoRapid::getInstance().save(path, rootNode);
 	}
@@ -639,8 +1159,6 @@ XmlNode::XmlNode(xml_node<> *node, const std::map<string,string> &mapTagReplacem
 
 	//get name
 	name = node->name();
-	children.reserve(1000);
-	attributes.reserve(1000);
 
 	//check document
 	if(node->type() == node_document) {
@@ -0,0 +1,176 @@
+// ==============================================================
+//	This file is part of MegaGlest Unit Tests (www.megaglest.org)
+//
+//	Copyright (C) 2013 Mark Vejvoda
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <vector>
+#include "grid_path_search.h"
+
+using namespace Glest::Game;
+
+// Open rectangle with optional blocked cells, every cell is explored
+class TestGrid {
+private:
+	int width;
+	int height;
+	std::vector<bool> blocked;
+
+public:
+	TestGrid(int width, int height) : width(width), height(height), blocked(width * height, false) {
+	}
+	void block(int x, int y) {
+		blocked[y * width + x] = true;
+	}
+	bool isEnterable(const Vec2i &pos) {
+		return (pos.x >= 0 && pos.y >= 0 && pos.x < width && pos.y < height &&
+				blocked[pos.y * width + pos.x] == false);
+	}
+	bool isExplored(const Vec2i &pos) const {
+		return true;
+	}
+};
+
+class TestNode {
+public:
+	TestNode() : pos(0, 0), next(NULL), prev(NULL) {
+	}
+	Vec2i pos;
+	TestNode *next;
+	TestNode *prev;
+};
+
+// Fixed size node pool like the pathfinder's per faction pool
+class TestNodeSource {
+private:
+	std::vector<TestNode> nodes;
+	unsigned int used;
+
+public:
+	TestNodeSource(int size) : nodes(size), used(0) {
+	}
+	TestNode *newNode() {
+		return (used < nodes.size() ? &nodes[used++] : NULL);
+	}
+};
+
+// builds the next pointers the same way the pathfinder does
+static void linkTestNodes(TestNode *lastNode) {
+	for(TestNode *currNode = lastNode; currNode->prev != NULL; currNode = currNode->prev) {
+		currNode->prev->next = currNode;
+	}
+}
+
+class GridPathSearchTest : public CppUnit::TestFixture {
+	// Register the suite of tests for this fixture
+	CPPUNIT_TEST_SUITE( GridPathSearchTest );
+
+	CPPUNIT_TEST( test_jump_point_distance );
+	CPPUNIT_TEST( test_straight_scan_stops_at_cap );
+	CPPUNIT_TEST( test_diagonal_scan_enters_long_corridor );
+	CPPUNIT_TEST( test_diagonal_scan_blocked );
+	CPPUNIT_TEST( test_flow_path_chained_from_start );
+	CPPUNIT_TEST( test_flow_path_pool_exhausted );
+	CPPUNIT_TEST( test_path_cells_fill_jumps );
+
+	CPPUNIT_TEST_SUITE_END();
+	// End of Fixture registration
+
+	static const int maxDistance = 64;
+
+public:
+
+	void test_jump_point_distance() {
+		CPPUNIT_ASSERT_EQUAL( 0, jumpPointDistance(Vec2i(3, 3), Vec2i(3, 3)) );
+		CPPUNIT_ASSERT_EQUAL( 50, jumpPointDistance(Vec2i(0, 0), Vec2i(5, 0)) );
+		CPPUNIT_ASSERT_EQUAL( 14 * 3 + 10 * 2, jumpPointDistance(Vec2i(0, 0), Vec2i(3, 5)) );
+	}
+
+	void test_straight_scan_stops_at_cap() {
+		TestGrid grid(200, 1);
+		Vec2i jumpPoint;
+		CPPUNIT_ASSERT( findJumpPoint(grid, Vec2i(0, 0), 1, 0, Vec2i(150, 0), maxDistance, jumpPoint) == true );
+		CPPUNIT_ASSERT( jumpPoint == Vec2i(maxDistance, 0) );
+	}
+
+	// A two row corridor much longer than the cap, the only way to the
+	// target is one diagonal step into the lower row followed by a long
+	// straight run, so the diagonal cell must be reported as a jump point
+	void test_diagonal_scan_enters_long_corridor() {
+		TestGrid grid(maxDistance * 3, 2);
+		Vec2i jumpPoint;
+		CPPUNIT_ASSERT( findJumpPoint(grid, Vec2i(0, 0), 1, 1, Vec2i(maxDistance * 2, 1), maxDistance, jumpPoint) == true );
+		CPPUNIT_ASSERT( jumpPoint == Vec2i(1, 1) );
+	}
+
+	void test_diagonal_scan_blocked() {
+		TestGrid grid(10, 10);
+		grid.block(1, 0);
+		Vec2i jumpPoint;
+		// corners are never cut
+		CPPUNIT_ASSERT( findJumpPoint(grid, Vec2i(0, 0), 1, 1, Vec2i(9, 9), maxDistance, jumpPoint) == false );
+	}
+
+	void test_flow_path_chained_from_start() {
+		std::vector<Vec2i> flowPath;
+		flowPath.push_back(Vec2i(1, 1));
+		flowPath.push_back(Vec2i(2, 2));
+		flowPath.push_back(Vec2i(3, 2));
+
+		TestNodeSource nodeSource(10);
+		TestNode *firstNode = nodeSource.newNode();
+		TestNode *lastNode = chainPathNodes(firstNode, flowPath, nodeSource);
+		CPPUNIT_ASSERT( lastNode != firstNode );
+		linkTestNodes(lastNode);
+
+		std::vector<Vec2i> cells;
+		getPathCells(firstNode, cells);
+		CPPUNIT_ASSERT_EQUAL( (int)flowPath.size(), (int)cells.size() );
+		for(unsigned int i = 0; i < cells.size(); ++i) {
+			CPPUNIT_ASSERT( cells[i] == flowPath[i] );
+		}
+	}
+
+	void test_flow_path_pool_exhausted() {
+		std::vector<Vec2i> flowPath;
+		flowPath.push_back(Vec2i(1, 0));
+		flowPath.push_back(Vec2i(2, 0));
+		flowPath.push_back(Vec2i(3, 0));
+
+		TestNodeSource nodeSource(3);
+		TestNode *firstNode = nodeSource.newNode();
+		TestNode *lastNode = chainPathNodes(firstNode, flowPath, nodeSource);
+		CPPUNIT_ASSERT( lastNode->pos == Vec2i(2, 0) );
+		linkTestNodes(lastNode);
+
+		std::vector<Vec2i> cells;
+		getPathCells(firstNode, cells);
+		CPPUNIT_ASSERT_EQUAL( 2, (int)cells.size() );
+	}
+
+	void test_path_cells_fill_jumps() {
+		std::vector<Vec2i> jumpPoints;
+		jumpPoints.push_back(Vec2i(3, 3));
+		jumpPoints.push_back(Vec2i(3, 5));
+
+		TestNodeSource nodeSource(10);
+		TestNode *firstNode = nodeSource.newNode();
+		linkTestNodes(chainPathNodes(firstNode, jumpPoints, nodeSource));
+
+		std::vector<Vec2i> cells;
+		getPathCells(firstNode, cells);
+		CPPUNIT_ASSERT_EQUAL( 5, (int)cells.size() );
+		CPPUNIT_ASSERT( cells[0] == Vec2i(1, 1) );
+		CPPUNIT_ASSERT( cells[2] == Vec2i(3, 3) );
+		CPPUNIT_ASSERT( cells[4] == Vec2i(3, 5) );
+	}
+};
+
+// Suite Registrations
+CPPUNIT_TEST_SUITE_REGISTRATION( GridPathSearchTest );
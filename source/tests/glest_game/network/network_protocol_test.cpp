@@ -0,0 +1,131 @@
+// ==============================================================
+//	This file is part of MegaGlest Unit Tests (www.megaglest.org)
+//
+//	Copyright (C) 2013 Mark Vejvoda
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cstring>
+#include <string>
+#include "data_types.h"
+#include "network_protocol.h"
+
+using namespace Shared::Platform;
+using namespace Glest::Game;
+using std::string;
+
+// The intro layout every release since the packed protocol uses
+static const char *introPackedFormat = "cl128s32shcLL60sc";
+static const int introLanguageSize = 60;
+
+// Fields of an intro as NetworkMessageIntro holds them, strings are zero
+// filled like NetworkString does
+class TestIntro {
+public:
+	int8 messageType;
+	int32 sessionId;
+	char versionString[128];
+	char name[32];
+	int16 playerIndex;
+	int8 gameState;
+	uint32 externalIp;
+	uint32 ftpPort;
+	char language[introLanguageSize];
+	int8 gameInProgress;
+
+	TestIntro() {
+		memset(this, 0, sizeof(*this));
+	}
+	TestIntro(const string &name, const string &language) {
+		memset(this, 0, sizeof(*this));
+		messageType = 1;
+		sessionId = 123456;
+		strncpy(versionString, "v3.8-dev", sizeof(versionString) - 1);
+		strncpy(this->name, name.c_str(), sizeof(this->name) - 1);
+		playerIndex = 3;
+		gameState = 1;
+		externalIp = 0x7F000001;
+		ftpPort = 61358;
+		strncpy(this->language, language.c_str(), sizeof(this->language) - 1);
+		gameInProgress = 1;
+	}
+
+	unsigned int pack(unsigned char *buf) {
+		return Glest::Game::pack(buf, introPackedFormat, messageType, sessionId,
+				versionString, name, playerIndex, gameState, externalIp, ftpPort,
+				language, gameInProgress);
+	}
+	unsigned int unpack(unsigned char *buf) {
+		return Glest::Game::unpack(buf, introPackedFormat, &messageType, &sessionId,
+				versionString, name, &playerIndex, &gameState, &externalIp, &ftpPort,
+				language, &gameInProgress);
+	}
+};
+
+class NetworkProtocolTest : public CppUnit::TestFixture {
+	// Register the suite of tests for this fixture
+	CPPUNIT_TEST_SUITE( NetworkProtocolTest );
+
+	CPPUNIT_TEST( test_old_intro_decodes_as_base_version );
+	CPPUNIT_TEST( test_intro_version_survives_packing );
+	CPPUNIT_TEST( test_intro_version_keeps_layout );
+
+	CPPUNIT_TEST_SUITE_END();
+	// End of Fixture registration
+
+public:
+
+	// an intro sent by a release without protocol versions
+	void test_old_intro_decodes_as_base_version() {
+		TestIntro sent("player", "english");
+		unsigned char buf[1024];
+		sent.pack(buf);
+
+		TestIntro received;
+		received.unpack(buf);
+		CPPUNIT_ASSERT_EQUAL( (int32)123456, received.sessionId );
+		CPPUNIT_ASSERT_EQUAL( string("player"), string(received.name) );
+		CPPUNIT_ASSERT_EQUAL( (int16)3, received.playerIndex );
+		CPPUNIT_ASSERT_EQUAL( (uint32)61358, received.ftpPort );
+		CPPUNIT_ASSERT_EQUAL( string("english"), string(received.language) );
+		CPPUNIT_ASSERT_EQUAL( (int8)1, received.gameInProgress );
+		CPPUNIT_ASSERT_EQUAL( (signed char)0, getIntroProtocolVersion(received.language, introLanguageSize) );
+	}
+
+	void test_intro_version_survives_packing() {
+		TestIntro sent("player", "english");
+		setIntroProtocolVersion(sent.language, introLanguageSize, 1);
+		unsigned char buf[1024];
+		sent.pack(buf);
+
+		TestIntro received;
+		received.unpack(buf);
+		CPPUNIT_ASSERT_EQUAL( (signed char)1, getIntroProtocolVersion(received.language, introLanguageSize) );
+		// what an older peer reads from the same bytes
+		CPPUNIT_ASSERT_EQUAL( string("english"), string(received.language) );
+		CPPUNIT_ASSERT_EQUAL( (int8)1, received.gameInProgress );
+	}
+
+	// an older peer reads exactly as many bytes as it always did
+	void test_intro_version_keeps_layout() {
+		TestIntro oldIntro("player", "english");
+		TestIntro newIntro("player", "a language name that is long enough to run over the protocol version byte");
+		setIntroProtocolVersion(newIntro.language, introLanguageSize, 1);
+		unsigned char oldBuf[1024];
+		unsigned char newBuf[1024];
+		CPPUNIT_ASSERT_EQUAL( oldIntro.pack(oldBuf), newIntro.pack(newBuf) );
+
+		TestIntro received;
+		received.unpack(newBuf);
+		CPPUNIT_ASSERT_EQUAL( (signed char)1, getIntroProtocolVersion(received.language, introLanguageSize) );
+		CPPUNIT_ASSERT_EQUAL( (size_t)(introLanguageSize - 3), strlen(received.language) );
+	}
+};
+
+// Suite Registrations
+CPPUNIT_TEST_SUITE_REGISTRATION( NetworkProtocolTest );
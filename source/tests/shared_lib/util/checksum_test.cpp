@@ -0,0 +1,184 @@
+// ==============================================================
+//	This file is part of MegaGlest Unit Tests (www.megaglest.org)
+//
+//	Copyright (C) 2013 Mark Vejvoda
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include "checksum.h"
+#include "platform_common.h"
+
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace Shared::Util;
+using namespace Shared::PlatformCommon;
+
+static void removeChecksumTestFile(const string &file) {
+#ifdef WIN32
+	_unlink(file.c_str());
+#else
+	unlink(file.c_str());
+#endif
+}
+
+// The checksum of the bytes added one at a time, the way it was
+// computed before addBytes worked on several bytes per step
+static uint32 getByteAtATimeSum(const vector<unsigned char> &data, size_t offset, size_t size) {
+	Checksum checksum;
+	for(size_t i = offset; i < offset + size; ++i) {
+		checksum.addByte((char)data[i]);
+	}
+	return checksum.getSum();
+}
+
+class ChecksumTest : public CppUnit::TestFixture {
+	// Register the suite of tests for this fixture
+	CPPUNIT_TEST_SUITE( ChecksumTest );
+
+	CPPUNIT_TEST( test_known_values );
+	CPPUNIT_TEST( test_addBytes_same_as_addByte );
+	CPPUNIT_TEST( test_addString_same_as_addByte );
+	CPPUNIT_TEST( test_xml_file_ignores_formatting );
+	CPPUNIT_TEST( test_fastSum_chaining );
+
+	CPPUNIT_TEST_SUITE_END();
+	// End of Fixture registration
+
+public:
+
+	void test_known_values() {
+		Checksum checksum;
+		checksum.addBytes("123456789", 9);
+		CPPUNIT_ASSERT_EQUAL( (uint32)0xCBF43926, checksum.getSum() );
+
+		CPPUNIT_ASSERT_EQUAL( (uint32)0xE3069283, Checksum::getFastSum("123456789", 9) );
+	}
+
+	void test_addBytes_same_as_addByte() {
+		vector<unsigned char> data(1024 + 8);
+		for(size_t i = 0; i < data.size(); ++i) {
+			data[i] = (unsigned char)((i * 131 + 7) ^ (i >> 3));
+		}
+		// every alignment and every tail length of the 8 byte steps
+		for(size_t offset = 0; offset < 8; ++offset) {
+			for(size_t size = 0; size <= 1024; size += (size < 64 ? 1 : 61)) {
+				Checksum checksum;
+				checksum.addBytes(&data[offset], size);
+				CPPUNIT_ASSERT_EQUAL( getByteAtATimeSum(data, offset, size), checksum.getSum() );
+			}
+		}
+	}
+
+	void test_addString_same_as_addByte() {
+		const string value = "techs/megapack/factions/magic/units/battlemage";
+		vector<unsigned char> data(value.begin(), value.end());
+
+		Checksum checksum;
+		checksum.addString(value);
+		CPPUNIT_ASSERT_EQUAL( getByteAtATimeSum(data, 0, data.size()), checksum.getSum() );
+	}
+
+	void test_xml_file_ignores_formatting() {
+		const string test_filename_formatted = "checksum_test_formatted.xml";
+		const string test_filename_compact = "checksum_test_compact.xml";
+
+		std::ofstream formattedFile(test_filename_formatted.c_str());
+		formattedFile << "<?xml version=\"1.0\"?>\n"
+				<< "<!-- a comment -->\n"
+				<< "<unit>\r\n\t<size value=\"2\"/>\n"
+				<< "\t<!-- another\n comment -->\n"
+				<< "\t<height value=\"3\"/>\n</unit>\n";
+		formattedFile.close();
+
+		std::ofstream compactFile(test_filename_compact.c_str());
+		compactFile << "<?xmlversion=\"1.0\"?><unit><sizevalue=\"2\"/><heightvalue=\"3\"/></unit>";
+		compactFile.close();
+
+		uint32 formattedSum = Checksum::getFileSum(test_filename_formatted);
+		uint32 compactSum = Checksum::getFileSum(test_filename_compact);
+		removeChecksumTestFile(test_filename_formatted);
+		removeChecksumTestFile(test_filename_compact);
+
+		// the file name is part of the sum, so compare the content only
+		Checksum formattedExpected;
+		formattedExpected.addString(test_filename_formatted);
+		formattedExpected.addString("<?xmlversion=\"1.0\"?><unit><sizevalue=\"2\"/><heightvalue=\"3\"/></unit>");
+		CPPUNIT_ASSERT_EQUAL( formattedExpected.getSum(), formattedSum );
+
+		Checksum compactExpected;
+		compactExpected.addString(test_filename_compact);
+		compactExpected.addString("<?xmlversion=\"1.0\"?><unit><sizevalue=\"2\"/><heightvalue=\"3\"/></unit>");
+		CPPUNIT_ASSERT_EQUAL( compactExpected.getSum(), compactSum );
+	}
+
+	void test_fastSum_chaining() {
+		const char *data = "The quick brown fox jumps over the lazy dog";
+		size_t size = strlen(data);
+		uint32 wholeSum = Checksum::getFastSum(data, size);
+		for(size_t split = 0; split <= size; ++split) {
+			uint32 partSum = Checksum::getFastSum(data, split);
+			partSum = Checksum::getFastSum(data + split, size - split, partSum);
+			CPPUNIT_ASSERT_EQUAL( wholeSum, partSum );
+		}
+	}
+};
+
+// Not a check, prints how fast each way of summing 64MB is. Registered
+// apart from the unit tests so it only runs when asked for with --benchmark
+class ChecksumBenchmark : public CppUnit::TestFixture {
+	// Register the suite of tests for this fixture
+	CPPUNIT_TEST_SUITE( ChecksumBenchmark );
+
+	CPPUNIT_TEST( test_benchmark );
+
+	CPPUNIT_TEST_SUITE_END();
+	// End of Fixture registration
+
+public:
+
+	void test_benchmark() {
+		const size_t dataSize = 64 * 1024 * 1024;
+		vector<unsigned char> data(dataSize);
+		for(size_t i = 0; i < data.size(); ++i) {
+			data[i] = (unsigned char)(i * 2654435761u >> 24);
+		}
+
+		Chrono chrono(true);
+		Checksum byteChecksum;
+		for(size_t i = 0; i < data.size(); ++i) {
+			byteChecksum.addByte((char)data[i]);
+		}
+		int64 byteMillis = chrono.getMillis();
+
+		chrono.start();
+		Checksum bytesChecksum;
+		bytesChecksum.addBytes(&data[0], data.size());
+		int64 bytesMillis = chrono.getMillis();
+
+		chrono.start();
+		uint32 fastSum = Checksum::getFastSum(&data[0], data.size());
+		int64 fastMillis = chrono.getMillis();
+
+		CPPUNIT_ASSERT_EQUAL( byteChecksum.getSum(), bytesChecksum.getSum() );
+
+		printf("\nChecksum of %d MB: addByte %d ms, addBytes %d ms, getFastSum %d ms [%u]\n",
+				(int)(dataSize / (1024 * 1024)),(int)byteMillis,(int)bytesMillis,(int)fastMillis,fastSum);
+	}
+};
+
+// Suite Registrations
+CPPUNIT_TEST_SUITE_REGISTRATION( ChecksumTest );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( ChecksumBenchmark, "benchmark" );
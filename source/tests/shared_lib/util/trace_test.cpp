@@ -0,0 +1,162 @@
+// ==============================================================
+//	This file is part of MegaGlest Unit Tests (www.megaglest.org)
+//
+//	Copyright (C) 2013 Mark Vejvoda
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "trace.h"
+
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace Shared::Util;
+
+enum TraceTestEvent {
+	tteScope,
+	tteCounter,
+
+	tteCount
+};
+
+static const TraceEventType traceTestEventTypes[tteCount] = {
+	{ "test_scope",		"test",	{ "first", "second" } },
+	{ "test_counter",	"test",	{ NULL, NULL } }
+};
+
+static string readTraceTestFile(const string &file) {
+	std::ifstream in(file.c_str());
+	std::stringstream content;
+	content << in.rdbuf();
+	in.close();
+#ifdef WIN32
+	_unlink(file.c_str());
+#else
+	unlink(file.c_str());
+#endif
+	return content.str();
+}
+
+static int countOccurrences(const string &value, const string &find) {
+	int count = 0;
+	for(size_t pos = value.find(find); pos != string::npos; pos = value.find(find, pos + 1)) {
+		count++;
+	}
+	return count;
+}
+
+class TraceTest : public CppUnit::TestFixture {
+	// Register the suite of tests for this fixture
+	CPPUNIT_TEST_SUITE( TraceTest );
+
+	CPPUNIT_TEST( test_disabled_records_nothing );
+	CPPUNIT_TEST( test_export_chrome_trace );
+	CPPUNIT_TEST( test_ring_keeps_last_events );
+	CPPUNIT_TEST( test_scope_ends_after_cleanup );
+	CPPUNIT_TEST( test_released_buffer_is_reused );
+
+	CPPUNIT_TEST_SUITE_END();
+	// End of Fixture registration
+
+public:
+
+	void tearDown() {
+		Tracer::cleanup();
+	}
+
+	void test_disabled_records_nothing() {
+		Tracer::init(traceTestEventTypes, tteCount, 16);
+		Tracer::setEnabled(false);
+		{
+			TRACE_SCOPE_ARGS(tteScope, 1, 2);
+		}
+		Tracer::setEnabled(true);
+		CPPUNIT_ASSERT_EQUAL( (uint32)0, Tracer::getThreadBuffer()->writeCount );
+	}
+
+	void test_export_chrome_trace() {
+		Tracer::init(traceTestEventTypes, tteCount, 16);
+		Tracer::setEnabled(true);
+		Tracer::setThreadName("trace \"test\"");
+		{
+			TRACE_SCOPE_ARGS(tteScope, 7, 0.5f);
+			TRACE_COUNTER(tteCounter, 42);
+		}
+		Tracer::setEnabled(false);
+
+		const string test_filename = "trace_test.json";
+		CPPUNIT_ASSERT( Tracer::exportChromeTrace(test_filename) == true );
+		string trace = readTraceTestFile(test_filename);
+
+		CPPUNIT_ASSERT( trace.find("\"traceEvents\":[") != string::npos );
+		CPPUNIT_ASSERT( trace.find("\"name\":\"trace \\\"test\\\"\"") != string::npos );
+		CPPUNIT_ASSERT( trace.find("\"ph\":\"B\"") != string::npos );
+		CPPUNIT_ASSERT( trace.find("\"ph\":\"E\"") != string::npos );
+		CPPUNIT_ASSERT( trace.find("\"args\":{\"first\":7,\"second\":0.5}") != string::npos );
+		CPPUNIT_ASSERT( trace.find("\"args\":{\"test_counter\":42}") != string::npos );
+	}
+
+	void test_ring_keeps_last_events() {
+		Tracer::init(traceTestEventTypes, tteCount, 4);
+		Tracer::setEnabled(true);
+		for(int i = 0; i < 10; ++i) {
+			TRACE_COUNTER(tteCounter, i);
+		}
+		Tracer::setEnabled(false);
+
+		const string test_filename = "trace_test_ring.json";
+		CPPUNIT_ASSERT( Tracer::exportChromeTrace(test_filename) == true );
+		string trace = readTraceTestFile(test_filename);
+
+		CPPUNIT_ASSERT_EQUAL( 4, countOccurrences(trace, "\"ph\":\"C\"") );
+		CPPUNIT_ASSERT( trace.find("\"test_counter\":5}") == string::npos );
+		// oldest first
+		size_t first = trace.find("\"test_counter\":6}");
+		size_t last = trace.find("\"test_counter\":9}");
+		CPPUNIT_ASSERT( first != string::npos && last != string::npos && first < last );
+	}
+
+	void test_scope_ends_after_cleanup() {
+		Tracer::init(traceTestEventTypes, tteCount, 16);
+		Tracer::setEnabled(true);
+		TraceBuffer *buffer = Tracer::getThreadBuffer();
+		{
+			TRACE_SCOPE(tteScope);
+			Tracer::cleanup();
+		}
+		// the scope ended in the same buffer, which cleanup left empty
+		CPPUNIT_ASSERT( Tracer::getThreadBuffer() == buffer );
+		CPPUNIT_ASSERT_EQUAL( (uint32)0, buffer->writeCount );
+
+		Tracer::init(traceTestEventTypes, tteCount, 16);
+		CPPUNIT_ASSERT_EQUAL( (size_t)16, buffer->events.size() );
+	}
+
+	void test_released_buffer_is_reused() {
+		Tracer::init(traceTestEventTypes, tteCount, 16);
+		Tracer::setEnabled(true);
+		TRACE_COUNTER(tteCounter, 1);
+		TraceBuffer *buffer = Tracer::getThreadBuffer();
+		CPPUNIT_ASSERT_EQUAL( (uint32)1, buffer->writeCount );
+
+		// as if the thread ended and a new one started tracing
+		Tracer::releaseThreadBuffer();
+		CPPUNIT_ASSERT( Tracer::getThreadBuffer() == buffer );
+		CPPUNIT_ASSERT_EQUAL( (uint32)0, buffer->writeCount );
+		Tracer::setEnabled(false);
+	}
+};
+
+// Suite Registrations
+CPPUNIT_TEST_SUITE_REGISTRATION( TraceTest );
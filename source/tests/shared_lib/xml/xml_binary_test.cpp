@@ -0,0 +1,218 @@
+// ==============================================================
+//	This file is part of MegaGlest Unit Tests (www.megaglest.org)
+//
+//	Copyright (C) 2013 Mark Vejvoda
+//
+//	You can redistribute this code and/or modify it under
+//	the terms of the GNU General Public License as published
+//	by the Free Software Foundation; either version 2 of the
+//	License, or (at your option) any later version
+// ==============================================================
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cstdio>
+#include <memory>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include "xml_parser.h"
+#include "conversion.h"
+#include "platform_util.h"
+
+using namespace Shared::Xml;
+using namespace Shared::Platform;
+using namespace Shared::Util;
+using std::vector;
+using std::auto_ptr;
+
+static void removeBinaryTestFile(const string &file) {
+	remove(file.c_str());
+}
+
+static void readBinaryTestFile(const string &file, vector<char> &data) {
+	std::ifstream in(file.c_str(), std::ios::binary);
+	data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void writeBinaryTestFile(const string &file, const vector<char> &data) {
+	std::ofstream out(file.c_str(), std::ios::binary);
+	out.write(&data[0], data.size());
+}
+
+class SafeRemoveBinaryTestFile {
+private:
+	string filename;
+public:
+	SafeRemoveBinaryTestFile(const string &filename) {
+		this->filename = filename;
+	}
+	~SafeRemoveBinaryTestFile() {
+		removeBinaryTestFile(this->filename);
+	}
+};
+
+// A unit like tree: attributes, child text and repeated names
+static XmlNode * createBinaryTestTree(int skillCount) {
+	std::map<string,string> mapTagReplacementValues;
+	XmlNode *rootNode = new XmlNode("unit");
+	rootNode->addAttribute("version", "3.8", mapTagReplacementValues);
+
+	XmlNode *parameters = rootNode->addChild("parameters");
+	parameters->addChild("size")->addAttribute("value", "2", mapTagReplacementValues);
+	parameters->addChild("description", "A unit with \"quotes\" & <brackets>");
+	parameters->addChild("empty");
+
+	XmlNode *skills = rootNode->addChild("skills");
+	for(int i = 0; i < skillCount; ++i) {
+		XmlNode *skill = skills->addChild("skill");
+		skill->addChild("type")->addAttribute("value", "attack", mapTagReplacementValues);
+		skill->addChild("name")->addAttribute("value", "attack_skill_" + intToStr(i), mapTagReplacementValues);
+		skill->addChild("ep-cost")->addAttribute("value", intToStr(i * 10), mapTagReplacementValues);
+	}
+	return rootNode;
+}
+
+// The root text is dropped on load, everything else has to come back
+static void assertSameNode(const XmlNode *expected, const XmlNode *actual, bool compareText) {
+	CPPUNIT_ASSERT_EQUAL( expected->getName(), actual->getName() );
+	if(compareText == true) {
+		CPPUNIT_ASSERT_EQUAL( expected->getText(), actual->getText() );
+	}
+	CPPUNIT_ASSERT_EQUAL( expected->getAttributeCount(), actual->getAttributeCount() );
+	for(unsigned int i = 0; i < expected->getAttributeCount(); ++i) {
+		CPPUNIT_ASSERT_EQUAL( expected->getAttribute(i)->getName(), actual->getAttribute(i)->getName() );
+		CPPUNIT_ASSERT_EQUAL( expected->getAttribute(i)->getValue(), actual->getAttribute(i)->getValue() );
+	}
+	CPPUNIT_ASSERT_EQUAL( expected->getChildCount(), actual->getChildCount() );
+	for(unsigned int i = 0; i < expected->getChildCount(); ++i) {
+		assertSameNode(expected->getChild(i), actual->getChild(i), true);
+	}
+}
+
+class XmlIoBinaryTest : public CppUnit::TestFixture {
+	// Register the suite of tests for this fixture
+	CPPUNIT_TEST_SUITE( XmlIoBinaryTest );
+
+	CPPUNIT_TEST( test_save_load_round_trip );
+	CPPUNIT_TEST( test_save_load_compressed_round_trip );
+	CPPUNIT_TEST( test_is_binary_file );
+	CPPUNIT_TEST_EXCEPTION( test_save_file_null_node,  megaglest_runtime_error );
+	CPPUNIT_TEST_EXCEPTION( test_load_file_missing,  megaglest_runtime_error );
+	CPPUNIT_TEST_EXCEPTION( test_load_file_bad_version,  megaglest_runtime_error );
+	CPPUNIT_TEST_EXCEPTION( test_load_file_truncated,  megaglest_runtime_error );
+	CPPUNIT_TEST_EXCEPTION( test_load_file_compressed_truncated,  megaglest_runtime_error );
+
+	CPPUNIT_TEST_SUITE_END();
+	// End of Fixture registration
+
+public:
+
+	void test_save_load_round_trip() {
+		const string test_filename = "xml_test_binary.mgxb";
+		SafeRemoveBinaryTestFile deleteFile(test_filename);
+
+		auto_ptr<XmlNode> rootNode(createBinaryTestTree(3));
+		XmlIoBinary::getInstance().save(test_filename, rootNode.get());
+
+		vector<char> data;
+		readBinaryTestFile(test_filename, data);
+		CPPUNIT_ASSERT( data.size() > 10 );
+		CPPUNIT_ASSERT_EQUAL( 0, (int)data[5] );
+
+		auto_ptr<XmlNode> loadedNode(XmlIoBinary::getInstance().load(test_filename, std::map<string,string>()));
+		CPPUNIT_ASSERT( loadedNode.get() != NULL );
+		assertSameNode(rootNode.get(), loadedNode.get(), false);
+	}
+
+	void test_save_load_compressed_round_trip() {
+		const string test_filename = "xml_test_binary_compressed.mgxb";
+		SafeRemoveBinaryTestFile deleteFile(test_filename);
+
+		auto_ptr<XmlNode> rootNode(createBinaryTestTree(200));
+		XmlIoBinary::getInstance().save(test_filename, rootNode.get(), 9);
+
+		vector<char> data;
+		readBinaryTestFile(test_filename, data);
+		CPPUNIT_ASSERT( data.size() > 10 );
+		// the compressed flag
+		CPPUNIT_ASSERT_EQUAL( 1, (int)data[5] );
+
+		auto_ptr<XmlNode> loadedNode(XmlIoBinary::getInstance().load(test_filename, std::map<string,string>()));
+		CPPUNIT_ASSERT( loadedNode.get() != NULL );
+		assertSameNode(rootNode.get(), loadedNode.get(), false);
+	}
+
+	void test_is_binary_file() {
+		const string test_filename = "xml_test_binary_check.mgxb";
+		const string test_filename_text = "xml_test_binary_check.xml";
+		SafeRemoveBinaryTestFile deleteFile(test_filename);
+		SafeRemoveBinaryTestFile deleteFile2(test_filename_text);
+
+		auto_ptr<XmlNode> rootNode(createBinaryTestTree(1));
+		XmlIoBinary::getInstance().save(test_filename, rootNode.get());
+		std::ofstream xmlFile(test_filename_text.c_str());
+		xmlFile << "<?xml version=\"1.0\"?>" << std::endl << "<menu/>" << std::endl;
+		xmlFile.close();
+
+		CPPUNIT_ASSERT( XmlIoBinary::isBinaryFile(test_filename) == true );
+		CPPUNIT_ASSERT( XmlIoBinary::isBinaryFile(test_filename_text) == false );
+		CPPUNIT_ASSERT( XmlIoBinary::isBinaryFile("/some/path/that/does/not exist") == false );
+	}
+
+	void test_save_file_null_node() {
+		XmlNode *rootNode = NULL;
+		XmlIoBinary::getInstance().save("xml_test_binary_null.mgxb",rootNode);
+	}
+
+	void test_load_file_missing() {
+		XmlIoBinary::getInstance().load("/some/path/that/does/not exist", std::map<string,string>());
+	}
+
+	void test_load_file_bad_version() {
+		const string test_filename = "xml_test_binary_version.mgxb";
+		SafeRemoveBinaryTestFile deleteFile(test_filename);
+
+		auto_ptr<XmlNode> rootNode(createBinaryTestTree(3));
+		XmlIoBinary::getInstance().save(test_filename, rootNode.get());
+
+		vector<char> data;
+		readBinaryTestFile(test_filename, data);
+		data[4] = 99;
+		writeBinaryTestFile(test_filename, data);
+
+		XmlIoBinary::getInstance().load(test_filename, std::map<string,string>());
+	}
+
+	void test_load_file_truncated() {
+		const string test_filename = "xml_test_binary_truncated.mgxb";
+		SafeRemoveBinaryTestFile deleteFile(test_filename);
+
+		auto_ptr<XmlNode> rootNode(createBinaryTestTree(3));
+		XmlIoBinary::getInstance().save(test_filename, rootNode.get());
+
+		vector<char> data;
+		readBinaryTestFile(test_filename, data);
+		data.resize(data.size() / 2);
+		writeBinaryTestFile(test_filename, data);
+
+		XmlIoBinary::getInstance().load(test_filename, std::map<string,string>());
+	}
+
+	void test_load_file_compressed_truncated() {
+		const string test_filename = "xml_test_binary_compressed_truncated.mgxb";
+		SafeRemoveBinaryTestFile deleteFile(test_filename);
+
+		auto_ptr<XmlNode> rootNode(createBinaryTestTree(200));
+		XmlIoBinary::getInstance().save(test_filename, rootNode.get(), 9);
+
+		vector<char> data;
+		readBinaryTestFile(test_filename, data);
+		data.resize(data.size() / 2);
+		writeBinaryTestFile(test_filename, data);
+
+		XmlIoBinary::getInstance().load(test_filename, std::map<string,string>());
+	}
+};
+
+// Suite Registrations
+CPPUNIT_TEST_SUITE_REGISTRATION( XmlIoBinaryTest );
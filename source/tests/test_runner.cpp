@@ -1,12 +1,17 @@
 #include <cppunit/CompilerOutputter.h>
 #include <cppunit/extensions/TestFactoryRegistry.h>
 #include <cppunit/ui/text/TestRunner.h>
+#include <cstring>
 
 
 int main(int argc, char* argv[])
 {
-  // Get the top level suite from the registry
-  CppUnit::Test *suite = CppUnit::TestFactoryRegistry::getRegistry().makeTest();
+  // Get the top level suite from the registry, benchmarks are kept in
+  // their own registry and only run with --benchmark
+  bool runBenchmarks = (argc > 1 && strcmp(argv[1], "--benchmark") == 0);
+  CppUnit::Test *suite = (runBenchmarks == true ?
+      CppUnit::TestFactoryRegistry::getRegistry("benchmark").makeTest() :
+      CppUnit::TestFactoryRegistry::getRegistry().makeTest());
 
   // Adds the test to the list of test to run
   CppUnit::TextUi::TestRunner runner;